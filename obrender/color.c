@@ -117,6 +117,13 @@ void RrColorFree(RrColor* c) {
   }
 }
 
+gboolean RrDepthIsNative(const RrInstance* inst, const XImage* im) {
+  return im->bits_per_pixel == 32 && im->bytes_per_line == im->width * 4 &&
+         im->byte_order == (G_BYTE_ORDER == G_LITTLE_ENDIAN ? LSBFirst : MSBFirst) &&
+         RrVisual(inst)->class == TrueColor && RrRedOffset(inst) == RrDefaultRedOffset &&
+         RrGreenOffset(inst) == RrDefaultGreenOffset && RrBlueOffset(inst) == RrDefaultBlueOffset;
+}
+
 void RrReduceDepth(const RrInstance* inst, RrPixel32* data, XImage* im) {
   gint r, g, b;
   gint x, y;
@@ -266,6 +273,16 @@ void RrIncreaseDepth(const RrInstance* inst, RrPixel32* data, XImage* im) {
   RrPixel16* p16 = (RrPixel16*)im->data;
   guchar* p8 = (guchar*)im->data;
 
+  if (RrDepthIsNative(inst, im)) {
+    const gsize n = (gsize)im->width * (gsize)im->height;
+    gsize i;
+
+    /* only the alpha channel needs filling in */
+    for (i = 0; i < n; ++i)
+      data[i] = p32[i] | ((guint)0xff << RrDefaultAlphaOffset);
+    return;
+  }
+
   if (im->byte_order != LSBFirst)
     swap_byte_order(im);
 
@@ -47,5 +47,8 @@ void RrColorAllocateGC(RrColor* in);
 XColor* RrPickColor(const RrInstance* inst, gint r, gint g, gint b);
 void RrReduceDepth(const RrInstance* inst, RrPixel32* data, XImage* im);
 void RrIncreaseDepth(const RrInstance* inst, RrPixel32* data, XImage* im);
+/*! Returns TRUE if the image's pixels are laid out exactly like RrPixel32s,
+  so they can be copied to and from it without any conversion */
+gboolean RrDepthIsNative(const RrInstance* inst, const XImage* im);
 
 #endif /* __color_h */
@@ -31,6 +31,117 @@
 #include <stdlib.h>
 #include <locale.h>
 
+/* the most laid out strings that are kept for each font */
+#define LAYOUT_CACHE_SIZE 256
+
+/*! A string laid out with some settings, kept so that measuring and drawing
+  it again doesn't have to shape it again */
+typedef struct _RrFontLayout {
+  gchar* text;
+  gint width; /* in pango units, or -1 */
+  PangoEllipsizeMode ellipsize;
+  gboolean flow;
+  gint shortcut; /* the byte to underline, or -1 */
+
+  PangoLayout* layout;
+  GList link;
+} RrFontLayout;
+
+struct _RrFontLayoutCache {
+  /* RrFontLayouts, which are their own keys */
+  GHashTable* table;
+  /* the most recently used at the head */
+  GQueue lru;
+};
+
+static guint layout_hash(gconstpointer p) {
+  const RrFontLayout* l = p;
+  guint h = g_str_hash(l->text);
+
+  h = h * 31 + (guint)l->width;
+  h = h * 31 + (guint)l->ellipsize;
+  h = h * 31 + (guint)l->flow;
+  h = h * 31 + (guint)l->shortcut;
+  return h;
+}
+
+static gboolean layout_equal(gconstpointer pa, gconstpointer pb) {
+  const RrFontLayout *a = pa, *b = pb;
+
+  return a->width == b->width && a->ellipsize == b->ellipsize && a->flow == b->flow &&
+         a->shortcut == b->shortcut && !strcmp(a->text, b->text);
+}
+
+static void layout_free(gpointer p) {
+  RrFontLayout* l = p;
+
+  g_object_unref(l->layout);
+  g_free(l->text);
+  g_slice_free(RrFontLayout, l);
+}
+
+/* finds the string laid out with the given settings, or lays it out if it
+   hasn't been lately */
+static PangoLayout* font_layout(const RrFont* f,
+                                const gchar* text,
+                                gint width,
+                                PangoEllipsizeMode ellipsize,
+                                gboolean flow,
+                                gint shortcut) {
+  RrFontLayoutCache* c = f->layouts;
+  RrFontLayout key, *l;
+
+  key.text = (gchar*)text;
+  key.width = width;
+  key.ellipsize = ellipsize;
+  key.flow = flow;
+  key.shortcut = shortcut;
+
+  if ((l = g_hash_table_lookup(c->table, &key))) {
+    g_queue_unlink(&c->lru, &l->link);
+    g_queue_push_head_link(&c->lru, &l->link);
+    return l->layout;
+  }
+
+  l = g_slice_new(RrFontLayout);
+  *l = key;
+  l->text = g_strdup(text);
+
+  l->layout = pango_layout_new(f->inst->pango);
+  pango_layout_set_font_description(l->layout, f->font_desc);
+  pango_layout_set_wrap(l->layout, PANGO_WRAP_WORD_CHAR);
+  pango_layout_set_single_paragraph_mode(l->layout, !flow);
+  pango_layout_set_width(l->layout, width);
+  pango_layout_set_ellipsize(l->layout, ellipsize);
+  if (shortcut >= 0) {
+    const gchar* s = text + shortcut;
+    PangoAttrList* attrlist = pango_attr_list_new();
+    PangoAttribute* underline = pango_attr_underline_new(PANGO_UNDERLINE_SINGLE);
+
+    underline->start_index = shortcut;
+    underline->end_index = shortcut + (g_utf8_next_char(s) - s);
+    /* the attribute is owned by the attrlist, which is owned by the
+       layout */
+    pango_attr_list_insert(attrlist, underline);
+    pango_layout_set_attributes(l->layout, attrlist);
+    pango_attr_list_unref(attrlist);
+  }
+  pango_layout_set_text(l->layout, text, -1);
+
+  l->link.data = l;
+  l->link.prev = l->link.next = NULL;
+  g_queue_push_head_link(&c->lru, &l->link);
+  g_hash_table_insert(c->table, l, l);
+
+  if (c->lru.length > LAYOUT_CACHE_SIZE) {
+    RrFontLayout* old = c->lru.tail->data;
+
+    g_queue_unlink(&c->lru, &old->link);
+    g_hash_table_remove(c->table, old);
+  }
+  return l->layout;
+}
+
 static void measure_font(const RrInstance* inst, RrFont* f) {
   PangoFontMetrics* metrics;
   static PangoLanguage* lang = NULL;
@@ -63,23 +174,14 @@ RrFont* RrFontOpen(const RrInstance* inst, const gchar* name, gint size, RrFontW
   RrFont* out;
   PangoWeight pweight;
   PangoStyle pstyle;
-  PangoAttrList* attrlist;
 
   out = g_slice_new(RrFont);
   out->inst = inst;
   out->ref = 1;
   out->font_desc = pango_font_description_new();
-  out->layout = pango_layout_new(inst->pango);
-  out->shortcut_underline = pango_attr_underline_new(PANGO_UNDERLINE_SINGLE);
-  out->shortcut_underline->start_index = 0;
-  out->shortcut_underline->end_index = 0;
-
-  attrlist = pango_attr_list_new();
-  /* shortcut_underline is owned by the attrlist */
-  pango_attr_list_insert(attrlist, out->shortcut_underline);
-  /* the attributes are owned by the layout */
-  pango_layout_set_attributes(out->layout, attrlist);
-  pango_attr_list_unref(attrlist);
+  out->layouts = g_slice_new(RrFontLayoutCache);
+  out->layouts->table = g_hash_table_new_full(layout_hash, layout_equal, NULL, layout_free);
+  g_queue_init(&out->layouts->lru);
 
   switch (weight) {
     case RR_FONTWEIGHT_LIGHT:
@@ -121,10 +223,6 @@ RrFont* RrFontOpen(const RrInstance* inst, const gchar* name, gint size, RrFontW
   pango_font_description_set_style(out->font_desc, pstyle);
   pango_font_description_set_size(out->font_desc, size * PANGO_SCALE);
 
-  /* setup the layout */
-  pango_layout_set_font_description(out->layout, out->font_desc);
-  pango_layout_set_wrap(out->layout, PANGO_WRAP_WORD_CHAR);
-
   /* get the ascent and descent */
   measure_font(inst, out);
 
@@ -142,7 +240,8 @@ void RrFontRef(RrFont* f) {
 void RrFontClose(RrFont* f) {
   if (f) {
     if (--f->ref < 1) {
-      g_object_unref(f->layout);
+      g_hash_table_destroy(f->layouts->table);
+      g_slice_free(RrFontLayoutCache, f->layouts);
       pango_font_description_free(f->font_desc);
       g_slice_free(RrFont, f);
     }
@@ -157,24 +256,18 @@ static void font_measure_full(const RrFont* f,
                               gint shadow_y,
                               gboolean flow,
                               gint maxwidth) {
+  PangoLayout* layout;
   PangoRectangle rect;
 
-  pango_layout_set_text(f->layout, str, -1);
-  if (flow) {
-    pango_layout_set_single_paragraph_mode(f->layout, FALSE);
-    pango_layout_set_width(f->layout, maxwidth * PANGO_SCALE);
-    pango_layout_set_ellipsize(f->layout, PANGO_ELLIPSIZE_NONE);
-  }
-  else {
+  if (flow)
+    layout = font_layout(f, str, maxwidth * PANGO_SCALE, PANGO_ELLIPSIZE_NONE, TRUE, -1);
+  else
     /* single line mode */
-    pango_layout_set_single_paragraph_mode(f->layout, TRUE);
-    pango_layout_set_width(f->layout, -1);
-    pango_layout_set_ellipsize(f->layout, PANGO_ELLIPSIZE_MIDDLE);
-  }
+    layout = font_layout(f, str, -1, PANGO_ELLIPSIZE_MIDDLE, FALSE, -1);
 
   /* pango_layout_get_pixel_extents lies! this is the right way to get the
      size of the text's area */
-  pango_layout_get_extents(f->layout, NULL, &rect);
+  pango_layout_get_extents(layout, NULL, &rect);
 #if PANGO_VERSION_MAJOR > 1 || (PANGO_VERSION_MAJOR == 1 && PANGO_VERSION_MINOR >= 16)
   /* pass the logical rect as the ink rect, this is on purpose so we get the
      full area for the text */
@@ -233,7 +326,7 @@ void RrFontDraw(XftDraw* d, RrTextureText* t, RrRect* area) {
   XftColor c;
   gint mw;
   PangoRectangle rect;
-  PangoAttrList* attrlist;
+  PangoLayout* layout;
   PangoEllipsizeMode ell;
 
   g_assert(!t->flow || t->maxwidth > 0);
@@ -276,14 +369,10 @@ void RrFontDraw(XftDraw* d, RrTextureText* t, RrRect* area) {
     }
   }
 
-  pango_layout_set_text(t->font->layout, t->string, -1);
-  pango_layout_set_width(t->font->layout, w * PANGO_SCALE);
-  pango_layout_set_ellipsize(t->font->layout, ell);
-  pango_layout_set_single_paragraph_mode(t->font->layout, !t->flow);
-
-  /* * * end of setting up the layout * * */
+  /* the shadow is drawn without the shortcut underlined */
+  layout = font_layout(t->font, t->string, w * PANGO_SCALE, ell, t->flow, -1);
 
-  pango_layout_get_pixel_extents(t->font->layout, NULL, &rect);
+  pango_layout_get_pixel_extents(layout, NULL, &rect);
   mw = rect.width;
 
   /* pango_layout_set_alignment doesn't work with
@@ -320,14 +409,14 @@ void RrFontDraw(XftDraw* d, RrTextureText* t, RrRect* area) {
     if (!t->flow) {
       pango_xft_render_layout_line(d, &c,
 #if PANGO_VERSION_MAJOR > 1 || (PANGO_VERSION_MAJOR == 1 && PANGO_VERSION_MINOR >= 16)
-                                   pango_layout_get_line_readonly(t->font->layout, 0),
+                                   pango_layout_get_line_readonly(layout, 0),
 #else
-                                   pango_layout_get_line(t->font->layout, 0),
+                                   pango_layout_get_line(layout, 0),
 #endif
                                    (x + t->shadow_offset_x) * PANGO_SCALE, (y + t->shadow_offset_y) * PANGO_SCALE);
     }
     else {
-      pango_xft_render_layout(d, &c, t->font->layout, (x + t->shadow_offset_x) * PANGO_SCALE,
+      pango_xft_render_layout(d, &c, layout, (x + t->shadow_offset_x) * PANGO_SCALE,
                               (y + t->shadow_offset_y) * PANGO_SCALE);
     }
   }
@@ -338,45 +427,21 @@ void RrFontDraw(XftDraw* d, RrTextureText* t, RrRect* area) {
   c.color.alpha = 0xff | 0xff << 8; /* fully opaque text */
   c.pixel = t->color->pixel;
 
-  if (t->shortcut) {
-    const gchar* s = t->string + t->shortcut_pos;
-
-    t->font->shortcut_underline->start_index = t->shortcut_pos;
-    t->font->shortcut_underline->end_index = t->shortcut_pos + (g_utf8_next_char(s) - s);
-
-    /* the attributes are owned by the layout.
-       re-add the attributes to the layout after changing the
-       start and end index */
-    attrlist = pango_layout_get_attributes(t->font->layout);
-    pango_attr_list_ref(attrlist);
-    pango_layout_set_attributes(t->font->layout, attrlist);
-    pango_attr_list_unref(attrlist);
-  }
+  if (t->shortcut)
+    layout = font_layout(t->font, t->string, w * PANGO_SCALE, ell, t->flow, t->shortcut_pos);
 
   /* layout_line() uses y to specify the baseline
      The line doesn't need to be freed, it's a part of the layout */
   if (!t->flow) {
     pango_xft_render_layout_line(d, &c,
 #if PANGO_VERSION_MAJOR > 1 || (PANGO_VERSION_MAJOR == 1 && PANGO_VERSION_MINOR >= 16)
-                                 pango_layout_get_line_readonly(t->font->layout, 0),
+                                 pango_layout_get_line_readonly(layout, 0),
 #else
-                                 pango_layout_get_line(t->font->layout, 0),
+                                 pango_layout_get_line(layout, 0),
 #endif
                                  x * PANGO_SCALE, y * PANGO_SCALE);
   }
   else {
-    pango_xft_render_layout(d, &c, t->font->layout, x * PANGO_SCALE, y * PANGO_SCALE);
-  }
-
-  if (t->shortcut) {
-    t->font->shortcut_underline->start_index = 0;
-    t->font->shortcut_underline->end_index = 0;
-    /* the attributes are owned by the layout.
-       re-add the attributes to the layout after changing the
-       start and end index */
-    attrlist = pango_layout_get_attributes(t->font->layout);
-    pango_attr_list_ref(attrlist);
-    pango_layout_set_attributes(t->font->layout, attrlist);
-    pango_attr_list_unref(attrlist);
+    pango_xft_render_layout(d, &c, layout, x * PANGO_SCALE, y * PANGO_SCALE);
   }
 }
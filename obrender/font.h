@@ -23,14 +23,16 @@
 #include "geom.h"
 #include <pango/pango.h>
 
+typedef struct _RrFontLayoutCache RrFontLayoutCache;
+
 struct _RrFont {
   const RrInstance* inst;
   gint ref;
   PangoFontDescription* font_desc;
-  PangoLayout* layout;                /*!< Used for measuring and rendering strings */
-  PangoAttribute* shortcut_underline; /*< For underlining the shortcut key */
-  gint ascent;                        /*!< The font's ascent in pango-units */
-  gint descent;                       /*!< The font's descent in pango-units */
+  RrFontLayoutCache* layouts; /*!< The strings most recently measured and
+                                   rendered, already laid out */
+  gint ascent;                 /*!< The font's ascent in pango-units */
+  gint descent;                /*!< The font's descent in pango-units */
 };
 
 void RrFontDraw(XftDraw* d, RrTextureText* t, RrRect* position);
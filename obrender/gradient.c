@@ -21,10 +21,12 @@
 #include "render.h"
 #include "gradient.h"
 #include "color.h"
+#include "simd.h"
 #include <glib.h>
 #include <string.h>
 
 static void highlight(RrSurface* s, RrPixel32* x, RrPixel32* y, gboolean raised);
+static void highlight_row(RrSurface* s, RrPixel32* x, RrPixel32* y, gint n, gboolean raised);
 static void gradient_parentrelative(RrAppearance* a, gint w, gint h);
 static void gradient_solid(RrAppearance* l, gint w, gint h);
 static void gradient_splitvertical(RrAppearance* a, gint w, gint h);
@@ -83,9 +85,8 @@ void RrRender(RrAppearance* a, gint w, gint h) {
     b = a->surface.interlace_color->b;
     current = ((guint)r << RrDefaultRedOffset) + ((guint)g << RrDefaultGreenOffset) + ((guint)b << RrDefaultBlueOffset);
     p = data;
-    for (i = 0; i < h; i += 2, p += w)
-      for (x = 0; x < w; ++x, ++p)
-        *p = current;
+    for (i = 0; i < h; i += 2, p += 2 * w)
+      RrSimd()->fill(p, current, w);
   }
 
   if (a->surface.relief == RR_RELIEF_FLAT && a->surface.border) {
@@ -105,15 +106,13 @@ void RrRender(RrAppearance* a, gint w, gint h) {
 
   if (a->surface.relief != RR_RELIEF_FLAT) {
     if (a->surface.bevel == RR_BEVEL_1) {
-      for (off = 1, x = 1; x < w - 1; ++x, off++)
-        highlight(&a->surface, data + off, data + off + (h - 1) * w, a->surface.relief == RR_RELIEF_RAISED);
+      highlight_row(&a->surface, data + 1, data + 1 + (h - 1) * w, w - 2, a->surface.relief == RR_RELIEF_RAISED);
       for (off = 0, x = 0; x < h; ++x, off++)
         highlight(&a->surface, data + off * w, data + off * w + w - 1, a->surface.relief == RR_RELIEF_RAISED);
     }
 
     if (a->surface.bevel == RR_BEVEL_2) {
-      for (off = 2, x = 2; x < w - 2; ++x, off++)
-        highlight(&a->surface, data + off + w, data + off + (h - 2) * w, a->surface.relief == RR_RELIEF_RAISED);
+      highlight_row(&a->surface, data + 2 + w, data + 2 + (h - 2) * w, w - 4, a->surface.relief == RR_RELIEF_RAISED);
       for (off = 1, x = 1; x < h - 1; ++x, off++)
         highlight(&a->surface, data + off * w + 1, data + off * w + w - 2, a->surface.relief == RR_RELIEF_RAISED);
     }
@@ -156,6 +155,23 @@ static void highlight(RrSurface* s, RrPixel32* x, RrPixel32* y, gboolean raised)
   *down = ((guint)r << RrDefaultRedOffset) + ((guint)g << RrDefaultGreenOffset) + ((guint)b << RrDefaultBlueOffset);
 }
 
+/* highlight() for a run of pixels along a row */
+static void highlight_row(RrSurface* s, RrPixel32* x, RrPixel32* y, gint n, gboolean raised) {
+  if (n <= 0)
+    return;
+
+  /* the vector kernels only have room for adjustments up to 256 */
+  if (s->bevel_light_adjust <= 256 && s->bevel_dark_adjust <= 256) {
+    if (raised)
+      RrSimd()->highlight(x, y, n, s->bevel_light_adjust, s->bevel_dark_adjust);
+    else
+      RrSimd()->highlight(y, x, n, s->bevel_light_adjust, s->bevel_dark_adjust);
+  }
+  else
+    for (; n > 0; --n)
+      highlight(s, x++, y++, raised);
+}
+
 static void create_bevel_colors(RrAppearance* l) {
   register gint r, g, b;
 
@@ -190,33 +206,7 @@ static inline void repeat_pixel(RrPixel32* start, gint w) {
   if (w <= 1)
     return; /* nothing to do or 1 pixel wide */
 
-  /* copy the first pixel into the next 3 so we have 4 identical pixels to double from */
-  RrPixel32* dest = start + 1;
-  if (w < 8) {
-    for (gint x = w - 1; x > 0; --x)
-      *(dest++) = *start;
-    return;
-  }
-
-  for (gint x = 3; x > 0; --x)
-    *(dest++) = *start;
-
-  /* exponentially copy non-overlapping chunks until row is filled */
-  char* cdest = (char*)dest;               /* byte-wise pointer math */
-  size_t lenbytes = 4 * sizeof(RrPixel32); /* current chunk to copy from start */
-  size_t remaining = (size_t)(w - 4) * sizeof(RrPixel32);
-
-  while (remaining > 0) {
-    size_t copied = lenbytes;
-    if (copied > remaining)
-      copied = remaining;
-    memcpy(cdest, start, copied); /* safe because source and dest do not overlap */
-    cdest += copied;
-    remaining -= copied;
-    lenbytes <<= 1;
-    if (lenbytes > remaining)
-      lenbytes = remaining;
-  }
+  RrSimd()->fill(start + 1, *start, w - 1);
 }
 
 static void gradient_parentrelative(RrAppearance* a, gint w, gint h) {
@@ -272,7 +262,6 @@ static void gradient_parentrelative(RrAppearance* a, gint w, gint h) {
 }
 
 static void gradient_solid(RrAppearance* l, gint w, gint h) {
-  register gint i;
   RrPixel32 pix;
   RrPixel32* data = l->surface.pixel_data;
   RrSurface* sp = &l->surface;
@@ -281,8 +270,7 @@ static void gradient_solid(RrAppearance* l, gint w, gint h) {
   pix = ((guint)sp->primary->r << RrDefaultRedOffset) + ((guint)sp->primary->g << RrDefaultGreenOffset) +
         ((guint)sp->primary->b << RrDefaultBlueOffset);
 
-  for (i = 0; i < w * h; i++)
-    *data++ = pix;
+  RrSimd()->fill(data, pix, w * h);
 
   if (sp->interlaced)
     return;
@@ -601,108 +589,149 @@ static void gradient_vertical(RrSurface* sf, gint w, gint h) {
   }
 }
 
-static void gradient_diagonal(RrSurface* sf, gint w, gint h) {
-  register gint x, y;
-  RrPixel32* data = sf->pixel_data;
-  RrColor left, right;
-  RrColor extracorner;
-
-  VARS(lefty);
-  VARS(righty);
-  VARS(x);
-
-  extracorner.r = (sf->primary->r + sf->secondary->r) / 2;
-  extracorner.g = (sf->primary->g + sf->secondary->g) / 2;
-  extracorner.b = (sf->primary->b + sf->secondary->b) / 2;
+/* The diagonal gradients step every row from its own left color to its own
+   right color, one channel at a time in the NEXT macro.  Within a row a
+   channel changes at most once per pixel (unless the row is narrower than
+   the color difference), so rather than stepping every pixel this finds
+   where each channel changes and fills the runs in between.  A row of pixels
+   is then the three channel rows put together.
+
+   Like the x variables in the original loops, the error terms are carried
+   over from one row to the next. */
+typedef struct _RrChannelRows {
+  RrPixel32* row[3];
+  gint error[3];
+} RrChannelRows;
+
+static void channel_rows_init(RrChannelRows* c, gint len) {
+  c->row[0] = g_new(RrPixel32, (gsize)len * 3);
+  c->row[1] = c->row[0] + len;
+  c->row[2] = c->row[1] + len;
+  c->error[0] = c->error[1] = c->error[2] = 0;
+}
 
-  SETUP(lefty, sf->primary, (&extracorner), h);
-  SETUP(righty, (&extracorner), sf->secondary, h);
+static void channel_rows_free(RrChannelRows* c) {
+  g_free(c->row[0]);
+}
 
-  for (y = h - 1; y > 0; --y) { /* 0 -> h-1 */
-    COLOR_RR(lefty, (&left));
-    COLOR_RR(righty, (&right));
+/* the same steps as SETUP and NEXT take for a single channel, NEXT being
+   run between each of the @len pixels */
+static void channel_ramp(RrPixel32* out, gint from, gint to, gint len, gint shift, gint* error) {
+  gint color = from, cdelta = to - from, inc = 1, x;
 
-    SETUP(x, (&left), (&right), w);
+  if (!cdelta) {
+    RrSimd()->fill(out, (guint)color << shift, len);
+    return;
+  }
+  if (cdelta < 0) {
+    cdelta = -cdelta;
+    inc = -1;
+  }
 
-    for (x = w - 1; x > 0; --x) { /* 0 -> w-1 */
-      *(data++) = COLOR(x);
+  if (cdelta <= len) {
+    /* the color changes on the k'th step, the first where
+       (error + k * cdelta) * 2 >= len */
+    for (x = 0; x < len;) {
+      gint k = (len - 2 * *error + 2 * cdelta - 1) / (2 * cdelta);
 
-      NEXT(x);
+      if (x + k >= len) {
+        RrSimd()->fill(out + x, (guint)color << shift, len - x);
+        *error += (len - 1 - x) * cdelta;
+        break;
+      }
+      RrSimd()->fill(out + x, (guint)color << shift, k);
+      *error += k * cdelta - len;
+      color += inc;
+      x += k;
     }
-    *(data++) = COLOR(x);
-
-    NEXT(lefty);
-    NEXT(righty);
   }
-  COLOR_RR(lefty, (&left));
-  COLOR_RR(righty, (&right));
-
-  SETUP(x, (&left), (&right), w);
-
-  for (x = w - 1; x > 0; --x) { /* 0 -> w-1 */
-    *(data++) = COLOR(x);
-
-    NEXT(x);
+  else {
+    for (x = 0; x < len; ++x) {
+      out[x] = (guint)color << shift;
+      if (x == len - 1)
+        break;
+      while (1) {
+        color += inc;
+        *error += len;
+        if ((*error * 2) >= cdelta) {
+          *error -= cdelta;
+          break;
+        }
+      }
+    }
   }
-  *data = COLOR(x);
 }
 
-static void gradient_crossdiagonal(RrSurface* sf, gint w, gint h) {
-  register gint x, y;
+/* fill @out with the row stepping from @left to @right */
+static void channel_rows_draw(RrChannelRows* c, RrPixel32* out, const RrColor* left, const RrColor* right, gint len) {
+  channel_ramp(c->row[0], left->r, right->r, len, RrDefaultRedOffset, &c->error[0]);
+  channel_ramp(c->row[1], left->g, right->g, len, RrDefaultGreenOffset, &c->error[1]);
+  channel_ramp(c->row[2], left->b, right->b, len, RrDefaultBlueOffset, &c->error[2]);
+  RrSimd()->combine(out, c->row[0], c->row[1], c->row[2], len);
+}
+
+static void gradient_diagonal_rows(RrSurface* sf,
+                                   gint w,
+                                   gint h,
+                                   const RrColor* lfrom,
+                                   const RrColor* lto,
+                                   const RrColor* rfrom,
+                                   const RrColor* rto) {
+  register gint y;
   RrPixel32* data = sf->pixel_data;
   RrColor left, right;
-  RrColor extracorner;
+  RrChannelRows rows;
 
   VARS(lefty);
   VARS(righty);
-  VARS(x);
-
-  extracorner.r = (sf->primary->r + sf->secondary->r) / 2;
-  extracorner.g = (sf->primary->g + sf->secondary->g) / 2;
-  extracorner.b = (sf->primary->b + sf->secondary->b) / 2;
 
-  SETUP(lefty, (&extracorner), sf->secondary, h);
-  SETUP(righty, sf->primary, (&extracorner), h);
+  SETUP(lefty, lfrom, lto, h);
+  SETUP(righty, rfrom, rto, h);
 
-  for (y = h - 1; y > 0; --y) { /* 0 -> h-1 */
+  channel_rows_init(&rows, w);
+  for (y = h; y > 0; --y) { /* 0 -> h-1 */
     COLOR_RR(lefty, (&left));
     COLOR_RR(righty, (&right));
 
-    SETUP(x, (&left), (&right), w);
-
-    for (x = w - 1; x > 0; --x) { /* 0 -> w-1 */
-      *(data++) = COLOR(x);
-
-      NEXT(x);
-    }
-    *(data++) = COLOR(x);
+    channel_rows_draw(&rows, data, &left, &right, w);
+    data += w;
 
     NEXT(lefty);
     NEXT(righty);
   }
-  COLOR_RR(lefty, (&left));
-  COLOR_RR(righty, (&right));
+  channel_rows_free(&rows);
+}
 
-  SETUP(x, (&left), (&right), w);
+static void gradient_diagonal(RrSurface* sf, gint w, gint h) {
+  RrColor extracorner;
 
-  for (x = w - 1; x > 0; --x) { /* 0 -> w-1 */
-    *(data++) = COLOR(x);
+  extracorner.r = (sf->primary->r + sf->secondary->r) / 2;
+  extracorner.g = (sf->primary->g + sf->secondary->g) / 2;
+  extracorner.b = (sf->primary->b + sf->secondary->b) / 2;
 
-    NEXT(x);
-  }
-  *data = COLOR(x);
+  gradient_diagonal_rows(sf, w, h, sf->primary, &extracorner, &extracorner, sf->secondary);
+}
+
+static void gradient_crossdiagonal(RrSurface* sf, gint w, gint h) {
+  RrColor extracorner;
+
+  extracorner.r = (sf->primary->r + sf->secondary->r) / 2;
+  extracorner.g = (sf->primary->g + sf->secondary->g) / 2;
+  extracorner.b = (sf->primary->b + sf->secondary->b) / 2;
+
+  gradient_diagonal_rows(sf, w, h, &extracorner, sf->secondary, sf->primary, &extracorner);
 }
 
 static void gradient_pyramid(RrSurface* sf, gint w, gint h) {
-  RrPixel32 *ldata, *rdata;
+  RrPixel32* ldata;
   RrPixel32* cp;
   RrColor left, right;
   RrColor extracorner;
-  register gint x, y, halfw, halfh, midx, midy;
+  RrChannelRows rows;
+  register gint y, halfw, halfh, midx, midy;
 
   VARS(lefty);
   VARS(righty);
-  VARS(x);
 
   extracorner.r = (sf->primary->r + sf->secondary->r) / 2;
   extracorner.g = (sf->primary->g + sf->secondary->g) / 2;
@@ -716,36 +745,24 @@ static void gradient_pyramid(RrSurface* sf, gint w, gint h) {
   SETUP(lefty, sf->primary, (&extracorner), halfh + midy);
   SETUP(righty, (&extracorner), sf->secondary, halfh + midy);
 
-  /* draw the top half
-
-     it is faster to draw both top quarters together than to draw one and
-     then copy it over to the other side.
-  */
+  /* draw the top half */
 
   ldata = sf->pixel_data;
-  rdata = ldata + w - 1;
+  channel_rows_init(&rows, halfw + midx);
   for (y = halfh + midy; y > 0; --y) { /* 0 -> (h+1)/2 */
-    RrPixel32 c;
-
     COLOR_RR(lefty, (&left));
     COLOR_RR(righty, (&right));
 
-    SETUP(x, (&left), (&right), halfw + midx);
-
-    for (x = halfw + midx - 1; x > 0; --x) { /* 0 -> (w+1)/2 */
-      c = COLOR(x);
-      *(ldata++) = *(rdata--) = c;
-
-      NEXT(x);
-    }
-    c = COLOR(x);
-    *ldata = *rdata = c;
-    ldata += halfw + 1;
-    rdata += halfw - 1 + midx + w;
+    /* the left half of the row (and the middle column if there is one),
+       then mirrored into the right half */
+    channel_rows_draw(&rows, ldata, &left, &right, halfw + midx);
+    RrSimd()->reverse(ldata + halfw + midx, ldata, halfw);
+    ldata += w;
 
     NEXT(lefty);
     NEXT(righty);
   }
+  channel_rows_free(&rows);
 
   /* copy the top half into the bottom half, mirroring it, so we can only
      copy one row at a time
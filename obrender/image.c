@@ -21,6 +21,9 @@
 #include "image.h"
 #include "color.h"
 #include "imagecache.h"
+#include "scale.h"
+#include "simd.h"
+#include "obt/icontheme.h"
 #ifdef USE_IMLIB2
 #include <Imlib2.h>
 #endif
@@ -31,10 +34,12 @@
 
 #include <glib.h>
 
-#define FRACTION 12
-#define FLOOR(i) ((i) & (~0UL << FRACTION))
 #define AVERAGE(a, b) (((((a) ^ (b)) & 0xfefefefeL) >> 1) + ((a) & (b)))
 
+static RrScaleFilter scale_filter = RR_SCALE_BOX;
+static ObtIconTheme* icon_theme = NULL;
+static gint icon_size = 0;
+
 /************************************************************************
  RrImagePic functions.
 
@@ -58,6 +63,7 @@ static void RrImagePicInit(RrImagePic* pic, gint w, gint h, RrPixel32* data) {
   pic->width = w;
   pic->height = h;
   pic->data = data;
+  pic->premult = NULL;
   pic->sum = 0;
   for (i = w * h; i > 0; --i)
     pic->sum += *(data++);
@@ -76,12 +82,22 @@ static RrImagePic* RrImagePicNew(gint w, gint h, RrPixel32* data) {
   return pic;
 }
 
+/*! Makes the premultiplied copy of the picture's data if it doesn't have one
+  yet */
+static void RrImagePicPremultiply(RrImagePic* pic) {
+  if (!pic->premult) {
+    pic->premult = g_new(RrPixel32, (gsize)pic->width * (gsize)pic->height);
+    RrPremultiply(pic->premult, pic->data, pic->width * pic->height);
+  }
+}
+
 /*! Destroy an RrImagePic.
   This frees the RrImagePic object and everything inside it.
 */
 static void RrImagePicFree(RrImagePic* pic) {
   if (pic) {
     g_free(pic->data);
+    g_free(pic->premult);
     g_slice_free(RrImagePic, pic);
   }
 }
@@ -631,8 +647,12 @@ RrImage* RrImageNewFromName(RrImageCache* cache, const gchar* name) {
     return self;
   }
 
-  /* XXX find the path via freedesktop icon spec (use obt) ! */
-  path = g_strdup(name);
+  /* a name that isn't a path to a file is looked for in the icon theme */
+  path = NULL;
+  if (icon_theme && !g_path_is_absolute(name))
+    path = obt_icon_theme_lookup(icon_theme, name, icon_size);
+  if (!path)
+    path = g_strdup(name);
 
   loaded = FALSE;
 #if defined(USE_LIBRSVG)
@@ -689,6 +709,45 @@ RrImage* RrImageNewFromName(RrImageCache* cache, const gchar* name) {
  Image drawing and resizing operations.
 **************************************************************************/
 
+void RrPremultiply(RrPixel32* dest, const RrPixel32* src, gint n) {
+  gint i;
+
+  for (i = 0; i < n; ++i) {
+    const guint a = src[i] >> RrDefaultAlphaOffset;
+
+    if (a == 0xff)
+      dest[i] = src[i];
+    else if (a == 0)
+      dest[i] = 0;
+    else {
+      guint r, g, b;
+
+      r = (src[i] >> RrDefaultRedOffset) & 0xff;
+      g = (src[i] >> RrDefaultGreenOffset) & 0xff;
+      b = (src[i] >> RrDefaultBlueOffset) & 0xff;
+      /* c * a / 255, rounded */
+      r = r * a + 128;
+      g = g * a + 128;
+      b = b * a + 128;
+      dest[i] = (a << RrDefaultAlphaOffset) | (((r + (r >> 8)) >> 8) << RrDefaultRedOffset) |
+                (((g + (g >> 8)) >> 8) << RrDefaultGreenOffset) | (((b + (b >> 8)) >> 8) << RrDefaultBlueOffset);
+    }
+  }
+}
+
+void RrImageSetScaleFilter(RrScaleFilter filter) {
+  g_return_if_fail(filter < RR_SCALE_NUM_TYPES);
+
+  scale_filter = filter;
+}
+
+void RrImageSetIconTheme(const gchar* theme, gint size) {
+  if (icon_theme)
+    obt_icon_theme_unref(icon_theme);
+  icon_theme = theme ? obt_icon_theme_new(theme, "openbox") : NULL;
+  icon_size = size;
+}
+
 /*! Given a picture in RGBA format, of a specified size, resize it to the new
   requested size (but keep its aspect ratio).  If the image does not need to
   be resized (it is already the right size) then this returns NULL.  Otherwise
@@ -697,11 +756,7 @@ RrImage* RrImageNewFromName(RrImageCache* cache, const gchar* name) {
     image in the requested size (keeping aspect ratio).
 */
 static RrImagePic* ResizeImage(RrPixel32* src, gulong srcW, gulong srcH, gulong dstW, gulong dstH) {
-  RrPixel32 *dst, *dststart;
   RrImagePic* pic;
-  gulong dstX, dstY, srcX, srcY;
-  gulong srcX1, srcX2, srcY1, srcY2;
-  gulong ratioX, ratioY;
   gulong aspectW, aspectH;
 
   g_assert(srcW > 0);
@@ -722,90 +777,25 @@ static RrImagePic* ResizeImage(RrPixel32* src, gulong srcW, gulong srcH, gulong
   if (srcW == dstW && srcH == dstH)
     return NULL; /* no scaling needed! */
 
-  dststart = dst = g_new(RrPixel32, dstW * dstH);
-
-  ratioX = (srcW << FRACTION) / dstW;
-  ratioY = (srcH << FRACTION) / dstH;
-
-  srcY2 = 0;
-  for (dstY = 0; dstY < dstH; dstY++) {
-    srcY1 = srcY2;
-    srcY2 += ratioY;
-
-    srcX2 = 0;
-    for (dstX = 0; dstX < dstW; dstX++) {
-      gulong red = 0, green = 0, blue = 0, alpha = 0;
-      gulong portionX, portionY, portionXY, sumXY = 0;
-      RrPixel32 pixel;
-
-      srcX1 = srcX2;
-      srcX2 += ratioX;
-
-      for (srcY = srcY1; srcY < srcY2; srcY += (1UL << FRACTION)) {
-        if (srcY == srcY1) {
-          srcY = FLOOR(srcY);
-          portionY = (1UL << FRACTION) - (srcY1 - srcY);
-          if (portionY > srcY2 - srcY1)
-            portionY = srcY2 - srcY1;
-        }
-        else if (srcY == FLOOR(srcY2))
-          portionY = srcY2 - srcY;
-        else
-          portionY = (1UL << FRACTION);
-
-        for (srcX = srcX1; srcX < srcX2; srcX += (1UL << FRACTION)) {
-          if (srcX == srcX1) {
-            srcX = FLOOR(srcX);
-            portionX = (1UL << FRACTION) - (srcX1 - srcX);
-            if (portionX > srcX2 - srcX1)
-              portionX = srcX2 - srcX1;
-          }
-          else if (srcX == FLOOR(srcX2))
-            portionX = srcX2 - srcX;
-          else
-            portionX = (1UL << FRACTION);
-
-          portionXY = (portionX * portionY) >> FRACTION;
-          sumXY += portionXY;
-
-          pixel = *(src + (srcY >> FRACTION) * srcW + (srcX >> FRACTION));
-          red += ((pixel >> RrDefaultRedOffset) & 0xFF) * portionXY;
-          green += ((pixel >> RrDefaultGreenOffset) & 0xFF) * portionXY;
-          blue += ((pixel >> RrDefaultBlueOffset) & 0xFF) * portionXY;
-          alpha += ((pixel >> RrDefaultAlphaOffset) & 0xFF) * portionXY;
-        }
-      }
-
-      g_assert(sumXY != 0);
-      red /= sumXY;
-      green /= sumXY;
-      blue /= sumXY;
-      alpha /= sumXY;
-
-      *dst++ = ((guint)red << RrDefaultRedOffset) | ((guint)green << RrDefaultGreenOffset) |
-               ((guint)blue << RrDefaultBlueOffset) | ((guint)alpha << RrDefaultAlphaOffset);
-    }
-  }
-
   pic = g_slice_new(RrImagePic);
-  RrImagePicInit(pic, dstW, dstH, dststart);
+  RrImagePicInit(pic, dstW, dstH, RrScale(src, srcW, srcH, dstW, dstH, scale_filter));
 
   return pic;
 }
 
 /*! This draws an RGBA picture into the target, within the rectangle specified
   by the area parameter.  If the area's size differs from the source's then it
-  will be centered within the rectangle */
+  will be centered within the rectangle.  The source must be premultiplied. */
 void DrawRGBA(RrPixel32* target,
               gint target_w,
               gint target_h,
-              RrPixel32* source,
+              const RrPixel32* source,
               gint source_w,
               gint source_h,
               gint alpha,
               RrRect* area) {
   RrPixel32* dest;
-  gint col, num_pixels;
+  gint y;
   gint dw, dh;
 
   g_assert(source_w <= area->width && source_h <= area->height);
@@ -820,39 +810,11 @@ void DrawRGBA(RrPixel32* target,
     dw = (gint)(dh * ((gdouble)source_w / source_h));
   }
 
-  /* copy source -> dest, and apply the alpha channel.
+  /* blend source over dest a row at a time, with the rgba's opacity as well.
      center the image if it is smaller than the area */
-  col = 0;
-  num_pixels = dw * dh;
   dest = target + area->x + (area->width - dw) / 2 + (target_w * (area->y + (area->height - dh) / 2));
-  while (num_pixels-- > 0) {
-    guchar a, r, g, b, bgr, bgg, bgb;
-
-    /* apply the rgba's opacity as well */
-    a = ((*source >> RrDefaultAlphaOffset) * alpha) >> 8;
-    r = *source >> RrDefaultRedOffset;
-    g = *source >> RrDefaultGreenOffset;
-    b = *source >> RrDefaultBlueOffset;
-
-    /* background color */
-    bgr = *dest >> RrDefaultRedOffset;
-    bgg = *dest >> RrDefaultGreenOffset;
-    bgb = *dest >> RrDefaultBlueOffset;
-
-    r = bgr + (((r - bgr) * a) >> 8);
-    g = bgg + (((g - bgg) * a) >> 8);
-    b = bgb + (((b - bgb) * a) >> 8);
-
-    *dest = ((guint)r << RrDefaultRedOffset) | ((guint)g << RrDefaultGreenOffset) | ((guint)b << RrDefaultBlueOffset);
-
-    dest++;
-    source++;
-
-    if (++col >= dw) {
-      col = 0;
-      dest += target_w - dw;
-    }
-  }
+  for (y = 0; y < dh; ++y, dest += target_w, source += dw)
+    RrSimd()->blend(dest, source, dw, alpha);
 }
 
 /*! Draw an RGBA texture into a target pixel buffer. */
@@ -867,11 +829,17 @@ void RrImageDrawRGBA(RrPixel32* target, RrTextureRGBA* rgba, gint target_w, gint
         "Scaling an RGBA! You should avoid this and just make "
         "it the right size yourself!");
 #endif
-    DrawRGBA(target, target_w, target_h, scaled->data, scaled->width, scaled->height, rgba->alpha, area);
+    RrImagePicPremultiply(scaled);
+    DrawRGBA(target, target_w, target_h, scaled->premult, scaled->width, scaled->height, rgba->alpha, area);
     RrImagePicFree(scaled);
   }
-  else
-    DrawRGBA(target, target_w, target_h, rgba->data, rgba->width, rgba->height, rgba->alpha, area);
+  else {
+    RrPixel32* premult = g_new(RrPixel32, (gsize)rgba->width * (gsize)rgba->height);
+
+    RrPremultiply(premult, rgba->data, rgba->width * rgba->height);
+    DrawRGBA(target, target_w, target_h, premult, rgba->width, rgba->height, rgba->alpha, area);
+    g_free(premult);
+  }
 }
 
 /*! Draw an RrImage texture into a target pixel buffer.  If the RrImage does
@@ -995,7 +963,9 @@ void RrImageDrawImage(RrPixel32* target, RrTextureImage* img, gint target_w, gin
 
   g_assert(pic != NULL);
 
-  DrawRGBA(target, target_w, target_h, pic->data, pic->width, pic->height, img->alpha, area);
+  /* the premultiplied copy stays with the picture for next time */
+  RrImagePicPremultiply(pic);
+  DrawRGBA(target, target_w, target_h, pic->premult, pic->width, pic->height, img->alpha, area);
   if (free_pic)
     RrImagePicFree(pic);
 }
@@ -25,4 +25,8 @@
 void RrImageDrawImage(RrPixel32* target, RrTextureImage* img, gint target_w, gint target_h, RrRect* area);
 void RrImageDrawRGBA(RrPixel32* target, RrTextureRGBA* rgba, gint target_w, gint target_h, RrRect* area);
 
+/*! Copies @n pixels from @src to @dest with their colors multiplied by their
+  alpha */
+void RrPremultiply(RrPixel32* dest, const RrPixel32* src, gint n);
+
 #endif
@@ -25,6 +25,9 @@ struct _RrImagePic;
 
 guint RrImagePicHash(const struct _RrImagePic* p);
 
+/*! Hashes @length words starting at @key */
+guint32 hashword(const guint32* key, gint length, guint32 initval);
+
 /*! Create a new image cache.  An image cache is basically a hash table to look
   up RrImages.  Each RrImage in the cache may contain one or more Pictures,
   that is one or more actual copies of image data at various sizes.  For eg,
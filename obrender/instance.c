@@ -19,11 +19,56 @@
 
 #include "render.h"
 #include "instance.h"
+#include "simd.h"
+#include "surfacecache.h"
+
+#ifdef USE_XSHM
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+/* Images smaller than this are sent over the wire.  Reusing a shared
+   segment can mean waiting for the server to finish reading it, and that
+   costs more than just sending a button's worth of pixels. */
+#define RR_SHM_MIN_PIXELS 4096
+
+/* Images are put from the segments in turn, so one can be filled while the
+   server is still reading the last one */
+#define RR_SHM_SEGMENTS 2
+
+/* Scratch buffers bigger than this are given back after each use, so that one
+   huge image (like a background) doesn't hold onto the memory forever */
+#define RR_XIMAGE_POOL_MAX_SIZE (4 * 1024 * 1024)
+
+struct _RrXImagePool {
+  XImage format; /* everything about the image but its size and data */
+  XImage image;  /* the image handed out by RrXImageGet */
+  gchar* scratch;
+  gsize size;
+};
+
+typedef struct _RrShmSegment {
+#ifdef USE_XSHM
+  XShmSegmentInfo info;
+#endif
+  gsize size;    /* 0 if the segment had to be given up */
+  gulong serial; /* the request that last put an image from it, or 0 */
+} RrShmSegment;
+
+struct _RrShm {
+  RrShmSegment seg[RR_SHM_SEGMENTS];
+  guint next; /* the segment the next image is put from */
+};
 
 static RrInstance* definst = NULL;
 
 static void RrTrueColorSetup(RrInstance* inst);
 static void RrPseudoColorSetup(RrInstance* inst);
+static void RrShmSetup(RrInstance* inst);
+static void RrShmRelease(const RrInstance* inst, RrShmSegment* seg);
+static RrXImagePool* RrXImagePoolNew(RrInstance* inst);
+static void RrXImagePoolFree(RrXImagePool* pool);
 
 #ifdef DEBUG
 #include "color.h"
@@ -67,6 +112,9 @@ RrInstance* RrInstanceNew(Display* display, gint screen) {
   }
 
   definst->pseudo_colors = NULL;
+  definst->shm = NULL;
+  definst->ximage_pool = NULL;
+  definst->surface_cache = RrSurfaceCacheNew(RR_SURFACE_CACHE_DEFAULT_SIZE);
 
   definst->color_hash = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, dest);
 
@@ -82,9 +130,14 @@ RrInstance* RrInstanceNew(Display* display, gint screen) {
       break;
     default:
       g_critical("Unsupported visual class");
+      RrSurfaceCacheFree(definst, definst->surface_cache);
       g_free(definst);
       return definst = NULL;
   }
+
+  RrShmSetup(definst);
+  definst->ximage_pool = RrXImagePoolNew(definst);
+  RrSimdSetup();
   return definst;
 }
 
@@ -217,10 +270,260 @@ static void RrPseudoColorSetup(RrInstance* inst) {
   }
 }
 
+#ifdef USE_XSHM
+static gboolean shm_failed;
+/* the type of the events the server sends when it has put an image */
+static gint shm_completion_type;
+
+static gint shm_error_handler(Display* d, XErrorEvent* e) {
+  shm_failed = TRUE;
+  return 0;
+}
+
+/* attach a new segment of the given size, both here and in the server */
+static gboolean RrShmAttach(const RrInstance* inst, RrShmSegment* seg, gsize size) {
+  XErrorHandler old;
+
+  seg->size = 0;
+  seg->serial = 0;
+
+  seg->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if (seg->info.shmid < 0)
+    return FALSE;
+  seg->info.shmaddr = shmat(seg->info.shmid, NULL, 0);
+  /* the segment is destroyed once everyone has detached from it, so it
+     can't leak if we crash */
+  shmctl(seg->info.shmid, IPC_RMID, NULL);
+  if (seg->info.shmaddr == (char*)-1)
+    return FALSE;
+  seg->info.readOnly = True;
+
+  /* the server can fail to attach (e.g. it is on another machine), and it
+     only tells us so with an asynchronous error */
+  XSync(inst->display, FALSE);
+  shm_failed = FALSE;
+  old = XSetErrorHandler(shm_error_handler);
+  XShmAttach(inst->display, &seg->info);
+  XSync(inst->display, FALSE);
+  XSetErrorHandler(old);
+
+  if (shm_failed) {
+    shmdt(seg->info.shmaddr);
+    return FALSE;
+  }
+  seg->size = size;
+  return TRUE;
+}
+
+/* returns TRUE once the server has processed the last request that put an
+   image from the segment */
+static gboolean RrShmDone(const RrInstance* inst, const RrShmSegment* seg) {
+  return !seg->serial || (glong)(LastKnownRequestProcessed(inst->display) - seg->serial) >= 0;
+}
+
+static Bool shm_completion(Display* d, XEvent* e, XPointer arg) {
+  const RrShmSegment* seg = (const RrShmSegment*)arg;
+
+  return e->type == shm_completion_type && ((XShmCompletionEvent*)e)->shmseg == seg->info.shmseg &&
+         (glong)(e->xany.serial - seg->serial) >= 0;
+}
+
+/* waits for the server to finish reading the last image put from the
+   segment */
+static void RrShmWait(const RrInstance* inst, RrShmSegment* seg) {
+  if (!RrShmDone(inst, seg)) {
+    /* anything the server has sent already says how far it has got */
+    XEventsQueued(inst->display, QueuedAfterReading);
+    if (!RrShmDone(inst, seg)) {
+      XEvent e;
+
+      /* the server sends an event when it is done with the image, so there
+         is no need for a round trip */
+      XIfEvent(inst->display, &e, shm_completion, (XPointer)seg);
+    }
+  }
+  seg->serial = 0;
+}
+#endif
+
+static void RrShmSetup(RrInstance* inst) {
+#ifdef USE_XSHM
+  RrShm* shm;
+  guint i;
+
+  if (!XShmQueryExtension(inst->display))
+    return;
+  shm_completion_type = XShmGetEventBase(inst->display) + ShmCompletion;
+
+  shm = g_slice_new0(RrShm);
+  for (i = 0; i < RR_SHM_SEGMENTS; ++i)
+    /* enough for a 256x256 image at 32bpp, it grows as needed */
+    if (!RrShmAttach(inst, &shm->seg[i], 256 * 256 * 4)) {
+      while (i--)
+        RrShmRelease(inst, &shm->seg[i]);
+      g_slice_free(RrShm, shm);
+      return;
+    }
+  inst->shm = shm;
+#endif
+}
+
+static void RrShmRelease(const RrInstance* inst, RrShmSegment* seg) {
+#ifdef USE_XSHM
+  if (seg->size) {
+    XShmDetach(inst->display, &seg->info);
+    XSync(inst->display, FALSE);
+    shmdt(seg->info.shmaddr);
+    seg->size = 0;
+    seg->serial = 0;
+  }
+#endif
+}
+
+XImage* RrShmImageNew(const RrInstance* inst, gint w, gint h) {
+#ifdef USE_XSHM
+  RrShmSegment* seg;
+  XImage* im;
+  gsize need;
+
+  if (!inst)
+    inst = definst;
+  if (!inst->shm || w * h < RR_SHM_MIN_PIXELS)
+    return NULL;
+  seg = &inst->shm->seg[inst->shm->next];
+  if (!seg->size)
+    return NULL;
+
+  RrShmWait(inst, seg);
+
+  im = XShmCreateImage(inst->display, inst->visual, inst->depth, ZPixmap, NULL, &seg->info, w, h);
+  if (!im)
+    return NULL;
+
+  need = (gsize)im->bytes_per_line * (gsize)im->height;
+  if (need > seg->size) {
+    gsize size = seg->size;
+
+    while (size < need)
+      size <<= 1;
+    RrShmRelease(inst, seg);
+    if (!RrShmAttach(inst, seg, size)) {
+      /* fall back to sending images over the wire from now on */
+      XDestroyImage(im);
+      return NULL;
+    }
+  }
+
+  im->data = seg->info.shmaddr;
+  return im;
+#else
+  return NULL;
+#endif
+}
+
+void RrShmPutImage(const RrInstance* inst, Drawable d, GC gc, XImage* im, gint x, gint y) {
+#ifdef USE_XSHM
+  RrShmSegment* seg;
+
+  if (!inst)
+    inst = definst;
+
+  seg = &inst->shm->seg[inst->shm->next];
+  seg->serial = NextRequest(inst->display);
+  /* ask for an event when it's done, in case the segment is needed again
+     before anything else comes back from the server */
+  XShmPutImage(inst->display, d, gc, im, 0, 0, x, y, im->width, im->height, TRUE);
+  inst->shm->next = (inst->shm->next + 1) % RR_SHM_SEGMENTS;
+  /* the data belongs to the segment */
+  im->data = NULL;
+  XDestroyImage(im);
+#endif
+}
+
+static RrXImagePool* RrXImagePoolNew(RrInstance* inst) {
+  RrXImagePool* pool;
+  XImage* im;
+
+  im = XCreateImage(inst->display, inst->visual, inst->depth, ZPixmap, 0, NULL, 1, 1, 32, 0);
+  g_assert(im != NULL);
+
+  pool = g_slice_new0(RrXImagePool);
+  pool->format = *im;
+  pool->format.width = pool->format.height = 0;
+  pool->format.bytes_per_line = 0;
+  pool->format.data = NULL;
+  XDestroyImage(im);
+  return pool;
+}
+
+static void RrXImagePoolFree(RrXImagePool* pool) {
+  if (pool) {
+    g_free(pool->scratch);
+    g_slice_free(RrXImagePool, pool);
+  }
+}
+
+XImage* RrXImageGet(const RrInstance* inst, gint w, gint h) {
+  RrXImagePool* pool;
+
+  if (!inst)
+    inst = definst;
+  pool = inst->ximage_pool;
+
+  pool->image = pool->format;
+  pool->image.width = w;
+  pool->image.height = h;
+  /* XInitImage works out bytes_per_line and sets up the image's functions */
+  if (!XInitImage(&pool->image))
+    g_error("Unable to create an XImage of %dx%d", w, h);
+  return &pool->image;
+}
+
+void RrXImageScratch(const RrInstance* inst, XImage* im) {
+  RrXImagePool* pool;
+  gsize need;
+
+  if (!inst)
+    inst = definst;
+  pool = inst->ximage_pool;
+
+  need = (gsize)im->bytes_per_line * (gsize)im->height;
+  if (need > pool->size) {
+    pool->size = MAX(need, pool->size * 2);
+    g_free(pool->scratch);
+    pool->scratch = g_malloc(pool->size);
+  }
+  im->data = pool->scratch;
+}
+
+void RrXImageDone(const RrInstance* inst, XImage* im) {
+  RrXImagePool* pool;
+
+  if (!inst)
+    inst = definst;
+  pool = inst->ximage_pool;
+
+  im->data = NULL;
+  if (pool->size > RR_XIMAGE_POOL_MAX_SIZE) {
+    g_free(pool->scratch);
+    pool->scratch = NULL;
+    pool->size = 0;
+  }
+}
+
 void RrInstanceFree(RrInstance* inst) {
   if (inst) {
     if (inst == definst)
       definst = NULL;
+    RrSurfaceCacheFree(inst, inst->surface_cache);
+    RrXImagePoolFree(inst->ximage_pool);
+    if (inst->shm) {
+      guint i;
+
+      for (i = 0; i < RR_SHM_SEGMENTS; ++i)
+        RrShmRelease(inst, &inst->shm->seg[i]);
+      g_slice_free(RrShm, inst->shm);
+    }
     g_free(inst->pseudo_colors);
     g_hash_table_destroy(inst->color_hash);
     g_object_unref(inst->pango);
@@ -23,6 +23,10 @@
 #include <glib.h>
 #include <pango/pangoxft.h>
 
+typedef struct _RrShm RrShm;
+typedef struct _RrSurfaceCache RrSurfaceCache;
+typedef struct _RrXImagePool RrXImagePool;
+
 struct _RrInstance {
   Display* display;
   gint screen;
@@ -48,10 +52,39 @@ struct _RrInstance {
   XColor* pseudo_colors;
 
   GHashTable* color_hash;
+
+  /* shared memory segment used to upload images, NULL when MIT-SHM can't be
+     used with the display (remote display, no extension) */
+  RrShm* shm;
+
+  /* rendered surfaces that can be shared between appearances */
+  RrSurfaceCache* surface_cache;
+
+  /* an XImage and a conversion buffer that are reused for every image sent
+     to or read from the server without shared memory */
+  RrXImagePool* ximage_pool;
 };
 
 guint RrPseudoBPC(const RrInstance* inst);
 XColor* RrPseudoColors(const RrInstance* inst);
 GHashTable* RrColorHash(const RrInstance* inst);
 
+/*! Returns an XImage of the given size whose data lives in shared memory, or
+  NULL if the image should be sent the normal way instead.  The image must be
+  handed back with RrShmPutImage. */
+XImage* RrShmImageNew(const RrInstance* inst, gint w, gint h);
+/*! Copies an image from RrShmImageNew onto the drawable and destroys it */
+void RrShmPutImage(const RrInstance* inst, Drawable d, GC gc, XImage* im, gint x, gint y);
+
+/*! Returns an XImage of the given size in the instance's visual and depth,
+  without any data.  The image belongs to the instance and is reused by the
+  next call, so it must be given back with RrXImageDone rather than
+  destroyed. */
+XImage* RrXImageGet(const RrInstance* inst, gint w, gint h);
+/*! Points the image from RrXImageGet at a scratch buffer big enough for it.
+  The buffer is kept between images, and grows as it needs to. */
+void RrXImageScratch(const RrInstance* inst, XImage* im);
+/*! Finishes with the image from RrXImageGet */
+void RrXImageDone(const RrInstance* inst, XImage* im);
+
 #endif
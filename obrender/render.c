@@ -7,6 +7,8 @@
 #include "color.h"
 #include "image.h"
 #include "theme.h"
+#include "instance.h"
+#include "surfacecache.h"
 
 #include <glib.h>
 #include <X11/Xlib.h>
@@ -16,6 +18,7 @@
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
+#include <string.h>
 
 static void pixel_data_to_pixmap(RrAppearance* l, gint x, gint y, gint w, gint h);
 
@@ -57,7 +60,18 @@ Pixmap RrPaintPixmap(RrAppearance* a, gint w, gint h) {
     a->surface.pixel_data = g_new(RrPixel32, (gsize)w * (gsize)h);
   }
 
-  RrRender(a, w, h);
+  if (RrSurfaceCacheable(a)) {
+    /* none of the textures draw into the pixel data, so the surface can be
+       copied to the pixmap right away and shared with other appearances */
+    transferred = 1;
+    if (!RrSurfaceCacheFetch(a, w, h)) {
+      RrRender(a, w, h);
+      pixel_data_to_pixmap(a, 0, 0, w, h);
+      RrSurfaceCacheStore(a, w, h);
+    }
+  }
+  else
+    RrRender(a, w, h);
 
   {
     gint l, t, r, b;
@@ -319,24 +333,44 @@ void RrAppearanceFree(RrAppearance* a) {
 }
 
 static void pixel_data_to_pixmap(RrAppearance* l, gint x, gint y, gint w, gint h) {
-  RrPixel32 *in, *scratch;
+  RrPixel32* in;
   Pixmap out;
   XImage* im = NULL;
-  im = XCreateImage(RrDisplay(l->inst), RrVisual(l->inst), RrDepth(l->inst), ZPixmap, 0, NULL, w, h, 32, 0);
-  g_assert(im != NULL);
 
   in = l->surface.pixel_data;
   out = l->pixmap;
 
-  /* this malloc is a complete waste of time on normal 32bpp
-     as reduce_depth just sets im->data = data and returns */
-  scratch = g_new(RrPixel32, (gsize)im->width * (gsize)im->height);
-  im->data = (gchar*)scratch;
-  RrReduceDepth(l->inst, in, im);
+  im = RrShmImageNew(l->inst, w, h);
+  if (im) {
+    gchar* shmdata = im->data;
+
+    if (RrDepthIsNative(l->inst, im))
+      /* the server can read our pixels as they are, it just can't see them
+         where they are */
+      memcpy(shmdata, in, (gsize)im->bytes_per_line * (gsize)im->height);
+    else {
+      RrReduceDepth(l->inst, in, im);
+      /* reduce_depth may point the image at our pixel data instead of
+         converting it */
+      if (im->data != shmdata) {
+        memcpy(shmdata, im->data, (gsize)im->bytes_per_line * (gsize)im->height);
+        im->data = shmdata;
+      }
+    }
+    RrShmPutImage(l->inst, out, DefaultGC(RrDisplay(l->inst), RrScreen(l->inst)), im, x, y);
+    return;
+  }
+
+  im = RrXImageGet(l->inst, w, h);
+  if (RrDepthIsNative(l->inst, im))
+    /* send the pixel data without converting or copying it */
+    im->data = (gchar*)in;
+  else {
+    RrXImageScratch(l->inst, im);
+    RrReduceDepth(l->inst, in, im);
+  }
   XPutImage(RrDisplay(l->inst), out, DefaultGC(RrDisplay(l->inst), RrScreen(l->inst)), im, 0, 0, x, y, w, h);
-  im->data = NULL;
-  XDestroyImage(im);
-  g_free(scratch);
+  RrXImageDone(l->inst, im);
 }
 
 void RrMargins(RrAppearance* a, gint* l, gint* t, gint* r, gint* b) {
@@ -468,10 +502,11 @@ static void reverse_bits(gchar* c, gint n) {
 gboolean RrPixmapToRGBA(const RrInstance* inst, Pixmap pmap, Pixmap mask, gint* w, gint* h, RrPixel32** data) {
   Window xr;
   gint xx, xy;
-  guint pw, ph, mw, mh, xb, xd, i, x, y, di;
+  guint pw, ph, mw, mh, xb, xd, pd, i, x, y, di;
   XImage *xi, *xm = NULL;
+  gboolean pooled;
 
-  if (!XGetGeometry(RrDisplay(inst), pmap, &xr, &xx, &xy, &pw, &ph, &xb, &xd))
+  if (!XGetGeometry(RrDisplay(inst), pmap, &xr, &xx, &xy, &pw, &ph, &xb, &pd))
     return FALSE;
 
   if (mask) {
@@ -481,14 +516,29 @@ gboolean RrPixmapToRGBA(const RrInstance* inst, Pixmap pmap, Pixmap mask, gint*
       return FALSE;
   }
 
-  xi = XGetImage(RrDisplay(inst), pmap, 0, 0, pw, ph, 0xffffffff, ZPixmap);
-  if (!xi)
-    return FALSE;
+  /* pixmaps in our own depth can be read into the reusable image */
+  pooled = (pd == (guint)RrDepth(inst));
+  if (pooled) {
+    xi = RrXImageGet(inst, pw, ph);
+    RrXImageScratch(inst, xi);
+    if (!XGetSubImage(RrDisplay(inst), pmap, 0, 0, pw, ph, 0xffffffff, ZPixmap, xi, 0, 0)) {
+      RrXImageDone(inst, xi);
+      return FALSE;
+    }
+  }
+  else {
+    xi = XGetImage(RrDisplay(inst), pmap, 0, 0, pw, ph, 0xffffffff, ZPixmap);
+    if (!xi)
+      return FALSE;
+  }
 
   if (mask) {
     xm = XGetImage(RrDisplay(inst), mask, 0, 0, mw, mh, 0xffffffff, ZPixmap);
     if (!xm) {
-      XDestroyImage(xi);
+      if (pooled)
+        RrXImageDone(inst, xi);
+      else
+        XDestroyImage(xi);
       return FALSE;
     }
     if ((xm->bits_per_pixel == 1) && (xm->bitmap_bit_order != LSBFirst))
@@ -516,7 +566,10 @@ gboolean RrPixmapToRGBA(const RrInstance* inst, Pixmap pmap, Pixmap mask, gint*
   *w = (gint)pw;
   *h = (gint)ph;
 
-  XDestroyImage(xi);
+  if (pooled)
+    RrXImageDone(inst, xi);
+  else
+    XDestroyImage(xi);
   if (mask)
     XDestroyImage(xm);
 
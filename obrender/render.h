@@ -103,6 +103,8 @@ typedef enum {
 
 typedef enum { RR_FONTSLANT_NORMAL, RR_FONTSLANT_ITALIC, RR_FONTSLANT_OBLIQUE, RR_FONTSLANT_NUM_TYPES } RrFontSlant;
 
+typedef enum { RR_SCALE_BOX, RR_SCALE_LANCZOS, RR_SCALE_NUM_TYPES } RrScaleFilter;
+
 struct _RrSurface {
   RrSurfaceColorType grad;
   RrReliefType relief;
@@ -218,6 +220,9 @@ struct _RrAppearance {
 struct _RrImagePic {
   gint width, height;
   RrPixel32* data;
+  /* A copy of data with premultiplied alpha, made the first time the
+     picture is drawn, or NULL. */
+  RrPixel32* premult;
   /* The sum of all the pixels.  This is used to compare pictures if their
      hashes match. */
   gint sum;
@@ -343,6 +348,10 @@ gint RrRedMask(const RrInstance* inst);
 gint RrGreenMask(const RrInstance* inst);
 gint RrBlueMask(const RrInstance* inst);
 
+/*! Sets how many bytes of rendered surfaces are kept to be reused when an
+  appearance is painted again at the same size.  0 turns off the cache. */
+void RrSurfaceCacheSetSize(const RrInstance* inst, gsize max_bytes);
+
 RrColor* RrColorNew(const RrInstance* inst, gint r, gint g, gint b);
 RrColor* RrColorCopy(RrColor* c);
 RrColor* RrColorParse(const RrInstance* inst, gchar* colorname);
@@ -440,6 +449,15 @@ void RrImageAddFromData(RrImage* image, RrPixel32* data, gint w, gint h);
 void RrImageRef(RrImage* im);
 void RrImageUnref(RrImage* im);
 
+/*! Sets the filter used when a picture has to be drawn at a size it doesn't
+  come in.  The default is RR_SCALE_BOX. */
+void RrImageSetScaleFilter(RrScaleFilter filter);
+
+/*! Sets the freedesktop icon theme that RrImageNewFromName looks for names
+  in, and the size in pixels of the icons to look for.  A NULL @theme only
+  loads names as files. */
+void RrImageSetIconTheme(const gchar* theme, gint size);
+
 G_END_DECLS
 
 #endif /*__render_h*/
@@ -0,0 +1,207 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   scale.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "scale.h"
+#include "simd.h"
+#include "image.h"
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+/* weights are fixed point with this many fractional bits, and add up to 1 */
+#define WEIGHT_BITS 14
+/* fractional bits kept for the channels between the two passes */
+#define MID_BITS 8
+
+#define LANCZOS_LOBES 3
+
+/*! The source pixels that go into each destination pixel along one axis */
+typedef struct _RrScaleTaps {
+  /*! The first source pixel for each destination pixel */
+  gint* start;
+  /*! The number of source pixels for each destination pixel */
+  gint* count;
+  /*! @ntaps weights for each destination pixel */
+  gint16* weights;
+  gint ntaps;
+} RrScaleTaps;
+
+static gdouble lanczos(gdouble x) {
+  if (x == 0.0)
+    return 1.0;
+  if (x <= -LANCZOS_LOBES || x >= LANCZOS_LOBES)
+    return 0.0;
+  x *= G_PI;
+  return LANCZOS_LOBES * sin(x) * sin(x / LANCZOS_LOBES) / (x * x);
+}
+
+/* turns the weights into fixed point, making sure they still add up to
+   exactly 1 so that flat areas stay flat */
+static void quantize(const gdouble* w, gint n, gint16* out) {
+  gdouble sum = 0.0;
+  gint32 total = 0;
+  gint i, biggest = 0;
+
+  for (i = 0; i < n; ++i)
+    sum += w[i];
+  for (i = 0; i < n; ++i) {
+    out[i] = (gint16)floor(w[i] / sum * (1 << WEIGHT_BITS) + 0.5);
+    total += out[i];
+    if (out[i] > out[biggest])
+      biggest = i;
+  }
+  out[biggest] += (1 << WEIGHT_BITS) - total;
+}
+
+static void taps_init(RrScaleTaps* t, gint slen, gint dlen, RrScaleFilter filter) {
+  const gdouble scale = (gdouble)slen / dlen;
+  gdouble* w;
+  gint i;
+
+  if (filter == RR_SCALE_LANCZOS)
+    /* spread the filter out when shrinking so every source pixel counts */
+    t->ntaps = (gint)ceil(LANCZOS_LOBES * MAX(scale, 1.0)) * 2 + 1;
+  else
+    t->ntaps = (gint)ceil(scale) + 1;
+  t->ntaps = MIN(t->ntaps, slen);
+
+  t->start = g_new(gint, dlen);
+  t->count = g_new(gint, dlen);
+  t->weights = g_new0(gint16, (gsize)dlen * t->ntaps);
+  w = g_new(gdouble, t->ntaps);
+
+  for (i = 0; i < dlen; ++i) {
+    gint first, last, j;
+
+    if (filter == RR_SCALE_LANCZOS) {
+      const gdouble stretch = MAX(scale, 1.0);
+      const gdouble center = (i + 0.5) * scale - 0.5;
+      const gint lo = (gint)floor(center - LANCZOS_LOBES * stretch) + 1;
+      const gint hi = (gint)floor(center + LANCZOS_LOBES * stretch);
+
+      first = CLAMP(lo, 0, slen - 1);
+      last = CLAMP(hi, 0, slen - 1);
+      for (j = 0; j <= last - first; ++j)
+        w[j] = 0.0;
+      /* pixels past the edges repeat the edge pixels */
+      for (j = lo; j <= hi; ++j)
+        w[CLAMP(j, 0, slen - 1) - first] += lanczos((j - center) / stretch);
+    }
+    else {
+      /* how much of each source pixel is covered by the destination
+         pixel */
+      const gdouble x1 = i * scale;
+      const gdouble x2 = MIN((i + 1) * scale, slen);
+
+      first = (gint)floor(x1);
+      last = MIN((gint)ceil(x2) - 1, slen - 1);
+      for (j = first; j <= last; ++j)
+        w[j - first] = MIN(x2, j + 1) - MAX(x1, j);
+    }
+
+    g_assert(last - first < t->ntaps);
+    t->start[i] = first;
+    t->count[i] = last - first + 1;
+    quantize(w, t->count[i], t->weights + (gsize)i * t->ntaps);
+  }
+
+  g_free(w);
+}
+
+static void taps_free(RrScaleTaps* t) {
+  g_free(t->start);
+  g_free(t->count);
+  g_free(t->weights);
+}
+
+static inline guint clamp_channel(gint32 v) {
+  v = (v + (1 << (WEIGHT_BITS + MID_BITS - 1))) >> (WEIGHT_BITS + MID_BITS);
+  return CLAMP(v, 0, 0xff);
+}
+
+/* turns a row of channels from the vertical pass back into pixels */
+static void pack_row(RrPixel32* dest, const gint32* acc, gint n, gboolean premultiplied) {
+  gint i;
+
+  for (i = 0; i < n; ++i, acc += 4) {
+    guint a, r, g, b;
+
+    a = clamp_channel(acc[RrDefaultAlphaOffset / 8]);
+    r = clamp_channel(acc[RrDefaultRedOffset / 8]);
+    g = clamp_channel(acc[RrDefaultGreenOffset / 8]);
+    b = clamp_channel(acc[RrDefaultBlueOffset / 8]);
+    if (premultiplied) {
+      if (a) {
+        r = MIN((r * 255 + a / 2) / a, 0xff);
+        g = MIN((g * 255 + a / 2) / a, 0xff);
+        b = MIN((b * 255 + a / 2) / a, 0xff);
+      }
+      else
+        r = g = b = 0;
+    }
+    dest[i] = (a << RrDefaultAlphaOffset) | (r << RrDefaultRedOffset) | (g << RrDefaultGreenOffset) |
+              (b << RrDefaultBlueOffset);
+  }
+}
+
+RrPixel32* RrScale(const RrPixel32* src, gint sw, gint sh, gint dw, gint dh, RrScaleFilter filter) {
+  const gboolean premultiplied = (filter == RR_SCALE_LANCZOS);
+  RrScaleTaps xt, yt;
+  RrPixel32 *dest, *row;
+  gint32 *mid, *acc;
+  gint y, k;
+
+  g_assert(sw > 0 && sh > 0 && dw > 0 && dh > 0);
+
+  taps_init(&xt, sw, dw, filter);
+  taps_init(&yt, sh, dh, filter);
+
+  /* scale each source row across, into 4 channels per pixel */
+  mid = g_new(gint32, (gsize)sh * dw * 4);
+  row = premultiplied ? g_new(RrPixel32, sw) : NULL;
+  for (y = 0; y < sh; ++y) {
+    const RrPixel32* in = src + (gsize)y * sw;
+
+    if (premultiplied) {
+      RrPremultiply(row, in, sw);
+      in = row;
+    }
+    /* drop down to MID_BITS of fraction so the second pass can't overflow */
+    RrSimd()->scale_row(mid + (gsize)y * dw * 4, in, xt.start, xt.count, xt.weights, xt.ntaps, dw,
+                        WEIGHT_BITS - MID_BITS);
+  }
+  g_free(row);
+
+  /* then scale down, a whole row at a time */
+  dest = g_new(RrPixel32, (gsize)dw * dh);
+  acc = g_new(gint32, (gsize)dw * 4);
+  for (y = 0; y < dh; ++y) {
+    const gint16* w = yt.weights + (gsize)y * yt.ntaps;
+
+    memset(acc, 0, sizeof(gint32) * dw * 4);
+    for (k = 0; k < yt.count[y]; ++k)
+      RrSimd()->accumulate(acc, mid + (gsize)(yt.start[y] + k) * dw * 4, w[k], dw * 4);
+    pack_row(dest + (gsize)y * dw, acc, dw, premultiplied);
+  }
+  g_free(acc);
+  g_free(mid);
+
+  taps_free(&xt);
+  taps_free(&yt);
+  return dest;
+}
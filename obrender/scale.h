@@ -0,0 +1,35 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   scale.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __scale_h
+#define __scale_h
+
+#include "render.h"
+
+/*! Scales an ARGB picture to exactly @dw x @dh pixels with the given filter,
+  and returns the result in a newly allocated buffer.  The picture is scaled
+  in two passes, first across and then down, using weights that are worked
+  out once for each column and each row.
+
+  RR_SCALE_BOX averages the source pixels covered by each destination pixel,
+  like openbox always has.  RR_SCALE_LANCZOS uses a 3-lobed Lanczos filter on
+  premultiplied pixels, which is sharper and doesn't let the colors of
+  transparent pixels bleed into their neighbours.
+*/
+RrPixel32* RrScale(const RrPixel32* src, gint sw, gint sh, gint dw, gint dh, RrScaleFilter filter);
+
+#endif
@@ -0,0 +1,175 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   scalebench.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+/* Times RrScale against the box filter that obrender used before it, at the
+   sizes that icons are usually scaled between, and reports how far apart
+   their output is.  Run it with OBRENDER_SIMD set to compare kernels. */
+
+#include "render.h"
+#include "scale.h"
+#include "simd.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRACTION 12
+#define FLOOR(i) ((i) & (~0UL << FRACTION))
+
+/* the old ResizeImage, without the aspect ratio handling */
+static RrPixel32* old_scale(const RrPixel32* src, gulong srcW, gulong srcH, gulong dstW, gulong dstH) {
+  RrPixel32 *dst, *dststart;
+  gulong dstX, dstY, srcX, srcY;
+  gulong srcX1, srcX2, srcY1, srcY2;
+  gulong ratioX, ratioY;
+
+  dststart = dst = g_new(RrPixel32, dstW * dstH);
+
+  ratioX = (srcW << FRACTION) / dstW;
+  ratioY = (srcH << FRACTION) / dstH;
+
+  srcY2 = 0;
+  for (dstY = 0; dstY < dstH; dstY++) {
+    srcY1 = srcY2;
+    srcY2 += ratioY;
+
+    srcX2 = 0;
+    for (dstX = 0; dstX < dstW; dstX++) {
+      gulong red = 0, green = 0, blue = 0, alpha = 0;
+      gulong portionX, portionY, portionXY, sumXY = 0;
+      RrPixel32 pixel;
+
+      srcX1 = srcX2;
+      srcX2 += ratioX;
+
+      for (srcY = srcY1; srcY < srcY2; srcY += (1UL << FRACTION)) {
+        if (srcY == srcY1) {
+          srcY = FLOOR(srcY);
+          portionY = (1UL << FRACTION) - (srcY1 - srcY);
+          if (portionY > srcY2 - srcY1)
+            portionY = srcY2 - srcY1;
+        }
+        else if (srcY == FLOOR(srcY2))
+          portionY = srcY2 - srcY;
+        else
+          portionY = (1UL << FRACTION);
+
+        for (srcX = srcX1; srcX < srcX2; srcX += (1UL << FRACTION)) {
+          if (srcX == srcX1) {
+            srcX = FLOOR(srcX);
+            portionX = (1UL << FRACTION) - (srcX1 - srcX);
+            if (portionX > srcX2 - srcX1)
+              portionX = srcX2 - srcX1;
+          }
+          else if (srcX == FLOOR(srcX2))
+            portionX = srcX2 - srcX;
+          else
+            portionX = (1UL << FRACTION);
+
+          portionXY = (portionX * portionY) >> FRACTION;
+          sumXY += portionXY;
+
+          pixel = *(src + (srcY >> FRACTION) * srcW + (srcX >> FRACTION));
+          red += ((pixel >> RrDefaultRedOffset) & 0xFF) * portionXY;
+          green += ((pixel >> RrDefaultGreenOffset) & 0xFF) * portionXY;
+          blue += ((pixel >> RrDefaultBlueOffset) & 0xFF) * portionXY;
+          alpha += ((pixel >> RrDefaultAlphaOffset) & 0xFF) * portionXY;
+        }
+      }
+
+      red /= sumXY;
+      green /= sumXY;
+      blue /= sumXY;
+      alpha /= sumXY;
+
+      *dst++ = ((guint)red << RrDefaultRedOffset) | ((guint)green << RrDefaultGreenOffset) |
+               ((guint)blue << RrDefaultBlueOffset) | ((guint)alpha << RrDefaultAlphaOffset);
+    }
+  }
+  return dststart;
+}
+
+/* something icon-like: a soft-edged disc over a transparent background */
+static RrPixel32* make_icon(gint size) {
+  RrPixel32* p = g_new(RrPixel32, size * size);
+  gint x, y;
+
+  for (y = 0; y < size; ++y)
+    for (x = 0; x < size; ++x) {
+      gint dx = x - size / 2, dy = y - size / 2;
+      gint d = (dx * dx + dy * dy) * 255 / (size * size / 4);
+      guint a = d >= 255 ? 0 : 255 - d;
+      guint r = x * 255 / size, g = y * 255 / size, b = (x ^ y) & 0xff;
+
+      p[y * size + x] = (a << RrDefaultAlphaOffset) | (r << RrDefaultRedOffset) | (g << RrDefaultGreenOffset) |
+                        (b << RrDefaultBlueOffset);
+    }
+  return p;
+}
+
+static gint channel_diff(RrPixel32 a, RrPixel32 b) {
+  gint i, m = 0;
+
+  for (i = 0; i < 32; i += 8)
+    m = MAX(m, ABS((gint)((a >> i) & 0xff) - (gint)((b >> i) & 0xff)));
+  return m;
+}
+
+gint main(gint argc, gchar** argv) {
+  static const gint sizes[][2] = {{256, 48}, {128, 32}, {64, 24}, {48, 16}, {16, 48}, {32, 128}};
+  gint iters = argc > 1 ? atoi(argv[1]) : 200;
+  guint i;
+
+  RrSimdSetup();
+  printf("kernels: %s, %d iterations\n", RrSimd()->name, iters);
+  printf("%-12s %10s %10s %10s %8s\n", "size", "old ms", "box ms", "lanczos ms", "max diff");
+
+  for (i = 0; i < G_N_ELEMENTS(sizes); ++i) {
+    const gint s = sizes[i][0], d = sizes[i][1];
+    RrPixel32 *src, *a, *b;
+    gint64 t0, t1, t2, t3;
+    gint n, j, diff = 0;
+    gchar name[32];
+
+    src = make_icon(s);
+
+    t0 = g_get_monotonic_time();
+    for (n = 0; n < iters; ++n)
+      g_free(old_scale(src, s, s, d, d));
+    t1 = g_get_monotonic_time();
+    for (n = 0; n < iters; ++n)
+      g_free(RrScale(src, s, s, d, d, RR_SCALE_BOX));
+    t2 = g_get_monotonic_time();
+    for (n = 0; n < iters; ++n)
+      g_free(RrScale(src, s, s, d, d, RR_SCALE_LANCZOS));
+    t3 = g_get_monotonic_time();
+
+    a = old_scale(src, s, s, d, d);
+    b = RrScale(src, s, s, d, d, RR_SCALE_BOX);
+    for (j = 0; j < d * d; ++j)
+      diff = MAX(diff, channel_diff(a[j], b[j]));
+
+    g_snprintf(name, sizeof(name), "%dx%d->%d", s, s, d);
+    printf("%-12s %10.2f %10.2f %10.2f %8d\n", name, (t1 - t0) / 1000.0, (t2 - t1) / 1000.0, (t3 - t2) / 1000.0,
+           diff);
+
+    g_free(a);
+    g_free(b);
+    g_free(src);
+  }
+  return 0;
+}
@@ -0,0 +1,676 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   simd.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "simd.h"
+
+#include <glib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RR_SIMD_X86
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RR_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+/* the alpha channel is left empty by the gradients */
+#define RGB_MASK 0x00ffffff
+#define ALPHA_MASK 0xff000000
+
+/* * * * * * * * * * * * * * * * * scalar * * * * * * * * * * * * * * * * * */
+
+static void scalar_fill(RrPixel32* dest, RrPixel32 pixel, gint n) {
+  gchar* cdest;
+  gsize lenbytes, remaining;
+
+  if (n < 8) {
+    while (n-- > 0)
+      *(dest++) = pixel;
+    return;
+  }
+
+  /* write 4 pixels and then exponentially copy non-overlapping chunks of
+     them until the row is filled */
+  dest[0] = dest[1] = dest[2] = dest[3] = pixel;
+  cdest = (gchar*)(dest + 4);
+  lenbytes = 4 * sizeof(RrPixel32);
+  remaining = (gsize)(n - 4) * sizeof(RrPixel32);
+  while (remaining > 0) {
+    gsize copied = MIN(lenbytes, remaining);
+    memcpy(cdest, dest, copied);
+    cdest += copied;
+    remaining -= copied;
+    lenbytes <<= 1;
+  }
+}
+
+static void scalar_combine(RrPixel32* dest, const RrPixel32* r, const RrPixel32* g, const RrPixel32* b, gint n) {
+  gint i;
+
+  for (i = 0; i < n; ++i)
+    dest[i] = r[i] | g[i] | b[i];
+}
+
+static void scalar_reverse(RrPixel32* dest, const RrPixel32* src, gint n) {
+  gint i;
+
+  for (i = 0; i < n; ++i)
+    dest[i] = src[n - 1 - i];
+}
+
+static inline RrPixel32 lighten(RrPixel32 p, gint light) {
+  gint r, g, b;
+
+  r = (p >> RrDefaultRedOffset) & 0xFF;
+  r += (r * light) >> 8;
+  g = (p >> RrDefaultGreenOffset) & 0xFF;
+  g += (g * light) >> 8;
+  b = (p >> RrDefaultBlueOffset) & 0xFF;
+  b += (b * light) >> 8;
+  if (r > 0xFF)
+    r = 0xFF;
+  if (g > 0xFF)
+    g = 0xFF;
+  if (b > 0xFF)
+    b = 0xFF;
+  return ((guint)r << RrDefaultRedOffset) + ((guint)g << RrDefaultGreenOffset) + ((guint)b << RrDefaultBlueOffset);
+}
+
+static inline RrPixel32 darken(RrPixel32 p, gint dark) {
+  gint r, g, b;
+
+  r = (p >> RrDefaultRedOffset) & 0xFF;
+  r -= (r * dark) >> 8;
+  g = (p >> RrDefaultGreenOffset) & 0xFF;
+  g -= (g * dark) >> 8;
+  b = (p >> RrDefaultBlueOffset) & 0xFF;
+  b -= (b * dark) >> 8;
+  return ((guint)r << RrDefaultRedOffset) + ((guint)g << RrDefaultGreenOffset) + ((guint)b << RrDefaultBlueOffset);
+}
+
+static void scalar_highlight(RrPixel32* up, RrPixel32* down, gint n, gint light, gint dark) {
+  gint i;
+
+  for (i = 0; i < n; ++i) {
+    up[i] = lighten(up[i], light);
+    down[i] = darken(down[i], dark);
+  }
+}
+
+static void scalar_accumulate(gint32* acc, const gint32* src, gint32 weight, gint n) {
+  gint i;
+
+  for (i = 0; i < n; ++i)
+    acc[i] += src[i] * weight;
+}
+
+static void scalar_scale_row(gint32* dest,
+                             const RrPixel32* src,
+                             const gint* start,
+                             const gint* count,
+                             const gint16* weights,
+                             gint ntaps,
+                             gint n,
+                             gint shift) {
+  const gint32 round = 1 << (shift - 1);
+  gint i, k, c;
+
+  for (i = 0; i < n; ++i, dest += 4, weights += ntaps) {
+    const guint8* p = (const guint8*)(src + start[i]);
+    gint32 sum[4] = {0, 0, 0, 0};
+
+    for (k = 0; k < count[i]; ++k, p += 4)
+      for (c = 0; c < 4; ++c)
+        sum[c] += p[c] * weights[k];
+    for (c = 0; c < 4; ++c)
+      dest[c] = (sum[c] + round) >> shift;
+  }
+}
+
+/* c * 255 / 255 without the division, rounded */
+static inline guint div255(guint c) {
+  c += 128;
+  return (c + (c >> 8)) >> 8;
+}
+
+/* the opacity is stretched to 0-256 so that fully opaque is a shift */
+static inline guint blend_opacity(gint alpha) {
+  return (guint)alpha + ((guint)alpha >> 7);
+}
+
+static void scalar_blend(RrPixel32* dest, const RrPixel32* src, gint n, gint alpha) {
+  const guint op = blend_opacity(alpha);
+  gint i, sh;
+
+  for (i = 0; i < n; ++i) {
+    const RrPixel32 s = src[i], d = dest[i];
+    guint a, inv;
+    RrPixel32 out;
+
+    a = s >> RrDefaultAlphaOffset;
+    if (a == 0)
+      continue;
+    if (a == 0xff && op == 256) {
+      dest[i] = (s & RGB_MASK) | (d & ALPHA_MASK);
+      continue;
+    }
+
+    a = (a * op) >> 8;
+    inv = 0xff - a;
+    out = d & ALPHA_MASK;
+    for (sh = 0; sh < 24; sh += 8) {
+      const guint c = (((s >> sh) & 0xff) * op) >> 8;
+      out |= (c + div255(((d >> sh) & 0xff) * inv)) << sh;
+    }
+    dest[i] = out;
+  }
+}
+
+static const RrSimdOps scalar_ops = {
+    "scalar",          scalar_fill,      scalar_combine, scalar_reverse, scalar_highlight,
+    scalar_accumulate, scalar_scale_row, scalar_blend,
+};
+
+/* * * * * * * * * * * * * * * * * * SSE2 * * * * * * * * * * * * * * * * * */
+
+#ifdef RR_SIMD_X86
+__attribute__((target("sse2"))) static void sse2_fill(RrPixel32* dest, RrPixel32 pixel, gint n) {
+  const __m128i v = _mm_set1_epi32((gint)pixel);
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm_storeu_si128((__m128i*)(dest + i), v);
+  for (; i < n; ++i)
+    dest[i] = pixel;
+}
+
+__attribute__((target("sse2"))) static void sse2_combine(RrPixel32* dest,
+                                                         const RrPixel32* r,
+                                                         const RrPixel32* g,
+                                                         const RrPixel32* b,
+                                                         gint n) {
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(r + i));
+    v = _mm_or_si128(v, _mm_loadu_si128((const __m128i*)(g + i)));
+    v = _mm_or_si128(v, _mm_loadu_si128((const __m128i*)(b + i)));
+    _mm_storeu_si128((__m128i*)(dest + i), v);
+  }
+  for (; i < n; ++i)
+    dest[i] = r[i] | g[i] | b[i];
+}
+
+__attribute__((target("sse2"))) static void sse2_reverse(RrPixel32* dest, const RrPixel32* src, gint n) {
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + n - 4 - i));
+    _mm_storeu_si128((__m128i*)(dest + i), _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+  }
+  for (; i < n; ++i)
+    dest[i] = src[n - 1 - i];
+}
+
+/* each channel is widened to 16 bits, where c * adjust fits for adjust <= 256,
+   and packing back down with unsigned saturation clamps the lightened
+   channels to 0xff */
+__attribute__((target("sse2"))) static void sse2_highlight(RrPixel32* up,
+                                                           RrPixel32* down,
+                                                           gint n,
+                                                           gint light,
+                                                           gint dark) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i mask = _mm_set1_epi32(RGB_MASK);
+  const __m128i lv = _mm_set1_epi16((gshort)light);
+  const __m128i dv = _mm_set1_epi16((gshort)dark);
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i v, lo, hi;
+
+    v = _mm_loadu_si128((const __m128i*)(up + i));
+    lo = _mm_unpacklo_epi8(v, zero);
+    hi = _mm_unpackhi_epi8(v, zero);
+    lo = _mm_add_epi16(lo, _mm_srli_epi16(_mm_mullo_epi16(lo, lv), 8));
+    hi = _mm_add_epi16(hi, _mm_srli_epi16(_mm_mullo_epi16(hi, lv), 8));
+    _mm_storeu_si128((__m128i*)(up + i), _mm_and_si128(_mm_packus_epi16(lo, hi), mask));
+
+    v = _mm_loadu_si128((const __m128i*)(down + i));
+    lo = _mm_unpacklo_epi8(v, zero);
+    hi = _mm_unpackhi_epi8(v, zero);
+    lo = _mm_sub_epi16(lo, _mm_srli_epi16(_mm_mullo_epi16(lo, dv), 8));
+    hi = _mm_sub_epi16(hi, _mm_srli_epi16(_mm_mullo_epi16(hi, dv), 8));
+    _mm_storeu_si128((__m128i*)(down + i), _mm_and_si128(_mm_packus_epi16(lo, hi), mask));
+  }
+  scalar_highlight(up + i, down + i, n - i, light, dark);
+}
+
+/* sse2 has no 32 bit multiply, so the even and odd lanes are done separately
+   as 64 bit multiplies.  The low halves of those are the same whether the
+   values are signed or not. */
+__attribute__((target("sse2"))) static void sse2_accumulate(gint32* acc, const gint32* src, gint32 weight, gint n) {
+  const __m128i wv = _mm_set1_epi32(weight);
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i v, even, odd;
+
+    v = _mm_loadu_si128((const __m128i*)(src + i));
+    even = _mm_mul_epu32(v, wv);
+    odd = _mm_mul_epu32(_mm_srli_si128(v, 4), wv);
+    v = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                           _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    _mm_storeu_si128((__m128i*)(acc + i), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i)), v));
+  }
+  scalar_accumulate(acc + i, src + i, weight, n - i);
+}
+
+/* two source pixels are done at a time, with their channels interleaved so
+   that madd multiplies each pair by the pair of weights and adds them up */
+__attribute__((target("sse2"))) static void sse2_scale_row(gint32* dest,
+                                                           const RrPixel32* src,
+                                                           const gint* start,
+                                                           const gint* count,
+                                                           const gint16* weights,
+                                                           gint ntaps,
+                                                           gint n,
+                                                           gint shift) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  gint i, k;
+
+  for (i = 0; i < n; ++i, dest += 4, weights += ntaps) {
+    const RrPixel32* p = src + start[i];
+    __m128i sum = zero;
+
+    for (k = 0; k + 2 <= count[i]; k += 2) {
+      __m128i v, w;
+
+      v = _mm_unpacklo_epi8(_mm_cvtsi32_si128((gint)p[k]), _mm_cvtsi32_si128((gint)p[k + 1]));
+      v = _mm_unpacklo_epi8(v, zero);
+      w = _mm_set1_epi32((gint)(((guint32)(guint16)weights[k + 1] << 16) | (guint16)weights[k]));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+    }
+    if (k < count[i]) {
+      __m128i v = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128((gint)p[k]), zero), zero);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(v, _mm_set1_epi32((guint16)weights[k])));
+    }
+    _mm_storeu_si128((__m128i*)dest, _mm_sra_epi32(_mm_add_epi32(sum, round), sh));
+  }
+}
+
+/* blends two pixels widened to 16 bit channels */
+__attribute__((target("sse2"))) static inline __m128i sse2_blend2(__m128i s, __m128i d, __m128i op, gboolean scale) {
+  const __m128i v128 = _mm_set1_epi16(128);
+  const __m128i v255 = _mm_set1_epi16(255);
+  __m128i a, t;
+
+  if (scale)
+    s = _mm_srli_epi16(_mm_mullo_epi16(s, op), 8);
+  a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  t = _mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(v255, a)), v128);
+  t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+  return _mm_add_epi16(s, t);
+}
+
+__attribute__((target("sse2"))) static void sse2_blend(RrPixel32* dest, const RrPixel32* src, gint n, gint alpha) {
+  const guint opacity = blend_opacity(alpha);
+  const gboolean scale = opacity != 256;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i amask = _mm_set1_epi32((gint)ALPHA_MASK);
+  const __m128i op = _mm_set1_epi16((gshort)opacity);
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i s, d, sa, lo, hi;
+
+    s = _mm_loadu_si128((const __m128i*)(src + i));
+    sa = _mm_and_si128(s, amask);
+    /* runs of transparent pixels are left alone, and opaque ones copied */
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero)) == 0xffff)
+      continue;
+    d = _mm_loadu_si128((const __m128i*)(dest + i));
+    if (!scale && _mm_movemask_epi8(_mm_cmpeq_epi32(sa, amask)) == 0xffff) {
+      _mm_storeu_si128((__m128i*)(dest + i), _mm_or_si128(_mm_andnot_si128(amask, s), _mm_and_si128(d, amask)));
+      continue;
+    }
+
+    lo = sse2_blend2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), op, scale);
+    hi = sse2_blend2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), op, scale);
+    _mm_storeu_si128((__m128i*)(dest + i),
+                     _mm_or_si128(_mm_andnot_si128(amask, _mm_packus_epi16(lo, hi)), _mm_and_si128(d, amask)));
+  }
+  scalar_blend(dest + i, src + i, n - i, alpha);
+}
+
+static const RrSimdOps sse2_ops = {
+    "sse2",          sse2_fill,      sse2_combine, sse2_reverse, sse2_highlight,
+    sse2_accumulate, sse2_scale_row, sse2_blend,
+};
+
+/* * * * * * * * * * * * * * * * * * AVX2 * * * * * * * * * * * * * * * * * */
+
+__attribute__((target("avx2"))) static void avx2_fill(RrPixel32* dest, RrPixel32 pixel, gint n) {
+  const __m256i v = _mm256_set1_epi32((gint)pixel);
+  gint i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm256_storeu_si256((__m256i*)(dest + i), v);
+  for (; i < n; ++i)
+    dest[i] = pixel;
+}
+
+__attribute__((target("avx2"))) static void avx2_combine(RrPixel32* dest,
+                                                         const RrPixel32* r,
+                                                         const RrPixel32* g,
+                                                         const RrPixel32* b,
+                                                         gint n) {
+  gint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(r + i));
+    v = _mm256_or_si256(v, _mm256_loadu_si256((const __m256i*)(g + i)));
+    v = _mm256_or_si256(v, _mm256_loadu_si256((const __m256i*)(b + i)));
+    _mm256_storeu_si256((__m256i*)(dest + i), v);
+  }
+  for (; i < n; ++i)
+    dest[i] = r[i] | g[i] | b[i];
+}
+
+__attribute__((target("avx2"))) static void avx2_reverse(RrPixel32* dest, const RrPixel32* src, gint n) {
+  const __m256i order = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  gint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(src + n - 8 - i));
+    _mm256_storeu_si256((__m256i*)(dest + i), _mm256_permutevar8x32_epi32(v, order));
+  }
+  for (; i < n; ++i)
+    dest[i] = src[n - 1 - i];
+}
+
+__attribute__((target("avx2"))) static void avx2_highlight(RrPixel32* up,
+                                                           RrPixel32* down,
+                                                           gint n,
+                                                           gint light,
+                                                           gint dark) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i mask = _mm256_set1_epi32(RGB_MASK);
+  const __m256i lv = _mm256_set1_epi16((gshort)light);
+  const __m256i dv = _mm256_set1_epi16((gshort)dark);
+  gint i;
+
+  /* unpack and pack work within each 128 bit lane, so the pixels come back
+     out in the order they went in */
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i v, lo, hi;
+
+    v = _mm256_loadu_si256((const __m256i*)(up + i));
+    lo = _mm256_unpacklo_epi8(v, zero);
+    hi = _mm256_unpackhi_epi8(v, zero);
+    lo = _mm256_add_epi16(lo, _mm256_srli_epi16(_mm256_mullo_epi16(lo, lv), 8));
+    hi = _mm256_add_epi16(hi, _mm256_srli_epi16(_mm256_mullo_epi16(hi, lv), 8));
+    _mm256_storeu_si256((__m256i*)(up + i), _mm256_and_si256(_mm256_packus_epi16(lo, hi), mask));
+
+    v = _mm256_loadu_si256((const __m256i*)(down + i));
+    lo = _mm256_unpacklo_epi8(v, zero);
+    hi = _mm256_unpackhi_epi8(v, zero);
+    lo = _mm256_sub_epi16(lo, _mm256_srli_epi16(_mm256_mullo_epi16(lo, dv), 8));
+    hi = _mm256_sub_epi16(hi, _mm256_srli_epi16(_mm256_mullo_epi16(hi, dv), 8));
+    _mm256_storeu_si256((__m256i*)(down + i), _mm256_and_si256(_mm256_packus_epi16(lo, hi), mask));
+  }
+  scalar_highlight(up + i, down + i, n - i, light, dark);
+}
+
+__attribute__((target("avx2"))) static void avx2_accumulate(gint32* acc, const gint32* src, gint32 weight, gint n) {
+  const __m256i wv = _mm256_set1_epi32(weight);
+  gint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(src + i)), wv);
+    _mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(acc + i)), v));
+  }
+  scalar_accumulate(acc + i, src + i, weight, n - i);
+}
+
+__attribute__((target("avx2"))) static inline __m256i avx2_blend2(__m256i s, __m256i d, __m256i op, gboolean scale) {
+  const __m256i v128 = _mm256_set1_epi16(128);
+  const __m256i v255 = _mm256_set1_epi16(255);
+  __m256i a, t;
+
+  if (scale)
+    s = _mm256_srli_epi16(_mm256_mullo_epi16(s, op), 8);
+  a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  t = _mm256_add_epi16(_mm256_mullo_epi16(d, _mm256_sub_epi16(v255, a)), v128);
+  t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+  return _mm256_add_epi16(s, t);
+}
+
+__attribute__((target("avx2"))) static void avx2_blend(RrPixel32* dest, const RrPixel32* src, gint n, gint alpha) {
+  const guint opacity = blend_opacity(alpha);
+  const gboolean scale = opacity != 256;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i amask = _mm256_set1_epi32((gint)ALPHA_MASK);
+  const __m256i op = _mm256_set1_epi16((gshort)opacity);
+  gint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i s, d, sa, lo, hi;
+
+    s = _mm256_loadu_si256((const __m256i*)(src + i));
+    sa = _mm256_and_si256(s, amask);
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, zero)) == -1)
+      continue;
+    d = _mm256_loadu_si256((const __m256i*)(dest + i));
+    if (!scale && _mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, amask)) == -1) {
+      _mm256_storeu_si256((__m256i*)(dest + i),
+                          _mm256_or_si256(_mm256_andnot_si256(amask, s), _mm256_and_si256(d, amask)));
+      continue;
+    }
+
+    /* unpack and pack stay within 128 bit lanes, so the order comes back
+       the same */
+    lo = avx2_blend2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero), op, scale);
+    hi = avx2_blend2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero), op, scale);
+    _mm256_storeu_si256((__m256i*)(dest + i), _mm256_or_si256(_mm256_andnot_si256(amask, _mm256_packus_epi16(lo, hi)),
+                                                              _mm256_and_si256(d, amask)));
+  }
+  scalar_blend(dest + i, src + i, n - i, alpha);
+}
+
+static const RrSimdOps avx2_ops = {
+    "avx2",          avx2_fill,      avx2_combine, avx2_reverse, avx2_highlight,
+    avx2_accumulate, sse2_scale_row, avx2_blend,
+};
+#endif /* RR_SIMD_X86 */
+
+/* * * * * * * * * * * * * * * * * * NEON * * * * * * * * * * * * * * * * * */
+
+#ifdef RR_SIMD_NEON
+static void neon_fill(RrPixel32* dest, RrPixel32 pixel, gint n) {
+  const uint32x4_t v = vdupq_n_u32(pixel);
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    vst1q_u32(dest + i, v);
+  for (; i < n; ++i)
+    dest[i] = pixel;
+}
+
+static void neon_combine(RrPixel32* dest, const RrPixel32* r, const RrPixel32* g, const RrPixel32* b, gint n) {
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    uint32x4_t v = vld1q_u32(r + i);
+    v = vorrq_u32(v, vld1q_u32(g + i));
+    v = vorrq_u32(v, vld1q_u32(b + i));
+    vst1q_u32(dest + i, v);
+  }
+  for (; i < n; ++i)
+    dest[i] = r[i] | g[i] | b[i];
+}
+
+static void neon_reverse(RrPixel32* dest, const RrPixel32* src, gint n) {
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    uint32x4_t v = vrev64q_u32(vld1q_u32(src + n - 4 - i));
+    vst1q_u32(dest + i, vcombine_u32(vget_high_u32(v), vget_low_u32(v)));
+  }
+  for (; i < n; ++i)
+    dest[i] = src[n - 1 - i];
+}
+
+static void neon_highlight(RrPixel32* up, RrPixel32* down, gint n, gint light, gint dark) {
+  const uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(RGB_MASK));
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    uint8x16_t v;
+    uint16x8_t lo, hi;
+
+    v = vld1q_u8((const guint8*)(up + i));
+    lo = vmovl_u8(vget_low_u8(v));
+    hi = vmovl_u8(vget_high_u8(v));
+    lo = vaddq_u16(lo, vshrq_n_u16(vmulq_n_u16(lo, (guint16)light), 8));
+    hi = vaddq_u16(hi, vshrq_n_u16(vmulq_n_u16(hi, (guint16)light), 8));
+    vst1q_u8((guint8*)(up + i), vandq_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)), mask));
+
+    v = vld1q_u8((const guint8*)(down + i));
+    lo = vmovl_u8(vget_low_u8(v));
+    hi = vmovl_u8(vget_high_u8(v));
+    lo = vsubq_u16(lo, vshrq_n_u16(vmulq_n_u16(lo, (guint16)dark), 8));
+    hi = vsubq_u16(hi, vshrq_n_u16(vmulq_n_u16(hi, (guint16)dark), 8));
+    vst1q_u8((guint8*)(down + i), vandq_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)), mask));
+  }
+  scalar_highlight(up + i, down + i, n - i, light, dark);
+}
+
+static void neon_accumulate(gint32* acc, const gint32* src, gint32 weight, gint n) {
+  gint i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    vst1q_s32(acc + i, vmlaq_n_s32(vld1q_s32(acc + i), vld1q_s32(src + i), weight));
+  scalar_accumulate(acc + i, src + i, weight, n - i);
+}
+
+static void neon_scale_row(gint32* dest,
+                           const RrPixel32* src,
+                           const gint* start,
+                           const gint* count,
+                           const gint16* weights,
+                           gint ntaps,
+                           gint n,
+                           gint shift) {
+  const int32x4_t sh = vdupq_n_s32(-shift);
+  const int32x4_t round = vdupq_n_s32(1 << (shift - 1));
+  gint i, k;
+
+  for (i = 0; i < n; ++i, dest += 4, weights += ntaps) {
+    const RrPixel32* p = src + start[i];
+    int32x4_t sum = vdupq_n_s32(0);
+
+    for (k = 0; k < count[i]; ++k) {
+      int16x4_t v = vreinterpret_s16_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(p[k])))));
+      sum = vmlal_n_s16(sum, v, weights[k]);
+    }
+    vst1q_s32(dest, vshlq_s32(vaddq_s32(sum, round), sh));
+  }
+}
+
+static void neon_blend(RrPixel32* dest, const RrPixel32* src, gint n, gint alpha) {
+  const guint opacity = blend_opacity(alpha);
+  const uint8x8_t op = vdup_n_u8((guint8)opacity);
+  gint i, c;
+
+  /* vld4 splits 8 pixels up into their channels: b, g, r, a */
+  for (i = 0; i + 8 <= n; i += 8) {
+    uint8x8x4_t s, d;
+    uint8x8_t inv;
+    guint64 sa;
+
+    s = vld4_u8((const guint8*)(src + i));
+    sa = vget_lane_u64(vreinterpret_u64_u8(s.val[3]), 0);
+    if (sa == 0)
+      continue;
+    d = vld4_u8((const guint8*)(dest + i));
+    if (opacity == 256 && sa == G_GUINT64_CONSTANT(0xffffffffffffffff)) {
+      s.val[3] = d.val[3];
+      vst4_u8((guint8*)(dest + i), s);
+      continue;
+    }
+
+    if (opacity != 256)
+      for (c = 0; c < 4; ++c)
+        s.val[c] = vshrn_n_u16(vmull_u8(s.val[c], op), 8);
+    inv = vmvn_u8(s.val[3]);
+    for (c = 0; c < 3; ++c) {
+      uint16x8_t t = vaddq_u16(vmull_u8(d.val[c], inv), vdupq_n_u16(128));
+      d.val[c] = vadd_u8(s.val[c], vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8));
+    }
+    vst4_u8((guint8*)(dest + i), d);
+  }
+  scalar_blend(dest + i, src + i, n - i, alpha);
+}
+
+static const RrSimdOps neon_ops = {
+    "neon",          neon_fill,      neon_combine, neon_reverse, neon_highlight,
+    neon_accumulate, neon_scale_row, neon_blend,
+};
+#endif /* RR_SIMD_NEON */
+
+static const RrSimdOps* ops = &scalar_ops;
+
+void RrSimdSetup(void) {
+  const RrSimdOps* all[4];
+  const gchar* force;
+  gint i, n = 0;
+
+  /* best first */
+#ifdef RR_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    all[n++] = &avx2_ops;
+  if (__builtin_cpu_supports("sse2"))
+    all[n++] = &sse2_ops;
+#endif
+#ifdef RR_SIMD_NEON
+  all[n++] = &neon_ops;
+#endif
+  all[n++] = &scalar_ops;
+
+  ops = all[0];
+
+  force = g_getenv("OBRENDER_SIMD");
+  if (force) {
+    for (i = 0; i < n; ++i)
+      if (!strcmp(force, all[i]->name)) {
+        ops = all[i];
+        break;
+      }
+    if (i == n)
+      g_message("OBRENDER_SIMD=%s is not available, using %s", force, ops->name);
+  }
+}
+
+const RrSimdOps* RrSimd(void) {
+  return ops;
+}
@@ -0,0 +1,66 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   simd.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __simd_h
+#define __simd_h
+
+#include "render.h"
+
+/*! Pixel row kernels used by the renderer.  Every implementation must give
+  exactly the same output as the scalar one. */
+typedef struct _RrSimdOps {
+  const gchar* name;
+
+  /*! Sets @n pixels to @pixel */
+  void (*fill)(RrPixel32* dest, RrPixel32 pixel, gint n);
+  /*! Sets each pixel to the OR of the three channel rows */
+  void (*combine)(RrPixel32* dest, const RrPixel32* r, const RrPixel32* g, const RrPixel32* b, gint n);
+  /*! Copies @n pixels from @src into @dest in reverse order.  The two must
+    not overlap */
+  void (*reverse)(RrPixel32* dest, const RrPixel32* src, gint n);
+  /*! Lightens the @up row and darkens the @down row for a bevel.  The rows are
+    either the same or disjoint.  @light and @dark must be at most 256. */
+  void (*highlight)(RrPixel32* up, RrPixel32* down, gint n, gint light, gint dark);
+  /*! Adds @src times @weight to each of the @n values in @acc.  The results
+    must fit in 32 bits. */
+  void (*accumulate)(gint32* acc, const gint32* src, gint32 weight, gint n);
+  /*! Scales a row of pixels across.  Destination pixel i is made from the
+    @count[i] source pixels starting at @src + @start[i], each multiplied by
+    its fixed point weight from the @ntaps weights for i.  The four channel
+    sums, in the order the channels are in memory, are rounded off by
+    @shift bits and written to @dest. */
+  void (*scale_row)(gint32* dest,
+                    const RrPixel32* src,
+                    const gint* start,
+                    const gint* count,
+                    const gint16* weights,
+                    gint ntaps,
+                    gint n,
+                    gint shift);
+  /*! Draws @n premultiplied pixels from @src over @dest, with the extra
+    opacity @alpha (0-255).  The alpha channel of @dest is left as it was. */
+  void (*blend)(RrPixel32* dest, const RrPixel32* src, gint n, gint alpha);
+} RrSimdOps;
+
+/*! Picks the best kernels for the cpu.  Setting OBRENDER_SIMD in the
+  environment to the name of a set of kernels (e.g. "scalar") forces it. */
+void RrSimdSetup(void);
+
+/*! The kernels picked by RrSimdSetup, or the scalar ones before it runs */
+const RrSimdOps* RrSimd(void);
+
+#endif /* __simd_h */
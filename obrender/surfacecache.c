@@ -0,0 +1,209 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   surfacecache.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "surfacecache.h"
+#include "imagecache.h"
+#include "color.h"
+
+#include <string.h>
+
+#define HASH_INITVAL 0x5eed
+
+/* the words of a cache key */
+enum {
+  KEY_WIDTH,
+  KEY_HEIGHT,
+  KEY_TYPE, /* gradient, relief, bevel, interlaced, border */
+  KEY_PRIMARY,
+  KEY_SECONDARY,
+  KEY_SPLIT_PRIMARY,
+  KEY_SPLIT_SECONDARY,
+  KEY_INTERLACE,
+  KEY_BORDER,
+  KEY_BEVEL_ADJUST,
+  KEY_LEN
+};
+
+typedef struct _RrSurfaceCacheEntry {
+  guint32 key[KEY_LEN];
+  Pixmap pixmap;
+  RrPixel32* pixels;
+  gsize cost;
+  /*! The entry's place in the lru queue */
+  GList link;
+} RrSurfaceCacheEntry;
+
+struct _RrSurfaceCache {
+  gsize max_bytes;
+  gsize bytes;
+  /*! Maps keys to RrSurfaceCacheEntrys */
+  GHashTable* table;
+  /*! The entries, with the most recently used at the head */
+  GQueue lru;
+};
+
+static guint key_hash(gconstpointer key) {
+  return hashword(key, KEY_LEN, HASH_INITVAL);
+}
+
+static gboolean key_equal(gconstpointer a, gconstpointer b) {
+  return memcmp(a, b, sizeof(guint32) * KEY_LEN) == 0;
+}
+
+/* colors are compared by value, as the same color is often parsed into
+   different RrColors by different parts of a theme */
+static guint32 color_key(const RrColor* c) {
+  if (!c)
+    return 0xff000000;
+  return ((guint32)c->r << 16) | ((guint32)c->g << 8) | (guint32)c->b;
+}
+
+static void make_key(const RrSurface* sf, gint w, gint h, guint32* key) {
+  memset(key, 0, sizeof(guint32) * KEY_LEN);
+
+  key[KEY_WIDTH] = w;
+  key[KEY_HEIGHT] = h;
+  key[KEY_TYPE] = sf->grad | (sf->relief << 8) | (sf->bevel << 16) | (!!sf->interlaced << 24) | (!!sf->border << 25);
+  key[KEY_PRIMARY] = color_key(sf->primary);
+  /* only include the settings that change how the surface is drawn */
+  if (sf->grad != RR_SURFACE_SOLID)
+    key[KEY_SECONDARY] = color_key(sf->secondary);
+  if (sf->grad == RR_SURFACE_SPLIT_VERTICAL) {
+    key[KEY_SPLIT_PRIMARY] = color_key(sf->split_primary);
+    key[KEY_SPLIT_SECONDARY] = color_key(sf->split_secondary);
+  }
+  if (sf->interlaced)
+    key[KEY_INTERLACE] = color_key(sf->interlace_color);
+  if (sf->relief == RR_RELIEF_FLAT) {
+    if (sf->border)
+      key[KEY_BORDER] = color_key(sf->border_color);
+  }
+  else
+    key[KEY_BEVEL_ADJUST] = ((guint32)sf->bevel_light_adjust & 0xffff) | ((guint32)sf->bevel_dark_adjust << 16);
+}
+
+static void entry_free(const RrInstance* inst, RrSurfaceCache* c, RrSurfaceCacheEntry* e) {
+  g_queue_unlink(&c->lru, &e->link);
+  g_hash_table_remove(c->table, e->key);
+  c->bytes -= e->cost;
+
+  XFreePixmap(RrDisplay(inst), e->pixmap);
+  g_free(e->pixels);
+  g_slice_free(RrSurfaceCacheEntry, e);
+}
+
+/* drop the least recently used entries until there is room for @needed more
+   bytes */
+static void make_room(const RrInstance* inst, RrSurfaceCache* c, gsize needed) {
+  while (c->lru.tail && c->bytes + needed > c->max_bytes)
+    entry_free(inst, c, c->lru.tail->data);
+}
+
+RrSurfaceCache* RrSurfaceCacheNew(gsize max_bytes) {
+  RrSurfaceCache* c;
+
+  c = g_slice_new(RrSurfaceCache);
+  c->max_bytes = max_bytes;
+  c->bytes = 0;
+  c->table = g_hash_table_new(key_hash, key_equal);
+  g_queue_init(&c->lru);
+  return c;
+}
+
+void RrSurfaceCacheFree(const RrInstance* inst, RrSurfaceCache* c) {
+  if (c) {
+    while (c->lru.head)
+      entry_free(inst, c, c->lru.head->data);
+    g_hash_table_destroy(c->table);
+    g_slice_free(RrSurfaceCache, c);
+  }
+}
+
+void RrSurfaceCacheSetSize(const RrInstance* inst, gsize max_bytes) {
+  RrSurfaceCache* c;
+
+  g_return_if_fail(inst != NULL);
+
+  c = inst->surface_cache;
+  c->max_bytes = max_bytes;
+  make_room(inst, c, 0);
+}
+
+gboolean RrSurfaceCacheable(const RrAppearance* a) {
+  gint i;
+
+  if (a->surface.grad == RR_SURFACE_PARENTREL)
+    return FALSE;
+  if (a->surface.grad == RR_SURFACE_SOLID && !a->surface.interlaced)
+    return FALSE;
+  if (a->inst->surface_cache->max_bytes == 0)
+    return FALSE;
+
+  for (i = 0; i < a->textures; i++)
+    if (a->texture[i].type == RR_TEXTURE_IMAGE || a->texture[i].type == RR_TEXTURE_RGBA)
+      return FALSE;
+  return TRUE;
+}
+
+gboolean RrSurfaceCacheFetch(RrAppearance* a, gint w, gint h) {
+  RrSurfaceCache* c = a->inst->surface_cache;
+  RrSurfaceCacheEntry* e;
+  guint32 key[KEY_LEN];
+
+  make_key(&a->surface, w, h, key);
+  e = g_hash_table_lookup(c->table, key);
+  if (!e)
+    return FALSE;
+
+  /* move it to the front of the lru queue */
+  g_queue_unlink(&c->lru, &e->link);
+  g_queue_push_head_link(&c->lru, &e->link);
+
+  memcpy(a->surface.pixel_data, e->pixels, sizeof(RrPixel32) * (gsize)w * (gsize)h);
+  XCopyArea(RrDisplay(a->inst), e->pixmap, a->pixmap, DefaultGC(RrDisplay(a->inst), RrScreen(a->inst)), 0, 0, w, h,
+            0, 0);
+  return TRUE;
+}
+
+void RrSurfaceCacheStore(RrAppearance* a, gint w, gint h) {
+  RrSurfaceCache* c = a->inst->surface_cache;
+  RrSurfaceCacheEntry* e;
+  gsize npixels = (gsize)w * (gsize)h;
+  gsize cost;
+
+  /* the pixel data, and about the same again for the pixmap in the server */
+  cost = 2 * sizeof(RrPixel32) * npixels;
+  /* don't let one huge surface (like a big menu) push out everything else */
+  if (cost > c->max_bytes / 4)
+    return;
+
+  make_room(a->inst, c, cost);
+
+  e = g_slice_new(RrSurfaceCacheEntry);
+  make_key(&a->surface, w, h, e->key);
+  e->cost = cost;
+  e->pixels = g_memdup2(a->surface.pixel_data, sizeof(RrPixel32) * npixels);
+  e->pixmap = XCreatePixmap(RrDisplay(a->inst), RrRootWindow(a->inst), w, h, RrDepth(a->inst));
+  XCopyArea(RrDisplay(a->inst), a->pixmap, e->pixmap, DefaultGC(RrDisplay(a->inst), RrScreen(a->inst)), 0, 0, w, h,
+            0, 0);
+
+  e->link.data = e;
+  e->link.prev = e->link.next = NULL;
+  g_queue_push_head_link(&c->lru, &e->link);
+  g_hash_table_insert(c->table, e->key, e);
+  c->bytes += cost;
+}
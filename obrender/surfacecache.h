@@ -0,0 +1,54 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   surfacecache.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __surfacecache_h
+#define __surfacecache_h
+
+#include "render.h"
+#include "instance.h"
+
+/*! The default number of bytes of rendered surfaces to keep around */
+#define RR_SURFACE_CACHE_DEFAULT_SIZE (4 * 1024 * 1024)
+
+/*! A cache of rendered surfaces.  Surfaces are looked up by what they look
+  like (gradient, colors, bevel, border, interlacing) and their size, so
+  appearances that are drawn the same way share a single rendering no matter
+  which RrAppearance they come from.  Each entry keeps a server-side copy of
+  the surface to paint from, and the pixel data for things like
+  parent-relative children that read it.  The least recently used entries
+  are dropped to stay within a byte budget.  There is one for each
+  RrInstance.
+*/
+
+RrSurfaceCache* RrSurfaceCacheNew(gsize max_bytes);
+void RrSurfaceCacheFree(const RrInstance* inst, RrSurfaceCache* c);
+
+/*! Returns TRUE if the appearance's surface can be shared through the cache.
+  Surfaces that depend on something other than their own settings
+  (parent-relative ones, or ones with images drawn into the pixel data) can't
+  be, and neither are plain solid colors, which the server fills faster than
+  it could copy them. */
+gboolean RrSurfaceCacheable(const RrAppearance* a);
+
+/*! Paints a cached rendering of the appearance's surface into a->pixmap and
+  a->surface.pixel_data, if there is one.  Returns FALSE on a miss. */
+gboolean RrSurfaceCacheFetch(RrAppearance* a, gint w, gint h);
+
+/*! Saves the surface that was just rendered and copied to a->pixmap */
+void RrSurfaceCacheStore(RrAppearance* a, gint w, gint h);
+
+#endif
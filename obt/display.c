@@ -32,10 +32,6 @@
 #include <unistd.h>
 #endif
 
-/* from xqueue.c */
-extern void xqueue_init(void);
-extern void xqueue_destroy(void);
-
 Display* obt_display = NULL;
 
 gboolean obt_display_error_occured = FALSE;
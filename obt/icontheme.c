@@ -0,0 +1,646 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   obt/icontheme.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "obt/icontheme.h"
+#include "obt/internal.h"
+#include "obt/paths.h"
+
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+/* An index file holds a header, then the directories that were looked at to
+   make it, the directories that have icons in them, a hash table of the
+   icon names, the icons, the places that each icon is found, and the strings
+   that all of those refer to by offset.  It's only ever read back on the
+   machine that wrote it, so everything is in the native byte order, and it
+   is used where it is mapped into memory. */
+
+#define INDEX_MAGIC "OBIC"
+#define INDEX_VERSION 2
+/* no icon, or the theme of the directories of icons without a theme */
+#define INDEX_NONE G_MAXUINT32
+
+#define THEME_GROUP "Icon Theme"
+
+typedef enum { DIR_FIXED, DIR_SCALABLE, DIR_THRESHOLD } DirType;
+
+/* the file types that icons come in, in the order they are preferred */
+static const gchar* const exts[] = {".png", ".svg", ".xpm"};
+
+typedef struct _IndexHeader {
+  gchar magic[4];
+  guint32 version;
+  guint32 n_sources;
+  guint32 n_dirs;
+  guint32 n_buckets;
+  guint32 n_icons;
+  guint32 n_entries;
+  guint32 strings_len;
+} IndexHeader;
+
+typedef struct _IndexSource {
+  guint32 path;
+  /* FALSE if it didn't exist */
+  guint32 exists;
+  gint64 mtime;
+} IndexSource;
+
+typedef struct _IndexDir {
+  guint32 path;
+  /* the theme that it is in, counting in the order they are searched */
+  guint32 theme;
+  guint32 type;
+  gint32 size;
+  gint32 min_size;
+  gint32 max_size;
+  gint32 threshold;
+  guint32 pad;
+} IndexDir;
+
+typedef struct _IndexIcon {
+  guint32 name;
+  /* the next icon in the same hash bucket */
+  guint32 next;
+  guint32 first_entry;
+  guint32 n_entries;
+} IndexIcon;
+
+typedef struct _IndexEntry {
+  guint32 dir;
+  /* a bit for each of exts[] that the icon has a file for in the dir */
+  guint32 exts;
+} IndexEntry;
+
+typedef struct _IndexBuilder {
+  GSList* bases;
+  GArray* sources;
+  GArray* dirs;
+  GString* strings;
+  GHashTable* offsets;
+  /* the places each icon is found, as GArrays of IndexEntry, by name */
+  GHashTable* icons;
+  /* the names of the themes that have been added */
+  GHashTable* themes;
+  guint32 n_themes;
+  time_t started;
+  gboolean ok;
+} IndexBuilder;
+
+struct _ObtIconTheme {
+  gint ref;
+  /* the index, if it was loaded from the cache */
+  GMappedFile* map;
+  /* the index, if it was made when the theme was opened */
+  GByteArray* built;
+  const IndexHeader* header;
+  const IndexSource* sources;
+  const IndexDir* dirs;
+  const guint32* buckets;
+  const IndexIcon* icons;
+  const IndexEntry* entries;
+  const gchar* strings;
+};
+
+static guint32 name_hash(const gchar* s) {
+  guint32 h = 5381;
+
+  for (; *s; ++s)
+    h = h * 33 + (guchar)*s;
+  return h;
+}
+
+static gchar* index_key(const gchar* name, GSList* bases) {
+  GString* s = g_string_new(name);
+  gchar* key;
+
+  for (; bases; bases = g_slist_next(bases)) {
+    g_string_append_c(s, '\n');
+    g_string_append(s, bases->data);
+  }
+  key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, s->str, s->len);
+  g_string_free(s, TRUE);
+  return key;
+}
+
+static guint32 builder_string(IndexBuilder* b, const gchar* s) {
+  gpointer offset;
+
+  if (!g_hash_table_lookup_extended(b->offsets, s, NULL, &offset)) {
+    offset = GUINT_TO_POINTER(b->strings->len);
+    g_string_append_len(b->strings, s, strlen(s) + 1);
+    g_hash_table_insert(b->offsets, g_strdup(s), offset);
+  }
+  return GPOINTER_TO_UINT(offset);
+}
+
+/* Records the time that @path was changed, or if @missing_too, that it
+   doesn't exist.  Returns TRUE if it exists. */
+static gboolean add_source(IndexBuilder* b, const gchar* path, gboolean missing_too) {
+  IndexSource src;
+  struct stat st;
+
+  src.path = 0;
+  src.exists = stat(path, &st) == 0;
+  src.mtime = src.exists ? st.st_mtime : 0;
+  if (!src.exists && !missing_too)
+    return FALSE;
+
+  /* it may have changed since it was looked at */
+  if (src.exists && st.st_mtime >= b->started)
+    b->ok = FALSE;
+  src.path = builder_string(b, path);
+  g_array_append_val(b->sources, src);
+  return src.exists;
+}
+
+static guint32 file_ext(const gchar* file) {
+  gsize len = strlen(file);
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(exts); ++i)
+    if (len > strlen(exts[i]) && !strcmp(file + len - strlen(exts[i]), exts[i]))
+      return 1 << i;
+  return 0;
+}
+
+/* Adds the icons in the directory @path, which is described by @info */
+static void scan_dir(IndexBuilder* b, const gchar* path, const IndexDir* info) {
+  GDir* dir;
+  const gchar* file;
+  IndexDir d;
+  guint32 n;
+
+  /* a theme's directories can be inside others, like 48x48/apps, and making
+     one only changes the time of the one it's in, so the ones that don't
+     exist are watched too */
+  if (!add_source(b, path, TRUE) || !(dir = g_dir_open(path, 0, NULL)))
+    return;
+
+  d = *info;
+  d.path = builder_string(b, path);
+  n = b->dirs->len;
+  g_array_append_val(b->dirs, d);
+
+  while ((file = g_dir_read_name(dir))) {
+    guint32 ext = file_ext(file);
+    GArray* entries;
+    gchar* icon;
+
+    if (!ext)
+      continue;
+
+    icon = g_strndup(file, strlen(file) - strlen(exts[g_bit_nth_lsf(ext, -1)]));
+    if (!(entries = g_hash_table_lookup(b->icons, icon))) {
+      entries = g_array_new(FALSE, FALSE, sizeof(IndexEntry));
+      g_hash_table_insert(b->icons, icon, entries);
+    }
+    else
+      g_free(icon);
+
+    if (entries->len && g_array_index(entries, IndexEntry, entries->len - 1).dir == n)
+      g_array_index(entries, IndexEntry, entries->len - 1).exts |= ext;
+    else {
+      IndexEntry e;
+
+      e.dir = n;
+      e.exts = ext;
+      g_array_append_val(entries, e);
+    }
+  }
+  g_dir_close(dir);
+}
+
+static gint key_int(GKeyFile* kf, const gchar* group, const gchar* key, gint def) {
+  return g_key_file_has_key(kf, group, key, NULL) ? g_key_file_get_integer(kf, group, key, NULL) : def;
+}
+
+/* Reads the sizes of icons that are in a theme's directory */
+static gboolean read_dir_info(GKeyFile* kf, const gchar* group, IndexDir* d) {
+  gchar* type;
+
+  if ((d->size = key_int(kf, group, "Size", 0)) <= 0)
+    return FALSE;
+  /* only icons for unscaled screens are looked for */
+  if (key_int(kf, group, "Scale", 1) != 1)
+    return FALSE;
+
+  d->min_size = key_int(kf, group, "MinSize", d->size);
+  d->max_size = key_int(kf, group, "MaxSize", d->size);
+  d->threshold = key_int(kf, group, "Threshold", 2);
+  d->pad = 0;
+
+  type = g_key_file_get_string(kf, group, "Type", NULL);
+  if (type && !strcmp(type, "Fixed"))
+    d->type = DIR_FIXED;
+  else if (type && !strcmp(type, "Scalable"))
+    d->type = DIR_SCALABLE;
+  else
+    d->type = DIR_THRESHOLD;
+  g_free(type);
+  return TRUE;
+}
+
+/* Adds the theme called @name, and then the themes it inherits from */
+static void add_theme(IndexBuilder* b, const gchar* name) {
+  GKeyFile* kf = NULL;
+  GSList *it, *found = NULL;
+  gchar **dirs, **inherits;
+  gsize i, n;
+  IndexDir d;
+
+  /* themes can inherit from each other in a loop */
+  if (!*name || strchr(name, G_DIR_SEPARATOR) || g_hash_table_contains(b->themes, name))
+    return;
+  g_hash_table_add(b->themes, g_strdup(name));
+
+  /* the theme is described by the first of its directories that has an
+     index.theme, and its icons are in any of them */
+  for (it = b->bases; it; it = g_slist_next(it)) {
+    gchar* dir = g_build_filename(it->data, name, NULL);
+
+    if (!add_source(b, dir, FALSE)) {
+      g_free(dir);
+      continue;
+    }
+    found = g_slist_append(found, dir);
+    if (!kf) {
+      gchar* file = g_build_filename(dir, "index.theme", NULL);
+
+      kf = g_key_file_new();
+      /* its lists are separated by commas */
+      g_key_file_set_list_separator(kf, ',');
+      if (!add_source(b, file, FALSE) || !g_key_file_load_from_file(kf, file, G_KEY_FILE_NONE, NULL)) {
+        g_key_file_free(kf);
+        kf = NULL;
+      }
+      g_free(file);
+    }
+  }
+  if (!kf) {
+    g_slist_free_full(found, g_free);
+    return;
+  }
+
+  d.theme = b->n_themes++;
+  dirs = g_key_file_get_string_list(kf, THEME_GROUP, "Directories", &n, NULL);
+  for (i = 0; dirs && i < n; ++i) {
+    if (!read_dir_info(kf, dirs[i], &d))
+      continue;
+    for (it = found; it; it = g_slist_next(it)) {
+      gchar* path = g_build_filename(it->data, dirs[i], NULL);
+
+      scan_dir(b, path, &d);
+      g_free(path);
+    }
+  }
+  g_strfreev(dirs);
+  g_slist_free_full(found, g_free);
+
+  inherits = g_key_file_get_string_list(kf, THEME_GROUP, "Inherits", &n, NULL);
+  for (i = 0; inherits && i < n; ++i)
+    add_theme(b, g_strstrip(inherits[i]));
+  g_strfreev(inherits);
+
+  g_key_file_free(kf);
+}
+
+/* Makes the index for the theme @name from the directories in @bases.  Sets
+   @ok to FALSE if anything changed while it was being made, so it shouldn't
+   be saved. */
+static GByteArray* index_build(const gchar* name, GSList* bases, gboolean* ok) {
+  IndexBuilder b;
+  IndexHeader h;
+  IndexDir unthemed;
+  GArray *icons, *entries;
+  guint32* buckets;
+  guint32 i, n_buckets;
+  GHashTableIter iter;
+  gpointer key, value;
+  GSList* it;
+  GByteArray* out;
+
+  b.bases = bases;
+  b.sources = g_array_new(FALSE, FALSE, sizeof(IndexSource));
+  b.dirs = g_array_new(FALSE, FALSE, sizeof(IndexDir));
+  /* offset 0 is the empty string, so the table is never empty */
+  b.strings = g_string_new_len("", 1);
+  b.offsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  b.icons = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_array_unref);
+  b.themes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  b.n_themes = 0;
+  b.started = time(NULL);
+  b.ok = TRUE;
+
+  add_theme(&b, name);
+  /* every theme falls back to hicolor in the end */
+  add_theme(&b, "hicolor");
+
+  memset(&unthemed, 0, sizeof(unthemed));
+  unthemed.theme = INDEX_NONE;
+  for (it = bases; it; it = g_slist_next(it))
+    scan_dir(&b, it->data, &unthemed);
+
+  n_buckets = MAX(g_hash_table_size(b.icons), 1);
+  buckets = g_new(guint32, n_buckets);
+  for (i = 0; i < n_buckets; ++i)
+    buckets[i] = INDEX_NONE;
+  icons = g_array_sized_new(FALSE, FALSE, sizeof(IndexIcon), g_hash_table_size(b.icons));
+  entries = g_array_new(FALSE, FALSE, sizeof(IndexEntry));
+
+  g_hash_table_iter_init(&iter, b.icons);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    GArray* places = value;
+    IndexIcon icon;
+    guint32 bucket = name_hash(key) % n_buckets;
+
+    icon.name = builder_string(&b, key);
+    icon.next = buckets[bucket];
+    icon.first_entry = entries->len;
+    icon.n_entries = places->len;
+    buckets[bucket] = icons->len;
+    g_array_append_vals(entries, places->data, places->len);
+    g_array_append_val(icons, icon);
+  }
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, INDEX_MAGIC, 4);
+  h.version = INDEX_VERSION;
+  h.n_sources = b.sources->len;
+  h.n_dirs = b.dirs->len;
+  h.n_buckets = n_buckets;
+  h.n_icons = icons->len;
+  h.n_entries = entries->len;
+  h.strings_len = b.strings->len;
+
+  out = g_byte_array_sized_new(sizeof(h) + b.sources->len * sizeof(IndexSource) + b.dirs->len * sizeof(IndexDir) +
+                               n_buckets * sizeof(guint32) + icons->len * sizeof(IndexIcon) +
+                               entries->len * sizeof(IndexEntry) + b.strings->len);
+  g_byte_array_append(out, (const guint8*)&h, sizeof(h));
+  g_byte_array_append(out, (const guint8*)b.sources->data, b.sources->len * sizeof(IndexSource));
+  g_byte_array_append(out, (const guint8*)b.dirs->data, b.dirs->len * sizeof(IndexDir));
+  g_byte_array_append(out, (const guint8*)buckets, n_buckets * sizeof(guint32));
+  g_byte_array_append(out, (const guint8*)icons->data, icons->len * sizeof(IndexIcon));
+  g_byte_array_append(out, (const guint8*)entries->data, entries->len * sizeof(IndexEntry));
+  g_byte_array_append(out, (const guint8*)b.strings->str, b.strings->len);
+
+  *ok = b.ok;
+
+  g_free(buckets);
+  g_array_free(icons, TRUE);
+  g_array_free(entries, TRUE);
+  g_array_free(b.sources, TRUE);
+  g_array_free(b.dirs, TRUE);
+  g_string_free(b.strings, TRUE);
+  g_hash_table_destroy(b.offsets);
+  g_hash_table_destroy(b.icons);
+  g_hash_table_destroy(b.themes);
+  return out;
+}
+
+/* Points the theme at the parts of the index in @data */
+static gboolean index_open(ObtIconTheme* t, const gchar* data, gsize len) {
+  const IndexHeader* h = (const IndexHeader*)data;
+  gsize need;
+
+  if (len < sizeof(IndexHeader) || memcmp(h->magic, INDEX_MAGIC, 4) || h->version != INDEX_VERSION)
+    return FALSE;
+  need = sizeof(IndexHeader) + (gsize)h->n_sources * sizeof(IndexSource) + (gsize)h->n_dirs * sizeof(IndexDir) +
+         (gsize)h->n_buckets * sizeof(guint32) + (gsize)h->n_icons * sizeof(IndexIcon) +
+         (gsize)h->n_entries * sizeof(IndexEntry) + h->strings_len;
+  if (len < need || !h->n_buckets || !h->strings_len)
+    return FALSE;
+
+  t->sources = (const IndexSource*)(h + 1);
+  t->dirs = (const IndexDir*)(t->sources + h->n_sources);
+  t->buckets = (const guint32*)(t->dirs + h->n_dirs);
+  t->icons = (const IndexIcon*)(t->buckets + h->n_buckets);
+  t->entries = (const IndexEntry*)(t->icons + h->n_icons);
+  t->strings = (const gchar*)(t->entries + h->n_entries);
+
+  /* every string ends inside the table */
+  if (t->strings[h->strings_len - 1] != '\0')
+    return FALSE;
+
+  t->header = h;
+  return TRUE;
+}
+
+static const gchar* index_string(const ObtIconTheme* t, guint32 offset) {
+  return offset < t->header->strings_len ? t->strings + offset : NULL;
+}
+
+/* An index is current when none of the directories it was made from have
+   had files added or removed since, which changes their times */
+static gboolean index_current(const ObtIconTheme* t) {
+  guint32 i;
+
+  for (i = 0; i < t->header->n_sources; ++i) {
+    const IndexSource* src = &t->sources[i];
+    const gchar* path = index_string(t, src->path);
+    struct stat st;
+
+    if (!path)
+      return FALSE;
+    if (stat(path, &st) != 0) {
+      if (src->exists)
+        return FALSE;
+    }
+    else if (!src->exists || st.st_mtime != src->mtime)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+ObtIconTheme* obt_icon_theme_new(const gchar* name, const gchar* domain) {
+  ObtIconTheme* t;
+  ObtPaths* p;
+  GSList *bases = NULL, *it;
+  gchar* dir = NULL;
+
+  g_return_val_if_fail(name != NULL, NULL);
+
+  p = obt_paths_new();
+
+  /* where the spec says to look for icons, in order */
+  bases = g_slist_append(bases, g_build_filename(g_get_home_dir(), ".icons", NULL));
+  for (it = obt_paths_data_dirs(p); it; it = g_slist_next(it))
+    bases = g_slist_append(bases, g_build_filename(it->data, "icons", NULL));
+  bases = g_slist_append(bases, g_build_filename(G_DIR_SEPARATOR_S, "usr", "share", "pixmaps", NULL));
+
+  if (domain)
+    dir = g_build_filename(obt_paths_cache_home(p), domain, "icons", NULL);
+  t = obt_icon_theme_new_in(name, bases, dir);
+
+  g_slist_free_full(bases, g_free);
+  g_free(dir);
+  obt_paths_unref(p);
+  return t;
+}
+
+ObtIconTheme* obt_icon_theme_new_in(const gchar* name, GSList* bases, const gchar* dir) {
+  ObtIconTheme* t;
+  gchar* file = NULL;
+
+  g_return_val_if_fail(name != NULL, NULL);
+
+  t = g_slice_new0(ObtIconTheme);
+  t->ref = 1;
+
+  if (dir) {
+    gchar* key = index_key(name, bases);
+    gchar* base = g_strconcat(key, ".index", NULL);
+
+    file = g_build_filename(dir, base, NULL);
+    g_free(base);
+    g_free(key);
+
+    if ((t->map = g_mapped_file_new(file, FALSE, NULL)) &&
+        !(index_open(t, g_mapped_file_get_contents(t->map), g_mapped_file_get_length(t->map)) && index_current(t))) {
+      g_mapped_file_unref(t->map);
+      t->map = NULL;
+    }
+  }
+
+  if (!t->map) {
+    gboolean ok;
+
+    t->built = index_build(name, bases, &ok);
+    if (!index_open(t, (const gchar*)t->built->data, t->built->len))
+      g_assert_not_reached();
+
+    /* written to a new file and renamed, so it's never seen half done */
+    if (file && ok && obt_paths_mkdir_path(dir, 0700))
+      g_file_set_contents(file, (const gchar*)t->built->data, t->built->len, NULL);
+  }
+
+  g_free(file);
+  return t;
+}
+
+void obt_icon_theme_ref(ObtIconTheme* t) {
+  ++t->ref;
+}
+
+void obt_icon_theme_unref(ObtIconTheme* t) {
+  if (t && --t->ref == 0) {
+    if (t->map)
+      g_mapped_file_unref(t->map);
+    if (t->built)
+      g_byte_array_free(t->built, TRUE);
+    g_slice_free(ObtIconTheme, t);
+  }
+}
+
+static const IndexIcon* find_icon(const ObtIconTheme* t, const gchar* icon) {
+  guint32 i, n;
+
+  /* a broken index could have a loop */
+  for (i = t->buckets[name_hash(icon) % t->header->n_buckets], n = 0; i < t->header->n_icons && n < t->header->n_icons;
+       i = t->icons[i].next, ++n) {
+    const gchar* name = index_string(t, t->icons[i].name);
+
+    if (name && !strcmp(name, icon))
+      return &t->icons[i];
+  }
+  return NULL;
+}
+
+/* How far @size is from the sizes of icons in the dir, which is 0 when they
+   can be used at that size */
+static gint size_distance(const IndexDir* d, gint size) {
+  gint min, max;
+
+  switch (d->type) {
+    case DIR_FIXED:
+      min = max = d->size;
+      break;
+    case DIR_SCALABLE:
+      min = d->min_size;
+      max = d->max_size;
+      break;
+    default:
+      min = d->size - d->threshold;
+      max = d->size + d->threshold;
+      break;
+  }
+  if (size < min)
+    return min - size;
+  if (size > max)
+    return size - max;
+  return 0;
+}
+
+gchar* obt_icon_theme_lookup(ObtIconTheme* t, const gchar* icon, gint size) {
+  const IndexIcon* ic;
+  const IndexDir* best = NULL;
+  guint32 best_exts = 0;
+  gint best_distance = G_MAXINT;
+  const gchar* dir;
+  guint32 i;
+
+  g_return_val_if_fail(t != NULL, NULL);
+  g_return_val_if_fail(icon != NULL, NULL);
+
+  /* icon names aren't paths */
+  if (!*icon || strchr(icon, G_DIR_SEPARATOR) || !(ic = find_icon(t, icon)))
+    return NULL;
+  if (ic->first_entry > t->header->n_entries || ic->n_entries > t->header->n_entries - ic->first_entry)
+    return NULL;
+
+  /* the places are in the order the spec searches them.  a theme's closest
+     icon is used before any in the themes after it, and the icons without a
+     theme have no size, so the first of them is used */
+  for (i = 0; i < ic->n_entries; ++i) {
+    const IndexEntry* e = &t->entries[ic->first_entry + i];
+    const IndexDir* d;
+    gint distance;
+
+    if (e->dir >= t->header->n_dirs)
+      return NULL;
+    d = &t->dirs[e->dir];
+    if (best && d->theme != best->theme)
+      break;
+
+    distance = d->theme == INDEX_NONE ? 0 : size_distance(d, size);
+    if (distance < best_distance) {
+      best = d;
+      best_exts = e->exts;
+      best_distance = distance;
+    }
+    if (!distance)
+      break;
+  }
+
+  if (!best || !(dir = index_string(t, best->path)))
+    return NULL;
+  for (i = 0; i < G_N_ELEMENTS(exts); ++i)
+    if (best_exts & (1 << i)) {
+      gchar* base = g_strconcat(icon, exts[i], NULL);
+      gchar* path = g_build_filename(dir, base, NULL);
+
+      g_free(base);
+      return path;
+    }
+  return NULL;
+}
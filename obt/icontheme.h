@@ -0,0 +1,47 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   obt/icontheme.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __obt_icontheme_h
+#define __obt_icontheme_h
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*! Finds icons by name the way the freedesktop.org Icon Theme Specification
+  says to: in a theme, then in the themes that it inherits from, then in
+  hicolor, and last on their own in the icon directories.  Which icons are in
+  which of those directories is kept in an index, saved in the user's cache
+  directory, and it is only made again when one of the directories has
+  changed.  So opening a theme looks at the directories, but looking up an
+  icon doesn't look at any files. */
+
+typedef struct _ObtIconTheme ObtIconTheme;
+
+/*! Opens the icon theme called @name, keeping its index in the user's cache
+  directory for @domain, or not keeping it at all if @domain is NULL. */
+ObtIconTheme* obt_icon_theme_new(const gchar* name, const gchar* domain);
+void obt_icon_theme_ref(ObtIconTheme* t);
+void obt_icon_theme_unref(ObtIconTheme* t);
+
+/*! Returns the file for the icon called @icon that is the closest to @size
+  pixels, or NULL if there isn't one. */
+gchar* obt_icon_theme_lookup(ObtIconTheme* t, const gchar* icon, gint size);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,441 @@
+#include "obt/unittest_base.h"
+
+#include "obt/icontheme.h"
+#include "obt/internal.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <utime.h>
+
+/* the themes are made in here, with the directories that are searched for
+   them in home/icons and sys/icons, and the index kept in cache.  nothing
+   outside of it is looked at */
+static gchar* root = NULL;
+/* what the files' times are set to.  it's in the past, since an index isn't
+   saved if anything changed while it was made */
+static time_t old_time;
+
+static const gchar* const test_theme =
+    "[Icon Theme]\n"
+    "Name=Test\n"
+    "Inherits=obtparent\n"
+    "Directories=16x16/apps,48x48/apps,scalable/apps,32x32@2/apps\n"
+    "\n"
+    "[16x16/apps]\n"
+    "Size=16\n"
+    "Type=Fixed\n"
+    "\n"
+    "[48x48/apps]\n"
+    "Size=48\n"
+    "Type=Threshold\n"
+    "\n"
+    "[scalable/apps]\n"
+    "Size=48\n"
+    "MinSize=8\n"
+    "MaxSize=256\n"
+    "Type=Scalable\n"
+    "\n"
+    "[32x32@2/apps]\n"
+    "Size=32\n"
+    "Scale=2\n";
+
+/* it inherits back from the first, which has to be ignored */
+static const gchar* const parent_theme =
+    "[Icon Theme]\n"
+    "Name=Parent\n"
+    "Inherits=obttest\n"
+    "Directories=32x32/apps\n"
+    "\n"
+    "[32x32/apps]\n"
+    "Size=32\n"
+    "Type=Fixed\n";
+
+static const gchar* const hicolor_theme =
+    "[Icon Theme]\n"
+    "Name=Hicolor\n"
+    "Directories=48x48/apps,48x48/mimetypes\n"
+    "\n"
+    "[48x48/apps]\n"
+    "Size=48\n"
+    "Type=Threshold\n"
+    "\n"
+    "[48x48/mimetypes]\n"
+    "Size=48\n"
+    "Type=Threshold\n";
+
+static void make_file(const gchar* name, const gchar* contents) {
+  gchar* path = g_build_filename(root, name, NULL);
+  gchar* dir = g_path_get_dirname(path);
+
+  g_mkdir_with_parents(dir, 0700);
+  g_file_set_contents(path, contents, -1, NULL);
+  g_free(dir);
+  g_free(path);
+}
+
+static void remove_file(const gchar* name) {
+  gchar* path = g_build_filename(root, name, NULL);
+
+  g_remove(path);
+  g_free(path);
+}
+
+static void set_times(const gchar* path, time_t when) {
+  struct utimbuf times;
+  GDir* dir;
+
+  if ((dir = g_dir_open(path, 0, NULL))) {
+    const gchar* name;
+
+    while ((name = g_dir_read_name(dir))) {
+      gchar* sub = g_build_filename(path, name, NULL);
+
+      set_times(sub, when);
+      g_free(sub);
+    }
+    g_dir_close(dir);
+  }
+  times.actime = times.modtime = when;
+  utime(path, &times);
+}
+
+static void remove_tree(const gchar* path) {
+  GDir* dir;
+
+  if ((dir = g_dir_open(path, 0, NULL))) {
+    const gchar* name;
+
+    while ((name = g_dir_read_name(dir))) {
+      gchar* sub = g_build_filename(path, name, NULL);
+
+      remove_tree(sub);
+      g_free(sub);
+    }
+    g_dir_close(dir);
+    g_rmdir(path);
+  }
+  else
+    g_remove(path);
+}
+
+/* the index saved for the theme, or NULL if there isn't one */
+static gchar* index_file(void) {
+  gchar* dir = g_build_filename(root, "cache", NULL);
+  gchar* file = NULL;
+  GDir* d;
+
+  if ((d = g_dir_open(dir, 0, NULL))) {
+    const gchar* name;
+
+    while (!file && (name = g_dir_read_name(d)))
+      if (g_str_has_suffix(name, ".index"))
+        file = g_build_filename(dir, name, NULL);
+    g_dir_close(d);
+  }
+  g_free(dir);
+  return file;
+}
+
+static ino_t index_inode(void) {
+  gchar* file = index_file();
+  struct stat st;
+  ino_t ino = 0;
+
+  if (file && stat(file, &st) == 0)
+    ino = st.st_ino;
+  g_free(file);
+  return ino;
+}
+
+/* looks up @icon, giving the file without the root in front of it */
+static gchar* lookup(ObtIconTheme* t, const gchar* icon, gint size) {
+  gchar* path = obt_icon_theme_lookup(t, icon, size);
+  gchar* rel = NULL;
+
+  if (path && g_str_has_prefix(path, root) && path[strlen(root)] == G_DIR_SEPARATOR)
+    rel = g_strdup(path + strlen(root) + 1);
+  else
+    rel = g_strdup(path);
+  g_free(path);
+  return rel;
+}
+
+#define EXPECT_ICON(expected, t, icon, size) \
+  {                                          \
+    gchar* found = lookup(t, icon, size);    \
+    EXPECT_STRING_EQ(expected, found);       \
+    g_free(found);                           \
+  }
+
+/* opens the theme @name from the root, keeping its index if @keep is TRUE */
+static ObtIconTheme* open_theme(const gchar* name, gboolean keep) {
+  GSList* bases = NULL;
+  gchar* dir = keep ? g_build_filename(root, "cache", NULL) : NULL;
+  ObtIconTheme* t;
+
+  bases = g_slist_append(bases, g_build_filename(root, "home", "icons", NULL));
+  bases = g_slist_append(bases, g_build_filename(root, "sys", "icons", NULL));
+  t = obt_icon_theme_new_in(name, bases, dir);
+  g_slist_free_full(bases, g_free);
+  g_free(dir);
+  return t;
+}
+
+static void setup(void) {
+  root = g_dir_make_tmp("obt-icontheme-XXXXXX", NULL);
+  g_assert(root);
+
+  make_file("home/icons/obttest/index.theme", test_theme);
+  make_file("home/icons/obttest/16x16/apps/obt-app.png", "");
+  make_file("home/icons/obttest/48x48/apps/obt-app.png", "");
+  make_file("home/icons/obttest/scalable/apps/obt-app.svg", "");
+  make_file("home/icons/obttest/48x48/apps/obt-both.xpm", "");
+  make_file("home/icons/obttest/48x48/apps/obt-both.png", "");
+  make_file("home/icons/obttest/16x16/apps/obt-near.png", "");
+  make_file("home/icons/obttest/16x16/apps/obt-tie.png", "");
+  make_file("home/icons/obttest/48x48/apps/obt-tie.png", "");
+  make_file("home/icons/obttest/32x32@2/apps/obt-scaled.png", "");
+
+  make_file("sys/icons/obtparent/index.theme", parent_theme);
+  make_file("sys/icons/obtparent/32x32/apps/obt-parent.png", "");
+  make_file("sys/icons/obtparent/32x32/apps/obt-near.png", "");
+  make_file("sys/icons/obtparent/32x32/apps/obt-app.png", "");
+
+  make_file("sys/icons/hicolor/index.theme", hicolor_theme);
+  make_file("sys/icons/hicolor/48x48/apps/obt-hicolor.png", "");
+
+  make_file("sys/icons/obt-loose.xpm", "");
+  make_file("sys/icons/obt-app.png", "");
+  make_file("sys/icons/obt-readme.txt", "");
+
+  old_time = time(NULL) - 60;
+  set_times(root, old_time);
+}
+
+static void teardown(void) {
+  remove_tree(root);
+  g_free(root);
+  root = NULL;
+}
+
+static void spec_order() {
+  TEST_START();
+  setup();
+
+  ObtIconTheme* t = open_theme("obttest", FALSE);
+
+  /* the closest size in the theme */
+  EXPECT_ICON("home/icons/obttest/16x16/apps/obt-app.png", t, "obt-app", 16);
+  EXPECT_ICON("home/icons/obttest/48x48/apps/obt-app.png", t, "obt-app", 48);
+  /* in the threshold */
+  EXPECT_ICON("home/icons/obttest/48x48/apps/obt-app.png", t, "obt-app", 50);
+  EXPECT_ICON("home/icons/obttest/scalable/apps/obt-app.svg", t, "obt-app", 128);
+  /* closest to the scalable one's range */
+  EXPECT_ICON("home/icons/obttest/scalable/apps/obt-app.svg", t, "obt-app", 1000);
+  /* the first of those that are as close */
+  EXPECT_ICON("home/icons/obttest/16x16/apps/obt-tie.png", t, "obt-tie", 31);
+  /* png is preferred */
+  EXPECT_ICON("home/icons/obttest/48x48/apps/obt-both.png", t, "obt-both", 48);
+
+  /* an icon in a theme is used before a closer one in a theme it inherits
+     from */
+  EXPECT_ICON("home/icons/obttest/16x16/apps/obt-near.png", t, "obt-near", 32);
+  EXPECT_ICON("sys/icons/obtparent/32x32/apps/obt-parent.png", t, "obt-parent", 16);
+  /* then hicolor, then the icons without a theme */
+  EXPECT_ICON("sys/icons/hicolor/48x48/apps/obt-hicolor.png", t, "obt-hicolor", 16);
+  EXPECT_ICON("sys/icons/obt-loose.xpm", t, "obt-loose", 16);
+
+  /* icons for scaled screens are not used */
+  EXPECT_ICON(NULL, t, "obt-scaled", 32);
+  EXPECT_ICON(NULL, t, "obt-readme", 16);
+  EXPECT_ICON(NULL, t, "obt-missing", 16);
+  EXPECT_ICON(NULL, t, "apps/obt-app", 16);
+  EXPECT_ICON(NULL, t, "", 16);
+
+  obt_icon_theme_unref(t);
+
+  /* with no theme, only hicolor and the icons without a theme */
+  t = open_theme("obtnothere", FALSE);
+  EXPECT_ICON("sys/icons/obt-app.png", t, "obt-app", 16);
+  EXPECT_ICON("sys/icons/hicolor/48x48/apps/obt-hicolor.png", t, "obt-hicolor", 16);
+  obt_icon_theme_unref(t);
+
+  teardown();
+  TEST_END();
+}
+
+static void index_reused() {
+  TEST_START();
+  setup();
+
+  ObtIconTheme* t = open_theme("obttest", TRUE);
+  ino_t saved;
+
+  EXPECT_ICON("home/icons/obttest/48x48/apps/obt-app.png", t, "obt-app", 48);
+  obt_icon_theme_unref(t);
+
+  /* the index is written to a new file, so it is the same one if it wasn't
+     made again */
+  saved = index_inode();
+  EXPECT_BOOL_EQ(TRUE, saved != 0);
+  t = open_theme("obttest", TRUE);
+  EXPECT_BOOL_EQ(TRUE, saved == index_inode());
+  EXPECT_ICON("home/icons/obttest/48x48/apps/obt-app.png", t, "obt-app", 48);
+  EXPECT_ICON("sys/icons/obtparent/32x32/apps/obt-parent.png", t, "obt-parent", 32);
+  EXPECT_ICON("sys/icons/obt-loose.xpm", t, "obt-loose", 16);
+  EXPECT_ICON(NULL, t, "obt-missing", 16);
+  obt_icon_theme_unref(t);
+
+  teardown();
+  TEST_END();
+}
+
+static void index_rebuilt() {
+  TEST_START();
+  setup();
+
+  ObtIconTheme* t = open_theme("obttest", TRUE);
+  ino_t saved;
+
+  EXPECT_ICON(NULL, t, "obt-mime", 48);
+  obt_icon_theme_unref(t);
+  saved = index_inode();
+
+  /* a directory made inside one that isn't watched.  the times are put back
+     so only the directory being there shows the change */
+  make_file("sys/icons/hicolor/48x48/mimetypes/obt-mime.png", "");
+  set_times(root, old_time);
+  t = open_theme("obttest", TRUE);
+  EXPECT_ICON("sys/icons/hicolor/48x48/mimetypes/obt-mime.png", t, "obt-mime", 48);
+  EXPECT_BOOL_EQ(TRUE, saved != index_inode());
+  obt_icon_theme_unref(t);
+
+  /* an icon taken away */
+  remove_file("sys/icons/hicolor/48x48/apps/obt-hicolor.png");
+  set_times(root, old_time + 1);
+  t = open_theme("obttest", TRUE);
+  EXPECT_ICON(NULL, t, "obt-hicolor", 48);
+  obt_icon_theme_unref(t);
+
+  /* a theme that it inherits from, installed later */
+  make_file("home/icons/obtparent/32x32/apps/obt-home.png", "");
+  set_times(root, old_time + 2);
+  t = open_theme("obttest", TRUE);
+  EXPECT_ICON("home/icons/obtparent/32x32/apps/obt-home.png", t, "obt-home", 32);
+  obt_icon_theme_unref(t);
+
+  teardown();
+  TEST_END();
+}
+
+/* the header's fields, as guint32s */
+enum { MAGIC, VERSION, N_SOURCES, N_DIRS, N_BUCKETS, N_ICONS, N_ENTRIES, STRINGS_LEN, N_FIELDS };
+
+static guint32 get_field(const gchar* index, guint field) {
+  guint32 value;
+
+  memcpy(&value, index + field * sizeof(guint32), sizeof(guint32));
+  return value;
+}
+
+static void set_field(gchar* index, guint field, guint32 value) {
+  memcpy(index + field * sizeof(guint32), &value, sizeof(guint32));
+}
+
+/* saves @bad in place of the index, opens the theme, and checks that the
+   index was made again and saved */
+static void open_broken(const gchar* bad, gsize bad_len, const gchar* good, gsize len) {
+  gchar* file = index_file();
+  gchar* saved = NULL;
+  gsize saved_len = 0;
+  ObtIconTheme* t;
+
+  g_file_set_contents(file, bad, bad_len, NULL);
+  t = open_theme("obttest", TRUE);
+  EXPECT_ICON("home/icons/obttest/48x48/apps/obt-app.png", t, "obt-app", 48);
+  EXPECT_ICON("sys/icons/obt-loose.xpm", t, "obt-loose", 16);
+  obt_icon_theme_unref(t);
+
+  g_file_get_contents(file, &saved, &saved_len, NULL);
+  EXPECT_BOOL_EQ(TRUE, saved_len == len && !memcmp(saved, good, len));
+  g_free(saved);
+  g_free(file);
+}
+
+static void broken_index() {
+  TEST_START();
+  setup();
+
+  static const struct {
+    guint field;
+    guint32 value;
+  } fields[] = {
+      {MAGIC, 0},         {VERSION, 0},          {N_DIRS, G_MAXUINT32}, {N_BUCKETS, 0},
+      {N_ICONS, 1 << 30}, {N_ENTRIES, G_MAXUINT32}, {STRINGS_LEN, 0},     {STRINGS_LEN, G_MAXUINT32},
+  };
+  ObtIconTheme* t = open_theme("obttest", TRUE);
+  gchar *file, *good, *bad;
+  gsize len, i;
+
+  obt_icon_theme_unref(t);
+  file = index_file();
+  EXPECT_BOOL_EQ(TRUE, g_file_get_contents(file, &good, &len, NULL));
+  EXPECT_BOOL_EQ(TRUE, len > N_FIELDS * sizeof(guint32));
+
+  /* an index that can't be used is made again */
+  for (i = 0; i < G_N_ELEMENTS(fields); ++i) {
+    bad = g_memdup2(good, len);
+    set_field(bad, fields[i].field, fields[i].value);
+    open_broken(bad, len, good, len);
+    g_free(bad);
+  }
+
+  /* no sources or buckets, with the strings starting where the sources did,
+     so they still end in the right place and nothing is out of date.  a
+     source is 16 bytes and a bucket is 4 */
+  bad = g_memdup2(good, len);
+  set_field(bad, N_SOURCES, 0);
+  set_field(bad, N_BUCKETS, 0);
+  set_field(bad, STRINGS_LEN,
+            get_field(good, STRINGS_LEN) + get_field(good, N_SOURCES) * 16 + get_field(good, N_BUCKETS) * 4);
+  open_broken(bad, len, good, len);
+
+  /* cut short, and with its strings not ended */
+  open_broken(good, 10, good, len);
+  open_broken(good, len / 2, good, len);
+  memcpy(bad, good, len);
+  bad[len - 1] = 'x';
+  open_broken(bad, len, good, len);
+  g_free(bad);
+
+  /* without its sources, it's never out of date, and the rest of it is read
+     from the wrong places, which must not be followed outside of it */
+  bad = g_memdup2(good, len);
+  set_field(bad, N_SOURCES, 0);
+  g_file_set_contents(file, bad, len, NULL);
+  g_free(bad);
+  t = open_theme("obttest", TRUE);
+  g_free(obt_icon_theme_lookup(t, "obt-app", 48));
+  g_free(obt_icon_theme_lookup(t, "obt-loose", 16));
+  g_free(obt_icon_theme_lookup(t, "obt-missing", 16));
+  obt_icon_theme_unref(t);
+
+  g_free(good);
+  g_free(file);
+  teardown();
+  TEST_END();
+}
+
+void run_icontheme_unittest() {
+  unittest_start_suite("icontheme");
+
+  spec_order();
+  index_reused();
+  index_rebuilt();
+  broken_index();
+
+  unittest_end_suite();
+}
@@ -20,8 +20,33 @@
 #ifndef __obt_internal_h
 #define __obt_internal_h
 
+#include <glib.h>
+#include <X11/Xlib.h>
+
 void obt_prop_startup(void);
 
+void xqueue_init(void);
+void xqueue_destroy(void);
+
+typedef gboolean (*ObtXQueueReadFunc)(XEvent* e);
+
+/*! Makes xqueue read its events with @func instead of from the display, so
+  the unit tests can run without one.  @func returns FALSE when there are no
+  more events for now.  NULL goes back to reading from the display. */
+void xqueue_set_read_func(ObtXQueueReadFunc func);
+
+struct _ObtXQueueRule;
+
+/*! Returns how many keys @rule remembers the last queued event for */
+guint xqueue_rule_keys(struct _ObtXQueueRule* rule);
+
 void obt_keyboard_shutdown(void);
 
+struct _ObtIconTheme;
+
+/*! Opens the icon theme called @name like obt_icon_theme_new(), but looks
+  for it in the directories in @bases, and keeps its index in @dir, or not at
+  all if @dir is NULL.  So the unit tests don't see the user's icons. */
+struct _ObtIconTheme* obt_icon_theme_new_in(const gchar* name, GSList* bases, const gchar* dir);
+
 #endif /* __obt_internal_h */
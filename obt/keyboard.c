@@ -41,6 +41,7 @@ struct _ObtIC {
 #define nth_mask(n) (1 << n)
 
 static void set_modkey_mask(guchar mask, KeySym sym);
+static void build_keysym_keycodes(void);
 static void xim_init(void);
 void obt_keyboard_shutdown();
 void obt_keyboard_context_renew(ObtIC* ic);
@@ -48,6 +49,9 @@ void obt_keyboard_context_renew(ObtIC* ic);
 static XModifierKeymap* modmap;
 static KeySym* keymap;
 static gint min_keycode, max_keycode, keysyms_per_keycode;
+/* the keycodes for each keysym in the keymap, as 0-terminated GArrays of
+   KeyCode, with keycodes that have it earlier in their list coming first */
+static GHashTable* keysym_keycodes;
 /*! This is a bitmask of the different masks for each modifier key */
 static guchar modkeys_keys[OBT_KEYBOARD_NUM_MODKEYS];
 
@@ -81,6 +85,7 @@ void obt_keyboard_reload(void) {
 
   XDisplayKeycodes(obt_display, &min_keycode, &max_keycode);
   keymap = XGetKeyboardMapping(obt_display, min_keycode, max_keycode - min_keycode + 1, &keysyms_per_keycode);
+  build_keysym_keycodes();
 
   alt_l = meta_l = super_l = hyper_l = FALSE;
 
@@ -117,6 +122,9 @@ void obt_keyboard_shutdown(void) {
   modmap = NULL;
   XFree(keymap);
   keymap = NULL;
+  if (keysym_keycodes)
+    g_hash_table_destroy(keysym_keycodes);
+  keysym_keycodes = NULL;
   for (it = xic_all; it; it = g_slist_next(it)) {
     ObtIC* ic = it->data;
     if (ic->xic) {
@@ -255,23 +263,61 @@ static void set_modkey_mask(guchar mask, KeySym sym) {
   /* CapsLock, Shift, and Control are special and hard-coded */
 }
 
-KeyCode* obt_keyboard_keysym_to_keycode(KeySym sym) {
-  KeyCode* ret;
-  gint i, j, n;
-
-  ret = g_new(KeyCode, 1);
-  n = 0;
-  ret[n] = 0;
-
-  /* go through each keycode and look for the keysym */
-  for (i = min_keycode; i <= max_keycode; ++i)
-    for (j = 0; j < keysyms_per_keycode; ++j)
-      if (sym == keymap[(i - min_keycode) * keysyms_per_keycode + j]) {
-        ret = g_renew(KeyCode, ret, ++n + 1);
-        ret[n - 1] = i;
-        ret[n] = 0;
+static void free_keycodes(gpointer p) {
+  g_array_free(p, TRUE);
+}
+
+static void build_keysym_keycodes(void) {
+  gint i, j;
+
+  keysym_keycodes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_keycodes);
+
+  /* go through the keysyms for each keycode a column at a time, so that a
+     keycode which has the keysym as its first one is found first, the same
+     as XKeysymToKeycode() would */
+  for (j = 0; j < keysyms_per_keycode; ++j)
+    for (i = min_keycode; i <= max_keycode; ++i) {
+      KeySym sym = keymap[(i - min_keycode) * keysyms_per_keycode + j];
+      GArray* codes;
+      guint k;
+
+      if (sym == NoSymbol)
+        continue;
+
+      codes = g_hash_table_lookup(keysym_keycodes, GSIZE_TO_POINTER(sym));
+      if (!codes) {
+        codes = g_array_sized_new(TRUE, FALSE, sizeof(KeyCode), 1);
+        g_hash_table_insert(keysym_keycodes, GSIZE_TO_POINTER(sym), codes);
       }
-  return ret;
+
+      /* a keysym is often in more than one column for the same key */
+      for (k = 0; k < codes->len; ++k)
+        if (g_array_index(codes, KeyCode, k) == i)
+          break;
+      if (k == codes->len) {
+        KeyCode code = i;
+        g_array_append_val(codes, code);
+      }
+    }
+}
+
+KeyCode* obt_keyboard_keysym_to_keycode(KeySym sym) {
+  GArray* codes = NULL;
+
+  if (keysym_keycodes)
+    codes = g_hash_table_lookup(keysym_keycodes, GSIZE_TO_POINTER(sym));
+  if (!codes)
+    return g_new0(KeyCode, 1);
+  /* include the 0 at the end */
+  return g_memdup2(codes->data, (codes->len + 1) * sizeof(KeyCode));
+}
+
+KeyCode obt_keyboard_keysym_to_first_keycode(KeySym sym) {
+  GArray* codes = NULL;
+
+  if (keysym_keycodes)
+    codes = g_hash_table_lookup(keysym_keycodes, GSIZE_TO_POINTER(sym));
+  return codes ? g_array_index(codes, KeyCode, 0) : 0;
 }
 
 gunichar obt_keyboard_keypress_to_unichar(ObtIC* ic, XEvent* ev) {
@@ -62,6 +62,10 @@ guint obt_keyboard_modkey_to_modmask(ObtModkeysKey key);
 /*! Convert a KeySym to all the KeyCodes which generate it. */
 KeyCode* obt_keyboard_keysym_to_keycode(KeySym sym);
 
+/*! Get the KeyCode which generates a KeySym most directly, or 0 if none do.
+  This is looked up in the keymap from the last obt_keyboard_reload(). */
+KeyCode obt_keyboard_keysym_to_first_keycode(KeySym sym);
+
 /*! Translate a KeyPress event to the unicode character it represents */
 gunichar obt_keyboard_keypress_to_unichar(ObtIC* ic, XEvent* ev);
 
@@ -23,31 +23,60 @@
 #include <string.h>
 #include <stdio.h>
 
-/* Helper to escape XML entities */
-static void xml_escape(GString* out, const gchar* str) {
-  while (*str) {
-    switch (*str) {
-      case '<':
-        g_string_append(out, "&lt;");
-        break;
-      case '>':
-        g_string_append(out, "&gt;");
-        break;
-      case '&':
-        g_string_append(out, "&amp;");
-        break;
-      case '"':
-        g_string_append(out, "&quot;");
-        break;
-      case '\'':
-        g_string_append(out, "&apos;");
-        break;
-      default:
-        g_string_append_c(out, *str);
-        break;
-    }
-    str++;
-  }
+/* The Openbox XML tree is built straight from the parser's events.  Each
+   mapping or sequence that is being read has a frame on a stack, which knows
+   the element that its contents go into. */
+
+typedef struct _YamlFrame {
+  gboolean mapping;
+  /* the top level mapping, whose keys are always elements */
+  gboolean root;
+  /* the element that the contents go into */
+  xmlNodePtr node;
+  /* the name of a mapping's element, or of the elements for the items in a
+     sequence */
+  gchar* tag;
+  /* the key that is waiting for its value, in a mapping */
+  gchar* key;
+  /* the key wasn't a scalar, so the pair is ignored */
+  gboolean skip_value;
+  /* the action and command of a menu item, which become an <action> */
+  gchar* action;
+  gchar* command;
+} YamlFrame;
+
+/* One node event, kept so that the node can be read again where it is
+   referred to by an alias */
+typedef struct _YamlRecorded {
+  yaml_event_type_t type;
+  gchar* value;
+} YamlRecorded;
+
+typedef struct _YamlRecording {
+  gchar* anchor;
+  GArray* events;
+  gint depth;
+} YamlRecording;
+
+typedef struct _YamlBuilder {
+  xmlDocPtr doc;
+  const gchar* root_node;
+  GSList* frames;
+  /* how deep inside a node that is being ignored the events are */
+  gint skipping;
+  /* the nodes with anchors that have been read, and those being read */
+  GHashTable* anchors;
+  GSList* recordings;
+  gboolean done;
+  gboolean failed;
+} YamlBuilder;
+
+static void recorded_free(GArray* events) {
+  guint i;
+
+  for (i = 0; i < events->len; ++i)
+    g_free(g_array_index(events, YamlRecorded, i).value);
+  g_array_free(events, TRUE);
 }
 
 /* Check if a key should be treated as an XML attribute for a given tag */
@@ -92,274 +121,328 @@ static gboolean is_attribute(const gchar* tag, const gchar* key) {
   return FALSE;
 }
 
-static void process_node(yaml_document_t* doc, yaml_node_t* node, const gchar* tag_name, GString* out);
-
-static void process_mapping(yaml_document_t* doc, yaml_node_t* node, const gchar* tag_name, GString* out) {
-  g_message("process_mapping: tag='%s'", tag_name);
-  yaml_node_pair_t* pair;
-  GList* attrs = NULL;
-  GList* children = NULL;
-  GList* l;
-  gchar* action_value = NULL;
-  gchar* command_value = NULL;
-
-  /* First pass: separate attributes and children, collect special values */
-  for (pair = node->data.mapping.pairs.start; pair < node->data.mapping.pairs.top; pair++) {
-    yaml_node_t* key_node = yaml_document_get_node(doc, pair->key);
-    yaml_node_t* value_node = yaml_document_get_node(doc, pair->value);
-
-    if (!key_node || key_node->type != YAML_SCALAR_NODE)
-      continue;
-
-    gchar* key_str = (gchar*)key_node->data.scalar.value;
-
-    /* For item tag, collect action and command values for special handling */
-    if (strcmp(tag_name, "item") == 0) {
-      if (strcmp(key_str, "action") == 0 && value_node->type == YAML_SCALAR_NODE) {
-        action_value = g_strdup((gchar*)value_node->data.scalar.value);
-        continue; /* Don't add to children list */
-      }
-      else if ((strcmp(key_str, "command") == 0 || strcmp(key_str, "execute") == 0) &&
-               value_node->type == YAML_SCALAR_NODE) {
-        command_value = g_strdup((gchar*)value_node->data.scalar.value);
-        continue; /* Don't add to children list */
-      }
-    }
+static void push_frame(YamlBuilder* b, gboolean mapping, xmlNodePtr node, const gchar* tag) {
+  YamlFrame* f = g_slice_new0(YamlFrame);
 
-    if (is_attribute(tag_name, key_str) && value_node->type == YAML_SCALAR_NODE) {
-      attrs = g_list_append(attrs, pair);
-    }
-    else {
-      children = g_list_append(children, pair);
+  f->mapping = mapping;
+  f->node = node;
+  f->tag = g_strdup(tag);
+  b->frames = g_slist_prepend(b->frames, f);
+}
+
+static void pop_frame(YamlBuilder* b) {
+  YamlFrame* f = b->frames->data;
+
+  /* a menu item's action goes before anything else in it */
+  if (f->mapping && strcmp(f->tag, "item") == 0 && (f->action || f->command)) {
+    xmlNodePtr a = xmlNewDocNode(b->doc, NULL, (const xmlChar*)"action", NULL);
+
+    if (f->action)
+      xmlSetProp(a, (const xmlChar*)"name", (const xmlChar*)f->action);
+    if (f->command)
+      xmlNodeAddContent(xmlNewChild(a, NULL, (const xmlChar*)"execute", NULL), (const xmlChar*)f->command);
+    if (f->node->children)
+      xmlAddPrevSibling(f->node->children, a);
+    else
+      xmlAddChild(f->node, a);
+  }
+
+  b->frames = g_slist_delete_link(b->frames, b->frames);
+  if (!b->frames)
+    b->done = TRUE;
+
+  g_free(f->tag);
+  g_free(f->key);
+  g_free(f->action);
+  g_free(f->command);
+  g_slice_free(YamlFrame, f);
+}
+
+static void skip_node(YamlBuilder* b, yaml_event_type_t type) {
+  if (type != YAML_SCALAR_EVENT)
+    b->skipping = 1;
+}
+
+static xmlNodePtr new_child(YamlBuilder* b, xmlNodePtr parent, const gchar* tag) {
+  /* the XML parser would have refused it */
+  if (xmlValidateName((const xmlChar*)tag, 0) != 0) {
+    g_message("YAML key '%s' is not a valid element name", tag);
+    b->failed = TRUE;
+    return NULL;
+  }
+  return xmlNewChild(parent, NULL, (const xmlChar*)tag, NULL);
+}
+
+/* adds a node found under the name @tag to @parent */
+static void add_node(YamlBuilder* b, xmlNodePtr parent, const gchar* tag, yaml_event_type_t type, const gchar* value) {
+  xmlNodePtr n;
+
+  if (type == YAML_SCALAR_EVENT) {
+    if (strcmp(tag, "separator") == 0)
+      new_child(b, parent, tag);
+    else if (strcmp(tag, "action") == 0) {
+      /* action scalar becomes <action name="value"/> */
+      if ((n = new_child(b, parent, tag)))
+        xmlSetProp(n, (const xmlChar*)"name", (const xmlChar*)value);
     }
+    else if ((n = new_child(b, parent, tag)))
+      xmlNodeAddContent(n, (const xmlChar*)value);
+    return;
   }
 
-  /* Start tag */
-  g_string_append_printf(out, "<%s", tag_name);
+  /* Map YAML tag names to Openbox XML tag names */
+  if (strcmp(tag, "submenu") == 0)
+    tag = "menu";
 
-  /* Write attributes */
-  for (l = attrs; l; l = l->next) {
-    yaml_node_pair_t* p = l->data;
-    yaml_node_t* k = yaml_document_get_node(doc, p->key);
-    yaml_node_t* v = yaml_document_get_node(doc, p->value);
+  if (type == YAML_SEQUENCE_START_EVENT)
+    /* each item is an element of its own */
+    push_frame(b, FALSE, parent, tag);
+  else if ((n = new_child(b, parent, tag)))
+    push_frame(b, TRUE, n, tag);
+}
 
-    gchar* key_s = (gchar*)k->data.scalar.value;
+/* adds the value for @key in the mapping @f */
+static void add_pair(YamlBuilder* b, YamlFrame* f, const gchar* key, yaml_event_type_t type, const gchar* value) {
+  if (f->root) {
+    add_node(b, f->node, key, type, value);
+    return;
+  }
 
-    g_string_append_printf(out, " %s=\"", key_s);
-    if (v->type == YAML_SCALAR_NODE) {
-      xml_escape(out, (gchar*)v->data.scalar.value);
+  /* For item tag, collect action and command values for special handling */
+  if (strcmp(f->tag, "item") == 0 && type == YAML_SCALAR_EVENT) {
+    if (strcmp(key, "action") == 0) {
+      g_free(f->action);
+      f->action = g_strdup(value);
+      return;
+    }
+    if (strcmp(key, "command") == 0 || strcmp(key, "execute") == 0) {
+      g_free(f->command);
+      f->command = g_strdup(value);
+      return;
     }
-    g_string_append(out, "\"");
   }
 
-  /* Special handling for separator - always produce <separator/> regardless of content */
-  if (strcmp(tag_name, "separator") == 0) {
-    g_string_append(out, "/>");
-    g_list_free(attrs);
-    g_list_free(children);
-    g_free(action_value);
-    g_free(command_value);
+  if (type == YAML_SCALAR_EVENT && is_attribute(f->tag, key)) {
+    xmlSetProp(f->node, (const xmlChar*)key, (const xmlChar*)value);
     return;
   }
 
-  if (!children && !action_value && !command_value) {
-    g_string_append(out, "/>");
+  /* a separator never has anything inside it */
+  if (strcmp(f->tag, "separator") == 0) {
+    skip_node(b, type);
+    return;
   }
-  else {
-    g_string_append(out, ">");
-
-    /* Special handling for item tag: combine action and command into Openbox XML structure */
-    if (strcmp(tag_name, "item") == 0 && (action_value || command_value)) {
-      g_string_append(out, "<action");
-      if (action_value) {
-        g_string_append(out, " name=\"");
-        xml_escape(out, action_value);
-        g_string_append(out, "\"");
-      }
-      g_string_append(out, ">");
-      if (command_value) {
-        g_string_append(out, "<execute>");
-        xml_escape(out, command_value);
-        g_string_append(out, "</execute>");
-      }
-      g_string_append(out, "</action>");
-    }
 
-    /* Write remaining children */
-    for (l = children; l; l = l->next) {
-      yaml_node_pair_t* p = l->data;
-      yaml_node_t* k = yaml_document_get_node(doc, p->key);
-      yaml_node_t* v = yaml_document_get_node(doc, p->value);
-
-      gchar* key_s = (gchar*)k->data.scalar.value;
-
-      /* Special handling for submenu */
-      if (strcmp(key_s, "submenu") == 0 && (strcmp(tag_name, "menu") == 0 || strcmp(tag_name, "item") == 0)) {
-        g_message("Processing submenu for %s tag, sequence length: %ld", tag_name,
-                  (long)(v->data.sequence.items.top - v->data.sequence.items.start));
-        /* submenu sequence items should be <item> elements */
-        if (v->type == YAML_SEQUENCE_NODE) {
-          yaml_node_item_t* sub_item;
-          for (sub_item = v->data.sequence.items.start; sub_item < v->data.sequence.items.top; sub_item++) {
-            yaml_node_t* sub_item_node = yaml_document_get_node(doc, *sub_item);
-            process_node(doc, sub_item_node, "item", out);
-          }
-        }
-        continue;
-      }
-      /* Rename command to execute if not already handled */
-      else if (strcmp(key_s, "command") == 0) {
-        key_s = "execute";
-      }
-
-      if (strcmp(key_s, "_content") == 0 || strcmp(key_s, "content") == 0) {
-        if (v->type == YAML_SCALAR_NODE) {
-          xml_escape(out, (gchar*)v->data.scalar.value);
-        }
-      }
-      else {
-        process_node(doc, v, key_s, out);
-      }
-    }
+  /* submenu sequence items should be <item> elements */
+  if (strcmp(key, "submenu") == 0 && (strcmp(f->tag, "menu") == 0 || strcmp(f->tag, "item") == 0)) {
+    if (type == YAML_SEQUENCE_START_EVENT)
+      push_frame(b, FALSE, f->node, "item");
+    else
+      skip_node(b, type);
+    return;
+  }
 
-    g_string_append_printf(out, "</%s>", tag_name);
+  if (strcmp(key, "_content") == 0 || strcmp(key, "content") == 0) {
+    if (type == YAML_SCALAR_EVENT)
+      xmlNodeAddContent(f->node, (const xmlChar*)value);
+    else
+      skip_node(b, type);
+    return;
   }
 
-  g_list_free(attrs);
-  g_list_free(children);
-  g_free(action_value);
-  g_free(command_value);
+  /* Rename command to execute if not already handled */
+  add_node(b, f->node, strcmp(key, "command") == 0 ? "execute" : key, type, value);
 }
 
-static void process_node(yaml_document_t* doc, yaml_node_t* node, const gchar* tag_name, GString* out) {
-  if (!node)
+/* handles a scalar, or the start of a sequence or mapping */
+static void node_start(YamlBuilder* b, yaml_event_type_t type, const gchar* value) {
+  YamlFrame* f;
+
+  if (b->skipping) {
+    if (type != YAML_SCALAR_EVENT)
+      ++b->skipping;
     return;
+  }
 
-  g_message("process_node: tag='%s', node type=%d", tag_name, node->type);
-  switch (node->type) {
-    case YAML_SCALAR_NODE:
-      /* Special handling for separator and action tags */
-      if (strcmp(tag_name, "separator") == 0) {
-        g_string_append(out, "<separator/>");
-      }
-      else if (strcmp(tag_name, "action") == 0) {
-        /* action scalar becomes <action name="value"/> */
-        g_string_append(out, "<action name=\"");
-        xml_escape(out, (gchar*)node->data.scalar.value);
-        g_string_append(out, "\"/>");
-      }
-      else {
-        g_string_append_printf(out, "<%s>", tag_name);
-        xml_escape(out, (gchar*)node->data.scalar.value);
-        g_string_append_printf(out, "</%s>", tag_name);
-      }
-      break;
+  if (!b->frames) {
+    xmlNodePtr root;
 
-    case YAML_SEQUENCE_NODE: {
-      yaml_node_item_t* item;
-      const gchar* xml_tag = tag_name;
-      /* Map YAML tag names to Openbox XML tag names */
-      if (strcmp(tag_name, "submenu") == 0) {
-        xml_tag = "menu";
-      }
-      for (item = node->data.sequence.items.start; item < node->data.sequence.items.top; item++) {
-        yaml_node_t* item_node = yaml_document_get_node(doc, *item);
-        process_node(doc, item_node, xml_tag, out);
-      }
-      break;
+    /* Only mapping roots are supported */
+    if (type != YAML_MAPPING_START_EVENT) {
+      g_message("YAML document's root is not a mapping");
+      b->failed = TRUE;
+      return;
     }
+    root = xmlNewDocNode(b->doc, NULL, (const xmlChar*)b->root_node, NULL);
+    xmlDocSetRootElement(b->doc, root);
+    push_frame(b, TRUE, root, b->root_node);
+    ((YamlFrame*)b->frames->data)->root = TRUE;
+    return;
+  }
 
-    case YAML_MAPPING_NODE: {
-      const gchar* xml_tag = tag_name;
-      /* Map YAML tag names to Openbox XML tag names */
-      if (strcmp(tag_name, "submenu") == 0) {
-        xml_tag = "menu";
-      }
-      process_mapping(doc, node, xml_tag, out);
-      break;
+  f = b->frames->data;
+  if (!f->mapping)
+    add_node(b, f->node, f->tag, type, value);
+  else if (f->skip_value) {
+    f->skip_value = FALSE;
+    skip_node(b, type);
+  }
+  else if (!f->key) {
+    if (type == YAML_SCALAR_EVENT)
+      f->key = g_strdup(value);
+    else {
+      /* only scalar keys mean anything */
+      f->skip_value = TRUE;
+      skip_node(b, type);
     }
+  }
+  else {
+    gchar* key = f->key;
 
-    default:
-      break;
+    f->key = NULL;
+    add_pair(b, f, key, type, value);
+    g_free(key);
   }
 }
 
-gboolean obt_yaml_to_xml(const gchar* yaml_path, const gchar* root_node, gchar** xml_out, gsize* len_out) {
-  g_message("obt_yaml_to_xml called: %s, root_node=%s", yaml_path, root_node);
-  FILE* fh = fopen(yaml_path, "r");
-  yaml_parser_t parser;
-  yaml_document_t doc;
-  GString* out;
-  gboolean success = FALSE;
-
-  if (!fh) {
-    g_message("Failed to open YAML file: %s", yaml_path);
-    return FALSE;
-  }
+static void node_end(YamlBuilder* b) {
+  if (b->skipping)
+    --b->skipping;
+  else if (b->frames)
+    pop_frame(b);
+}
 
-  if (!yaml_parser_initialize(&parser)) {
-    fclose(fh);
-    return FALSE;
-  }
+static void feed(YamlBuilder* b, yaml_event_type_t type, const gchar* value, const gchar* anchor) {
+  GSList* it;
 
-  yaml_parser_set_input_file(&parser, fh);
+  if (type == YAML_ALIAS_EVENT) {
+    GArray* events = g_hash_table_lookup(b->anchors, value);
+    guint i;
 
-  if (!yaml_parser_load(&parser, &doc)) {
-    g_message("yaml_parser_load failed");
-    yaml_parser_delete(&parser);
-    fclose(fh);
-    return FALSE;
+    if (!events) {
+      g_message("YAML alias '%s' refers to an unknown anchor", value);
+      b->failed = TRUE;
+      return;
+    }
+    for (i = 0; i < events->len && !b->failed; ++i) {
+      const YamlRecorded* e = &g_array_index(events, YamlRecorded, i);
+      feed(b, e->type, e->value, NULL);
+    }
+    return;
   }
 
-  /* Check empty document */
-  yaml_node_t* root = yaml_document_get_root_node(&doc);
-  if (!root) {
-    g_message("YAML document has no root node");
-    goto cleanup;
+  if (anchor) {
+    YamlRecording* r = g_slice_new(YamlRecording);
+    r->anchor = g_strdup(anchor);
+    r->events = g_array_new(FALSE, FALSE, sizeof(YamlRecorded));
+    r->depth = 0;
+    b->recordings = g_slist_prepend(b->recordings, r);
   }
 
-  out = g_string_new("");
-  g_string_append_printf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<%s>\n", root_node);
-
-  g_message("YAML root node type: %d (1=SCALAR,2=SEQUENCE,4=MAPPING)", root->type);
-  if (root->type == YAML_MAPPING_NODE) {
-    g_message("Root is mapping node");
-    /* Iterate top level keys and treat them as children of root_node */
-    yaml_node_pair_t* pair;
-    g_message("YAML mapping pairs: %ld", (long)(root->data.mapping.pairs.top - root->data.mapping.pairs.start));
-    for (pair = root->data.mapping.pairs.start; pair < root->data.mapping.pairs.top; pair++) {
-      yaml_node_t* key_node = yaml_document_get_node(&doc, pair->key);
-      yaml_node_t* value_node = yaml_document_get_node(&doc, pair->value);
-
-      if (key_node && key_node->type == YAML_SCALAR_NODE) {
-        g_message("Processing key: %s", key_node->data.scalar.value);
-        process_node(&doc, value_node, (gchar*)key_node->data.scalar.value, out);
-      }
-      else {
-        g_message("Key node not scalar: %p type=%d", (void*)key_node, key_node ? key_node->type : -1);
-      }
+  /* keep the events for the anchored nodes that are being read */
+  for (it = b->recordings; it;) {
+    YamlRecording* r = it->data;
+    YamlRecorded e = {type, g_strdup(value)};
+
+    it = g_slist_next(it);
+    g_array_append_val(r->events, e);
+    if (type == YAML_SEQUENCE_START_EVENT || type == YAML_MAPPING_START_EVENT)
+      ++r->depth;
+    else if (type == YAML_SEQUENCE_END_EVENT || type == YAML_MAPPING_END_EVENT)
+      --r->depth;
+    if (r->depth == 0) {
+      g_hash_table_replace(b->anchors, r->anchor, r->events);
+      b->recordings = g_slist_remove(b->recordings, r);
+      g_slice_free(YamlRecording, r);
     }
   }
-  else {
-    /* Only mapping roots are supported for complex format */
-    g_message("Unsupported root node type: %d (expected mapping)", root->type);
-    goto cleanup;
+
+  if (type == YAML_SEQUENCE_END_EVENT || type == YAML_MAPPING_END_EVENT)
+    node_end(b);
+  else
+    node_start(b, type, value);
+}
+
+xmlDocPtr obt_yaml_load_doc(const gchar* yaml_path, const gchar* root_node) {
+  FILE* fh;
+  yaml_parser_t parser;
+  YamlBuilder b;
+
+  if (!(fh = fopen(yaml_path, "r")))
+    return NULL;
+
+  if (!yaml_parser_initialize(&parser)) {
+    fclose(fh);
+    return NULL;
   }
+  yaml_parser_set_input_file(&parser, fh);
 
-  g_string_append_printf(out, "</%s>\n", root_node);
+  b.doc = xmlNewDoc((const xmlChar*)"1.0");
+  b.root_node = root_node;
+  b.frames = NULL;
+  b.skipping = 0;
+  b.anchors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)recorded_free);
+  b.recordings = NULL;
+  b.done = FALSE;
+  b.failed = FALSE;
+
+  /* only the first document in the file is read */
+  while (!b.done && !b.failed) {
+    yaml_event_t event;
+
+    if (!yaml_parser_parse(&parser, &event)) {
+      g_message("%s:%lu:%lu: %s", yaml_path, (gulong)parser.problem_mark.line + 1,
+                (gulong)parser.problem_mark.column + 1, parser.problem ? parser.problem : "YAML parse error");
+      b.failed = TRUE;
+      break;
+    }
 
-  *xml_out = g_string_free(out, FALSE);
-  *len_out = strlen(*xml_out);
-  success = TRUE;
-  g_message("YAML to XML conversion succeeded (len=%zu): %.*s", *len_out, (int)(*len_out > 200 ? 200 : *len_out),
-            *xml_out);
+    switch (event.type) {
+      case YAML_SCALAR_EVENT:
+        feed(&b, event.type, (const gchar*)event.data.scalar.value, (const gchar*)event.data.scalar.anchor);
+        break;
+      case YAML_SEQUENCE_START_EVENT:
+        feed(&b, event.type, NULL, (const gchar*)event.data.sequence_start.anchor);
+        break;
+      case YAML_MAPPING_START_EVENT:
+        feed(&b, event.type, NULL, (const gchar*)event.data.mapping_start.anchor);
+        break;
+      case YAML_ALIAS_EVENT:
+        feed(&b, event.type, (const gchar*)event.data.alias.anchor, NULL);
+        break;
+      case YAML_SEQUENCE_END_EVENT:
+      case YAML_MAPPING_END_EVENT:
+        feed(&b, event.type, NULL, NULL);
+        break;
+      case YAML_DOCUMENT_END_EVENT:
+      case YAML_STREAM_END_EVENT:
+        /* the document ended without a root */
+        b.done = TRUE;
+        break;
+      default:
+        break;
+    }
+    yaml_event_delete(&event);
+  }
 
-cleanup:
-  yaml_document_delete(&doc);
+  while (b.frames)
+    pop_frame(&b);
+  while (b.recordings) {
+    YamlRecording* r = b.recordings->data;
+    g_free(r->anchor);
+    recorded_free(r->events);
+    g_slice_free(YamlRecording, r);
+    b.recordings = g_slist_delete_link(b.recordings, b.recordings);
+  }
+  g_hash_table_destroy(b.anchors);
   yaml_parser_delete(&parser);
   fclose(fh);
 
-  return success;
+  if (b.failed || !xmlDocGetRootElement(b.doc)) {
+    xmlFreeDoc(b.doc);
+    return NULL;
+  }
+  return b.doc;
 }
 
 #endif /* HAVE_YAML */
@@ -19,12 +19,16 @@
 #ifndef __obt_obtyaml_h
 #define __obt_obtyaml_h
 
+#include <libxml/tree.h>
 #include <glib.h>
 
 G_BEGIN_DECLS
 
 #ifdef HAVE_YAML
-gboolean obt_yaml_to_xml(const gchar* yaml_path, const gchar* root_node, gchar** xml_out, gsize* len_out);
+/*! Reads a YAML file into the same XML tree as the Openbox XML file that it
+  stands in for, with its top level keys inside a @root_node element.
+  Returns NULL if the file can't be read, or isn't a YAML mapping. */
+xmlDocPtr obt_yaml_load_doc(const gchar* yaml_path, const gchar* root_node);
 #endif
 
 G_END_DECLS
@@ -21,13 +21,86 @@
 #include "obt/display.h"
 
 #include <X11/Xatom.h>
+#include <X11/Xutil.h>
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef USE_XCB
+#include <X11/Xlib-xcb.h>
+#endif
 
 Atom prop_atoms[OBT_PROP_NUM_ATOMS];
 gboolean prop_started = FALSE;
 
+#ifdef USE_XCB
+typedef struct _ObtPropKey {
+  Window win;
+  Atom prop;
+} ObtPropKey;
+
+/* the replies from obt_prop_prefetch, by ObtPropKey.  a NULL reply means
+   the window was gone */
+static GHashTable* prefetched = NULL;
+
+static guint key_hash(gconstpointer p) {
+  const ObtPropKey* k = p;
+  return (guint)k->win * 31 + (guint)k->prop;
+}
+
+static gboolean key_equal(gconstpointer pa, gconstpointer pb) {
+  const ObtPropKey *a = pa, *b = pb;
+  return a->win == b->win && a->prop == b->prop;
+}
+
+static void key_free(gpointer p) {
+  g_slice_free(ObtPropKey, p);
+}
+
+/*! Finds a property in the prefetched replies.
+  @return FALSE if the property wasn't prefetched.  Otherwise TRUE, and
+    @reply is set to the reply, which is NULL if there wasn't one. */
+static gboolean prefetch_lookup(Window win, Atom prop, xcb_get_property_reply_t** reply) {
+  ObtPropKey k;
+
+  if (!prefetched)
+    return FALSE;
+  k.win = win;
+  k.prop = prop;
+  return g_hash_table_lookup_extended(prefetched, &k, NULL, (gpointer*)reply);
+}
+
+/*! Returns the data in a prefetched reply if it has the given type and
+  size, like XGetWindowProperty would, and NULL otherwise */
+static const guchar* prefetch_data(xcb_get_property_reply_t* reply, Atom type, gint size, guint* num) {
+  if (!reply || reply->format != size || !reply->value_len)
+    return NULL;
+  if (type != AnyPropertyType && reply->type != type)
+    return NULL;
+  *num = reply->value_len;
+  return xcb_get_property_value(reply);
+}
+
+static gboolean forget_window(gpointer key, gpointer value, gpointer data) {
+  return ((ObtPropKey*)key)->win == *(Window*)data;
+}
+#endif
+
+/*! Drops a prefetched property when we change it ourselves */
+static void prefetch_forget(Window win, Atom prop) {
+#ifdef USE_XCB
+  ObtPropKey k;
+
+  if (!prefetched)
+    return;
+  k.win = win;
+  k.prop = prop;
+  g_hash_table_remove(prefetched, &k);
+#endif
+}
+
 #define CREATE_NAME(var, name) (prop_atoms[OBT_PROP_##var] = XInternAtom((obt_display), (name), FALSE))
 #define CREATE(var) CREATE_NAME(var, #var)
 #define CREATE_(var) CREATE_NAME(var, "_" #var)
@@ -215,6 +288,20 @@ static gboolean get_prealloc(Window win, Atom prop, Atom type, gint size, guchar
   gint ret_size;
   gulong ret_items, bytes_left;
   glong num32 = 32 / size * num; /* num in 32-bit elements */
+#ifdef USE_XCB
+  xcb_get_property_reply_t* reply;
+
+  if (prefetch_lookup(win, prop, &reply)) {
+    const guchar* pdata;
+    guint pnum;
+
+    if (!(pdata = prefetch_data(reply, type, size, &pnum)) || pnum < num)
+      return FALSE;
+    /* xcb packs the items at their real size */
+    memcpy(data, pdata, num * (size / 8));
+    return TRUE;
+  }
+#endif
 
   res = XGetWindowProperty(obt_display, win, prop, 0l, num32, FALSE, type, &ret_type, &ret_size, &ret_items,
                            &bytes_left, &xdata);
@@ -249,6 +336,20 @@ static gboolean get_all(Window win, Atom prop, Atom type, gint size, guchar** da
   Atom ret_type;
   gint ret_size;
   gulong ret_items, bytes_left;
+#ifdef USE_XCB
+  xcb_get_property_reply_t* reply;
+
+  if (prefetch_lookup(win, prop, &reply)) {
+    const guchar* pdata;
+    guint pnum;
+
+    if (!(pdata = prefetch_data(reply, type, size, &pnum)))
+      return FALSE;
+    *data = g_memdup2(pdata, pnum * (size / 8));
+    *num = pnum;
+    return TRUE;
+  }
+#endif
 
   res = XGetWindowProperty(obt_display, win, prop, 0l, G_MAXLONG, FALSE, type, &ret_type, &ret_size, &ret_items,
                            &bytes_left, &xdata);
@@ -279,6 +380,35 @@ static gboolean get_all(Window win, Atom prop, Atom type, gint size, guchar** da
   return ret;
 }
 
+/*! Reads a text property like XGetTextProperty does, from the prefetched
+  replies if it can */
+static gboolean read_text_property(Window win, Atom prop, XTextProperty* tprop) {
+#ifdef USE_XCB
+  xcb_get_property_reply_t* reply;
+
+  if (prefetch_lookup(win, prop, &reply)) {
+    const guchar* pdata;
+    guint pnum;
+
+    tprop->value = NULL;
+    tprop->encoding = None;
+    tprop->format = 0;
+    tprop->nitems = 0;
+    if (!(pdata = prefetch_data(reply, AnyPropertyType, 8, &pnum)))
+      return FALSE;
+    /* with a nul after the data, and freeable with XFree */
+    tprop->value = malloc(pnum + 1);
+    memcpy(tprop->value, pdata, pnum);
+    tprop->value[pnum] = '\0';
+    tprop->encoding = reply->type;
+    tprop->format = 8;
+    tprop->nitems = pnum;
+    return TRUE;
+  }
+#endif
+  return XGetTextProperty(obt_display, win, tprop, prop);
+}
+
 /*! Get a text property from a window, and fill out the XTextProperty with it.
   @param win The window to read the property from.
   @param prop The atom of the property to read off the window.
@@ -289,7 +419,7 @@ static gboolean get_all(Window win, Atom prop, Atom type, gint size, guchar** da
     otherwise.
 */
 static gboolean get_text_property(Window win, Atom prop, XTextProperty* tprop, ObtPropTextType type) {
-  if (!(XGetTextProperty(obt_display, win, tprop, prop) && tprop->nitems))
+  if (!(read_text_property(win, prop, tprop) && tprop->nitems))
     return FALSE;
   if (!type)
     return TRUE; /* no type checking */
@@ -458,6 +588,39 @@ gboolean obt_prop_get_array32(Window win, Atom prop, Atom type, guint32** ret, g
   return get_all(win, prop, type, 32, (guchar**)ret, nret);
 }
 
+gboolean obt_prop_get_range32(Window win,
+                              Atom prop,
+                              Atom type,
+                              gulong offset,
+                              gulong length,
+                              guint32** ret,
+                              guint* nret,
+                              gulong* nleft) {
+  gboolean r = FALSE;
+  gint res;
+  guchar* xdata = NULL;
+  Atom ret_type;
+  gint ret_size;
+  gulong ret_items, bytes_left;
+
+  res = XGetWindowProperty(obt_display, win, prop, offset, length, FALSE, type, &ret_type, &ret_size, &ret_items,
+                           &bytes_left, &xdata);
+  if (res == Success) {
+    if (ret_size == 32 && ret_items > 0) {
+      guint i;
+
+      *ret = g_new(guint32, ret_items);
+      for (i = 0; i < ret_items; ++i)
+        (*ret)[i] = ((gulong*)xdata)[i];
+      *nret = ret_items;
+      *nleft = bytes_left / 4;
+      r = TRUE;
+    }
+    XFree(xdata);
+  }
+  return r;
+}
+
 gboolean obt_prop_get_text(Window win, Atom prop, ObtPropTextType type, gchar** ret_string) {
   XTextProperty tprop;
   gchar* str;
@@ -492,15 +655,148 @@ gboolean obt_prop_get_array_text(Window win, Atom prop, ObtPropTextType type, gc
   return ret;
 }
 
+XWMHints* obt_prop_get_wm_hints(Window win) {
+  guint32* data;
+  guint num;
+  XWMHints* hints = NULL;
+
+  /* the same as XGetWMHints, which wants at least all but the window
+     group */
+  if (get_all(win, XA_WM_HINTS, XA_WM_HINTS, 32, (guchar**)&data, &num)) {
+    if (num >= 8) {
+      hints = XAllocWMHints();
+      hints->flags = data[0];
+      hints->input = data[1] ? True : False;
+      hints->initial_state = (gint32)data[2];
+      hints->icon_pixmap = data[3];
+      hints->icon_window = data[4];
+      hints->icon_x = (gint32)data[5];
+      hints->icon_y = (gint32)data[6];
+      hints->icon_mask = data[7];
+      hints->window_group = num >= 9 ? data[8] : None;
+    }
+    g_free(data);
+  }
+  return hints;
+}
+
+gboolean obt_prop_get_wm_normal_hints(Window win, XSizeHints* hints) {
+  guint32* data;
+  guint num;
+  glong supplied;
+  gboolean ret = FALSE;
+
+  /* the same as XGetWMNormalHints, which accepts the old hints without the
+     base size and gravity */
+  if (get_all(win, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 32, (guchar**)&data, &num)) {
+    if (num >= 15) {
+      supplied = USPosition | USSize | PAllHints;
+      if (num >= 18)
+        supplied |= PBaseSize | PWinGravity;
+
+      hints->flags = data[0] & supplied;
+      hints->x = (gint32)data[1];
+      hints->y = (gint32)data[2];
+      hints->width = (gint32)data[3];
+      hints->height = (gint32)data[4];
+      hints->min_width = (gint32)data[5];
+      hints->min_height = (gint32)data[6];
+      hints->max_width = (gint32)data[7];
+      hints->max_height = (gint32)data[8];
+      hints->width_inc = (gint32)data[9];
+      hints->height_inc = (gint32)data[10];
+      hints->min_aspect.x = (gint32)data[11];
+      hints->min_aspect.y = (gint32)data[12];
+      hints->max_aspect.x = (gint32)data[13];
+      hints->max_aspect.y = (gint32)data[14];
+      if (num >= 18) {
+        hints->base_width = (gint32)data[15];
+        hints->base_height = (gint32)data[16];
+        hints->win_gravity = (gint32)data[17];
+      }
+      else {
+        hints->base_width = hints->base_height = 0;
+        hints->win_gravity = 0;
+      }
+      ret = TRUE;
+    }
+    g_free(data);
+  }
+  return ret;
+}
+
+void obt_prop_prefetch(const Window* wins, guint nwins, const Atom* props, guint nprops) {
+#ifdef USE_XCB
+  xcb_connection_t* conn;
+  xcb_get_property_cookie_t* cookies;
+  guint i, j;
+
+  if (!nwins || !nprops)
+    return;
+
+  conn = XGetXCBConnection(obt_display);
+  if (!prefetched)
+    prefetched = g_hash_table_new_full(key_hash, key_equal, key_free, free);
+
+  /* send all of the requests, and only then wait for the replies, so it
+     costs one round trip instead of one for each property */
+  cookies = g_new(xcb_get_property_cookie_t, nwins * nprops);
+  for (i = 0; i < nwins; ++i)
+    for (j = 0; j < nprops; ++j) {
+      xcb_get_property_reply_t* reply;
+
+      if (wins[i] == None || prefetch_lookup(wins[i], props[j], &reply))
+        cookies[i * nprops + j].sequence = 0;
+      else
+        cookies[i * nprops + j] =
+            xcb_get_property(conn, FALSE, wins[i], props[j], XCB_GET_PROPERTY_TYPE_ANY, 0, G_MAXUINT32);
+    }
+
+  for (i = 0; i < nwins; ++i)
+    for (j = 0; j < nprops; ++j) {
+      xcb_get_property_cookie_t c = cookies[i * nprops + j];
+      xcb_generic_error_t* err = NULL;
+      xcb_get_property_reply_t* reply;
+      ObtPropKey* k;
+
+      if (!c.sequence)
+        continue;
+      /* errors come back here instead of going to the error handler */
+      reply = xcb_get_property_reply(conn, c, &err);
+      free(err);
+
+      k = g_slice_new(ObtPropKey);
+      k->win = wins[i];
+      k->prop = props[j];
+      g_hash_table_replace(prefetched, k, reply);
+    }
+  g_free(cookies);
+#endif
+}
+
+void obt_prop_prefetch_forget(Window win) {
+#ifdef USE_XCB
+  if (!prefetched)
+    return;
+  if (win == None)
+    g_hash_table_remove_all(prefetched);
+  else
+    g_hash_table_foreach_remove(prefetched, forget_window, &win);
+#endif
+}
+
 void obt_prop_set32(Window win, Atom prop, Atom type, gulong val) {
+  prefetch_forget(win, prop);
   XChangeProperty(obt_display, win, prop, type, 32, PropModeReplace, (guchar*)&val, 1);
 }
 
 void obt_prop_set_array32(Window win, Atom prop, Atom type, gulong* val, guint num) {
+  prefetch_forget(win, prop);
   XChangeProperty(obt_display, win, prop, type, 32, PropModeReplace, (guchar*)val, num);
 }
 
 void obt_prop_set_text(Window win, Atom prop, const gchar* val) {
+  prefetch_forget(win, prop);
   XChangeProperty(obt_display, win, prop, OBT_PROP_ATOM(UTF8_STRING), 8, PropModeReplace, (const guchar*)val,
                   strlen(val));
 }
@@ -509,6 +805,7 @@ void obt_prop_set_array_text(Window win, Atom prop, const gchar* const* strs) {
   GString* str;
   gchar const* const* s;
 
+  prefetch_forget(win, prop);
   str = g_string_sized_new(0);
   for (s = strs; *s; ++s) {
     str = g_string_append(str, *s);
@@ -519,6 +816,7 @@ void obt_prop_set_array_text(Window win, Atom prop, const gchar* const* strs) {
 }
 
 void obt_prop_erase(Window win, Atom prop) {
+  prefetch_forget(win, prop);
   XDeleteProperty(obt_display, win, prop);
 }
 
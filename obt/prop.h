@@ -21,6 +21,7 @@
 #define __obt_prop_h
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
 #include <glib.h>
 
 G_BEGIN_DECLS
@@ -248,10 +249,42 @@ typedef enum {
 
 gboolean obt_prop_get32(Window win, Atom prop, Atom type, guint32* ret);
 gboolean obt_prop_get_array32(Window win, Atom prop, Atom type, guint32** ret, guint* nret);
+/*! Reads up to @length values starting @offset values into the property, so
+  that a large property can be read a piece at a time.
+  @param nleft Set to the number of values in the property after the ones
+    that were returned.
+*/
+gboolean obt_prop_get_range32(Window win,
+                              Atom prop,
+                              Atom type,
+                              gulong offset,
+                              gulong length,
+                              guint32** ret,
+                              guint* nret,
+                              gulong* nleft);
 
 gboolean obt_prop_get_text(Window win, Atom prop, ObtPropTextType type, gchar** ret);
 gboolean obt_prop_get_array_text(Window win, Atom prop, ObtPropTextType type, gchar*** ret);
 
+/*! The same as XGetWMHints, but it can use prefetched properties.  The
+  returned hints are freed with XFree. */
+XWMHints* obt_prop_get_wm_hints(Window win);
+/*! The same as XGetWMNormalHints, but it can use prefetched properties */
+gboolean obt_prop_get_wm_normal_hints(Window win, XSizeHints* hints);
+
+/*! Asks for all of the properties on all of the windows at once, and keeps
+  the replies for the obt_prop_get functions to use, so that reading a bunch
+  of properties costs one round trip instead of one each.  The replies are
+  kept until obt_prop_prefetch_forget, so they only stay correct while
+  nobody else can change the properties, such as while the server is
+  grabbed.  Properties that we set ourselves are forgotten straight away.
+  This does nothing if Xlib isn't built on XCB.
+*/
+void obt_prop_prefetch(const Window* wins, guint nwins, const Atom* props, guint nprops);
+/*! Drops the prefetched properties of the window, or of every window if it
+  is None */
+void obt_prop_prefetch_forget(Window win);
+
 void obt_prop_set32(Window win, Atom prop, Atom type, gulong val);
 void obt_prop_set_array32(Window win, Atom prop, Atom type, gulong* val, guint num);
 void obt_prop_set_text(Window win, Atom prop, const gchar* str);
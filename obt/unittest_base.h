@@ -44,10 +44,10 @@ extern const gchar* g_active_test_name;
     fprintf(stderr, "Expected: %u\nActual: %u\n", (expected), (actual)); \
   }
 
-#define EXPECT_STRING_EQ(expected, actual)                                                                           \
-  if ((expected) != (actual)) {                                                                                      \
-    FAILURE_AT();                                                                                                    \
-    fprintf(stderr, "Expected: %s\nActual: %s\n", ((expected) ? (expected) : "NULL"), ((actual) ? (actual) : NULL)); \
+#define EXPECT_STRING_EQ(expected, actual)                                                                             \
+  if (g_strcmp0((expected), (actual))) {                                                                               \
+    FAILURE_AT();                                                                                                      \
+    fprintf(stderr, "Expected: %s\nActual: %s\n", ((expected) ? (expected) : "NULL"), ((actual) ? (actual) : "NULL")); \
   }
 
 void unittest_start_suite(const char* suite_name);
@@ -19,6 +19,7 @@
 #include "obt/xml.h"
 #include "obt/paths.h"
 #include "obt/obtyaml.h"
+#include "obt/xmlcache.h"
 
 #include <libxml/xinclude.h>
 #include <glib.h>
@@ -51,6 +52,8 @@ struct _ObtXmlInst {
   xmlDocPtr doc;
   xmlNodePtr root;
   gchar* path;
+  /* where snapshots of the documents are kept, if anywhere */
+  gchar* cache_dir;
   gchar* last_error_file;
   gint last_error_line;
   gchar* last_error_message;
@@ -95,6 +98,7 @@ ObtXmlInst* obt_xml_instance_new(void) {
   i->doc = NULL;
   i->root = NULL;
   i->path = NULL;
+  i->cache_dir = NULL;
   i->last_error_file = NULL;
   i->last_error_line = -1;
   i->last_error_message = NULL;
@@ -109,12 +113,18 @@ void obt_xml_instance_unref(ObtXmlInst* i) {
   if (i && --i->ref == 0) {
     obt_paths_unref(i->xdg_paths);
     g_hash_table_destroy(i->callbacks);
+    g_free(i->cache_dir);
     g_free(i->last_error_file);
     g_free(i->last_error_message);
     g_slice_free(ObtXmlInst, i);
   }
 }
 
+void obt_xml_instance_set_cache(ObtXmlInst* i, const gchar* domain) {
+  g_free(i->cache_dir);
+  i->cache_dir = domain ? g_build_filename(obt_paths_cache_home(i->xdg_paths), domain, "xml", NULL) : NULL;
+}
+
 xmlDocPtr obt_xml_doc(ObtXmlInst* i) {
   g_assert(i->doc); /* a doc is open? */
   return i->doc;
@@ -149,23 +159,39 @@ static gboolean load_file(ObtXmlInst* i,
                           const gchar* filename,
                           const gchar* root_node,
                           GSList* paths) {
-  GSList* it;
+  GSList *it, *files = NULL, *tried = NULL;
   gboolean r = FALSE;
+  gchar* key = NULL;
+  time_t started;
 
   g_assert(i->doc == NULL); /* another doc isn't open already? */
 
   xmlResetLastError();
 
-  for (it = paths; !r && it; it = g_slist_next(it)) {
+  for (it = paths; it; it = g_slist_next(it)) {
+    if (!domain && !filename) /* given a full path to the file */
+      files = g_slist_append(files, g_strdup(it->data));
+    else
+      files = g_slist_append(files, g_build_filename(it->data, domain, filename, NULL));
+  }
+
+  if (i->cache_dir) {
+    xmlDocPtr doc;
     gchar* path;
-    struct stat s;
 
-    if (!domain && !filename) /* given a full path to the file */
-      path = g_strdup(it->data);
+    key = obt_xml_cache_key(root_node, files);
+    if ((doc = obt_xml_cache_load(i->cache_dir, key, &path)) && obt_xml_load_doc(i, doc, root_node)) {
+      i->path = path;
+      r = TRUE;
+    }
     else
-      path = g_build_filename(it->data, domain, filename, NULL);
+      g_free(path);
+  }
+  started = time(NULL);
 
-    g_message("xml.c: trying path %s", path);
+  for (it = files; !r && it; it = g_slist_next(it)) {
+    const gchar* path = it->data;
+    struct stat s;
 
 #ifdef HAVE_YAML
     {
@@ -179,6 +205,7 @@ static gboolean load_file(ObtXmlInst* i,
       else if (g_str_has_suffix(path, ".xml")) {
         const gsize path_len = strlen(path);
         yaml_path = g_strdup_printf("%.*s.yaml", (int)(path_len - 4), path);
+        tried = g_slist_prepend(tried, g_strdup(yaml_path));
         if (stat(yaml_path, &s) == 0) {
           try_yaml = TRUE;
         }
@@ -188,23 +215,19 @@ static gboolean load_file(ObtXmlInst* i,
         }
       }
 
-      g_message("xml.c: try_yaml=%d, yaml_path=%s", try_yaml, yaml_path ? yaml_path : "(null)");
       if (try_yaml && yaml_path) {
-        g_message("xml.c: trying YAML file %s", yaml_path);
-        gchar* xml_buf = NULL;
-        gsize xml_len = 0;
-        if (obt_yaml_to_xml(yaml_path, root_node, &xml_buf, &xml_len)) {
-          if (obt_xml_load_mem(i, xml_buf, xml_len, root_node)) {
-            i->path = g_strdup(yaml_path);
-            r = TRUE;
-          }
-          g_free(xml_buf);
+        xmlDocPtr doc = obt_yaml_load_doc(yaml_path, root_node);
+        if (doc && obt_xml_load_doc(i, doc, root_node)) {
+          i->path = g_strdup(yaml_path);
+          r = TRUE;
         }
       }
       g_free(yaml_path);
     }
 #endif
 
+    tried = g_slist_prepend(tried, g_strdup(path));
+
     if (!r && stat(path, &s) >= 0) {
       /* XML_PARSE_BLANKS is needed apparently, or the tree can end up
          with extra nodes in it. */
@@ -232,10 +255,19 @@ static gboolean load_file(ObtXmlInst* i,
         }
       }
     }
+  }
 
-    g_free(path);
+  /* keep documents that loaded without any errors, so the errors are
+     shown again each time until they are fixed */
+  if (r && tried && key && !xmlGetLastError()) {
+    tried = g_slist_reverse(tried);
+    obt_xml_cache_save(i->cache_dir, key, i->doc, i->path, tried, started);
   }
 
+  g_slist_free_full(tried, g_free);
+  g_slist_free_full(files, g_free);
+  g_free(key);
+
   obt_xml_save_last_error(i);
 
   return r;
@@ -422,13 +454,25 @@ gboolean obt_xml_load_theme_file(ObtXmlInst* i,
 }
 
 gboolean obt_xml_load_mem(ObtXmlInst* i, gpointer data, guint len, const gchar* root_node) {
-  gboolean r = FALSE;
+  gboolean r;
 
   g_assert(i->doc == NULL); /* another doc isn't open already? */
 
   xmlResetLastError();
 
-  i->doc = xmlParseMemory(data, len);
+  r = obt_xml_load_doc(i, xmlParseMemory(data, len), root_node);
+
+  obt_xml_save_last_error(i);
+
+  return r;
+}
+
+gboolean obt_xml_load_doc(ObtXmlInst* i, xmlDocPtr doc, const gchar* root_node) {
+  gboolean r = FALSE;
+
+  g_assert(i->doc == NULL); /* another doc isn't open already? */
+
+  i->doc = doc;
   if (i->doc) {
     i->root = xmlDocGetRootElement(i->doc);
     if (!i->root) {
@@ -449,8 +493,6 @@ gboolean obt_xml_load_mem(ObtXmlInst* i, gpointer data, guint len, const gchar*
       r = TRUE; /* ok ! */
   }
 
-  obt_xml_save_last_error(i);
-
   return r;
 }
 
@@ -32,6 +32,12 @@ ObtXmlInst* obt_xml_instance_new(void);
 void obt_xml_instance_ref(ObtXmlInst* inst);
 void obt_xml_instance_unref(ObtXmlInst* inst);
 
+/*! Keeps snapshots of the documents that are loaded from files in the
+  user's cache directory for @domain, and loads them from there instead of
+  parsing the files again while none of them have changed.  Passing NULL
+  turns this off. */
+void obt_xml_instance_set_cache(ObtXmlInst* inst, const gchar* domain);
+
 gboolean obt_xml_load_file(ObtXmlInst* inst, const gchar* path, const gchar* root_node);
 gboolean obt_xml_load_config_file(ObtXmlInst* inst, const gchar* domain, const gchar* filename, const gchar* root_node);
 gboolean obt_xml_install_default_config(ObtXmlInst* inst, const gchar* domain, const gchar* filename);
@@ -42,6 +48,10 @@ gboolean obt_xml_load_theme_file(ObtXmlInst* inst,
                                  const gchar* filename,
                                  const gchar* root_node);
 gboolean obt_xml_load_mem(ObtXmlInst* inst, gpointer data, guint len, const gchar* root_node);
+/*! Opens a document that was already parsed, such as one built up with
+  libxml's push parser.  The instance takes ownership of the document, and
+  frees it if it can't be used. */
+gboolean obt_xml_load_doc(ObtXmlInst* inst, xmlDocPtr doc, const gchar* root_node);
 
 /* Returns true if an error is present. */
 gboolean obt_xml_last_error(ObtXmlInst* inst);
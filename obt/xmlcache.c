@@ -0,0 +1,508 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   obt/xmlcache.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "obt/xmlcache.h"
+#include "obt/paths.h"
+
+#include <libxml/uri.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+/* A snapshot file holds a header, then the sources, the nodes of the tree
+   in document order, their attributes, and the strings that all of those
+   refer to by offset.  It's only ever read back on the machine that wrote
+   it, so everything is in the native byte order. */
+
+#define CACHE_MAGIC "OBXC"
+#define CACHE_VERSION 1
+/* a string offset for no string */
+#define CACHE_NONE G_MAXUINT32
+
+typedef struct _CacheHeader {
+  gchar magic[4];
+  guint32 version;
+  guint32 n_sources;
+  guint32 n_nodes;
+  guint32 n_attrs;
+  guint32 strings_len;
+  /* the file the document was loaded from */
+  guint32 path;
+  guint32 pad;
+} CacheHeader;
+
+typedef struct _CacheSource {
+  guint32 path;
+  /* the file's checksum, or CACHE_NONE if it didn't exist */
+  guint32 checksum;
+  gint64 mtime;
+  gint64 size;
+} CacheSource;
+
+typedef struct _CacheNode {
+  guint32 type;
+  guint32 name;
+  guint32 content;
+  guint32 n_attrs;
+  guint32 n_children;
+} CacheNode;
+
+typedef struct _CacheAttr {
+  guint32 name;
+  guint32 value;
+} CacheAttr;
+
+typedef struct _CacheWriter {
+  GArray* sources;
+  GArray* nodes;
+  GArray* attrs;
+  GString* strings;
+  GHashTable* offsets;
+  time_t started;
+  gboolean ok;
+} CacheWriter;
+
+typedef struct _CacheReader {
+  xmlDocPtr doc;
+  const CacheNode* nodes;
+  guint n_nodes;
+  const CacheAttr* attrs;
+  guint n_attrs;
+  const gchar* strings;
+  guint strings_len;
+  guint next_node;
+  guint next_attr;
+} CacheReader;
+
+gchar* obt_xml_cache_key(const gchar* root_node, GSList* files) {
+  GString* s = g_string_new(root_node);
+  gchar* key;
+
+  for (; files; files = g_slist_next(files)) {
+    g_string_append_c(s, '\n');
+    g_string_append(s, files->data);
+  }
+  key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, s->str, s->len);
+  g_string_free(s, TRUE);
+  return key;
+}
+
+static gchar* cache_file(const gchar* dir, const gchar* key) {
+  gchar* name = g_strconcat(key, ".cache", NULL);
+  gchar* path = g_build_filename(dir, name, NULL);
+
+  g_free(name);
+  return path;
+}
+
+static gchar* file_checksum(const gchar* path) {
+  gchar* contents;
+  gsize len;
+  gchar* sum;
+
+  if (!g_file_get_contents(path, &contents, &len, NULL))
+    return NULL;
+  sum = g_compute_checksum_for_data(G_CHECKSUM_SHA1, (const guchar*)contents, len);
+  g_free(contents);
+  return sum;
+}
+
+static const gchar* reader_string(const CacheReader* r, guint32 offset) {
+  if (offset == CACHE_NONE || offset >= r->strings_len)
+    return NULL;
+  return r->strings + offset;
+}
+
+/* A file that still has the size and time that it was saved with hasn't
+   changed, since snapshots are only made of files that were last changed
+   before they were read.  A file of a different size has, and isn't read.
+   Otherwise it might have been written again with the same contents, and its
+   checksum tells.  Then @mtime is set to its new time if that can be saved
+   in place of the old one, so it's only read the once. */
+static gboolean source_unchanged(const CacheReader* r, const CacheSource* src, time_t now, gint64* mtime) {
+  const gchar* path = reader_string(r, src->path);
+  const gchar* checksum = reader_string(r, src->checksum);
+  struct stat st;
+  gchar* sum;
+  gboolean same;
+
+  *mtime = src->mtime;
+  if (!path)
+    return FALSE;
+  if (stat(path, &st) != 0)
+    return src->checksum == CACHE_NONE;
+  if (!checksum)
+    return FALSE;
+  if (st.st_size != src->size)
+    return FALSE;
+  if (st.st_mtime == src->mtime)
+    return TRUE;
+
+  sum = file_checksum(path);
+  same = sum && !strcmp(sum, checksum);
+  g_free(sum);
+  /* the same as when it's saved, it may change again within the second */
+  if (same && st.st_mtime < now)
+    *mtime = st.st_mtime;
+  return same;
+}
+
+static xmlNodePtr read_node(CacheReader* r) {
+  const CacheNode* n;
+  const gchar *name, *content;
+  xmlNodePtr node;
+  guint i;
+
+  if (r->next_node >= r->n_nodes)
+    return NULL;
+  n = &r->nodes[r->next_node++];
+  name = reader_string(r, n->name);
+  content = reader_string(r, n->content);
+
+  switch (n->type) {
+    case XML_ELEMENT_NODE:
+      if (!name || n->n_attrs > r->n_attrs - r->next_attr)
+        return NULL;
+      node = xmlNewDocNode(r->doc, NULL, (const xmlChar*)name, NULL);
+      for (i = 0; i < n->n_attrs; ++i) {
+        const CacheAttr* a = &r->attrs[r->next_attr++];
+        const gchar* aname = reader_string(r, a->name);
+        const gchar* avalue = reader_string(r, a->value);
+
+        if (!aname || !avalue) {
+          xmlFreeNode(node);
+          return NULL;
+        }
+        xmlNewProp(node, (const xmlChar*)aname, (const xmlChar*)avalue);
+      }
+      for (i = 0; i < n->n_children; ++i) {
+        xmlNodePtr child = read_node(r);
+
+        if (!child) {
+          xmlFreeNode(node);
+          return NULL;
+        }
+        xmlAddChild(node, child);
+      }
+      return node;
+    case XML_TEXT_NODE:
+      return content ? xmlNewDocText(r->doc, (const xmlChar*)content) : NULL;
+    case XML_CDATA_SECTION_NODE:
+      return content ? xmlNewCDataBlock(r->doc, (const xmlChar*)content, strlen(content)) : NULL;
+    default:
+      return NULL;
+  }
+}
+
+xmlDocPtr obt_xml_cache_load(const gchar* dir, const gchar* key, gchar** path) {
+  gchar* file;
+  GMappedFile* map;
+  const gchar* data;
+  gchar* touched = NULL;
+  gsize len, need;
+  const CacheHeader* h;
+  const CacheSource* sources;
+  CacheReader r;
+  xmlNodePtr root;
+  time_t now;
+  guint i;
+
+  *path = NULL;
+
+  file = cache_file(dir, key);
+  map = g_mapped_file_new(file, FALSE, NULL);
+  if (!map) {
+    g_free(file);
+    return NULL;
+  }
+
+  data = g_mapped_file_get_contents(map);
+  len = g_mapped_file_get_length(map);
+  h = (const CacheHeader*)data;
+  if (len < sizeof(CacheHeader) || memcmp(h->magic, CACHE_MAGIC, 4) || h->version != CACHE_VERSION) {
+    g_mapped_file_unref(map);
+    g_free(file);
+    return NULL;
+  }
+  need = sizeof(CacheHeader) + (gsize)h->n_sources * sizeof(CacheSource) + (gsize)h->n_nodes * sizeof(CacheNode) +
+         (gsize)h->n_attrs * sizeof(CacheAttr) + h->strings_len;
+  if (len < need || !h->strings_len) {
+    g_mapped_file_unref(map);
+    g_free(file);
+    return NULL;
+  }
+
+  sources = (const CacheSource*)(h + 1);
+  r.nodes = (const CacheNode*)(sources + h->n_sources);
+  r.n_nodes = h->n_nodes;
+  r.attrs = (const CacheAttr*)(r.nodes + h->n_nodes);
+  r.n_attrs = h->n_attrs;
+  r.strings = (const gchar*)(r.attrs + h->n_attrs);
+  r.strings_len = h->strings_len;
+  r.next_node = r.next_attr = 0;
+  r.doc = NULL;
+
+  /* every string ends inside the table */
+  if (r.strings[r.strings_len - 1] != '\0') {
+    g_mapped_file_unref(map);
+    g_free(file);
+    return NULL;
+  }
+
+  now = time(NULL);
+  for (i = 0; i < h->n_sources; ++i) {
+    gint64 mtime;
+
+    if (!source_unchanged(&r, &sources[i], now, &mtime)) {
+      g_free(touched);
+      g_mapped_file_unref(map);
+      g_free(file);
+      return NULL;
+    }
+    if (mtime != sources[i].mtime) {
+      if (!touched)
+        touched = g_memdup2(data, len);
+      ((CacheSource*)(touched + sizeof(CacheHeader)))[i].mtime = mtime;
+    }
+  }
+
+  r.doc = xmlNewDoc((const xmlChar*)"1.0");
+  /* share the element and attribute names like the parser does */
+  r.doc->dict = xmlDictCreate();
+  if (!(root = read_node(&r)) || r.next_node != r.n_nodes || !reader_string(&r, h->path)) {
+    if (root)
+      xmlFreeNode(root);
+    xmlFreeDoc(r.doc);
+    g_free(touched);
+    g_mapped_file_unref(map);
+    g_free(file);
+    return NULL;
+  }
+  xmlDocSetRootElement(r.doc, root);
+  *path = g_strdup(reader_string(&r, h->path));
+  r.doc->URL = xmlStrdup((const xmlChar*)*path);
+
+  /* files that were only touched are taken as unchanged by their time from
+     now on */
+  if (touched) {
+    g_file_set_contents(file, touched, len, NULL);
+    g_free(touched);
+  }
+  g_mapped_file_unref(map);
+  g_free(file);
+  return r.doc;
+}
+
+static guint32 writer_string(CacheWriter* w, const gchar* s) {
+  gpointer offset;
+
+  if (!s)
+    return CACHE_NONE;
+  if (!g_hash_table_lookup_extended(w->offsets, s, NULL, &offset)) {
+    offset = GUINT_TO_POINTER(w->strings->len);
+    g_string_append_len(w->strings, s, strlen(s) + 1);
+    g_hash_table_insert(w->offsets, g_strdup(s), offset);
+  }
+  return GPOINTER_TO_UINT(offset);
+}
+
+static void add_source(CacheWriter* w, const gchar* path) {
+  CacheSource src;
+  struct stat st;
+  guint i;
+
+  for (i = 0; i < w->sources->len; ++i)
+    if (!strcmp(w->strings->str + g_array_index(w->sources, CacheSource, i).path, path))
+      return;
+
+  src.path = writer_string(w, path);
+  src.checksum = CACHE_NONE;
+  src.mtime = src.size = 0;
+  if (stat(path, &st) == 0) {
+    gchar* sum;
+
+    /* it may have changed since it was read */
+    if (st.st_mtime >= w->started || !(sum = file_checksum(path))) {
+      w->ok = FALSE;
+      return;
+    }
+    src.checksum = writer_string(w, sum);
+    src.mtime = st.st_mtime;
+    src.size = st.st_size;
+    g_free(sum);
+  }
+  g_array_append_val(w->sources, src);
+}
+
+/* adds an included file as a source */
+static void add_include(CacheWriter* w, xmlNodePtr node) {
+  xmlChar *href, *base, *uri_str;
+  xmlURIPtr uri;
+
+  if (!(href = xmlGetProp(node, (const xmlChar*)"href"))) {
+    w->ok = FALSE;
+    return;
+  }
+  base = xmlNodeGetBase(node->doc, node);
+  uri_str = xmlBuildURI(href, base);
+  uri = uri_str ? xmlParseURI((const char*)uri_str) : NULL;
+
+  /* only local files can be checked */
+  if (uri && uri->path && (!uri->scheme || !strcmp(uri->scheme, "file")))
+    add_source(w, uri->path);
+  else
+    w->ok = FALSE;
+
+  if (uri)
+    xmlFreeURI(uri);
+  xmlFree(uri_str);
+  xmlFree(base);
+  xmlFree(href);
+}
+
+static guint32 count_children(xmlNodePtr node) {
+  guint32 n = 0;
+
+  for (node = node->children; node; node = node->next)
+    if (node->type == XML_ELEMENT_NODE || node->type == XML_TEXT_NODE || node->type == XML_CDATA_SECTION_NODE)
+      ++n;
+  return n;
+}
+
+static void write_node(CacheWriter* w, xmlNodePtr node) {
+  CacheNode n;
+  xmlAttrPtr a;
+  xmlNodePtr c;
+
+  n.type = node->type;
+  n.name = CACHE_NONE;
+  n.content = CACHE_NONE;
+  n.n_attrs = 0;
+  n.n_children = 0;
+
+  if (node->type == XML_ELEMENT_NODE) {
+    n.name = writer_string(w, (const gchar*)node->name);
+    n.n_children = count_children(node);
+    g_array_append_val(w->nodes, n);
+
+    for (a = node->properties; a; a = a->next) {
+      CacheAttr ca;
+      xmlChar* value;
+
+      /* leave out the xml:base attributes that XInclude adds */
+      if (a->ns)
+        continue;
+      value = xmlNodeListGetString(node->doc, a->children, TRUE);
+      ca.name = writer_string(w, (const gchar*)a->name);
+      ca.value = writer_string(w, value ? (const gchar*)value : "");
+      xmlFree(value);
+      g_array_append_val(w->attrs, ca);
+      ++g_array_index(w->nodes, CacheNode, w->nodes->len - 1).n_attrs;
+    }
+
+    for (c = node->children; c && w->ok; c = c->next) {
+      switch (c->type) {
+        case XML_ELEMENT_NODE:
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE:
+          write_node(w, c);
+          break;
+        case XML_XINCLUDE_START:
+          add_include(w, c);
+          break;
+        case XML_XINCLUDE_END:
+        case XML_COMMENT_NODE:
+        case XML_PI_NODE:
+          break;
+        default:
+          /* things like entity references can't be put back */
+          w->ok = FALSE;
+          break;
+      }
+    }
+  }
+  else {
+    n.content = writer_string(w, (const gchar*)node->content);
+    g_array_append_val(w->nodes, n);
+  }
+}
+
+void obt_xml_cache_save(const gchar* dir,
+                        const gchar* key,
+                        xmlDocPtr doc,
+                        const gchar* path,
+                        GSList* sources,
+                        time_t started) {
+  CacheWriter w;
+  CacheHeader h;
+  GByteArray* out;
+  xmlNodePtr root;
+
+  if (!(root = xmlDocGetRootElement(doc)))
+    return;
+
+  w.sources = g_array_new(FALSE, FALSE, sizeof(CacheSource));
+  w.nodes = g_array_new(FALSE, FALSE, sizeof(CacheNode));
+  w.attrs = g_array_new(FALSE, FALSE, sizeof(CacheAttr));
+  w.strings = g_string_new(NULL);
+  w.offsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  w.started = started;
+  w.ok = TRUE;
+
+  for (; sources && w.ok; sources = g_slist_next(sources))
+    add_source(&w, sources->data);
+  if (w.ok)
+    write_node(&w, root);
+
+  if (w.ok && obt_paths_mkdir_path(dir, 0700)) {
+    gchar* file = cache_file(dir, key);
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, 4);
+    h.version = CACHE_VERSION;
+    h.path = writer_string(&w, path);
+    h.n_sources = w.sources->len;
+    h.n_nodes = w.nodes->len;
+    h.n_attrs = w.attrs->len;
+    h.strings_len = w.strings->len;
+
+    out = g_byte_array_sized_new(sizeof(h) + w.sources->len * sizeof(CacheSource) +
+                                 w.nodes->len * sizeof(CacheNode) + w.attrs->len * sizeof(CacheAttr) + w.strings->len);
+    g_byte_array_append(out, (const guint8*)&h, sizeof(h));
+    g_byte_array_append(out, (const guint8*)w.sources->data, w.sources->len * sizeof(CacheSource));
+    g_byte_array_append(out, (const guint8*)w.nodes->data, w.nodes->len * sizeof(CacheNode));
+    g_byte_array_append(out, (const guint8*)w.attrs->data, w.attrs->len * sizeof(CacheAttr));
+    g_byte_array_append(out, (const guint8*)w.strings->str, w.strings->len);
+
+    /* written to a new file and renamed, so it's never seen half done */
+    g_file_set_contents(file, (const gchar*)out->data, out->len, NULL);
+
+    g_byte_array_free(out, TRUE);
+    g_free(file);
+  }
+
+  g_array_free(w.sources, TRUE);
+  g_array_free(w.nodes, TRUE);
+  g_array_free(w.attrs, TRUE);
+  g_string_free(w.strings, TRUE);
+  g_hash_table_destroy(w.offsets);
+}
@@ -0,0 +1,55 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   obt/xmlcache.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __obt_xmlcache_h
+#define __obt_xmlcache_h
+
+#include <libxml/tree.h>
+#include <glib.h>
+#include <time.h>
+
+G_BEGIN_DECLS
+
+/*! Snapshots of loaded documents, kept in a compact binary form so that a
+  document can be put back together without parsing its files again, as long
+  as none of them have changed.  A snapshot is found by a key made from the
+  files that would be searched for the document, and it records every file
+  that was looked at to find it, or that it includes, so that adding,
+  removing or changing any of them makes it stale. */
+
+/*! Returns the key for a document with the given root node, found by trying
+  the list of @files in order. */
+gchar* obt_xml_cache_key(const gchar* root_node, GSList* files);
+
+/*! Rebuilds the document saved under @key in @dir, if none of the files that
+  it came from have changed.  Sets @path to the file it was loaded from. */
+xmlDocPtr obt_xml_cache_load(const gchar* dir, const gchar* key, gchar** path);
+
+/*! Saves a snapshot of @doc under @key in @dir.  @path is the file that it
+  was loaded from, and @sources are all of the files that were tried to find
+  it, whether they exist or not.  Nothing is saved if any of them were
+  changed after @started, since the document may not match them. */
+void obt_xml_cache_save(const gchar* dir,
+                        const gchar* key,
+                        xmlDocPtr doc,
+                        const gchar* path,
+                        GSList* sources,
+                        time_t started);
+
+G_END_DECLS
+
+#endif
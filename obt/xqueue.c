@@ -18,14 +18,203 @@
 
 #include "obt/xqueue.h"
 #include "obt/display.h"
+#include "obt/internal.h"
 
-#define MINSZ 16
+#include <string.h>
 
-static XEvent* q = NULL;
+#define MINSZ 16
+/* event types fit in 7 bits, the 8th is for events sent with SendEvent */
+#define NUM_TYPES 128
+
+/* Events are never moved out of the middle of the queue.  When one is
+   removed from there, it is marked dead and left until it reaches the
+   start of the queue.  Each event has a serial number, which goes up by one
+   for each event added, so events can be found again after the queue has
+   grown or shrunk.  The events of each type, and of each type on each
+   window, are linked together in order, so the first one can be found
+   without looking through the whole queue. */
+typedef struct _ObtXQueueSlot {
+  XEvent e;
+  gboolean dead;
+  gulong next_type;   /* the next event of the same type, or 0 */
+  gulong next_window; /* the next event of the same type on the same window */
+} ObtXQueueSlot;
+
+/* the events of one type on one window */
+typedef struct _ObtXQueueChain {
+  ObtXQueueWindowType key;
+  gulong first, last;
+} ObtXQueueChain;
+
+static ObtXQueueSlot* q = NULL;
 static gulong qsz = 0;
 static gulong qstart; /* the first event in the queue */
 static gulong qend;   /* the last event in the queue */
 static gulong qnum = 0;
+static gulong qserial; /* the serial number of the first event in the queue */
+static gulong qlive = 0; /* the number of events in the queue that aren't dead */
+static gulong qpeak = 0; /* the most live events there have been */
+
+/* the first and last live event of each type, 0 when there is none */
+static gulong type_first[NUM_TYPES];
+static gulong type_last[NUM_TYPES];
+/* ObtXQueueChains by their window and type */
+static GHashTable* chains = NULL;
+/* the serial of the last event queued about each window, by the window */
+static GHashTable* window_last = NULL;
+
+struct _ObtXQueueRule {
+  gchar* name;
+  gint type;
+  ObtXQueueKeyFunc key;
+  ObtXQueueMergeFunc merge;
+  gulong dropped;
+  gboolean keep_order;
+  GHashTable* last; /* ObtXQueueRuleEntrys by their key */
+};
+
+/* the last event queued with a key */
+typedef struct _ObtXQueueRuleEntry {
+  ObtXQueueKey key;
+  gulong serial;
+} ObtXQueueRuleEntry;
+
+/* ObtXQueueRules in the order they were added, and by their type */
+static GSList* rules = NULL;
+static GSList* type_rules[NUM_TYPES];
+/* the earliest event that a new one was merged into since it was reset, so
+   a search can look at it again */
+static gulong merged_into = 0;
+
+static inline ObtXQueueSlot* slot(gulong serial) {
+  return &q[(qstart + (serial - qserial)) % qsz];
+}
+
+static guint chain_hash(gconstpointer p) {
+  const ObtXQueueWindowType* k = p;
+  return (guint)k->window * 31 + k->type;
+}
+
+static gboolean chain_equal(gconstpointer a, gconstpointer b) {
+  const ObtXQueueWindowType *ka = a, *kb = b;
+  return ka->window == kb->window && ka->type == kb->type;
+}
+
+static void chain_free(gpointer p) {
+  g_slice_free(ObtXQueueChain, p);
+}
+
+static guint rule_key_hash(gconstpointer p) {
+  const ObtXQueueKey* k = p;
+  return (guint)k->window * 31 + (guint)k->detail;
+}
+
+static gboolean rule_key_equal(gconstpointer a, gconstpointer b) {
+  const ObtXQueueKey *ka = a, *kb = b;
+  return ka->window == kb->window && ka->detail == kb->detail;
+}
+
+static void rule_entry_free(gpointer p) {
+  g_slice_free(ObtXQueueRuleEntry, p);
+}
+
+static inline gboolean live(gulong serial) {
+  return serial >= qserial && serial - qserial < qnum && !slot(serial)->dead;
+}
+
+/* the window that an event is about, which for requests and structure
+   events is the one that changes, not the one the event was sent to */
+static Window event_window(const XEvent* e) {
+  switch (e->type) {
+    case CreateNotify:
+      return e->xcreatewindow.window;
+    case DestroyNotify:
+      return e->xdestroywindow.window;
+    case UnmapNotify:
+      return e->xunmap.window;
+    case MapNotify:
+      return e->xmap.window;
+    case MapRequest:
+      return e->xmaprequest.window;
+    case ReparentNotify:
+      return e->xreparent.window;
+    case ConfigureNotify:
+      return e->xconfigure.window;
+    case ConfigureRequest:
+      return e->xconfigurerequest.window;
+    case GravityNotify:
+      return e->xgravity.window;
+    case CirculateNotify:
+      return e->xcirculate.window;
+    case CirculateRequest:
+      return e->xcirculaterequest.window;
+    default:
+      return e->xany.window;
+  }
+}
+
+/* returns TRUE if nothing about the window of @e was queued after the event
+   with @serial */
+static inline gboolean last_for_window(const XEvent* e, gulong serial) {
+  return GPOINTER_TO_SIZE(g_hash_table_lookup(window_last, GSIZE_TO_POINTER(event_window(e)))) == serial;
+}
+
+/* returns TRUE if the event was merged into one in the queue */
+static gboolean compress(const XEvent* e) {
+  const gint t = e->type & (NUM_TYPES - 1);
+  const gulong serial = qserial + qnum; /* the one it would get */
+  ObtXQueueKey key;
+  GSList* it;
+
+  if (!type_rules[t])
+    return FALSE;
+
+  for (it = type_rules[t]; it; it = g_slist_next(it)) {
+    ObtXQueueRule* r = it->data;
+    ObtXQueueRuleEntry* en;
+
+    memset(&key, 0, sizeof(key));
+    if (r->key(e, &key) && (en = g_hash_table_lookup(r->last, &key)) && live(en->serial) &&
+        (!r->keep_order || last_for_window(e, en->serial)) && r->merge(&slot(en->serial)->e, e)) {
+      ++r->dropped;
+      if (!merged_into || en->serial < merged_into)
+        merged_into = en->serial;
+      return TRUE;
+    }
+  }
+
+  /* it is going in the queue, so it is the last one with its keys now */
+  for (it = type_rules[t]; it; it = g_slist_next(it)) {
+    ObtXQueueRule* r = it->data;
+    ObtXQueueRuleEntry* en;
+
+    memset(&key, 0, sizeof(key));
+    if (!r->key(e, &key))
+      continue;
+    if (!(en = g_hash_table_lookup(r->last, &key))) {
+      en = g_slice_new(ObtXQueueRuleEntry);
+      en->key = key;
+      g_hash_table_insert(r->last, &en->key, en);
+    }
+    en->serial = serial;
+  }
+  return FALSE;
+}
+
+/* forget the last events for each key and window, when none of them are
+   queued */
+static void forget_rule_entries(void) {
+  GSList* it;
+
+  if (window_last && g_hash_table_size(window_last))
+    g_hash_table_remove_all(window_last);
+
+  for (it = rules; it; it = g_slist_next(it)) {
+    ObtXQueueRule* r = it->data;
+    if (g_hash_table_size(r->last))
+      g_hash_table_remove_all(r->last);
+  }
+}
 
 static inline void shrink(void) {
   if (qsz > MINSZ && qnum < qsz / 4) {
@@ -62,7 +251,7 @@ static inline void shrink(void) {
       qend = n - 1;
     }
 
-    q = g_renew(XEvent, q, newsz);
+    q = g_renew(ObtXQueueSlot, q, newsz);
     qsz = newsz;
   }
 }
@@ -72,7 +261,7 @@ static inline void grow(void) {
     const gulong newsz = qsz * 2;
     gulong i;
 
-    q = g_renew(XEvent, q, newsz);
+    q = g_renew(ObtXQueueSlot, q, newsz);
 
     g_assert(qnum > 0);
 
@@ -87,17 +276,65 @@ static inline void grow(void) {
 }
 
 static inline void queue_push(const XEvent* e) {
+  const gint t = e->type & (NUM_TYPES - 1);
+  ObtXQueueWindowType key;
+  ObtXQueueChain* c;
+  ObtXQueueSlot* s;
+  gulong serial;
+
+  if (compress(e))
+    return;
+
   grow(); /* make sure there is room */
 
+  serial = qserial + qnum;
   ++qnum;
   qend = (qend + 1) % qsz; /* move the end */
-  q[qend] = *e;            /* stick the event at the end */
+  s = &q[qend];
+  s->e = *e; /* stick the event at the end */
+  s->dead = FALSE;
+  if (++qlive > qpeak)
+    qpeak = qlive;
+  s->next_type = s->next_window = 0;
+
+  if (type_first[t])
+    slot(type_last[t])->next_type = serial;
+  else
+    type_first[t] = serial;
+  type_last[t] = serial;
+
+  key.window = e->xany.window;
+  key.type = t;
+  if ((c = g_hash_table_lookup(chains, &key)))
+    slot(c->last)->next_window = serial;
+  else {
+    c = g_slice_new(ObtXQueueChain);
+    c->key = key;
+    c->first = serial;
+    g_hash_table_insert(chains, &c->key, c);
+  }
+  c->last = serial;
+
+  g_hash_table_insert(window_last, GSIZE_TO_POINTER(event_window(e)), GSIZE_TO_POINTER(serial));
 }
 
+/* where the events come from, when it isn't the display */
+static ObtXQueueReadFunc read_func = NULL;
+
 /* Grab all pending X events */
 static gboolean read_events(gboolean block) {
   gboolean read_any = FALSE;
 
+  if (read_func) {
+    XEvent e;
+
+    while (read_func(&e)) {
+      queue_push(&e);
+      read_any = TRUE;
+    }
+    return read_any;
+  }
+
   while (TRUE) {
     gint pending = XPending(obt_display);
 
@@ -132,41 +369,58 @@ static gboolean read_events(gboolean block) {
   return read_any; /* return if we read anything */
 }
 
-static void pop(const gulong p) {
-  /* remove the event */
-  --qnum;
+static gulong first_of_window_type(Window window, gint type) {
+  ObtXQueueWindowType key;
+  ObtXQueueChain* c;
+
+  key.window = window;
+  key.type = type & (NUM_TYPES - 1);
+  c = g_hash_table_lookup(chains, &key);
+  return c ? c->first : 0;
+}
+
+/* removes the event from the queue */
+static void pop(const gulong serial) {
+  ObtXQueueSlot* s = slot(serial);
+  const gint t = s->e.type & (NUM_TYPES - 1);
+
+  s->dead = TRUE;
+  --qlive;
+
+  /* if it was the first of its type, or of its type on its window, then
+     move on to the next live one.  the dead ones after it are all still in
+     the queue, since they come after it */
+  if (type_first[t] == serial) {
+    gulong n = s->next_type;
+    while (n && slot(n)->dead)
+      n = slot(n)->next_type;
+    type_first[t] = n;
+  }
+  if (first_of_window_type(s->e.xany.window, t) == serial) {
+    ObtXQueueWindowType key;
+    gulong n = s->next_window;
+
+    while (n && slot(n)->dead)
+      n = slot(n)->next_window;
+
+    key.window = s->e.xany.window;
+    key.type = t;
+    if (n)
+      ((ObtXQueueChain*)g_hash_table_lookup(chains, &key))->first = n;
+    else
+      g_hash_table_remove(chains, &key);
+  }
+
+  /* take dead events off the front of the queue */
+  while (qnum && q[qstart].dead) {
+    --qnum;
+    ++qserial;
+    qstart = (qstart + 1) % qsz;
+  }
   if (qnum == 0) {
     qstart = 0;
     qend = -1;
-  }
-  else if (p == qstart)
-    qstart = (qstart + 1) % qsz;
-  else {
-    gulong pi;
-
-    /* is it cheaper to move the start or the end ? */
-    if ((p >= qstart && p < qstart + qnum / 2) || (p < qstart && p < (qstart + qnum / 2) % qsz)) {
-      /* move the start */
-      pi = p;
-      while (pi != qstart) {
-        const gulong pi_next = (pi == 0 ? qsz - 1 : pi - 1);
-
-        q[pi] = q[pi_next];
-        pi = pi_next;
-      }
-      qstart = (qstart + 1) % qsz;
-    }
-    else {
-      /* move the end */
-      pi = p;
-      while (pi != qend) {
-        const gulong pi_next = (pi + 1) % qsz;
-
-        q[pi] = q[pi_next];
-        pi = pi_next;
-      }
-      qend = (qend == 0 ? qsz - 1 : qend - 1);
-    }
+    forget_rule_entries();
   }
 
   shrink(); /* shrink the q if too little in it */
@@ -176,9 +430,12 @@ void xqueue_init(void) {
   if (q != NULL)
     return;
   qsz = MINSZ;
-  q = g_new(XEvent, qsz);
+  q = g_new(ObtXQueueSlot, qsz);
   qstart = 0;
   qend = -1;
+  qserial = 1; /* 0 means no event */
+  chains = g_hash_table_new_full(chain_hash, chain_equal, NULL, chain_free);
+  window_last = g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 
 void xqueue_destroy(void) {
@@ -187,6 +444,24 @@ void xqueue_destroy(void) {
   g_free(q);
   q = NULL;
   qsz = 0;
+  qnum = 0;
+  qlive = 0;
+  memset(type_first, 0, sizeof(type_first));
+  memset(type_last, 0, sizeof(type_last));
+  g_hash_table_destroy(chains);
+  chains = NULL;
+  g_hash_table_destroy(window_last);
+  window_last = NULL;
+  merged_into = 0;
+  forget_rule_entries();
+}
+
+void xqueue_set_read_func(ObtXQueueReadFunc func) {
+  read_func = func;
+}
+
+guint xqueue_rule_keys(ObtXQueueRule* rule) {
+  return g_hash_table_size(rule->last);
 }
 
 gboolean xqueue_match_window(XEvent* e, gpointer data) {
@@ -208,6 +483,23 @@ gboolean xqueue_match_window_message(XEvent* e, gpointer data) {
   return e->xany.window == x.window && e->type == ClientMessage && e->xclient.message_type == x.message;
 }
 
+/* finds the first event that xqueue_match_type or xqueue_match_window_type
+   would match, without looking through the queue */
+static gulong find_indexed(xqueue_match_func match, gpointer data) {
+  if (match == xqueue_match_type) {
+    const gint type = GPOINTER_TO_INT(data);
+    return type >= 0 && type < NUM_TYPES ? type_first[type] : 0;
+  }
+  else {
+    const ObtXQueueWindowType* x = data;
+    return x->type >= 0 && x->type < NUM_TYPES ? first_of_window_type(x->window, x->type) : 0;
+  }
+}
+
+static gboolean is_indexed(xqueue_match_func match) {
+  return match == xqueue_match_type || match == xqueue_match_window_type;
+}
+
 gboolean xqueue_peek(XEvent* event_return) {
   g_return_val_if_fail(q != NULL, FALSE);
   g_return_val_if_fail(event_return != NULL, FALSE);
@@ -216,7 +508,7 @@ gboolean xqueue_peek(XEvent* event_return) {
     read_events(TRUE);
   if (!qnum)
     return FALSE;
-  *event_return = q[qstart]; /* get the head */
+  *event_return = q[qstart].e; /* get the head */
   return TRUE;
 }
 
@@ -228,7 +520,7 @@ gboolean xqueue_peek_local(XEvent* event_return) {
     read_events(FALSE);
   if (!qnum)
     return FALSE;
-  *event_return = q[qstart]; /* get the head */
+  *event_return = q[qstart].e; /* get the head */
   return TRUE;
 }
 
@@ -239,8 +531,8 @@ gboolean xqueue_next(XEvent* event_return) {
   if (!qnum)
     read_events(TRUE);
   if (qnum) {
-    *event_return = q[qstart]; /* get the head */
-    pop(qstart);
+    *event_return = q[qstart].e; /* get the head */
+    pop(qserial);
     return TRUE;
   }
 
@@ -254,54 +546,97 @@ gboolean xqueue_next_local(XEvent* event_return) {
   if (!qnum)
     read_events(FALSE);
   if (qnum) {
-    *event_return = q[qstart]; /* get the head */
-    pop(qstart);
+    *event_return = q[qstart].e; /* get the head */
+    pop(qserial);
     return TRUE;
   }
 
   return FALSE;
 }
 
+/* looks through the queue from the @checked'th event, skipping dead ones,
+   and returns the serial number of the first one that matches */
+static gulong find_from(gulong* checked, xqueue_match_func match, gpointer data) {
+  for (; *checked < qnum; ++*checked) {
+    ObtXQueueSlot* s = &q[(qstart + *checked) % qsz];
+    if (!s->dead && match(&s->e, data))
+      return qserial + *checked;
+  }
+  return 0;
+}
+
+/* moves @checked back to look again at an event that new ones were merged
+   into while reading */
+static inline void rewind_checked(gulong* checked) {
+  if (merged_into && merged_into - qserial < *checked)
+    *checked = merged_into - qserial;
+}
+
 gboolean xqueue_exists(xqueue_match_func match, gpointer data) {
-  gulong i, checked;
+  gulong checked;
 
   g_return_val_if_fail(q != NULL, FALSE);
   g_return_val_if_fail(match != NULL, FALSE);
 
   checked = 0;
   while (TRUE) {
-    for (i = checked; i < qnum; ++i, ++checked) {
-      const gulong p = (qstart + i) % qsz;
-      if (match(&q[p], data))
-        return TRUE;
-    }
+    if (is_indexed(match) ? find_indexed(match, data) : find_from(&checked, match, data))
+      return TRUE;
+    merged_into = 0;
     if (!read_events(TRUE))
       break; /* error */
+    rewind_checked(&checked);
   }
   return FALSE;
 }
 
 gboolean xqueue_exists_local(xqueue_match_func match, gpointer data) {
-  gulong i, checked;
+  gulong checked;
 
   g_return_val_if_fail(q != NULL, FALSE);
   g_return_val_if_fail(match != NULL, FALSE);
 
   checked = 0;
   while (TRUE) {
-    for (i = checked; i < qnum; ++i, ++checked) {
-      const gulong p = (qstart + i) % qsz;
-      if (match(&q[p], data))
+    if (is_indexed(match) ? find_indexed(match, data) : find_from(&checked, match, data))
+      return TRUE;
+    merged_into = 0;
+    if (!read_events(FALSE))
+      break;
+    rewind_checked(&checked);
+  }
+  return FALSE;
+}
+
+gboolean xqueue_exists_local_type(gint type, xqueue_match_func match, gpointer data) {
+  gulong last = 0;
+
+  g_return_val_if_fail(q != NULL, FALSE);
+  g_return_val_if_fail(type >= 0 && type < NUM_TYPES, FALSE);
+
+  while (TRUE) {
+    gulong n;
+
+    /* carry on after the last one looked at, which is still in the queue
+       since nothing has been taken out */
+    for (n = last ? slot(last)->next_type : type_first[type]; n; n = slot(n)->next_type) {
+      ObtXQueueSlot* s = slot(n);
+      if (!s->dead && (!match || match(&s->e, data)))
         return TRUE;
+      last = n;
     }
+    merged_into = 0;
     if (!read_events(FALSE))
       break;
+    /* an event already looked at may have changed, so start over */
+    if (merged_into)
+      last = 0;
   }
   return FALSE;
 }
 
 gboolean xqueue_remove_local(XEvent* event_return, xqueue_match_func match, gpointer data) {
-  gulong i, checked;
+  gulong checked;
 
   g_return_val_if_fail(q != NULL, FALSE);
   g_return_val_if_fail(event_return != NULL, FALSE);
@@ -309,20 +644,28 @@ gboolean xqueue_remove_local(XEvent* event_return, xqueue_match_func match, gpoi
 
   checked = 0;
   while (TRUE) {
-    for (i = checked; i < qnum; ++i, ++checked) {
-      const gulong p = (qstart + i) % qsz;
-      if (match(&q[p], data)) {
-        *event_return = q[p];
-        pop(p);
-        return TRUE;
-      }
+    const gulong serial = is_indexed(match) ? find_indexed(match, data) : find_from(&checked, match, data);
+    if (serial) {
+      *event_return = slot(serial)->e;
+      pop(serial);
+      return TRUE;
     }
+    merged_into = 0;
     if (!read_events(FALSE))
       break;
+    rewind_checked(&checked);
   }
   return FALSE;
 }
 
+gulong xqueue_length(void) {
+  return qlive;
+}
+
+gulong xqueue_peak_length(void) {
+  return qpeak;
+}
+
 gboolean xqueue_pending_local(void) {
   g_return_val_if_fail(q != NULL, FALSE);
 
@@ -416,3 +759,94 @@ void xqueue_remove_callback(ObtXQueueFunc f, gpointer data) {
     }
   }
 }
+
+ObtXQueueRule* xqueue_add_rule(const gchar* name, gint type, ObtXQueueKeyFunc key, ObtXQueueMergeFunc merge) {
+  ObtXQueueRule* r;
+
+  g_return_val_if_fail(type >= 0 && type < NUM_TYPES, NULL);
+  g_return_val_if_fail(key != NULL, NULL);
+  g_return_val_if_fail(merge != NULL, NULL);
+
+  r = g_slice_new(ObtXQueueRule);
+  r->name = g_strdup(name);
+  r->type = type;
+  r->key = key;
+  r->merge = merge;
+  r->dropped = 0;
+  r->keep_order = FALSE;
+  r->last = g_hash_table_new_full(rule_key_hash, rule_key_equal, NULL, rule_entry_free);
+
+  rules = g_slist_append(rules, r);
+  type_rules[type] = g_slist_append(type_rules[type], r);
+  return r;
+}
+
+void xqueue_remove_rule(ObtXQueueRule* rule) {
+  g_return_if_fail(rule != NULL);
+
+  rules = g_slist_remove(rules, rule);
+  type_rules[rule->type] = g_slist_remove(type_rules[rule->type], rule);
+  g_hash_table_destroy(rule->last);
+  g_free(rule->name);
+  g_slice_free(ObtXQueueRule, rule);
+}
+
+void xqueue_rule_keep_order(ObtXQueueRule* rule) {
+  g_return_if_fail(rule != NULL);
+
+  rule->keep_order = TRUE;
+}
+
+void xqueue_foreach_rule(ObtXQueueRuleFunc func, gpointer data) {
+  GSList* it;
+
+  g_return_if_fail(func != NULL);
+
+  for (it = rules; it; it = g_slist_next(it)) {
+    const ObtXQueueRule* r = it->data;
+    func(r->name, r->dropped, data);
+  }
+}
+
+gboolean xqueue_key_window(const XEvent* e, ObtXQueueKey* key) {
+  key->window = e->xany.window;
+  return TRUE;
+}
+
+gboolean xqueue_merge_latest(XEvent* queued, const XEvent* e) {
+  *queued = *e;
+  return TRUE;
+}
+
+gboolean xqueue_merge_expose(XEvent* queued, const XEvent* e) {
+  const gint x1 = MIN(queued->xexpose.x, e->xexpose.x);
+  const gint y1 = MIN(queued->xexpose.y, e->xexpose.y);
+  const gint x2 = MAX(queued->xexpose.x + queued->xexpose.width, e->xexpose.x + e->xexpose.width);
+  const gint y2 = MAX(queued->xexpose.y + queued->xexpose.height, e->xexpose.y + e->xexpose.height);
+
+  queued->xexpose.x = x1;
+  queued->xexpose.y = y1;
+  queued->xexpose.width = MAX(1, x2 - x1);
+  queued->xexpose.height = MAX(1, y2 - y1);
+  queued->xexpose.count = e->xexpose.count;
+  return TRUE;
+}
+
+gboolean xqueue_merge_motion(XEvent* queued, const XEvent* e) {
+  queued->xmotion.x = e->xmotion.x;
+  queued->xmotion.y = e->xmotion.y;
+  queued->xmotion.x_root = e->xmotion.x_root;
+  queued->xmotion.y_root = e->xmotion.y_root;
+  return TRUE;
+}
+
+gboolean xqueue_merge_net_wm_state(XEvent* queued, const XEvent* e) {
+  const glong* a = queued->xclient.data.l;
+  const glong* b = e->xclient.data.l;
+
+  /* 0 is remove and 1 is add */
+  if ((a[0] != 0 && a[0] != 1) || (b[0] != 0 && b[0] != 1) || a[1] != b[1] || a[2] != b[2] || a[3] != b[3])
+    return FALSE;
+  *queued = *e;
+  return TRUE;
+}
@@ -62,6 +62,13 @@ gboolean xqueue_next_local(XEvent* event_return);
   otherwise. */
 gboolean xqueue_pending_local(void);
 
+/*! Returns the number of events in the local event queue */
+gulong xqueue_length(void);
+
+/*! Returns the largest number of events that have been in the local event
+  queue at once */
+gulong xqueue_peak_length(void);
+
 /*! Returns TRUE and passes the next event in the queue, or FALSE if there
   is an error */
 gboolean xqueue_peek(XEvent* event_return);
@@ -81,6 +88,12 @@ gboolean xqueue_exists(xqueue_match_func match, gpointer data);
   from the queue. */
 gboolean xqueue_exists_local(xqueue_match_func match, gpointer data);
 
+/*! Returns TRUE if xqueue_match_func returns TRUE for some event of the given
+  type in the current event queue.  Only the events of that type are looked
+  at, so this is quick even when the queue is long.  @match may be NULL to
+  look for any event of the type. */
+gboolean xqueue_exists_local_type(gint type, xqueue_match_func match, gpointer data);
+
 /*! Returns TRUE if xqueue_match_func returns TRUE for some event in the
   current event queue, and passes the matching event while removing it
   from the queue. */
@@ -95,6 +108,69 @@ void xqueue_listen(void);
 void xqueue_add_callback(ObtXQueueFunc f, gpointer data);
 void xqueue_remove_callback(ObtXQueueFunc f, gpointer data);
 
+/*! Events are compressed as they are read from the server, by rules which
+  say which events can be folded into one that is already waiting in the
+  queue.  Each rule gives a key for the events of one type, and the events
+  with the same key are offered to its merge function, so that the event
+  waiting in the queue can take in the new one in its place. */
+
+/*! What identifies the events that a rule can fold together */
+typedef struct _ObtXQueueKey {
+  Window window;
+  gulong detail;
+} ObtXQueueKey;
+
+/*! Fills in @key for the event and returns TRUE, or returns FALSE if the
+  event is not one to compress.  @key is zeroed beforehand. */
+typedef gboolean (*ObtXQueueKeyFunc)(const XEvent* e, ObtXQueueKey* key);
+
+/*! Folds @e into @queued, the last event read with the same key, which is
+  still waiting in the queue.  Returns TRUE if it did, so @e is dropped, or
+  FALSE to add @e to the queue on its own.  The type and window of @queued
+  must not be changed. */
+typedef gboolean (*ObtXQueueMergeFunc)(XEvent* queued, const XEvent* e);
+
+typedef struct _ObtXQueueRule ObtXQueueRule;
+
+/*! Adds a rule for compressing events of the given type.  The rules for a
+  type are tried in the order they were added.  @name is used when
+  reporting how many events the rule has dropped. */
+ObtXQueueRule* xqueue_add_rule(const gchar* name, gint type, ObtXQueueKeyFunc key, ObtXQueueMergeFunc merge);
+void xqueue_remove_rule(ObtXQueueRule* rule);
+
+/*! Makes the rule fold an event into the queued one only when nothing else
+  about the same window was read after the queued one.  Otherwise the new
+  event would be handled ahead of those, so the rules for requests from
+  clients use this to never change the order of the requests.  The window
+  an event is about is the one it changes, for requests and structure
+  events. */
+void xqueue_rule_keep_order(ObtXQueueRule* rule);
+
+typedef void (*ObtXQueueRuleFunc)(const gchar* name, gulong dropped, gpointer data);
+
+/*! Calls @func with the name of each rule and the number of events it has
+  dropped so far */
+void xqueue_foreach_rule(ObtXQueueRuleFunc func, gpointer data);
+
+/*! A key function that puts together the events on the same window */
+gboolean xqueue_key_window(const XEvent* e, ObtXQueueKey* key);
+
+/*! Replaces the queued event with the new one */
+gboolean xqueue_merge_latest(XEvent* queued, const XEvent* e);
+
+/*! Grows the queued Expose to cover the new one's area too, and takes its
+  count */
+gboolean xqueue_merge_expose(XEvent* queued, const XEvent* e);
+
+/*! Moves the queued MotionNotify to where the new one is */
+gboolean xqueue_merge_motion(XEvent* queued, const XEvent* e);
+
+/*! Replaces a queued _NET_WM_STATE request to add or remove some states with
+  a new one for the same states.  Toggles depend on what came before them,
+  so they are never merged.  The new request is handled where the queued one
+  was, so its rule should keep the order with xqueue_rule_keep_order(). */
+gboolean xqueue_merge_net_wm_state(XEvent* queued, const XEvent* e);
+
 G_END_DECLS
 
 #endif
@@ -0,0 +1,448 @@
+#include "obt/unittest_base.h"
+
+#include "obt/internal.h"
+#include "obt/xqueue.h"
+
+#include <glib.h>
+#include <string.h>
+
+/* the events that the queue reads next, in place of the display */
+static XEvent pending[8];
+static guint n_pending = 0;
+static guint next_pending = 0;
+
+static gboolean read_pending(XEvent* e) {
+  if (next_pending == n_pending) {
+    next_pending = n_pending = 0;
+    return FALSE;
+  }
+  *e = pending[next_pending++];
+  return TRUE;
+}
+
+static void add_pending(const XEvent* e) {
+  g_assert(n_pending < G_N_ELEMENTS(pending));
+  pending[n_pending++] = *e;
+}
+
+static XEvent expose(Window w, gint x, gint y, gint width, gint height, gint count) {
+  XEvent e;
+
+  memset(&e, 0, sizeof(e));
+  e.type = Expose;
+  e.xexpose.window = w;
+  e.xexpose.x = x;
+  e.xexpose.y = y;
+  e.xexpose.width = width;
+  e.xexpose.height = height;
+  e.xexpose.count = count;
+  return e;
+}
+
+static XEvent configure(Window w) {
+  XEvent e;
+
+  memset(&e, 0, sizeof(e));
+  e.type = ConfigureNotify;
+  e.xconfigure.window = w;
+  return e;
+}
+
+/* requests are sent to the parent, which is the root */
+static XEvent configure_request(Window w) {
+  XEvent e;
+
+  memset(&e, 0, sizeof(e));
+  e.type = ConfigureRequest;
+  e.xconfigurerequest.parent = 99;
+  e.xconfigurerequest.window = w;
+  return e;
+}
+
+static XEvent map_request(Window w) {
+  XEvent e;
+
+  memset(&e, 0, sizeof(e));
+  e.type = MapRequest;
+  e.xmaprequest.parent = 99;
+  e.xmaprequest.window = w;
+  return e;
+}
+
+static XEvent wm_state(Window w, glong action, glong first, glong second) {
+  XEvent e;
+
+  memset(&e, 0, sizeof(e));
+  e.type = ClientMessage;
+  e.xclient.window = w;
+  e.xclient.format = 32;
+  e.xclient.data.l[0] = action;
+  e.xclient.data.l[1] = first;
+  e.xclient.data.l[2] = second;
+  e.xclient.data.l[3] = 1;
+  return e;
+}
+
+static void count_dropped(const gchar* name, gulong dropped, gpointer data) {
+  *(gulong*)data += dropped;
+}
+
+static gulong dropped(void) {
+  gulong n = 0;
+  xqueue_foreach_rule(count_dropped, &n);
+  return n;
+}
+
+static gboolean match_nothing(XEvent* e, gpointer data) {
+  return FALSE;
+}
+
+/* reads what's pending into the queue */
+static void read_all(void) {
+  xqueue_exists_local(match_nothing, NULL);
+}
+
+static gboolean match_big_expose(XEvent* e, gpointer data) {
+  return e->type == Expose && e->xexpose.width >= 100;
+}
+
+static ObtXQueueRule* rule = NULL;
+
+static void setup(void) {
+  xqueue_set_read_func(read_pending);
+  xqueue_init();
+  rule = xqueue_add_rule("Expose", Expose, xqueue_key_window, xqueue_merge_expose);
+}
+
+static void teardown(void) {
+  xqueue_remove_rule(rule);
+  rule = NULL;
+  xqueue_destroy();
+  xqueue_set_read_func(NULL);
+  next_pending = n_pending = 0;
+}
+
+static void merge_expose_union() {
+  TEST_START();
+
+  XEvent queued = expose(1, 10, 10, 20, 20, 3);
+  XEvent e = expose(1, 25, 5, 10, 10, 2);
+
+  EXPECT_BOOL_EQ(TRUE, xqueue_merge_expose(&queued, &e));
+  EXPECT_INT_EQ(10, queued.xexpose.x);
+  EXPECT_INT_EQ(5, queued.xexpose.y);
+  EXPECT_INT_EQ(25, queued.xexpose.width);
+  EXPECT_INT_EQ(25, queued.xexpose.height);
+  /* the count of the last one tells if more are coming */
+  EXPECT_INT_EQ(2, queued.xexpose.count);
+
+  /* one inside the other doesn't change it */
+  e = expose(1, 12, 12, 1, 1, 0);
+  EXPECT_BOOL_EQ(TRUE, xqueue_merge_expose(&queued, &e));
+  EXPECT_INT_EQ(10, queued.xexpose.x);
+  EXPECT_INT_EQ(5, queued.xexpose.y);
+  EXPECT_INT_EQ(25, queued.xexpose.width);
+  EXPECT_INT_EQ(25, queued.xexpose.height);
+  EXPECT_INT_EQ(0, queued.xexpose.count);
+
+  TEST_END();
+}
+
+static void merge_net_wm_state() {
+  TEST_START();
+
+  XEvent queued, e;
+
+  /* remove then add the same states */
+  queued = wm_state(1, 0, 100, 101);
+  e = wm_state(1, 1, 100, 101);
+  EXPECT_BOOL_EQ(TRUE, xqueue_merge_net_wm_state(&queued, &e));
+  EXPECT_INT_EQ(1, (gint)queued.xclient.data.l[0]);
+
+  /* toggles are never merged, either way around */
+  queued = wm_state(1, 1, 100, 101);
+  e = wm_state(1, 2, 100, 101);
+  EXPECT_BOOL_EQ(FALSE, xqueue_merge_net_wm_state(&queued, &e));
+  EXPECT_INT_EQ(1, (gint)queued.xclient.data.l[0]);
+  queued = wm_state(1, 2, 100, 101);
+  e = wm_state(1, 0, 100, 101);
+  EXPECT_BOOL_EQ(FALSE, xqueue_merge_net_wm_state(&queued, &e));
+  EXPECT_INT_EQ(2, (gint)queued.xclient.data.l[0]);
+
+  /* other states */
+  queued = wm_state(1, 1, 100, 101);
+  e = wm_state(1, 1, 102, 101);
+  EXPECT_BOOL_EQ(FALSE, xqueue_merge_net_wm_state(&queued, &e));
+  EXPECT_INT_EQ(100, (gint)queued.xclient.data.l[1]);
+  e = wm_state(1, 1, 100, 0);
+  EXPECT_BOOL_EQ(FALSE, xqueue_merge_net_wm_state(&queued, &e));
+  EXPECT_INT_EQ(101, (gint)queued.xclient.data.l[2]);
+  /* another source */
+  e = wm_state(1, 1, 100, 101);
+  e.xclient.data.l[3] = 2;
+  EXPECT_BOOL_EQ(FALSE, xqueue_merge_net_wm_state(&queued, &e));
+
+  TEST_END();
+}
+
+static void compress_in_queue() {
+  TEST_START();
+  setup();
+
+  XEvent e = expose(1, 0, 0, 10, 10, 2);
+  add_pending(&e);
+  e = configure(2);
+  add_pending(&e);
+  e = expose(1, 20, 0, 10, 10, 1);
+  add_pending(&e);
+  e = expose(3, 0, 0, 5, 5, 0);
+  add_pending(&e);
+  e = expose(1, 0, 20, 10, 10, 0);
+  add_pending(&e);
+  read_all();
+
+  /* the exposes on window 1 went into the first one */
+  EXPECT_UINT_EQ(3, (guint)xqueue_length());
+  EXPECT_UINT_EQ(2, (guint)dropped());
+
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(Expose, e.type);
+  EXPECT_UINT_EQ(1, (guint)e.xexpose.window);
+  EXPECT_INT_EQ(30, e.xexpose.width);
+  EXPECT_INT_EQ(30, e.xexpose.height);
+  EXPECT_INT_EQ(0, e.xexpose.count);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(ConfigureNotify, e.type);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_UINT_EQ(3, (guint)e.xexpose.window);
+  EXPECT_BOOL_EQ(FALSE, xqueue_next_local(&e));
+
+  teardown();
+  TEST_END();
+}
+
+static void no_merge_into_removed() {
+  TEST_START();
+  setup();
+
+  XEvent e = expose(1, 0, 0, 10, 10, 0);
+  add_pending(&e);
+  e = configure(2);
+  add_pending(&e);
+  read_all();
+
+  /* the expose is handled, but the queue isn't empty */
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(Expose, e.type);
+
+  e = expose(1, 50, 50, 10, 10, 0);
+  add_pending(&e);
+  read_all();
+  EXPECT_UINT_EQ(2, (guint)xqueue_length());
+  EXPECT_UINT_EQ(0, (guint)dropped());
+
+  /* the expose is taken from behind the configure, so it stays in the queue
+     marked dead */
+  EXPECT_BOOL_EQ(TRUE, xqueue_remove_local(&e, xqueue_match_type, GINT_TO_POINTER(Expose)));
+  EXPECT_INT_EQ(50, e.xexpose.x);
+  e = expose(1, 70, 70, 10, 10, 0);
+  add_pending(&e);
+  read_all();
+  EXPECT_UINT_EQ(2, (guint)xqueue_length());
+  EXPECT_UINT_EQ(0, (guint)dropped());
+
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(ConfigureNotify, e.type);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(70, e.xexpose.x);
+
+  teardown();
+  TEST_END();
+}
+
+static void forget_after_drain() {
+  TEST_START();
+  setup();
+
+  XEvent e = expose(1, 0, 0, 10, 10, 0);
+  add_pending(&e);
+  e = expose(2, 0, 0, 10, 10, 0);
+  add_pending(&e);
+  read_all();
+  EXPECT_UINT_EQ(2, xqueue_rule_keys(rule));
+
+  /* the keys are kept until nothing is queued */
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_UINT_EQ(2, xqueue_rule_keys(rule));
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_UINT_EQ(0, (guint)xqueue_length());
+  EXPECT_UINT_EQ(0, xqueue_rule_keys(rule));
+
+  e = expose(1, 0, 0, 10, 10, 0);
+  add_pending(&e);
+  read_all();
+  EXPECT_UINT_EQ(1, xqueue_rule_keys(rule));
+
+  teardown();
+  TEST_END();
+}
+
+static void forget_on_destroy() {
+  TEST_START();
+  setup();
+
+  XEvent e = expose(1, 0, 0, 10, 10, 0);
+  add_pending(&e);
+  read_all();
+
+  /* a new queue numbers its events from the start again, so a key left from
+     before would point at the configure */
+  xqueue_destroy();
+  xqueue_init();
+  EXPECT_UINT_EQ(0, xqueue_rule_keys(rule));
+  e = configure(2);
+  add_pending(&e);
+  e = expose(1, 5, 5, 10, 10, 0);
+  add_pending(&e);
+  read_all();
+  EXPECT_UINT_EQ(2, (guint)xqueue_length());
+  EXPECT_UINT_EQ(0, (guint)dropped());
+
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(ConfigureNotify, e.type);
+  EXPECT_INT_EQ(0, e.xconfigure.width);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(Expose, e.type);
+  EXPECT_INT_EQ(5, e.xexpose.x);
+
+  teardown();
+  TEST_END();
+}
+
+static void search_sees_merged() {
+  TEST_START();
+  setup();
+
+  XEvent e = expose(1, 0, 0, 10, 10, 0);
+  add_pending(&e);
+  e = configure(2);
+  add_pending(&e);
+  read_all();
+
+  /* the search looks at both, then reads a bigger expose that is merged
+     into the first, behind where it has looked */
+  e = expose(1, 0, 0, 200, 200, 0);
+  add_pending(&e);
+  EXPECT_BOOL_EQ(TRUE, xqueue_exists_local(match_big_expose, NULL));
+  EXPECT_UINT_EQ(2, (guint)xqueue_length());
+
+  /* the same for taking it out of the queue */
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  e = expose(1, 0, 0, 10, 10, 0);
+  add_pending(&e);
+  read_all();
+  e = expose(1, 0, 0, 300, 10, 0);
+  add_pending(&e);
+  EXPECT_BOOL_EQ(TRUE, xqueue_remove_local(&e, match_big_expose, NULL));
+  EXPECT_INT_EQ(300, e.xexpose.width);
+  EXPECT_UINT_EQ(1, (guint)xqueue_length());
+
+  teardown();
+  TEST_END();
+}
+
+static void keep_order_net_wm_state() {
+  TEST_START();
+  setup();
+
+  ObtXQueueRule* state = xqueue_add_rule("_NET_WM_STATE", ClientMessage, xqueue_key_window, xqueue_merge_net_wm_state);
+  xqueue_rule_keep_order(state);
+
+  /* add fullscreen, move, remove fullscreen.  the remove can't go ahead of
+     the move */
+  XEvent e = wm_state(1, 1, 100, 0);
+  add_pending(&e);
+  e = configure_request(1);
+  add_pending(&e);
+  e = wm_state(1, 0, 100, 0);
+  add_pending(&e);
+  read_all();
+  EXPECT_UINT_EQ(3, (guint)xqueue_length());
+  EXPECT_UINT_EQ(0, (guint)dropped());
+
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(1, (gint)e.xclient.data.l[0]);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(ConfigureRequest, e.type);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(0, (gint)e.xclient.data.l[0]);
+
+  /* a request for another window in between doesn't matter */
+  e = wm_state(1, 1, 100, 0);
+  add_pending(&e);
+  e = configure_request(2);
+  add_pending(&e);
+  e = wm_state(1, 0, 100, 0);
+  add_pending(&e);
+  read_all();
+  EXPECT_UINT_EQ(2, (guint)xqueue_length());
+  EXPECT_UINT_EQ(1, (guint)dropped());
+
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(ClientMessage, e.type);
+  EXPECT_INT_EQ(0, (gint)e.xclient.data.l[0]);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(ConfigureRequest, e.type);
+
+  xqueue_remove_rule(state);
+  teardown();
+  TEST_END();
+}
+
+static void keep_order_latest() {
+  TEST_START();
+  setup();
+
+  ObtXQueueRule* message = xqueue_add_rule("ClientMessage", ClientMessage, xqueue_key_window, xqueue_merge_latest);
+  xqueue_rule_keep_order(message);
+
+  XEvent e = wm_state(1, 1, 0, 0);
+  add_pending(&e);
+  e = map_request(1);
+  add_pending(&e);
+  e = wm_state(1, 2, 0, 0);
+  add_pending(&e);
+  e = wm_state(1, 3, 0, 0);
+  add_pending(&e);
+  read_all();
+
+  /* only the last two are put together */
+  EXPECT_UINT_EQ(3, (guint)xqueue_length());
+  EXPECT_UINT_EQ(1, (guint)dropped());
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(1, (gint)e.xclient.data.l[0]);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(MapRequest, e.type);
+  EXPECT_BOOL_EQ(TRUE, xqueue_next_local(&e));
+  EXPECT_INT_EQ(3, (gint)e.xclient.data.l[0]);
+
+  xqueue_remove_rule(message);
+  teardown();
+  TEST_END();
+}
+
+void run_xqueue_unittest() {
+  unittest_start_suite("xqueue");
+
+  merge_expose_union();
+  merge_net_wm_state();
+  compress_in_queue();
+  no_merge_into_removed();
+  forget_after_drain();
+  forget_on_destroy();
+  search_sees_merged();
+  keep_order_net_wm_state();
+  keep_order_latest();
+
+  unittest_end_suite();
+}
@@ -0,0 +1,303 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   apprules.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "apprules.h"
+#include "config.h"
+#include "client.h"
+
+#include <string.h>
+
+/* the fields that a rule can constrain */
+enum {
+  RULE_NAME = 1 << 0,
+  RULE_GROUP_NAME = 1 << 1,
+  RULE_CLASS = 1 << 2,
+  RULE_GROUP_CLASS = 1 << 3,
+  RULE_ROLE = 1 << 4,
+  RULE_TITLE = 1 << 5,
+  RULE_TYPE = 1 << 6
+};
+
+/* the fields that rules are indexed by */
+enum { KEY_NAME, KEY_CLASS, KEY_ROLE, NUM_KEYS };
+
+static const guint key_field[NUM_KEYS] = {RULE_NAME, RULE_CLASS, RULE_ROLE};
+
+typedef struct _ObAppRule ObAppRule;
+typedef struct _ObAppRuleTrie ObAppRuleTrie;
+
+struct _ObAppRule {
+  struct _ObAppSettings* settings;
+  /* the fields that still need to be matched against the rule's patterns
+     once the index has picked it */
+  guint check;
+};
+
+struct _ObAppRuleTrie {
+  gchar c;
+  /* the rules whose prefix (or suffix) ends here */
+  GArray* rules;
+
+  ObAppRuleTrie* next_sibling;
+  ObAppRuleTrie* first_child;
+};
+
+struct _ObAppRules {
+  /* every ObAppRule, in order */
+  GArray* rules;
+  /* literal patterns, mapping to arrays of rule numbers */
+  GHashTable* exact[NUM_KEYS];
+  /* glob patterns by their literal start, and by their literal end read
+     backwards */
+  ObAppRuleTrie* prefix[NUM_KEYS];
+  ObAppRuleTrie* suffix[NUM_KEYS];
+  /* rules that couldn't be indexed, and are always tried */
+  GArray* unindexed;
+};
+
+static void trie_free(ObAppRuleTrie* t) {
+  while (t) {
+    ObAppRuleTrie* n = t->next_sibling;
+
+    trie_free(t->first_child);
+    if (t->rules)
+      g_array_free(t->rules, TRUE);
+    g_slice_free(ObAppRuleTrie, t);
+    t = n;
+  }
+}
+
+static ObAppRuleTrie* trie_child(ObAppRuleTrie* t, gchar c, gboolean create) {
+  ObAppRuleTrie* child;
+
+  for (child = t->first_child; child; child = child->next_sibling)
+    if (child->c == c)
+      return child;
+  if (!create)
+    return NULL;
+
+  child = g_slice_new0(ObAppRuleTrie);
+  child->c = c;
+  child->next_sibling = t->first_child;
+  t->first_child = child;
+  return child;
+}
+
+/* files rule number @n under the first @len characters of @s, which are read
+   backwards from the end if @reverse is set */
+static void trie_add(ObAppRuleTrie* t, const gchar* s, gsize len, gboolean reverse, guint n) {
+  gsize i;
+
+  for (i = 0; i < len; ++i)
+    t = trie_child(t, reverse ? s[len - 1 - i] : s[i], TRUE);
+  if (!t->rules)
+    t->rules = g_array_new(FALSE, FALSE, sizeof(guint));
+  g_array_append_val(t->rules, n);
+}
+
+/* collects the rules filed under any prefix (or suffix) of @s */
+static void trie_find(ObAppRuleTrie* t, const gchar* s, gboolean reverse, GArray* found) {
+  const gsize len = strlen(s);
+  gsize i;
+
+  for (i = 0; i < len && t; ++i) {
+    t = trie_child(t, reverse ? s[len - 1 - i] : s[i], FALSE);
+    if (t && t->rules)
+      g_array_append_vals(found, t->rules->data, t->rules->len);
+  }
+}
+
+ObAppRules* app_rules_new(void) {
+  ObAppRules* rules;
+  gint i;
+
+  rules = g_slice_new0(ObAppRules);
+  rules->rules = g_array_new(FALSE, FALSE, sizeof(ObAppRule));
+  rules->unindexed = g_array_new(FALSE, FALSE, sizeof(guint));
+  for (i = 0; i < NUM_KEYS; ++i) {
+    rules->exact[i] = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_array_unref);
+    rules->prefix[i] = g_slice_new0(ObAppRuleTrie);
+    rules->suffix[i] = g_slice_new0(ObAppRuleTrie);
+  }
+  return rules;
+}
+
+void app_rules_free(ObAppRules* rules) {
+  gint i;
+
+  if (!rules)
+    return;
+
+  for (i = 0; i < NUM_KEYS; ++i) {
+    g_hash_table_destroy(rules->exact[i]);
+    trie_free(rules->prefix[i]);
+    trie_free(rules->suffix[i]);
+  }
+  g_array_free(rules->unindexed, TRUE);
+  g_array_free(rules->rules, TRUE);
+  g_slice_free(ObAppRules, rules);
+}
+
+void app_rules_add(ObAppRules* rules,
+                   struct _ObAppSettings* settings,
+                   const gchar* name,
+                   const gchar* class,
+                   const gchar* role) {
+  const gchar* pattern[NUM_KEYS];
+  ObAppRule r;
+  guint n = rules->rules->len;
+  gint i, best = -1;
+  gsize best_prefix = 0, best_suffix = 0;
+
+  pattern[KEY_NAME] = name;
+  pattern[KEY_CLASS] = class;
+  pattern[KEY_ROLE] = role;
+
+  r.settings = settings;
+  r.check = 0;
+  if (settings->name)
+    r.check |= RULE_NAME;
+  if (settings->group_name)
+    r.check |= RULE_GROUP_NAME;
+  if (settings->class)
+    r.check |= RULE_CLASS;
+  if (settings->group_class)
+    r.check |= RULE_GROUP_CLASS;
+  if (settings->role)
+    r.check |= RULE_ROLE;
+  if (settings->title)
+    r.check |= RULE_TITLE;
+  if ((signed)settings->type >= 0)
+    r.check |= RULE_TYPE;
+
+  /* a literal pattern narrows things down the most, and matching it in the
+     hash table means it doesn't need to be checked again */
+  for (i = 0; i < NUM_KEYS; ++i) {
+    GArray* a;
+
+    if (!pattern[i] || strpbrk(pattern[i], "*?"))
+      continue;
+
+    if (!(a = g_hash_table_lookup(rules->exact[i], pattern[i]))) {
+      a = g_array_new(FALSE, FALSE, sizeof(guint));
+      g_hash_table_insert(rules->exact[i], g_strdup(pattern[i]), a);
+    }
+    g_array_append_val(a, n);
+    r.check &= ~key_field[i];
+    g_array_append_val(rules->rules, r);
+    return;
+  }
+
+  /* otherwise use the glob with the longest literal start or end */
+  for (i = 0; i < NUM_KEYS; ++i) {
+    gsize prefix, suffix;
+
+    if (!pattern[i])
+      continue;
+
+    prefix = strcspn(pattern[i], "*?");
+    suffix = strlen(pattern[i]);
+    while (suffix > 0 && pattern[i][suffix - 1] != '*' && pattern[i][suffix - 1] != '?')
+      --suffix;
+    suffix = strlen(pattern[i]) - suffix;
+
+    if (MAX(prefix, suffix) > MAX(best_prefix, best_suffix)) {
+      best = i;
+      best_prefix = prefix;
+      best_suffix = suffix;
+    }
+  }
+
+  if (best < 0)
+    g_array_append_val(rules->unindexed, n);
+  else if (best_prefix >= best_suffix)
+    trie_add(rules->prefix[best], pattern[best], best_prefix, FALSE, n);
+  else
+    trie_add(rules->suffix[best], pattern[best] + strlen(pattern[best]) - best_suffix, best_suffix, TRUE, n);
+
+  g_array_append_val(rules->rules, r);
+}
+
+static gboolean pattern_match(const GPatternSpec* pspec, const gchar* value) {
+  if (!value)
+    return FALSE;
+  return g_pattern_spec_match((GPatternSpec*)pspec, strlen(value), value, NULL);
+}
+
+static gboolean rule_match(const ObAppRule* r, ObClient* c) {
+  const ObAppSettings* s = r->settings;
+
+  if ((r->check & RULE_NAME) && !pattern_match(s->name, c->name))
+    return FALSE;
+  if ((r->check & RULE_GROUP_NAME) && !pattern_match(s->group_name, c->group_name))
+    return FALSE;
+  if ((r->check & RULE_CLASS) && !pattern_match(s->class, c->class))
+    return FALSE;
+  if ((r->check & RULE_GROUP_CLASS) && !pattern_match(s->group_class, c->group_class))
+    return FALSE;
+  if ((r->check & RULE_ROLE) && !pattern_match(s->role, c->role))
+    return FALSE;
+  if ((r->check & RULE_TITLE) && !pattern_match(s->title, c->title))
+    return FALSE;
+  if ((r->check & RULE_TYPE) && s->type != c->type)
+    return FALSE;
+  return TRUE;
+}
+
+static gint uint_compare(gconstpointer a, gconstpointer b) {
+  const guint x = *(const guint*)a, y = *(const guint*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+void app_rules_match(ObAppRules* rules, ObClient* client, ObAppRulesFunc func, gpointer data) {
+  const gchar* value[NUM_KEYS];
+  GArray* found;
+  guint i;
+
+  if (!rules->rules->len)
+    return;
+
+  value[KEY_NAME] = client->name;
+  value[KEY_CLASS] = client->class;
+  value[KEY_ROLE] = client->role;
+
+  found = g_array_new(FALSE, FALSE, sizeof(guint));
+  g_array_append_vals(found, rules->unindexed->data, rules->unindexed->len);
+  for (i = 0; i < NUM_KEYS; ++i) {
+    GArray* a;
+
+    /* nothing filed under a field can match if the window doesn't have it */
+    if (!value[i])
+      continue;
+
+    if ((a = g_hash_table_lookup(rules->exact[i], value[i])))
+      g_array_append_vals(found, a->data, a->len);
+    trie_find(rules->prefix[i], value[i], FALSE, found);
+    trie_find(rules->suffix[i], value[i], TRUE, found);
+  }
+
+  /* each rule is filed in one place, so there are no duplicates, but later
+     rules have to override earlier ones */
+  g_array_sort(found, uint_compare);
+  for (i = 0; i < found->len; ++i) {
+    const ObAppRule* r = &g_array_index(rules->rules, ObAppRule, g_array_index(found, guint, i));
+
+    if (rule_match(r, client))
+      func(r->settings, data);
+  }
+  g_array_free(found, TRUE);
+}
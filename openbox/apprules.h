@@ -0,0 +1,50 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   apprules.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __apprules_h
+#define __apprules_h
+
+#include <glib.h>
+
+struct _ObClient;
+struct _ObAppSettings;
+
+/*! An index over the per-app settings, so that finding the ones that match a
+  window doesn't mean trying every pattern of every rule.  Each rule is filed
+  under one of its name, class or role patterns: literal patterns go in a hash
+  table, and globs in a trie keyed on their literal prefix or suffix.  Rules
+  with none of those are always tried. */
+typedef struct _ObAppRules ObAppRules;
+
+typedef void (*ObAppRulesFunc)(struct _ObAppSettings* settings, gpointer data);
+
+ObAppRules* app_rules_new(void);
+void app_rules_free(ObAppRules* rules);
+
+/*! Adds a rule after all the others.  @name, @class and @role are the
+  patterns that the rule's GPatternSpecs were made from, or NULL. */
+void app_rules_add(ObAppRules* rules,
+                   struct _ObAppSettings* settings,
+                   const gchar* name,
+                   const gchar* class,
+                   const gchar* role);
+
+/*! Calls @func for each rule that matches the client, in the order that they
+  were added */
+void app_rules_match(ObAppRules* rules, struct _ObClient* client, ObAppRulesFunc func, gpointer data);
+
+#endif
@@ -30,12 +30,15 @@
 #include "event.h"
 #include "grab.h"
 #include "prompt.h"
+#include "rootprops.h"
 #include "focus.h"
 #include "focus_cycle.h"
 #include "stacking.h"
 #include "openbox.h"
 #include "group.h"
 #include "config.h"
+#include "apprules.h"
+#include "edgeindex.h"
 #include "menuframe.h"
 #include "keyboard.h"
 #include "mouse.h"
@@ -56,6 +59,7 @@
 #endif
 
 #include <glib.h>
+#include <X11/Xatom.h>
 #include <X11/Xutil.h>
 
 /*! The event mask to grab on client windows */
@@ -73,6 +77,18 @@ static GList* client_list_tail = NULL;
 
 static GSList* client_destroy_notifies = NULL;
 static RrImage* client_default_icon = NULL;
+/* the sizes that client icons are drawn at, for picking which of the
+   window's icons to load */
+static gint client_icon_sizes[3];
+
+/* how much of _NET_WM_ICON is read at a time while looking through it.  the
+   smaller icons usually fit in the first piece */
+#define ICON_CHUNK 4096
+
+typedef struct _ClientIconHeader {
+  guint offset; /* where the pixels start in the property */
+  guint w, h;
+} ClientIconHeader;
 
 static void client_get_all(ObClient* self, gboolean real);
 static void client_get_startup_id(ObClient* self);
@@ -114,11 +130,28 @@ static void client_setup_default_decor_and_functions(ObClient* self);
 static void client_setup_decor_undecorated(ObClient* self);
 
 void client_startup(gboolean reconfig) {
+  gint sizes[G_N_ELEMENTS(client_icon_sizes)];
+
   client_default_icon = RrImageNewFromData(ob_rr_icons, ob_rr_theme->def_win_icon, ob_rr_theme->def_win_icon_w,
                                            ob_rr_theme->def_win_icon_h);
 
-  if (reconfig)
+  /* the titlebar, the menus and the focus cycling popup */
+  sizes[0] = ob_rr_theme->button_size + 2;
+  sizes[1] = ob_rr_theme->menu_font_height;
+  sizes[2] = config_theme_window_list_icon_size;
+
+  if (reconfig) {
+    /* pick new icons from the windows if they're drawn at new sizes */
+    if (memcmp(sizes, client_icon_sizes, sizeof(sizes))) {
+      GList* it;
+
+      memcpy(client_icon_sizes, sizes, sizeof(sizes));
+      for (it = client_list; it; it = g_list_next(it))
+        client_update_icons(it->data);
+    }
     return;
+  }
+  memcpy(client_icon_sizes, sizes, sizeof(sizes));
 
   client_set_list();
 }
@@ -208,27 +241,67 @@ static void client_list_unlink(ObClient* self) {
   self->list_node = NULL;
 }
 
-void client_set_list(void) {
+static void set_list(void) {
   GArray* windows = NULL;
   GList* it;
 
   if (client_list) {
-    windows = g_array_new(FALSE, FALSE, sizeof(Window));
+    windows = g_array_new(FALSE, FALSE, sizeof(gulong));
     for (it = client_list; it; it = g_list_next(it)) {
-      Window win = ((ObClient*)it->data)->window;
+      gulong win = ((ObClient*)it->data)->window;
       g_array_append_val(windows, win);
     }
   }
 
-  OBT_PROP_SETA32(obt_root(ob_screen), NET_CLIENT_LIST, WINDOW, windows ? (gulong*)windows->data : NULL,
-                  windows ? windows->len : 0);
+  ROOT_PROPS_SETA32(NET_CLIENT_LIST, WINDOW, windows ? (gulong*)windows->data : NULL, windows ? windows->len : 0);
 
   if (windows)
     g_array_free(windows, TRUE);
+}
+
+void client_set_list(void) {
+  /* this is called for each window that is managed or unmanaged, so only
+     make the list once they are done */
+  root_props_build(set_list);
 
   stacking_set_list();
 }
 
+void client_prefetch(const Window* wins, guint nwins) {
+  /* everything that client_manage reads off the window while the server is
+     grabbed.  the icon is left out since it can be huge */
+  const Atom props[] = {
+      OBT_PROP_ATOM(MOTIF_WM_HINTS),
+      OBT_PROP_ATOM(NET_WM_WINDOW_TYPE),
+      OBT_PROP_ATOM(WM_TRANSIENT_FOR),
+      XA_WM_NORMAL_HINTS,
+      OBT_PROP_ATOM(NET_WM_STATE),
+      OBT_PROP_ATOM(WM_CLIENT_LEADER),
+      OBT_PROP_ATOM(SM_CLIENT_ID),
+      OBT_PROP_ATOM(WM_CLASS),
+      OBT_PROP_ATOM(WM_WINDOW_ROLE),
+      OBT_PROP_ATOM(WM_COMMAND),
+      OBT_PROP_ATOM(WM_CLIENT_MACHINE),
+      OBT_PROP_ATOM(NET_WM_PID),
+      OBT_PROP_ATOM(NET_WM_NAME),
+      OBT_PROP_ATOM(WM_NAME),
+      OBT_PROP_ATOM(NET_WM_ICON_NAME),
+      OBT_PROP_ATOM(WM_ICON_NAME),
+      OBT_PROP_ATOM(WM_PROTOCOLS),
+      XA_WM_HINTS,
+      OBT_PROP_ATOM(NET_STARTUP_ID),
+      OBT_PROP_ATOM(NET_WM_DESKTOP),
+#ifdef SYNC
+      OBT_PROP_ATOM(NET_WM_SYNC_REQUEST_COUNTER),
+#endif
+      OBT_PROP_ATOM(NET_WM_STRUT_PARTIAL),
+      OBT_PROP_ATOM(NET_WM_STRUT),
+      OBT_PROP_ATOM(NET_WM_ICON_GEOMETRY),
+  };
+
+  obt_prop_prefetch(wins, nwins, props, G_N_ELEMENTS(props));
+}
+
 void client_manage(Window window, ObPrompt* prompt) {
   ObClient* self;
   XSetWindowAttributes attrib_set;
@@ -263,7 +336,8 @@ void client_manage(Window window, ObPrompt* prompt) {
   self->gravity = NorthWestGravity;
   self->desktop = screen_num_desktops; /* always an invalid value */
 
-  /* get all the stuff off the window */
+  /* get all the stuff off the window, asking for it all at once first */
+  client_prefetch(&window, 1);
   client_get_all(self, TRUE);
 
   ob_debug("Window type: %d", self->type);
@@ -301,6 +375,7 @@ void client_manage(Window window, ObPrompt* prompt) {
 
   /* we've grabbed everything and set everything that we need to at mapping
      time now */
+  obt_prop_prefetch_forget(window);
   grab_server(FALSE);
 
   /* this needs to occur once we have a frame, since it sets a property on
@@ -480,6 +555,8 @@ void client_manage(Window window, ObPrompt* prompt) {
      this also places the window
   */
   client_apply_startup_state(self, place.x, place.y, place.width, place.height);
+  /* its desktop and iconic state are settled by now */
+  edge_index_update(self);
 
   /* set the initial value of the desktop hint, when one wasn't requested
      on map. */
@@ -595,6 +672,7 @@ void client_unmanage(ObClient* self) {
     ignore_start = event_start_ignore_all_enters();
 
   frame_hide(self->frame);
+  edge_index_remove(self);
   /* flush to send the hide to the server quickly */
   XFlush(obt_display);
 
@@ -622,7 +700,7 @@ void client_unmanage(ObClient* self) {
   self->kill_prompt = NULL;
 
   client_list_unlink(self);
-  stacking_remove(self);
+  stacking_remove(CLIENT_AS_WINDOW(self));
   window_remove(self->window);
 
   /* once the client is out of the list, update the struts to remove its
@@ -894,58 +972,29 @@ static gboolean client_can_steal_focus(ObClient* self,
   return steal;
 }
 
-// match helper for precompiled GLib patterns
-static gboolean pattern_spec_match_pspec(const GPatternSpec* pspec, const char* value) {
-  if (!pspec || !value)
-    return FALSE;
-  return g_pattern_spec_match((GPatternSpec*)pspec, strlen(value), value, NULL);
+static void client_apply_app_settings(ObAppSettings* app, gpointer data) {
+  ObAppSettings* settings = data;
+  const char* tag = app->name          ? "name"
+                    : app->group_name  ? "group_name"
+                    : app->class       ? "class"
+                    : app->group_class ? "group_class"
+                    : app->role        ? "role"
+                    : app->title       ? "title"
+                                       : "(unnamed)";
+  ob_debug("Window matching: %s", tag);
+
+  // copy the settings to our struct, overriding the existing defaults
+  config_app_settings_copy_non_defaults(app, settings);
 }
 
 /*! Returns a new structure containing the per-app settings for this client
   The returned structure needs to be freed with g_free */
 static ObAppSettings* client_get_settings_state(ObClient* self) {
   ObAppSettings* settings;
-  GSList* it;
 
   settings = config_create_app_settings();
 
-  for (it = config_per_app_settings; it; it = g_slist_next(it)) {
-    ObAppSettings* app = it->data;
-    gboolean match = TRUE;
-
-    g_assert(app->name != NULL || app->class != NULL || app->role != NULL || app->title != NULL ||
-             app->group_name != NULL || app->group_class != NULL || (signed)app->type >= 0);
-
-    if (app->name && !pattern_spec_match_pspec(app->name, self->name))
-      match = FALSE;
-    else if (app->group_name && !pattern_spec_match_pspec(app->group_name, self->group_name))
-      match = FALSE;
-    else if (app->class && !pattern_spec_match_pspec(app->class, self->class))
-      match = FALSE;
-    else if (app->group_class && !pattern_spec_match_pspec(app->group_class, self->group_class))
-      match = FALSE;
-    else if (app->role && !pattern_spec_match_pspec(app->role, self->role))
-      match = FALSE;
-    else if (app->title && !pattern_spec_match_pspec(app->title, self->title))
-      match = FALSE;
-    else if ((signed)app->type >= 0 && app->type != self->type) {
-      match = FALSE;
-    }
-
-    if (match) {
-      const char* tag = app->name          ? "name"
-                        : app->group_name  ? "group_name"
-                        : app->class       ? "class"
-                        : app->group_class ? "group_class"
-                        : app->role        ? "role"
-                        : app->title       ? "title"
-                                           : "(unnamed)";
-      ob_debug("Window matching: %s", tag);
-
-      // copy the settings to our struct, overriding the existing defaults
-      config_app_settings_copy_non_defaults(app, settings);
-    }
-  }
+  app_rules_match(config_per_app_rules, self, client_apply_app_settings, settings);
 
   if (settings->shade != -1)
     self->shaded = !!settings->shade;
@@ -1371,8 +1420,10 @@ void client_update_transient_for(ObClient* self) {
   Window t = None;
   ObClient* target = NULL;
   gboolean trangroup = FALSE;
+  guint32 t32;
 
-  if (XGetTransientForHint(obt_display, self->window, &t)) {
+  if (OBT_PROP_GET32(self->window, WM_TRANSIENT_FOR, WINDOW, &t32)) {
+    t = t32;
     if (t != self->window) { /* can't be transient to itself! */
       ObWindow* tw = window_find(t);
       /* if this happens then we need to check for it */
@@ -1517,7 +1568,7 @@ void client_get_mwm_hints(ObClient* self) {
 void client_get_type_and_transientness(ObClient* self) {
   guint num, i;
   guint32* val;
-  Window t;
+  guint32 t;
 
   self->type = -1;
   self->transient = FALSE;
@@ -1554,7 +1605,7 @@ void client_get_type_and_transientness(ObClient* self) {
     g_free(val);
   }
 
-  if (XGetTransientForHint(obt_display, self->window, &t))
+  if (OBT_PROP_GET32(self->window, WM_TRANSIENT_FOR, WINDOW, &t))
     self->transient = TRUE;
 
   if (self->type == (ObClientType)-1) {
@@ -1657,7 +1708,6 @@ void client_update_opacity(ObClient* self) {
 
 void client_update_normal_hints(ObClient* self) {
   XSizeHints size;
-  glong ret;
 
   /* defaults */
   self->min_ratio = 0.0f;
@@ -1668,7 +1718,7 @@ void client_update_normal_hints(ObClient* self) {
   SIZE_SET(self->max_size, G_MAXINT, G_MAXINT);
 
   /* get the hints from the window */
-  if (XGetWMNormalHints(obt_display, self->window, &size, &ret)) {
+  if (obt_prop_get_wm_normal_hints(self->window, &size)) {
     /* normal windows can't request placement! har har
     if (!client_normal(self))
     */
@@ -1922,7 +1972,7 @@ void client_update_wmhints(ObClient* self) {
   /* assume a window takes input if it doesn't specify */
   self->can_focus = TRUE;
 
-  if ((hints = XGetWMHints(obt_display, self->window)) != NULL) {
+  if ((hints = obt_prop_get_wm_hints(self->window)) != NULL) {
     gboolean ur;
 
     if (hints->flags & InputHint)
@@ -2117,57 +2167,138 @@ void client_update_strut(ObClient* self) {
   }
 }
 
+/* reads _NET_WM_ICON a piece at a time */
+typedef struct _ClientIconReader {
+  Window window;
+  guint32* data;
+  guint offset; /* where data starts in the property */
+  guint num;    /* how many values are in data */
+  guint total;  /* the length of the whole property, as far as we know */
+} ClientIconReader;
+
+/* returns @n values from @offset in the property, only going to the server
+   if they weren't in the last piece read */
+static guint32* client_icon_read(ClientIconReader* r, guint offset, guint n) {
+  gulong left;
+
+  if (offset >= r->offset && offset + n <= r->offset + r->num)
+    return r->data + (offset - r->offset);
+  if (offset + n > r->total)
+    return NULL;
+
+  g_free(r->data);
+  r->data = NULL;
+  r->offset = offset;
+  r->num = 0;
+  if (!obt_prop_get_range32(r->window, OBT_PROP_ATOM(NET_WM_ICON), OBT_PROP_ATOM(CARDINAL), offset,
+                            MAX(n, ICON_CHUNK), &r->data, &r->num, &left))
+    return NULL;
+  /* it may have changed since the last piece, if so we'll get a property
+     notify and start over */
+  r->total = offset + r->num + left;
+  return r->num >= n ? r->data : NULL;
+}
+
+/* picks the icon that will be scaled the least when drawn at @size, the
+   same way that RrImage chooses between its originals */
+static guint client_icon_closest(const ClientIconHeader* icons, guint n, gint size) {
+  guint i, best = 0;
+  gint best_diff = -1;
+
+  for (i = 0; i < n; ++i) {
+    gint wdiff = (gint)icons[i].w - size;
+    gint hdiff = (gint)icons[i].h - size;
+    gint diff;
+
+    if (wdiff < 0)
+      wdiff *= 2; /* prefer scaling down than up */
+    if (hdiff < 0)
+      hdiff *= 2;
+    diff = wdiff * wdiff + hdiff * hdiff;
+    if (best_diff < 0 || diff < best_diff) {
+      best_diff = diff;
+      best = i;
+    }
+  }
+  return best;
+}
+
 void client_update_icons(ObClient* self) {
-  guint num;
+  ClientIconReader r;
+  GArray* icons;
   guint32* data;
-  guint w, h, i, j;
+  guint w, h, i, j, offset;
   RrImage* img;
 
   img = NULL;
 
-  /* grab the server, because we might be setting the window's icon and
-     we don't want them to set it in between and we overwrite their own
-     icon */
-  grab_server(TRUE);
-
-  if (OBT_PROP_GETA32(self->window, NET_WM_ICON, CARDINAL, &data, &num)) {
-    /* figure out how many valid icons are in here */
-    i = 0;
-    while (i + 2 < num) { /* +2 is to make sure there is a w and h */
-      w = data[i++];
-      h = data[i++];
-      /* watch for the data being too small for the specified size,
-         or for zero sized icons. */
-      if (i + w * h > num || w == 0 || h == 0) {
-        i += w * h;
+  r.window = self->window;
+  r.data = NULL;
+  r.offset = r.num = 0;
+  r.total = G_MAXUINT;
+
+  /* find the size of each icon, without reading the pixels of any big ones
+     that won't be used */
+  icons = g_array_new(FALSE, FALSE, sizeof(ClientIconHeader));
+  offset = 0;
+  while ((data = client_icon_read(&r, offset, 2))) {
+    ClientIconHeader icon;
+
+    w = data[0];
+    h = data[1];
+    offset += 2;
+    /* watch for the data being too small for the specified size */
+    if (w > G_MAXUINT16 || h > G_MAXUINT16 || w * h > r.total - offset)
+      break;
+    /* and skip zero sized icons */
+    if (w > 0 && h > 0) {
+      icon.offset = offset;
+      icon.w = w;
+      icon.h = h;
+      g_array_append_val(icons, icon);
+    }
+    offset += w * h;
+  }
+
+  if (icons->len) {
+    const ClientIconHeader* all = (ClientIconHeader*)icons->data;
+    gboolean* want = g_new0(gboolean, icons->len);
+
+    for (i = 0; i < G_N_ELEMENTS(client_icon_sizes); ++i)
+      want[client_icon_closest(all, icons->len, client_icon_sizes[i])] = TRUE;
+
+    for (i = 0; i < icons->len; ++i) {
+      if (!want[i])
+        continue;
+      w = all[i].w;
+      h = all[i].h;
+      if (!(data = client_icon_read(&r, all[i].offset, w * h)))
         continue;
-      }
 
       /* convert it to the right bit order for ObRender */
       for (j = 0; j < w * h; ++j)
-        data[i + j] = ((guint)((data[i + j] >> 24) & 0xff) << RrDefaultAlphaOffset) +
-                      ((guint)((data[i + j] >> 16) & 0xff) << RrDefaultRedOffset) +
-                      ((guint)((data[i + j] >> 8) & 0xff) << RrDefaultGreenOffset) +
-                      ((guint)((data[i + j] >> 0) & 0xff) << RrDefaultBlueOffset);
+        data[j] = ((guint)((data[j] >> 24) & 0xff) << RrDefaultAlphaOffset) +
+                  ((guint)((data[j] >> 16) & 0xff) << RrDefaultRedOffset) +
+                  ((guint)((data[j] >> 8) & 0xff) << RrDefaultGreenOffset) +
+                  ((guint)((data[j] >> 0) & 0xff) << RrDefaultBlueOffset);
 
       /* add it to the image cache as an original */
       if (!img)
-        img = RrImageNewFromData(ob_rr_icons, &data[i], w, h);
+        img = RrImageNewFromData(ob_rr_icons, data, w, h);
       else
-        RrImageAddFromData(img, &data[i], w, h);
-
-      i += w * h;
+        RrImageAddFromData(img, data, w, h);
     }
-
-    g_free(data);
+    g_free(want);
   }
+  g_array_free(icons, TRUE);
+  g_free(r.data);
 
   /* if we didn't find an image from the NET_WM_ICON stuff, then try the
      legacy X hints */
   if (!img) {
     XWMHints* hints;
 
-    if ((hints = XGetWMHints(obt_display, self->window))) {
+    if ((hints = obt_prop_get_wm_hints(self->window))) {
       if (hints->flags & IconPixmapHint) {
         gboolean xicon;
         obt_display_ignore_errors(TRUE);
@@ -2200,26 +2331,38 @@ void client_update_icons(ObClient* self) {
   if (!self->icon_set && !self->parents) {
     RrPixel32* icon = ob_rr_theme->def_win_icon;
     gulong* ldata; /* use a long here to satisfy OBT_PROP_SETA32 */
+    guint num;
+    gulong left;
+
+    /* grab the server, because we don't want them to set their icon in
+       between checking for it and overwriting it */
+    grab_server(TRUE);
+
+    if (obt_prop_get_range32(self->window, OBT_PROP_ATOM(NET_WM_ICON), OBT_PROP_ATOM(CARDINAL), 0, 2, &data, &num,
+                             &left))
+      /* they did set one after all, and we'll hear about it */
+      g_free(data);
+    else {
+      w = ob_rr_theme->def_win_icon_w;
+      h = ob_rr_theme->def_win_icon_h;
+      ldata = g_new(gulong, w * h + 2);
+      ldata[0] = w;
+      ldata[1] = h;
+      for (i = 0; i < w * h; ++i)
+        ldata[i + 2] = ((guint)((icon[i] >> RrDefaultAlphaOffset) & 0xff) << 24) +
+                       ((guint)((icon[i] >> RrDefaultRedOffset) & 0xff) << 16) +
+                       ((guint)((icon[i] >> RrDefaultGreenOffset) & 0xff) << 8) +
+                       ((guint)((icon[i] >> RrDefaultBlueOffset) & 0xff) << 0);
+      OBT_PROP_SETA32(self->window, NET_WM_ICON, CARDINAL, ldata, w * h + 2);
+      g_free(ldata);
+    }
 
-    w = ob_rr_theme->def_win_icon_w;
-    h = ob_rr_theme->def_win_icon_h;
-    ldata = g_new(gulong, w * h + 2);
-    ldata[0] = w;
-    ldata[1] = h;
-    for (i = 0; i < w * h; ++i)
-      ldata[i + 2] = ((guint)((icon[i] >> RrDefaultAlphaOffset) & 0xff) << 24) +
-                     ((guint)((icon[i] >> RrDefaultRedOffset) & 0xff) << 16) +
-                     ((guint)((icon[i] >> RrDefaultGreenOffset) & 0xff) << 8) +
-                     ((guint)((icon[i] >> RrDefaultBlueOffset) & 0xff) << 0);
-    OBT_PROP_SETA32(self->window, NET_WM_ICON, CARDINAL, ldata, w * h + 2);
-    g_free(ldata);
+    grab_server(FALSE);
   }
   else if (self->frame)
     /* don't draw the icon empty if we're just setting one now anyways,
        we'll get the property change any second */
     frame_adjust_icon(self->frame);
-
-  grab_server(FALSE);
 }
 
 void client_update_icon_geometry(ObClient* self) {
@@ -3299,6 +3442,7 @@ static void client_iconify_recursive(ObClient* self, gboolean iconic, gboolean c
   }
 
   if (changed) {
+    edge_index_update(self);
     client_change_state(self);
     if (config_animate_iconify && !hide_animation)
       frame_begin_iconify_animation(self->frame, iconic);
@@ -3592,6 +3736,7 @@ static void client_set_desktop_recursive(ObClient* self, guint target, gboolean
 
     old = self->desktop;
     self->desktop = target;
+    edge_index_update(self);
     OBT_PROP_SET32(self->window, NET_WM_DESKTOP, CARDINAL, target);
     /* the frame can display the current desktop state */
     frame_adjust_state(self->frame);
@@ -4233,7 +4378,8 @@ void client_find_edge_directional(ObClient* self,
                                   gint my_edge_size,
                                   gint* dest,
                                   gboolean* near_edge) {
-  GList* it;
+  GPtrArray* found;
+  ObOrientation axis;
   Rect* a;
   Rect dock_area;
   gint edge;
@@ -4268,22 +4414,29 @@ void client_find_edge_directional(ObClient* self,
     g_slice_free(Rect, area);
   }
 
-  /* search for edges of clients */
-  for (it = client_list; it; it = g_list_next(it)) {
-    ObClient* cur = it->data;
+  /* search for edges of the clients that we'd collide with, on our
+     desktop, all desktops or the one being shown. iconic windows aren't in
+     the index */
+  axis = (dir == OB_DIRECTION_NORTH || dir == OB_DIRECTION_SOUTH) ? OB_ORIENTATION_HORZ : OB_ORIENTATION_VERT;
+  found = g_ptr_array_new();
+  edge_index_find(self->desktop, axis, my_edge_start, my_edge_start + my_edge_size - 1, found);
+  if (self->desktop != DESKTOP_ALL)
+    edge_index_find(DESKTOP_ALL, axis, my_edge_start, my_edge_start + my_edge_size - 1, found);
+  if (self->desktop != screen_desktop)
+    edge_index_find(screen_desktop, axis, my_edge_start, my_edge_start + my_edge_size - 1, found);
+
+  for (i = 0; i < found->len; ++i) {
+    ObClient* cur = found->pdata[i];
 
     /* skip windows to not bump into */
     if (cur == self)
       continue;
-    if (cur->iconic)
-      continue;
-    if (self->desktop != cur->desktop && cur->desktop != DESKTOP_ALL && cur->desktop != screen_desktop)
-      continue;
 
     ob_debug("trying window %s", cur->title);
 
     detect_edge(cur->frame->area, dir, my_head, my_size, my_edge_start, my_edge_size, dest, near_edge);
   }
+  g_ptr_array_free(found, TRUE);
   dock_get_area(&dock_area);
   detect_edge(dock_area, dir, my_head, my_size, my_edge_start, my_edge_size, dest, near_edge);
 
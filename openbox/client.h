@@ -334,6 +334,10 @@ void client_remove_destroy_notify_data(ObClientCallback func, gpointer data);
                 possible to manage Openbox-owned windows through this.
 */
 void client_manage(Window win, struct _ObPrompt* prompt);
+/*! Reads the properties that client_manage looks at off all of the windows
+  at once.  Only useful while the server is grabbed, and they are kept until
+  the window is managed or obt_prop_prefetch_forget is called. */
+void client_prefetch(const Window* wins, guint nwins);
 /*! Unmanages all managed windows */
 void client_unmanage_all(void);
 /*! Unmanages a given client */
@@ -18,6 +18,7 @@
 */
 
 #include "config.h"
+#include "apprules.h"
 #include "keyboard.h"
 #include "mouse.h"
 #include "actions.h"
@@ -48,6 +49,9 @@ StrutPartial config_margins;
 gchar* config_theme;
 gboolean config_theme_keepborder;
 guint config_theme_window_list_icon_size;
+guint config_theme_surface_cache_size;
+RrScaleFilter config_theme_icon_scaling;
+gchar* config_theme_icon_theme;
 
 gchar* config_title_layout;
 
@@ -98,6 +102,8 @@ guint config_submenu_show_delay;
 guint config_submenu_hide_delay;
 gboolean config_menu_manage_desktops;
 gboolean config_menu_show_icons;
+guint config_menu_pipe_timeout;
+guint config_menu_pipe_cache_time;
 
 GSList* config_menu_files;
 
@@ -105,6 +111,7 @@ gint config_resist_win;
 gint config_resist_edge;
 
 GSList* config_per_app_settings;
+ObAppRules* config_per_app_rules;
 
 ObAppSettings* config_create_app_settings(void) {
   ObAppSettings* settings = g_slice_new0(ObAppSettings);
@@ -408,16 +415,18 @@ static void parse_per_app_settings(xmlNodePtr node, gpointer d) {
     if (type_set)
       settings->type = type;
 
-    g_free(name);
-    g_free(class);
     g_free(group_name);
     g_free(group_class);
-    g_free(role);
     g_free(title);
     g_free(type_str);
 
     parse_single_per_app_settings(app, settings);
     config_per_app_settings = g_slist_append(config_per_app_settings, (gpointer)settings);
+    app_rules_add(config_per_app_rules, settings, name, class, role);
+
+    g_free(name);
+    g_free(class);
+    g_free(role);
   }
 }
 
@@ -689,6 +698,18 @@ static void parse_theme(xmlNodePtr node, gpointer d) {
     else if (config_theme_window_list_icon_size > 96)
       config_theme_window_list_icon_size = 96;
   }
+  if ((n = obt_xml_find_node(node, "surfaceCacheSize")))
+    config_theme_surface_cache_size = MAX(obt_xml_node_int(n), 0);
+  if ((n = obt_xml_find_node(node, "iconScaling"))) {
+    if (obt_xml_node_contains(n, "lanczos"))
+      config_theme_icon_scaling = RR_SCALE_LANCZOS;
+    else
+      config_theme_icon_scaling = RR_SCALE_BOX;
+  }
+  if ((n = obt_xml_find_node(node, "iconTheme"))) {
+    g_free(config_theme_icon_theme);
+    config_theme_icon_theme = obt_xml_node_string(n);
+  }
 
   for (n = obt_xml_find_node(node, "font"); n; n = obt_xml_find_node(n->next, "font")) {
     xmlNodePtr fnode;
@@ -898,6 +919,10 @@ static void parse_menu(xmlNodePtr node, gpointer d) {
     config_submenu_hide_delay = obt_xml_node_int(n);
   if ((n = obt_xml_find_node(node, "manageDesktops")))
     config_menu_manage_desktops = obt_xml_node_bool(n);
+  if ((n = obt_xml_find_node(node, "pipeTimeout")))
+    config_menu_pipe_timeout = MAX(obt_xml_node_int(n), 0);
+  if ((n = obt_xml_find_node(node, "pipeCacheTime")))
+    config_menu_pipe_cache_time = MAX(obt_xml_node_int(n), 0);
   if ((n = obt_xml_find_node(node, "showIcons"))) {
     config_menu_show_icons = obt_xml_node_bool(n);
 #if !defined(USE_IMLIB2) && !defined(USE_LIBRSVG)
@@ -1041,6 +1066,9 @@ void config_startup(ObtXmlInst* i) {
   config_title_layout = g_strdup("NLIMC");
   config_theme_keepborder = TRUE;
   config_theme_window_list_icon_size = 36;
+  config_theme_surface_cache_size = 4096;
+  config_theme_icon_scaling = RR_SCALE_BOX;
+  config_theme_icon_theme = g_strdup("hicolor");
 
   config_font_activewindow = NULL;
   config_font_inactivewindow = NULL;
@@ -1109,10 +1137,13 @@ void config_startup(ObtXmlInst* i) {
   config_menu_manage_desktops = TRUE;
   config_menu_files = NULL;
   config_menu_show_icons = TRUE;
+  config_menu_pipe_timeout = 10000;
+  config_menu_pipe_cache_time = 0;
 
   obt_xml_register(i, "menu", parse_menu, NULL);
 
   config_per_app_settings = NULL;
+  config_per_app_rules = app_rules_new();
 
   obt_xml_register(i, "applications", parse_per_app_settings, NULL);
 }
@@ -1121,6 +1152,7 @@ void config_shutdown(void) {
   GSList* it;
 
   g_free(config_theme);
+  g_free(config_theme_icon_theme);
 
   g_free(config_title_layout);
 
@@ -1139,6 +1171,8 @@ void config_shutdown(void) {
     g_free(it->data);
   g_slist_free(config_menu_files);
 
+  app_rules_free(config_per_app_rules);
+  config_per_app_rules = NULL;
   for (it = config_per_app_settings; it; it = g_slist_next(it)) {
     ObAppSettings* itd = (ObAppSettings*)it->data;
     if (itd->name)
@@ -151,6 +151,12 @@ extern gchar* config_title_layout;
 extern gboolean config_animate_iconify;
 /*! Size of icons in focus switching dialogs */
 extern guint config_theme_window_list_icon_size;
+/*! Kilobytes of rendered decorations to keep for reuse */
+extern guint config_theme_surface_cache_size;
+/*! How icons are scaled when they don't come in the size needed */
+extern RrScaleFilter config_theme_icon_scaling;
+/*! The freedesktop icon theme that named menu icons are found in */
+extern gchar* config_theme_icon_theme;
 
 /*! The font for the active window's title */
 extern RrFont* config_font_activewindow;
@@ -210,10 +216,18 @@ extern guint config_submenu_hide_delay;
 extern gboolean config_menu_manage_desktops;
 /*! Load & show icons in user-defined menus */
 extern gboolean config_menu_show_icons;
+/*! How long a pipe-menu's command can run for in milliseconds, 0 for no
+  limit */
+extern guint config_menu_pipe_timeout;
+/*! How long to reuse a pipe-menu's output for in milliseconds, 0 to run the
+  command each time the menu is shown */
+extern guint config_menu_pipe_cache_time;
 /*! User-specified menu files */
 extern GSList* config_menu_files;
 /*! Per app settings */
 extern GSList* config_per_app_settings;
+/*! The per app settings, indexed for matching against windows */
+extern struct _ObAppRules* config_per_app_rules;
 
 void config_startup(ObtXmlInst* i);
 void config_shutdown(void);
@@ -0,0 +1,254 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   edgeindex.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "edgeindex.h"
+#include "client.h"
+#include "frame.h"
+
+typedef struct _ObEdgeNode ObEdgeNode;
+typedef struct _ObEdgeTrees ObEdgeTrees;
+typedef struct _ObEdgeEntry ObEdgeEntry;
+
+/* a node in a treap of intervals, ordered by their start, and knowing the
+   furthest end in its subtree so that searches can skip whole subtrees */
+struct _ObEdgeNode {
+  gint lo, hi;
+  gint max;
+  guint prio;
+  ObClient* client;
+
+  ObEdgeNode* left;
+  ObEdgeNode* right;
+};
+
+/* the frames on one desktop */
+struct _ObEdgeTrees {
+  ObEdgeNode* horz;
+  ObEdgeNode* vert;
+};
+
+/* where a client was put in the index */
+struct _ObEdgeEntry {
+  guint desktop;
+  Rect area;
+};
+
+/* ObEdgeTrees by desktop, and ObEdgeEntrys by client */
+static GHashTable* desktops = NULL;
+static GHashTable* entries = NULL;
+
+static gint node_cmp(gint lo, ObClient* c, const ObEdgeNode* n) {
+  if (lo != n->lo)
+    return lo < n->lo ? -1 : 1;
+  if (c != n->client)
+    return c < n->client ? -1 : 1;
+  return 0;
+}
+
+static void node_fix(ObEdgeNode* n) {
+  n->max = n->hi;
+  if (n->left && n->left->max > n->max)
+    n->max = n->left->max;
+  if (n->right && n->right->max > n->max)
+    n->max = n->right->max;
+}
+
+static ObEdgeNode* rotate_right(ObEdgeNode* n) {
+  ObEdgeNode* l = n->left;
+
+  n->left = l->right;
+  l->right = n;
+  node_fix(n);
+  node_fix(l);
+  return l;
+}
+
+static ObEdgeNode* rotate_left(ObEdgeNode* n) {
+  ObEdgeNode* r = n->right;
+
+  n->right = r->left;
+  r->left = n;
+  node_fix(n);
+  node_fix(r);
+  return r;
+}
+
+static ObEdgeNode* tree_insert(ObEdgeNode* n, ObEdgeNode* add) {
+  if (!n)
+    return add;
+
+  if (node_cmp(add->lo, add->client, n) < 0) {
+    n->left = tree_insert(n->left, add);
+    if (n->left->prio > n->prio)
+      return rotate_right(n);
+  }
+  else {
+    n->right = tree_insert(n->right, add);
+    if (n->right->prio > n->prio)
+      return rotate_left(n);
+  }
+  node_fix(n);
+  return n;
+}
+
+static ObEdgeNode* tree_remove(ObEdgeNode* n, gint lo, ObClient* c) {
+  gint cmp;
+
+  if (!n)
+    return NULL;
+
+  cmp = node_cmp(lo, c, n);
+  if (cmp < 0)
+    n->left = tree_remove(n->left, lo, c);
+  else if (cmp > 0)
+    n->right = tree_remove(n->right, lo, c);
+  else if (!n->left || !n->right) {
+    ObEdgeNode* child = n->left ? n->left : n->right;
+
+    g_slice_free(ObEdgeNode, n);
+    return child;
+  }
+  else if (n->left->prio > n->right->prio) {
+    /* rotate it down until it has only one child */
+    n = rotate_right(n);
+    n->right = tree_remove(n->right, lo, c);
+  }
+  else {
+    n = rotate_left(n);
+    n->left = tree_remove(n->left, lo, c);
+  }
+  node_fix(n);
+  return n;
+}
+
+static void tree_find(const ObEdgeNode* n, gint lo, gint hi, GPtrArray* found) {
+  while (n && n->max >= lo) {
+    tree_find(n->left, lo, hi, found);
+    /* everything after this starts past the range */
+    if (n->lo > hi)
+      return;
+    if (n->hi >= lo)
+      g_ptr_array_add(found, n->client);
+    n = n->right;
+  }
+}
+
+static void tree_free(ObEdgeNode* n) {
+  while (n) {
+    ObEdgeNode* r = n->right;
+
+    tree_free(n->left);
+    g_slice_free(ObEdgeNode, n);
+    n = r;
+  }
+}
+
+static void trees_free(gpointer p) {
+  ObEdgeTrees* t = p;
+
+  tree_free(t->horz);
+  tree_free(t->vert);
+  g_slice_free(ObEdgeTrees, t);
+}
+
+static void entry_free(gpointer p) {
+  g_slice_free(ObEdgeEntry, p);
+}
+
+static ObEdgeNode* node_new(gint lo, gint hi, ObClient* c) {
+  ObEdgeNode* n = g_slice_new0(ObEdgeNode);
+
+  n->lo = lo;
+  n->hi = hi;
+  n->max = hi;
+  n->prio = g_random_int();
+  n->client = c;
+  return n;
+}
+
+void edge_index_startup(gboolean reconfig) {
+  if (reconfig)
+    return;
+
+  desktops = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, trees_free);
+  entries = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, entry_free);
+}
+
+void edge_index_shutdown(gboolean reconfig) {
+  if (reconfig)
+    return;
+
+  g_hash_table_destroy(entries);
+  entries = NULL;
+  g_hash_table_destroy(desktops);
+  desktops = NULL;
+}
+
+void edge_index_remove(ObClient* c) {
+  ObEdgeEntry* e;
+  ObEdgeTrees* t;
+
+  if (!entries || !(e = g_hash_table_lookup(entries, c)))
+    return;
+
+  t = g_hash_table_lookup(desktops, GUINT_TO_POINTER(e->desktop));
+  t->horz = tree_remove(t->horz, RECT_LEFT(e->area), c);
+  t->vert = tree_remove(t->vert, RECT_TOP(e->area), c);
+  g_hash_table_remove(entries, c);
+}
+
+void edge_index_update(ObClient* c) {
+  ObEdgeEntry* e;
+  ObEdgeTrees* t;
+
+  if (!entries)
+    return;
+
+  if (!c->managed || c->iconic || !c->frame) {
+    edge_index_remove(c);
+    return;
+  }
+
+  if ((e = g_hash_table_lookup(entries, c))) {
+    /* nothing changed */
+    if (e->desktop == c->desktop && RECT_EQUAL(e->area, c->frame->area))
+      return;
+    edge_index_remove(c);
+  }
+
+  if (!(t = g_hash_table_lookup(desktops, GUINT_TO_POINTER(c->desktop)))) {
+    t = g_slice_new0(ObEdgeTrees);
+    g_hash_table_insert(desktops, GUINT_TO_POINTER(c->desktop), t);
+  }
+
+  e = g_slice_new(ObEdgeEntry);
+  e->desktop = c->desktop;
+  e->area = c->frame->area;
+  g_hash_table_insert(entries, c, e);
+
+  t->horz = tree_insert(t->horz, node_new(RECT_LEFT(e->area), RECT_RIGHT(e->area), c));
+  t->vert = tree_insert(t->vert, node_new(RECT_TOP(e->area), RECT_BOTTOM(e->area), c));
+}
+
+void edge_index_find(guint desktop, ObOrientation axis, gint lo, gint hi, GPtrArray* found) {
+  ObEdgeTrees* t;
+
+  if (!desktops || !(t = g_hash_table_lookup(desktops, GUINT_TO_POINTER(desktop))))
+    return;
+
+  tree_find(axis == OB_ORIENTATION_HORZ ? t->horz : t->vert, lo, hi, found);
+}
@@ -0,0 +1,49 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   edgeindex.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef ob__edgeindex_h
+#define ob__edgeindex_h
+
+#include "misc.h"
+
+#include <glib.h>
+
+struct _ObClient;
+
+/*! An index of where the frames of the clients on each desktop are, so that
+  edge resistance and moving or growing to an edge only have to look at the
+  windows that line up with them.  For each desktop it keeps an interval
+  tree of the frames' horizontal extents and one of their vertical extents.
+  Iconified clients are left out. */
+
+void edge_index_startup(gboolean reconfig);
+void edge_index_shutdown(gboolean reconfig);
+
+/*! Updates the client's place in the index.  Call this when its frame moves
+  or changes size, or it changes desktop or is iconified or restored. */
+void edge_index_update(struct _ObClient* c);
+/*! Takes the client out of the index */
+void edge_index_remove(struct _ObClient* c);
+
+/*! Finds the clients on the desktop whose frames overlap the range from @lo
+  to @hi, inclusive, and adds them to @found.
+  @axis OB_ORIENTATION_HORZ to look at the frames' left and right edges, or
+        OB_ORIENTATION_VERT for their top and bottom edges.
+*/
+void edge_index_find(guint desktop, ObOrientation axis, gint lo, gint hi, GPtrArray* found);
+
+#endif
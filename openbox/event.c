@@ -39,6 +39,7 @@
 #include "group.h"
 #include "stacking.h"
 #include "ping.h"
+#include "eventstats.h"
 #include "obt/display.h"
 #include "obt/xqueue.h"
 #include "obt/prop.h"
@@ -86,9 +87,8 @@ static void event_handle_dock(ObDock* s, XEvent* e);
 static void event_handle_dockapp(ObDockApp* app, XEvent* e);
 static void event_handle_client(ObClient* c, XEvent* e);
 static gboolean event_handle_user_input(ObClient* client, XEvent* e);
-static void event_coalesce(XEvent* e);
-static void event_coalesce_configurenotify(XEvent* e);
-static void event_coalesce_expose(XEvent* e);
+static void compress_startup(void);
+static void compress_shutdown(void);
 static gboolean is_enter_focus_event_ignored(gulong serial);
 static void event_ignore_enter_range(gulong start, gulong end);
 static void lookup_window_cached(Window win, ObWindow** out_obwin, ObDockApp** out_dockapp);
@@ -154,6 +154,7 @@ void event_startup(gboolean reconfig) {
     return;
 
   xqueue_add_callback(event_process, NULL);
+  compress_startup();
 
 #ifdef USE_SM
   IceAddConnectionWatch(ice_watch, NULL);
@@ -171,6 +172,7 @@ void event_shutdown(gboolean reconfig) {
 #endif
 
   client_remove_destroy_notify(focus_delay_client_dest);
+  compress_shutdown();
 }
 
 static Window event_get_window(XEvent* e) {
@@ -290,86 +292,73 @@ static void event_hack_mods(XEvent* e) {
       break;
     case MotionNotify:
       e->xmotion.state = obt_keyboard_only_modmasks(e->xmotion.state);
-      /* compress events */
-      {
-        XEvent ce;
-        ObtXQueueWindowType wt;
-
-        wt.window = e->xmotion.window;
-        wt.type = MotionNotify;
-        while (xqueue_remove_local(&ce, xqueue_match_window_type, &wt)) {
-          e->xmotion.x = ce.xmotion.x;
-          e->xmotion.y = ce.xmotion.y;
-          e->xmotion.x_root = ce.xmotion.x_root;
-          e->xmotion.y_root = ce.xmotion.y_root;
-        }
-      }
       break;
   }
 }
 
-static void event_coalesce(XEvent* e) {
-  if (G_UNLIKELY(e == NULL))
-    return;
+/* the rules for compressing events as they are read from the server */
+static ObtXQueueRule* compress_rules[6];
 
-  switch (e->type) {
-    case ConfigureNotify:
-      event_coalesce_configurenotify(e);
-      break;
-    case Expose:
-      event_coalesce_expose(e);
-      break;
-  }
+static gboolean key_property(const XEvent* e, ObtXQueueKey* key) {
+  const Atom a = e->xproperty.atom;
+
+  key->window = e->xproperty.window;
+  /* these are all updated together */
+  if (a == OBT_PROP_ATOM(WM_NAME) || a == OBT_PROP_ATOM(NET_WM_ICON_NAME) || a == OBT_PROP_ATOM(WM_ICON_NAME))
+    key->detail = OBT_PROP_ATOM(NET_WM_NAME);
+  else
+    key->detail = a;
+  return TRUE;
 }
 
-static void event_coalesce_configurenotify(XEvent* e) {
-  ObtXQueueWindowType match;
-  XEvent next;
+/* only the last of these messages for a window matters, when nothing else
+   about the window came between them */
+static gboolean key_message(const XEvent* e, ObtXQueueKey* key) {
+  const Atom msgtype = e->xclient.message_type;
 
-  match.window = e->xconfigure.window;
-  match.type = ConfigureNotify;
+  if (e->xclient.format != 32 || (msgtype != OBT_PROP_ATOM(WM_CHANGE_STATE) && msgtype != OBT_PROP_ATOM(NET_WM_DESKTOP)))
+    return FALSE;
+  key->window = e->xclient.window;
+  key->detail = msgtype;
+  return TRUE;
+}
 
-  while (xqueue_remove_local(&next, xqueue_match_window_type, &match))
-    *e = next;
+/* requests to add or remove the same states on a window replace each other,
+   when nothing else about the window came between them */
+static gboolean key_net_wm_state(const XEvent* e, ObtXQueueKey* key) {
+  if (e->xclient.format != 32 || e->xclient.message_type != OBT_PROP_ATOM(NET_WM_STATE))
+    return FALSE;
+  key->window = e->xclient.window;
+  return TRUE;
 }
 
-static void event_coalesce_expose(XEvent* e) {
-  ObtXQueueWindowType match;
-  XEvent next;
-  gint x1, y1, x2, y2;
-  gint last_count;
-  gboolean merged = FALSE;
-
-  match.window = e->xexpose.window;
-  match.type = Expose;
-
-  x1 = e->xexpose.x;
-  y1 = e->xexpose.y;
-  x2 = e->xexpose.x + e->xexpose.width;
-  y2 = e->xexpose.y + e->xexpose.height;
-  last_count = e->xexpose.count;
-
-  while (xqueue_remove_local(&next, xqueue_match_window_type, &match)) {
-    gint nx1 = next.xexpose.x;
-    gint ny1 = next.xexpose.y;
-    gint nx2 = next.xexpose.x + next.xexpose.width;
-    gint ny2 = next.xexpose.y + next.xexpose.height;
-
-    x1 = MIN(x1, nx1);
-    y1 = MIN(y1, ny1);
-    x2 = MAX(x2, nx2);
-    y2 = MAX(y2, ny2);
-    last_count = next.xexpose.count;
-    merged = TRUE;
-  }
+static void compress_startup(void) {
+  guint i = 0;
+
+  compress_rules[i++] = xqueue_add_rule("ConfigureNotify", ConfigureNotify, xqueue_key_window, xqueue_merge_latest);
+  compress_rules[i++] = xqueue_add_rule("Expose", Expose, xqueue_key_window, xqueue_merge_expose);
+  compress_rules[i++] = xqueue_add_rule("MotionNotify", MotionNotify, xqueue_key_window, xqueue_merge_motion);
+  compress_rules[i++] = xqueue_add_rule("PropertyNotify", PropertyNotify, key_property, xqueue_merge_latest);
+  /* requests from clients are handled in the order they were made */
+  compress_rules[i] = xqueue_add_rule("ClientMessage", ClientMessage, key_message, xqueue_merge_latest);
+  xqueue_rule_keep_order(compress_rules[i++]);
+  compress_rules[i] = xqueue_add_rule("_NET_WM_STATE", ClientMessage, key_net_wm_state, xqueue_merge_net_wm_state);
+  xqueue_rule_keep_order(compress_rules[i++]);
+  g_assert(i == G_N_ELEMENTS(compress_rules));
+}
+
+static void compress_report(const gchar* name, gulong dropped, gpointer data) {
+  ob_debug("Compressed %lu %s events", dropped, name);
+}
+
+static void compress_shutdown(void) {
+  guint i;
 
-  if (merged) {
-    e->xexpose.x = x1;
-    e->xexpose.y = y1;
-    e->xexpose.width = MAX(1, x2 - x1);
-    e->xexpose.height = MAX(1, y2 - y1);
+  xqueue_foreach_rule(compress_report, NULL);
+  for (i = 0; i < G_N_ELEMENTS(compress_rules); ++i) {
+    xqueue_remove_rule(compress_rules[i]);
+    compress_rules[i] = NULL;
   }
-  e->xexpose.count = last_count;
 }
 
 static gboolean wanted_focusevent(XEvent* e, gboolean in_client_only) {
@@ -527,9 +516,39 @@ static void print_focusevent(XEvent* e) {
                 modestr, detailstr);
 }
 
+/* what an event is counted as being handled by in the stats */
+static ObEventHandler event_handler_of(XEvent* e,
+                                       Window window,
+                                       ObClient* client,
+                                       ObDockApp* dockapp,
+                                       ObDock* dock,
+                                       ObMenuFrame* menu) {
+  switch (e->type) {
+    case FocusIn:
+    case FocusOut:
+      return OB_EVENT_HANDLER_FOCUS;
+    case ButtonPress:
+    case ButtonRelease:
+    case KeyPress:
+    case KeyRelease:
+    case MotionNotify:
+      return OB_EVENT_HANDLER_INPUT;
+  }
+  if (client)
+    return OB_EVENT_HANDLER_CLIENT;
+  if (dockapp)
+    return OB_EVENT_HANDLER_DOCKAPP;
+  if (dock)
+    return OB_EVENT_HANDLER_DOCK;
+  if (menu)
+    return OB_EVENT_HANDLER_MENU;
+  if (window == obt_root(ob_screen))
+    return OB_EVENT_HANDLER_ROOT;
+  return OB_EVENT_HANDLER_OTHER;
+}
+
 static void event_process(const XEvent* ec, gpointer data) {
   XEvent ee, *e;
-  XEvent* mutable_event = (XEvent*)ec;
   Window window;
   ObClient* client = NULL;
   ObDock* dock = NULL;
@@ -537,12 +556,13 @@ static void event_process(const XEvent* ec, gpointer data) {
   ObWindow* obwin = NULL;
   ObMenuFrame* menu = NULL;
   ObPrompt* prompt = NULL;
+  ObEventHandler handler;
   gboolean used;
 
-  event_coalesce(mutable_event);
+  event_stats_begin(ec);
 
   /* make a copy we can mangle */
-  ee = *mutable_event;
+  ee = *ec;
   e = &ee;
 
   event_set_curtime(e);
@@ -576,6 +596,10 @@ static void event_process(const XEvent* ec, gpointer data) {
     }
   }
 
+  /* worked out now, since handling the event can free the client */
+  handler = event_handler_of(e, window, client, dockapp, dock, menu);
+  event_stats_set_client(client);
+
   event_hack_mods(e);
 
   /* deal with it in the kernel */
@@ -624,7 +648,7 @@ static void event_process(const XEvent* ec, gpointer data) {
          But if the other focus in is something like PointerRoot then we
          still want to fall back.
       */
-      if (xqueue_exists_local(event_look_for_focusin_client, NULL)) {
+      if (xqueue_exists_local_type(FocusIn, event_look_for_focusin_client, NULL)) {
         ob_debug_type(OB_DEBUG_FOCUS, "  but another FocusIn is coming");
       }
       else {
@@ -662,7 +686,7 @@ static void event_process(const XEvent* ec, gpointer data) {
     if (!wanted_focusevent(e, FALSE))
       ; /* skip this one */
     /* Look for the followup FocusIn */
-    else if (!xqueue_exists_local(event_look_for_focusin, NULL)) {
+    else if (!xqueue_exists_local_type(FocusIn, event_look_for_focusin, NULL)) {
       /* There is no FocusIn, this means focus went to a window that
          is not being managed, or a window on another screen. */
       Window win, root;
@@ -799,6 +823,8 @@ static void event_process(const XEvent* ec, gpointer data) {
   /* show any debug prompts that are queued */
   ob_debug_show_prompts();
 
+  event_stats_end(handler);
+
   /* if something happens and it's not from an XEvent, then we don't know
      the time, so clear it here until the next event is handled */
   event_curtime = event_sourcetime = CurrentTime;
@@ -856,6 +882,8 @@ static void event_handle_root(XEvent* e) {
           ob_restart();
         else if (e->xclient.data.l[0] == 3)
           ob_exit(0);
+        else if (e->xclient.data.l[0] == 4)
+          event_stats_save();
       }
       else if (msgtype == OBT_PROP_ATOM(WM_PROTOCOLS)) {
         if ((Atom)e->xclient.data.l[0] == OBT_PROP_ATOM(NET_WM_PING))
@@ -994,38 +1022,6 @@ static gboolean* context_to_button(ObFrame* f, ObFrameContext con, gboolean pres
   }
 }
 
-static gboolean more_client_message_event(Window window, Atom msgtype) {
-  ObtXQueueWindowMessage wm;
-  wm.window = window;
-  wm.message = msgtype;
-  return xqueue_exists_local(xqueue_match_window_message, &wm);
-}
-
-struct ObSkipPropertyChange {
-  Window window;
-  Atom prop;
-};
-
-static gboolean skip_property_change(XEvent* e, gpointer data) {
-  const struct ObSkipPropertyChange s = *(struct ObSkipPropertyChange*)data;
-
-  if (e->type == PropertyNotify && e->xproperty.window == s.window) {
-    const Atom a = e->xproperty.atom;
-    const Atom b = s.prop;
-
-    /* these are all updated together */
-    if ((a == OBT_PROP_ATOM(NET_WM_NAME) || a == OBT_PROP_ATOM(WM_NAME) || a == OBT_PROP_ATOM(NET_WM_ICON_NAME) ||
-         a == OBT_PROP_ATOM(WM_ICON_NAME)) &&
-        (b == OBT_PROP_ATOM(NET_WM_NAME) || b == OBT_PROP_ATOM(WM_NAME) || b == OBT_PROP_ATOM(NET_WM_ICON_NAME) ||
-         b == OBT_PROP_ATOM(WM_ICON_NAME))) {
-      return TRUE;
-    }
-    else if (a == b && a == OBT_PROP_ATOM(NET_WM_ICON))
-      return TRUE;
-  }
-  return FALSE;
-}
-
 static void event_handle_client(ObClient* client, XEvent* e) {
   Atom msgtype;
   ObFrameContext con;
@@ -1417,19 +1413,16 @@ static void event_handle_client(ObClient* client, XEvent* e) {
 
       msgtype = e->xclient.message_type;
       if (msgtype == OBT_PROP_ATOM(WM_CHANGE_STATE)) {
-        if (!more_client_message_event(client->window, msgtype))
-          client_set_wm_state(client, e->xclient.data.l[0]);
+        client_set_wm_state(client, e->xclient.data.l[0]);
       }
       else if (msgtype == OBT_PROP_ATOM(NET_WM_DESKTOP)) {
-        if (!more_client_message_event(client->window, msgtype) &&
-            ((unsigned)e->xclient.data.l[0] < screen_num_desktops || (unsigned)e->xclient.data.l[0] == DESKTOP_ALL)) {
+        if ((unsigned)e->xclient.data.l[0] < screen_num_desktops || (unsigned)e->xclient.data.l[0] == DESKTOP_ALL) {
           client_set_desktop(client, (unsigned)e->xclient.data.l[0], FALSE, FALSE);
         }
       }
       else if (msgtype == OBT_PROP_ATOM(NET_WM_STATE)) {
         gulong ignore_start;
 
-        /* can't compress these */
         ob_debug("net_wm_state %s %ld %ld for 0x%lx",
                  (e->xclient.data.l[0] == 0   ? "Remove"
                   : e->xclient.data.l[0] == 1 ? "Add"
@@ -1607,18 +1600,6 @@ static void event_handle_client(ObClient* client, XEvent* e) {
       if (!client_validate(client))
         break;
 
-      msgtype = e->xproperty.atom;
-
-      /* ignore changes to some properties if there is another change
-         coming in the queue */
-      {
-        struct ObSkipPropertyChange s;
-        s.window = client->window;
-        s.prop = msgtype;
-        if (xqueue_exists_local(skip_property_change, &s))
-          break;
-      }
-
       msgtype = e->xproperty.atom;
       if (msgtype == XA_WM_NORMAL_HINTS) {
         int x, y, w, h, lw, lh;
@@ -2022,7 +2003,7 @@ static void event_handle_menu(ObMenuFrame* frame, XEvent* ev) {
       if ((e = g_hash_table_lookup(menu_frame_map, &ev->xcrossing.window))) {
         /* check if an EnterNotify event is coming, and if not, then select
            nothing in the menu */
-        if (!xqueue_exists_local(event_look_for_menu_enter, e->frame))
+        if (!xqueue_exists_local_type(EnterNotify, event_look_for_menu_enter, e->frame))
           menu_frame_select(e->frame, NULL, FALSE);
       }
       break;
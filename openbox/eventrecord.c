@@ -0,0 +1,187 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   eventrecord.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "eventrecord.h"
+#include "openbox.h"
+#include "gettext.h"
+#include "obt/display.h"
+#include "obt/prop.h"
+#include "obt/xqueue.h"
+
+#include <X11/Xlib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+const gchar* event_record_path = NULL;
+
+static FILE* record_file = NULL;
+/* the atoms whose names have been written */
+static GHashTable* atoms_written = NULL;
+static gint64 last_time;
+
+static void put_uint(guint64 v) {
+  guchar buf[10];
+  guint n = 0;
+
+  do {
+    buf[n] = v & 0x7f;
+    v >>= 7;
+    if (v)
+      buf[n] |= 0x80;
+    ++n;
+  } while (v);
+  fwrite(buf, 1, n, record_file);
+}
+
+static void put_int(gint64 v) {
+  put_uint(((guint64)v << 1) ^ (guint64)(v >> 63));
+}
+
+static void put_window(Window w) {
+  put_uint(w == obt_root(ob_screen) ? 0 : w);
+}
+
+static void put_atom(Atom a) {
+  if (a != None && !g_hash_table_contains(atoms_written, GUINT_TO_POINTER(a))) {
+    gchar* name;
+
+    obt_display_ignore_errors(TRUE);
+    name = XGetAtomName(obt_display, a);
+    obt_display_ignore_errors(FALSE);
+
+    put_uint(OB_EVENT_RECORD_ATOM);
+    put_uint(a);
+    put_uint(name ? strlen(name) : 0);
+    if (name) {
+      fwrite(name, 1, strlen(name), record_file);
+      XFree(name);
+    }
+    g_hash_table_add(atoms_written, GUINT_TO_POINTER(a));
+  }
+}
+
+static void record(const XEvent* e, gpointer data) {
+  const gint64 now = g_get_monotonic_time();
+  Window window;
+  gint i;
+
+  /* the atom records have to come first */
+  if (e->type == PropertyNotify)
+    put_atom(e->xproperty.atom);
+  else if (e->type == ClientMessage) {
+    put_atom(e->xclient.message_type);
+    if (e->xclient.message_type == OBT_PROP_ATOM(NET_WM_STATE) && e->xclient.format == 32) {
+      put_atom(e->xclient.data.l[1]);
+      put_atom(e->xclient.data.l[2]);
+    }
+  }
+
+  switch (e->type) {
+    case MapNotify:
+      window = e->xmap.window;
+      break;
+    case MapRequest:
+      window = e->xmaprequest.window;
+      break;
+    case UnmapNotify:
+      window = e->xunmap.window;
+      break;
+    case DestroyNotify:
+      window = e->xdestroywindow.window;
+      break;
+    case ConfigureRequest:
+      window = e->xconfigurerequest.window;
+      break;
+    default:
+      window = e->xany.window;
+      break;
+  }
+
+  put_uint(OB_EVENT_RECORD_EVENT);
+  put_uint(e->type);
+  put_uint(now - last_time);
+  put_window(window);
+  last_time = now;
+
+  switch (e->type) {
+    case MapRequest: {
+      XWindowAttributes attrib;
+      gboolean ok;
+
+      /* openbox doesn't get CreateNotify, so ask where the window is */
+      obt_display_ignore_errors(TRUE);
+      ok = XGetWindowAttributes(obt_display, window, &attrib);
+      obt_display_ignore_errors(FALSE);
+      if (!ok)
+        attrib.x = attrib.y = attrib.width = attrib.height = 0;
+      put_int(attrib.x);
+      put_int(attrib.y);
+      put_uint(attrib.width);
+      put_uint(attrib.height);
+      break;
+    }
+    case ConfigureRequest:
+      put_uint(e->xconfigurerequest.value_mask);
+      put_int(e->xconfigurerequest.x);
+      put_int(e->xconfigurerequest.y);
+      put_uint(e->xconfigurerequest.width);
+      put_uint(e->xconfigurerequest.height);
+      put_uint(e->xconfigurerequest.border_width);
+      put_uint(e->xconfigurerequest.detail);
+      break;
+    case PropertyNotify:
+      put_uint(e->xproperty.atom);
+      put_uint(e->xproperty.state);
+      break;
+    case ClientMessage:
+      put_uint(e->xclient.message_type);
+      put_uint(e->xclient.format);
+      if (e->xclient.format == 32)
+        for (i = 0; i < 5; ++i)
+          put_int(e->xclient.data.l[i]);
+      break;
+  }
+}
+
+void event_record_startup(gboolean reconfig) {
+  if (reconfig || !event_record_path)
+    return;
+
+  if (!(record_file = fopen(event_record_path, "wb"))) {
+    g_message(_("Unable to record events to '%s': %s"), event_record_path, g_strerror(errno));
+    return;
+  }
+
+  fwrite(OB_EVENT_RECORD_MAGIC, 1, sizeof(OB_EVENT_RECORD_MAGIC), record_file);
+  put_uint(OB_EVENT_RECORD_VERSION);
+
+  atoms_written = g_hash_table_new(g_direct_hash, g_direct_equal);
+  last_time = g_get_monotonic_time();
+  xqueue_add_callback(record, NULL);
+}
+
+void event_record_shutdown(gboolean reconfig) {
+  if (reconfig || !record_file)
+    return;
+
+  xqueue_remove_callback(record, NULL);
+  g_hash_table_destroy(atoms_written);
+  atoms_written = NULL;
+  fclose(record_file);
+  record_file = NULL;
+}
@@ -0,0 +1,65 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   eventrecord.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef ob__eventrecord_h
+#define ob__eventrecord_h
+
+#include <glib.h>
+
+/*! Writes the X events that openbox handles to a file, given with
+  --record-events, so that what clients did can be played back against it
+  later by tests/eventbench.
+
+  The file starts with OB_EVENT_RECORD_MAGIC and a version number.  Then
+  come records, each starting with its kind.  Numbers are all written as
+  unsigned LEB128 varints, and those that can be negative are zigzag
+  encoded first.
+
+  An OB_EVENT_RECORD_ATOM record comes before the first record that uses an
+  atom, and holds the atom and the length and bytes of its name.  That
+  includes the states given in the data of _NET_WM_STATE messages.
+
+  An OB_EVENT_RECORD_EVENT record holds the event's type, the microseconds
+  since the event before it, and the window it is about, which is 0 for the
+  root window.  After that come some of the event's fields, for the types
+  that a client can cause:
+    MapRequest       x, y (zigzag), width, height of the window, or all 0 if
+                     it was already gone
+    ConfigureRequest value_mask, x, y (zigzag), width, height,
+                     border_width, detail
+    PropertyNotify   atom, state
+    ClientMessage    message_type, format, and if the format is 32 the 5
+                     longs of data (zigzag)
+  For Map, Unmap and DestroyNotify events and MapRequests the window is the
+  one that changed, not the one the event was sent to.
+*/
+
+#define OB_EVENT_RECORD_MAGIC "OBEVREC"
+#define OB_EVENT_RECORD_VERSION 2
+
+typedef enum {
+  OB_EVENT_RECORD_ATOM,
+  OB_EVENT_RECORD_EVENT
+} ObEventRecordKind;
+
+/*! The file to record events in, or NULL to not record them */
+extern const gchar* event_record_path;
+
+void event_record_startup(gboolean reconfig);
+void event_record_shutdown(gboolean reconfig);
+
+#endif
@@ -0,0 +1,476 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   eventstats.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "eventstats.h"
+#include "client.h"
+#include "debug.h"
+#include "gettext.h"
+#include "window.h"
+#include "obt/display.h"
+#include "obt/paths.h"
+#include "obt/xqueue.h"
+
+#include <errno.h>
+#include <string.h>
+
+/* event types fit in 7 bits, the 8th is for events sent with SendEvent */
+#define NUM_TYPES 128
+
+/* Times are counted in buckets like an HDR histogram.  Below 2^SUB_BITS
+   microseconds each bucket holds one value, and above that each power of
+   two is split into 2^SUB_BITS buckets, so a time is always known to within
+   1/8th of itself.  Times of 2^32 microseconds or more go in the last one. */
+#define SUB_BITS 3
+#define SUBS (1 << SUB_BITS)
+#define MAX_BIT 31
+#define NUM_BUCKETS ((MAX_BIT - SUB_BITS + 2) * SUBS)
+
+/* how many clients to save, the ones with the most events, and how many of
+   the clients that are gone to keep */
+#define MAX_CLIENTS 50
+
+typedef struct _ObEventCounts {
+  gulong count;
+  gulong requests; /* requests made to the X server */
+  guint64 total;   /* microseconds */
+  guint64 max;
+  guint32 buckets[NUM_BUCKETS];
+} ObEventCounts;
+
+typedef struct _ObEventClientCounts {
+  Window window;
+  gchar* class; /* only set once the client is gone */
+  gchar* title;
+  gulong count;
+  gulong requests;
+  guint64 total;
+} ObEventClientCounts;
+
+static const gchar* const handler_names[OB_NUM_EVENT_HANDLERS] = {
+    "focus", "client", "dockapp", "dock", "menu", "root", "input", "other",
+};
+
+/* ObEventCounts by event type, made when an event of the type is seen */
+static ObEventCounts* types[NUM_TYPES];
+static ObEventCounts handlers[OB_NUM_EVENT_HANDLERS];
+/* ObEventClientCounts for managed clients by their window, and for the
+   clients that are gone, with the most events */
+static GHashTable* clients = NULL;
+static GSList* gone = NULL;
+static guint n_gone = 0;
+/* the clients that are gone and weren't kept, all together.  they're saved in
+   "other_clients" with the clients that weren't listed */
+static ObEventClientCounts gone_others;
+
+static gint64 started;
+static gint64 event_start;
+static gulong event_request;
+static gint event_type = -1; /* -1 when no event is being timed */
+static guint event_depth = 0; /* events being handled, inside each other */
+/* the counts for the client that the event being timed is for, or NULL */
+static ObEventClientCounts* event_client = NULL;
+
+static guint window_hash(Window* w) {
+  return *w;
+}
+static gboolean window_comp(Window* w1, Window* w2) {
+  return *w1 == *w2;
+}
+
+static void client_counts_free(gpointer p) {
+  ObEventClientCounts* c = p;
+
+  g_free(c->class);
+  g_free(c->title);
+  g_slice_free(ObEventClientCounts, c);
+}
+
+/* folds the client that is gone with the fewest events into gone_others */
+static void drop_gone(void) {
+  GSList *it, *least = NULL;
+  ObEventClientCounts* c;
+
+  for (it = gone; it; it = g_slist_next(it))
+    if (!least || ((ObEventClientCounts*)it->data)->count < ((ObEventClientCounts*)least->data)->count)
+      least = it;
+
+  c = least->data;
+  gone_others.count += c->count;
+  gone_others.requests += c->requests;
+  gone_others.total += c->total;
+  /* the event being handled is still counted */
+  if (event_client == c)
+    event_client = &gone_others;
+
+  gone = g_slist_delete_link(gone, least);
+  --n_gone;
+  client_counts_free(c);
+}
+
+static void client_dest(ObClient* client, gpointer data) {
+  ObEventClientCounts* c;
+
+  /* keep its counts, with its names since it can't be found any more, and
+     its window may be used again for another client */
+  if ((c = g_hash_table_lookup(clients, &client->window))) {
+    g_hash_table_steal(clients, &client->window);
+    c->class = g_strdup(client->class);
+    c->title = g_strdup(client->title);
+    gone = g_slist_prepend(gone, c);
+    if (++n_gone > MAX_CLIENTS)
+      drop_gone();
+  }
+}
+
+void event_stats_startup(gboolean reconfig) {
+  if (reconfig)
+    return;
+
+  clients = g_hash_table_new_full((GHashFunc)window_hash, (GEqualFunc)window_comp, NULL, client_counts_free);
+  started = g_get_monotonic_time();
+  client_add_destroy_notify(client_dest, NULL);
+}
+
+void event_stats_shutdown(gboolean reconfig) {
+  guint i;
+
+  if (reconfig)
+    return;
+
+  client_remove_destroy_notify(client_dest);
+  g_hash_table_destroy(clients);
+  clients = NULL;
+  g_slist_free_full(gone, client_counts_free);
+  gone = NULL;
+  n_gone = 0;
+  memset(&gone_others, 0, sizeof(gone_others));
+  for (i = 0; i < NUM_TYPES; ++i) {
+    g_free(types[i]);
+    types[i] = NULL;
+  }
+  memset(handlers, 0, sizeof(handlers));
+}
+
+static guint bucket_of(guint64 us) {
+  guint bit;
+
+  if (us < SUBS)
+    return us;
+  if (us >> (MAX_BIT + 1))
+    return NUM_BUCKETS - 1;
+  bit = g_bit_storage(us) - 1;
+  return (bit - SUB_BITS + 1) * SUBS + ((us >> (bit - SUB_BITS)) & (SUBS - 1));
+}
+
+/* the smallest time that goes in the bucket */
+static guint64 bucket_low(guint b) {
+  const guint bit = b / SUBS + SUB_BITS - 1;
+
+  if (b < SUBS)
+    return b;
+  return (guint64)(SUBS + b % SUBS) << (bit - SUB_BITS);
+}
+
+/* the largest time that goes in the bucket */
+static guint64 bucket_high(guint b) {
+  return b + 1 < NUM_BUCKETS ? bucket_low(b + 1) - 1 : G_MAXUINT64;
+}
+
+static void counts_add(ObEventCounts* c, guint64 us, gulong requests) {
+  ++c->count;
+  c->requests += requests;
+  c->total += us;
+  c->max = MAX(c->max, us);
+  ++c->buckets[bucket_of(us)];
+}
+
+void event_stats_begin(const XEvent* e) {
+  /* events handled while handling another are counted as part of it */
+  if (event_depth++)
+    return;
+
+  event_type = e->type & (NUM_TYPES - 1);
+  event_request = NextRequest(obt_display);
+  event_start = g_get_monotonic_time();
+}
+
+void event_stats_set_client(ObClient* client) {
+  ObEventClientCounts* c;
+
+  if (event_depth != 1 || !client)
+    return;
+
+  if (!(c = g_hash_table_lookup(clients, &client->window))) {
+    c = g_slice_new0(ObEventClientCounts);
+    c->window = client->window;
+    g_hash_table_insert(clients, &c->window, c);
+  }
+  /* if the client is unmanaged, this is kept in gone or folded into
+     gone_others, so it can still be counted */
+  event_client = c;
+}
+
+void event_stats_end(ObEventHandler handler) {
+  guint64 us;
+  gulong requests;
+
+  if (!event_depth || --event_depth)
+    return;
+
+  us = g_get_monotonic_time() - event_start;
+  requests = NextRequest(obt_display) - event_request;
+
+  if (!types[event_type])
+    types[event_type] = g_new0(ObEventCounts, 1);
+  counts_add(types[event_type], us, requests);
+  counts_add(&handlers[handler], us, requests);
+
+  if (event_client) {
+    ++event_client->count;
+    event_client->requests += requests;
+    event_client->total += us;
+    event_client = NULL;
+  }
+
+  event_type = -1;
+}
+
+static const gchar* type_name(gint type) {
+  static const gchar* const names[] = {
+      NULL,
+      NULL,
+      "KeyPress",
+      "KeyRelease",
+      "ButtonPress",
+      "ButtonRelease",
+      "MotionNotify",
+      "EnterNotify",
+      "LeaveNotify",
+      "FocusIn",
+      "FocusOut",
+      "KeymapNotify",
+      "Expose",
+      "GraphicsExpose",
+      "NoExpose",
+      "VisibilityNotify",
+      "CreateNotify",
+      "DestroyNotify",
+      "UnmapNotify",
+      "MapNotify",
+      "MapRequest",
+      "ReparentNotify",
+      "ConfigureNotify",
+      "ConfigureRequest",
+      "GravityNotify",
+      "ResizeRequest",
+      "CirculateNotify",
+      "CirculateRequest",
+      "PropertyNotify",
+      "SelectionClear",
+      "SelectionRequest",
+      "SelectionNotify",
+      "ColormapNotify",
+      "ClientMessage",
+      "MappingNotify",
+      "GenericEvent",
+  };
+
+  return type < (gint)G_N_ELEMENTS(names) ? names[type] : NULL;
+}
+
+static void json_string(GString* s, const gchar* str) {
+  g_string_append_c(s, '"');
+  for (; str && *str; ++str) {
+    const guchar c = *str;
+
+    if (c == '"' || c == '\\')
+      g_string_append_printf(s, "\\%c", c);
+    else if (c < 0x20)
+      g_string_append_printf(s, "\\u%04x", c);
+    else
+      g_string_append_c(s, c);
+  }
+  g_string_append_c(s, '"');
+}
+
+/* the time that a fraction of the events took at most */
+static guint64 percentile(const ObEventCounts* c, gdouble fraction) {
+  const guint64 want = MAX(1, (guint64)(c->count * fraction + 0.5));
+  guint64 seen = 0;
+  guint b;
+
+  for (b = 0; b < NUM_BUCKETS; ++b) {
+    seen += c->buckets[b];
+    if (seen >= want)
+      return MIN(bucket_high(b), c->max);
+  }
+  return c->max;
+}
+
+static void json_counts(GString* s, const ObEventCounts* c) {
+  gboolean first = TRUE;
+  guint b;
+
+  g_string_append_printf(s,
+                         "\"count\": %lu, \"requests\": %lu, \"total_us\": %" G_GUINT64_FORMAT
+                         ", \"max_us\": %" G_GUINT64_FORMAT ", \"p50_us\": %" G_GUINT64_FORMAT
+                         ", \"p90_us\": %" G_GUINT64_FORMAT ", \"p99_us\": %" G_GUINT64_FORMAT ", \"histogram\": [",
+                         c->count, c->requests, c->total, c->max, percentile(c, 0.5), percentile(c, 0.9),
+                         percentile(c, 0.99));
+  /* [lowest time in the bucket, count] for each bucket that isn't empty */
+  for (b = 0; b < NUM_BUCKETS; ++b) {
+    if (!c->buckets[b])
+      continue;
+    g_string_append_printf(s, "%s[%" G_GUINT64_FORMAT ", %u]", first ? "" : ", ", bucket_low(b), c->buckets[b]);
+    first = FALSE;
+  }
+  g_string_append_c(s, ']');
+}
+
+static void json_rule(const gchar* name, gulong dropped, gpointer data) {
+  GString* s = data;
+
+  if (s->str[s->len - 1] != '{')
+    g_string_append(s, ", ");
+  json_string(s, name);
+  g_string_append_printf(s, ": %lu", dropped);
+}
+
+static gint client_counts_cmp(gconstpointer a, gconstpointer b) {
+  const ObEventClientCounts *ca = a, *cb = b;
+
+  if (ca->count != cb->count)
+    return ca->count > cb->count ? -1 : 1;
+  return 0;
+}
+
+static void json_clients(GString* s) {
+  GSList *all, *it;
+  GHashTableIter iter;
+  gpointer value;
+  guint n = 0;
+  ObEventClientCounts others = gone_others;
+
+  all = g_slist_copy(gone);
+  g_hash_table_iter_init(&iter, clients);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    all = g_slist_prepend(all, value);
+  all = g_slist_sort(all, client_counts_cmp);
+
+  g_string_append(s, "  \"clients\": [");
+  for (it = all; it && n < MAX_CLIENTS; it = g_slist_next(it), ++n) {
+    const ObEventClientCounts* c = it->data;
+    const ObClient* client = NULL;
+    ObWindow* w;
+
+    /* managed clients are looked up for their current names */
+    if (!c->class && (w = window_find(c->window)) && WINDOW_IS_CLIENT(w))
+      client = WINDOW_AS_CLIENT(w);
+
+    g_string_append_printf(s, "%s\n    {\"window\": \"0x%lx\", \"managed\": %s, \"class\": ", n ? "," : "", c->window,
+                           client ? "true" : "false");
+    json_string(s, client ? client->class : c->class);
+    g_string_append(s, ", \"title\": ");
+    json_string(s, client ? client->title : c->title);
+    g_string_append_printf(s, ", \"count\": %lu, \"requests\": %lu, \"total_us\": %" G_GUINT64_FORMAT "}", c->count,
+                           c->requests, c->total);
+  }
+  g_string_append(s, n ? "\n  ],\n" : "],\n");
+
+  /* the clients that weren't listed, so the totals still add up */
+  for (; it; it = g_slist_next(it)) {
+    const ObEventClientCounts* c = it->data;
+
+    others.count += c->count;
+    others.requests += c->requests;
+    others.total += c->total;
+  }
+  g_slist_free(all);
+
+  g_string_append_printf(s,
+                         "  \"other_clients\": {\"count\": %lu, \"requests\": %lu, \"total_us\": %" G_GUINT64_FORMAT
+                         "}\n",
+                         others.count, others.requests, others.total);
+}
+
+static gchar* stats_json(void) {
+  GString* s = g_string_new("{\n");
+  gboolean first = TRUE;
+  gint i;
+
+  g_string_append_printf(s, "  \"uptime_s\": %" G_GINT64_FORMAT ",\n",
+                         (g_get_monotonic_time() - started) / G_USEC_PER_SEC);
+  g_string_append_printf(s, "  \"queue\": {\"length\": %lu, \"peak\": %lu},\n", xqueue_length(),
+                         xqueue_peak_length());
+
+  g_string_append(s, "  \"compressed\": {");
+  xqueue_foreach_rule(json_rule, s);
+  g_string_append(s, "},\n");
+
+  g_string_append(s, "  \"types\": [");
+  for (i = 0; i < NUM_TYPES; ++i) {
+    const gchar* name;
+
+    if (!types[i])
+      continue;
+    g_string_append_printf(s, "%s\n    {\"type\": ", first ? "" : ",");
+    if ((name = type_name(i)))
+      json_string(s, name);
+    else
+      g_string_append_printf(s, "%d", i);
+    g_string_append(s, ", ");
+    json_counts(s, types[i]);
+    g_string_append_c(s, '}');
+    first = FALSE;
+  }
+  g_string_append(s, "\n  ],\n");
+
+  g_string_append(s, "  \"handlers\": [");
+  for (i = 0; i < OB_NUM_EVENT_HANDLERS; ++i) {
+    g_string_append_printf(s, "%s\n    {\"handler\": \"%s\", ", i ? "," : "", handler_names[i]);
+    json_counts(s, &handlers[i]);
+    g_string_append_c(s, '}');
+  }
+  g_string_append(s, "\n  ],\n");
+
+  json_clients(s);
+  g_string_append(s, "}\n");
+  return g_string_free(s, FALSE);
+}
+
+void event_stats_save(void) {
+  ObtPaths* p = obt_paths_new();
+  gchar* dir = g_build_filename(obt_paths_cache_home(p), "openbox", NULL);
+  gchar* name = g_build_filename(dir, "stats.json", NULL);
+  GError* err = NULL;
+  gchar* json;
+
+  json = stats_json();
+  if (!obt_paths_mkdir_path(dir, 0700))
+    g_message(_("Unable to make directory '%s': %s"), dir, g_strerror(errno));
+  else if (!g_file_set_contents(name, json, -1, &err)) {
+    g_message(_("Unable to save the event stats to '%s': %s"), name, err->message);
+    g_error_free(err);
+  }
+  else
+    ob_debug("Saved the event stats to %s", name);
+
+  g_free(json);
+  g_free(name);
+  g_free(dir);
+  obt_paths_unref(p);
+}
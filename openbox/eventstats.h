@@ -0,0 +1,60 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   eventstats.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef ob__eventstats_h
+#define ob__eventstats_h
+
+#include <X11/Xlib.h>
+#include <glib.h>
+
+struct _ObClient;
+
+/*! Counts of the X events that have been handled, and how long they took,
+  by their type, by what handled them, and by the client they were for.
+  The times are kept in histograms with buckets that grow with the times,
+  so that a few slow events stand out from many quick ones.  They can be
+  saved as JSON, with openbox --dump-stats. */
+
+/*! What handled an event */
+typedef enum {
+  OB_EVENT_HANDLER_FOCUS,
+  OB_EVENT_HANDLER_CLIENT,
+  OB_EVENT_HANDLER_DOCKAPP,
+  OB_EVENT_HANDLER_DOCK,
+  OB_EVENT_HANDLER_MENU,
+  OB_EVENT_HANDLER_ROOT,
+  OB_EVENT_HANDLER_INPUT,
+  OB_EVENT_HANDLER_OTHER,
+  OB_NUM_EVENT_HANDLERS
+} ObEventHandler;
+
+void event_stats_startup(gboolean reconfig);
+void event_stats_shutdown(gboolean reconfig);
+
+/*! Starts timing an event */
+void event_stats_begin(const XEvent* e);
+/*! Says that the event being timed is for @client.  This has to be called
+  before the event is handled, since handling it can unmanage the client. */
+void event_stats_set_client(struct _ObClient* client);
+/*! Stops timing the event passed to event_stats_begin, and counts it for
+  its type, its handler, and its client if it had one */
+void event_stats_end(ObEventHandler handler);
+
+/*! Saves the stats as JSON in openbox's cache directory */
+void event_stats_save(void);
+
+#endif
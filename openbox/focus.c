@@ -28,6 +28,7 @@
 #include "screen.h"
 #include "keyboard.h"
 #include "focus.h"
+#include "rootprops.h"
 #include "stacking.h"
 #include "obt/prop.h"
 
@@ -95,7 +96,7 @@ void focus_set_client(ObClient* client) {
   /* set the NET_ACTIVE_WINDOW hint, but preserve it on shutdown */
   if (ob_state() != OB_STATE_EXITING) {
     active = client ? client->window : None;
-    OBT_PROP_SET32(obt_root(ob_screen), NET_ACTIVE_WINDOW, WINDOW, active);
+    ROOT_PROPS_SET32(NET_ACTIVE_WINDOW, WINDOW, active);
   }
 
   /* when focus is moved to a new window, the last_user_time timestamp would
@@ -28,6 +28,7 @@
 #include "focus_cycle_indicator.h"
 #include "moveresize.h"
 #include "screen.h"
+#include "edgeindex.h"
 #include "obrender/theme.h"
 #include "obt/display.h"
 #include "obt/xqueue.h"
@@ -289,6 +290,7 @@ void frame_hide(ObFrame* self) {
 void frame_adjust_theme(ObFrame* self) {
   free_theme_statics(self);
   set_theme_statics(self);
+  self->dirty |= OB_FRAME_DIRTY_ALL;
 }
 
 #ifdef SHAPE
@@ -722,6 +724,8 @@ void frame_adjust_area(ObFrame* self, gboolean moved, gboolean resized, gboolean
   }
 
   if (!fake) {
+    edge_index_update(self->client);
+
     if (!frame_iconify_animating(self))
       /* move and resize the top level frame.
          shading can change without being moved or resized.
@@ -738,7 +742,7 @@ void frame_adjust_area(ObFrame* self, gboolean moved, gboolean resized, gboolean
     XMoveWindow(obt_display, self->client->window, self->size.left, self->size.top);
 
     if (resized) {
-      self->need_render = TRUE;
+      self->dirty |= OB_FRAME_DIRTY_ALL;
       framerender_frame(self);
       frame_adjust_shape(self);
     }
@@ -828,25 +832,31 @@ void frame_adjust_client_area(ObFrame* self) {
 }
 
 void frame_adjust_state(ObFrame* self) {
-  self->need_render = TRUE;
+  /* the buttons show the client's state, and their hover and press state */
+  self->dirty |= OB_FRAME_DIRTY_BUTTONS;
+  /* the line under the titlebar goes away when shaded */
+  if (self->client->shaded != self->drawn_shaded)
+    self->dirty |= OB_FRAME_DIRTY_BORDER;
   framerender_frame(self);
 }
 
 void frame_adjust_focus(ObFrame* self, gboolean hilite) {
   ob_debug_type(OB_DEBUG_FOCUS, "Frame for 0x%x has focus: %d", self->client->window, hilite);
   self->focused = hilite;
-  self->need_render = TRUE;
+  /* every part of the frame looks different with focus */
+  if (hilite != self->drawn_focused)
+    self->dirty |= OB_FRAME_DIRTY_ALL;
   framerender_frame(self);
   XFlush(obt_display);
 }
 
 void frame_adjust_title(ObFrame* self) {
-  self->need_render = TRUE;
+  self->dirty |= OB_FRAME_DIRTY_LABEL;
   framerender_frame(self);
 }
 
 void frame_adjust_icon(ObFrame* self) {
-  self->need_render = TRUE;
+  self->dirty |= OB_FRAME_DIRTY_ICON;
   framerender_frame(self);
 }
 
@@ -77,6 +77,23 @@ typedef enum {
   OB_FRAME_DECOR_CLOSE = 1 << 9  /*!< Display a close button */
 } ObFrameDecorations;
 
+/*! The parts of a frame that can be repainted separately */
+typedef enum {
+  OB_FRAME_DIRTY_BORDER = 1 << 0,  /*!< The border and inner colors */
+  OB_FRAME_DIRTY_TITLE = 1 << 1,   /*!< The titlebar and its resize areas */
+  OB_FRAME_DIRTY_LABEL = 1 << 2,   /*!< The title text */
+  OB_FRAME_DIRTY_ICON = 1 << 3,    /*!< The window's icon */
+  OB_FRAME_DIRTY_MAX = 1 << 4,     /*!< The maximize button */
+  OB_FRAME_DIRTY_ICONIFY = 1 << 5, /*!< The iconify button */
+  OB_FRAME_DIRTY_DESK = 1 << 6,    /*!< The all-desktops button */
+  OB_FRAME_DIRTY_SHADE = 1 << 7,   /*!< The shade button */
+  OB_FRAME_DIRTY_CLOSE = 1 << 8,   /*!< The close button */
+  OB_FRAME_DIRTY_HANDLE = 1 << 9,  /*!< The handle and its grips */
+  OB_FRAME_DIRTY_BUTTONS = OB_FRAME_DIRTY_MAX | OB_FRAME_DIRTY_ICONIFY | OB_FRAME_DIRTY_DESK |
+                           OB_FRAME_DIRTY_SHADE | OB_FRAME_DIRTY_CLOSE,
+  OB_FRAME_DIRTY_ALL = (1 << 10) - 1
+} ObFrameDirty;
+
 struct _ObFrame {
   struct _ObClient* client;
 
@@ -185,7 +202,12 @@ struct _ObFrame {
   gboolean iconify_hover;
 
   gboolean focused;
-  gboolean need_render;
+  /*! The parts of the frame that need repainting, from ObFrameDirty */
+  guint dirty;
+  /*! The focus state that the frame was last painted with */
+  gboolean drawn_focused;
+  /*! The shaded state that the border was last painted with */
+  gboolean drawn_shaded;
 
   gboolean flashing;
   gboolean flash_on;
@@ -24,6 +24,7 @@
 #include "framerender.h"
 #include "obrender/theme.h"
 
+static gboolean framerender_parentrel(const RrAppearance* a);
 static void framerender_label(ObFrame* self, RrAppearance* a);
 static void framerender_icon(ObFrame* self, RrAppearance* a);
 static void framerender_max(ObFrame* self, RrAppearance* a);
@@ -34,16 +35,19 @@ static void framerender_close(ObFrame* self, RrAppearance* a);
 
 void framerender_frame(ObFrame* self) {
   const RrInstance* inst = ob_rr_theme->inst;
+  guint dirty;
 
   if (frame_iconify_animating(self))
     return; /* delay redrawing until the animation is done */
-  if (!self->need_render)
+  if (!self->dirty)
     return;
   if (!self->visible)
     return;
-  self->need_render = FALSE;
+  dirty = self->dirty;
+  self->dirty = 0;
+  self->drawn_focused = self->focused;
 
-  {
+  if (dirty & OB_FRAME_DIRTY_BORDER) {
     const RrColor* inner = (self->focused ? ob_rr_theme->cb_focused_color : ob_rr_theme->cb_unfocused_color);
     const RrColor* border =
         (self->focused ? (self->client->undecorated ? ob_rr_theme->frame_undecorated_focused_border_color
@@ -88,9 +92,11 @@ void framerender_frame(ObFrame* self) {
       sep = (self->focused ? ob_rr_theme->title_separator_focused_color : ob_rr_theme->title_separator_unfocused_color);
 
     RrClearWindowColor(inst, self->titlebottom, sep);
+    self->drawn_shaded = self->client->shaded;
   }
 
-  if (self->decorations & OB_FRAME_DECOR_TITLEBAR) {
+  if (self->decorations & OB_FRAME_DECOR_TITLEBAR &&
+      dirty & (OB_FRAME_DIRTY_TITLE | OB_FRAME_DIRTY_LABEL | OB_FRAME_DIRTY_ICON | OB_FRAME_DIRTY_BUTTONS)) {
     RrAppearance *t, *l, *m, *n, *i, *d, *s, *c, *clear;
     if (self->focused) {
       t = ob_rr_theme->a_focused_title;
@@ -179,31 +185,44 @@ void framerender_frame(ObFrame* self) {
     }
     clear = ob_rr_theme->a_clear;
 
-    RrPaint(t, self->title, self->width, ob_rr_theme->title_height);
+    /* the title's appearance is shared by every frame, so the pixels that
+       parent-relative parts draw from have to be redrawn for this one */
+    if ((dirty & OB_FRAME_DIRTY_LABEL && framerender_parentrel(l)) ||
+        (dirty & OB_FRAME_DIRTY_ICON && framerender_parentrel(n)) ||
+        (dirty & OB_FRAME_DIRTY_MAX && framerender_parentrel(m)) ||
+        (dirty & OB_FRAME_DIRTY_ICONIFY && framerender_parentrel(i)) ||
+        (dirty & OB_FRAME_DIRTY_DESK && framerender_parentrel(d)) ||
+        (dirty & OB_FRAME_DIRTY_SHADE && framerender_parentrel(s)) ||
+        (dirty & OB_FRAME_DIRTY_CLOSE && framerender_parentrel(c)))
+      dirty |= OB_FRAME_DIRTY_TITLE;
 
-    clear->surface.parent = t;
-    clear->surface.parenty = 0;
+    if (dirty & OB_FRAME_DIRTY_TITLE) {
+      RrPaint(t, self->title, self->width, ob_rr_theme->title_height);
 
-    clear->surface.parentx = ob_rr_theme->grip_width;
+      clear->surface.parent = t;
+      clear->surface.parenty = 0;
 
-    RrPaint(clear, self->topresize, self->width - ob_rr_theme->grip_width * 2, ob_rr_theme->paddingy + 1);
+      clear->surface.parentx = ob_rr_theme->grip_width;
 
-    clear->surface.parentx = 0;
+      RrPaint(clear, self->topresize, self->width - ob_rr_theme->grip_width * 2, ob_rr_theme->paddingy + 1);
 
-    if (ob_rr_theme->grip_width > 0)
-      RrPaint(clear, self->tltresize, ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
-    if (ob_rr_theme->title_height > 0)
-      RrPaint(clear, self->tllresize, ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+      clear->surface.parentx = 0;
 
-    clear->surface.parentx = self->width - ob_rr_theme->grip_width;
+      if (ob_rr_theme->grip_width > 0)
+        RrPaint(clear, self->tltresize, ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
+      if (ob_rr_theme->title_height > 0)
+        RrPaint(clear, self->tllresize, ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
 
-    if (ob_rr_theme->grip_width > 0)
-      RrPaint(clear, self->trtresize, ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
+      clear->surface.parentx = self->width - ob_rr_theme->grip_width;
 
-    clear->surface.parentx = self->width - (ob_rr_theme->paddingx + 1);
+      if (ob_rr_theme->grip_width > 0)
+        RrPaint(clear, self->trtresize, ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
 
-    if (ob_rr_theme->title_height > 0)
-      RrPaint(clear, self->trrresize, ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+      clear->surface.parentx = self->width - (ob_rr_theme->paddingx + 1);
+
+      if (ob_rr_theme->title_height > 0)
+        RrPaint(clear, self->trrresize, ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+    }
 
     /* set parents for any parent relative guys */
     l->surface.parent = t;
@@ -234,16 +253,23 @@ void framerender_frame(ObFrame* self) {
     c->surface.parentx = self->close_x;
     c->surface.parenty = ob_rr_theme->paddingy + 1;
 
-    framerender_label(self, l);
-    framerender_max(self, m);
-    framerender_icon(self, n);
-    framerender_iconify(self, i);
-    framerender_desk(self, d);
-    framerender_shade(self, s);
-    framerender_close(self, c);
+    if (dirty & OB_FRAME_DIRTY_LABEL)
+      framerender_label(self, l);
+    if (dirty & OB_FRAME_DIRTY_MAX)
+      framerender_max(self, m);
+    if (dirty & OB_FRAME_DIRTY_ICON)
+      framerender_icon(self, n);
+    if (dirty & OB_FRAME_DIRTY_ICONIFY)
+      framerender_iconify(self, i);
+    if (dirty & OB_FRAME_DIRTY_DESK)
+      framerender_desk(self, d);
+    if (dirty & OB_FRAME_DIRTY_SHADE)
+      framerender_shade(self, s);
+    if (dirty & OB_FRAME_DIRTY_CLOSE)
+      framerender_close(self, c);
   }
 
-  if (self->decorations & OB_FRAME_DECOR_HANDLE && ob_rr_theme->handle_height > 0) {
+  if (self->decorations & OB_FRAME_DECOR_HANDLE && ob_rr_theme->handle_height > 0 && dirty & OB_FRAME_DIRTY_HANDLE) {
     RrAppearance *h, *g;
 
     h = (self->focused ? ob_rr_theme->a_focused_handle : ob_rr_theme->a_unfocused_handle);
@@ -271,6 +297,10 @@ void framerender_frame(ObFrame* self) {
   RrFlush(inst);
 }
 
+static gboolean framerender_parentrel(const RrAppearance* a) {
+  return a->surface.grad == RR_SURFACE_PARENTREL;
+}
+
 static void framerender_label(ObFrame* self, RrAppearance* a) {
   if (!self->label_on)
     return;
@@ -38,6 +38,7 @@
 #include <glib.h>
 
 KeyBindingTree* keyboard_firstnode = NULL;
+GHashTable* keyboard_firstlevel = NULL;
 static ObPopup* popup = NULL;
 static KeyBindingTree* curpos;
 static guint chain_timer = 0;
@@ -118,16 +119,21 @@ void keyboard_reset_chains(gint break_chroots) {
 void keyboard_unbind_all(void) {
   tree_destroy(keyboard_firstnode);
   keyboard_firstnode = NULL;
+  if (keyboard_firstlevel)
+    g_hash_table_destroy(keyboard_firstlevel);
+  keyboard_firstlevel = NULL;
 }
 
 void keyboard_chroot(GList* keylist) {
   /* try do it in the existing tree. if we can't that means it is an empty
      chroot binding. so add it to the tree then. */
-  if (!tree_chroot(keyboard_firstnode, keylist)) {
-    KeyBindingTree* tree;
+  if (!tree_chroot(keylist)) {
+    KeyBindingTree *tree, *t;
     if (!(tree = tree_build(keylist)))
       return;
-    tree_chroot(tree, keylist);
+    for (t = tree; t->first_child; t = t->first_child)
+      ;
+    t->chroot = TRUE;
     tree_assimilate(tree);
   }
 }
@@ -231,41 +237,34 @@ gboolean keyboard_event(ObClient* client, const XEvent* e) {
   }
 
   used = FALSE;
-  if (curpos == NULL)
-    p = keyboard_firstnode;
-  else
-    p = curpos->first_child;
-  while (p) {
-    if (p->key == e->xkey.keycode && p->state == mods) {
-      /* if we hit a key binding, then close any open menus and run it */
-      if (menu_frame_visible)
-        menu_frame_hide_all();
-
-      if (p->first_child != NULL) { /* part of a chain */
-        if (chain_timer)
-          g_source_remove(chain_timer);
-        /* 3 second timeout for chains */
-        chain_timer = g_timeout_add_full(G_PRIORITY_DEFAULT, 3000, chain_timeout, NULL, chain_done);
-        set_curpos(p);
-      }
-      else if (p->chroot) /* an empty chroot */
-        set_curpos(p);
-      else {
-        GSList* it;
-
-        for (it = p->actions; it; it = g_slist_next(it))
-          if (actions_act_is_interactive(it->data))
-            break;
-        if (it == NULL) /* reset if the actions are not interactive */
-          keyboard_reset_chains(0);
-
-        actions_run_acts(p->actions, OB_USER_ACTION_KEYBOARD_KEY, e->xkey.state, e->xkey.x_root, e->xkey.y_root, 0,
-                         OB_FRAME_CONTEXT_NONE, client);
-      }
-      used = TRUE;
-      break;
+  p = tree_lookup(curpos, mods, e->xkey.keycode);
+  if (p) {
+    /* if we hit a key binding, then close any open menus and run it */
+    if (menu_frame_visible)
+      menu_frame_hide_all();
+
+    if (p->first_child != NULL) { /* part of a chain */
+      if (chain_timer)
+        g_source_remove(chain_timer);
+      /* 3 second timeout for chains */
+      chain_timer = g_timeout_add_full(G_PRIORITY_DEFAULT, 3000, chain_timeout, NULL, chain_done);
+      set_curpos(p);
+    }
+    else if (p->chroot) /* an empty chroot */
+      set_curpos(p);
+    else {
+      GSList* it;
+
+      for (it = p->actions; it; it = g_slist_next(it))
+        if (actions_act_is_interactive(it->data))
+          break;
+      if (it == NULL) /* reset if the actions are not interactive */
+        keyboard_reset_chains(0);
+
+      actions_run_acts(p->actions, OB_USER_ACTION_KEYBOARD_KEY, e->xkey.state, e->xkey.x_root, e->xkey.y_root, 0,
+                       OB_FRAME_CONTEXT_NONE, client);
     }
-    p = p->next_sibling;
+    used = TRUE;
   }
   return used;
 }
@@ -301,13 +300,18 @@ static void node_rebind(KeyBindingTree* node) {
 
 void keyboard_rebind(void) {
   KeyBindingTree* old;
+  GHashTable* oldlevel;
 
   old = keyboard_firstnode;
+  oldlevel = keyboard_firstlevel;
   keyboard_firstnode = NULL;
+  keyboard_firstlevel = NULL;
   if (old)
     node_rebind(old);
 
   tree_destroy(old);
+  if (oldlevel)
+    g_hash_table_destroy(oldlevel);
   set_curpos(NULL);
   grab_keys(TRUE);
 }
@@ -30,6 +30,8 @@ struct _ObClient;
 struct _ObActionsAct;
 
 extern KeyBindingTree* keyboard_firstnode;
+/*! The bindings in keyboard_firstnode's level, by key and state */
+extern GHashTable* keyboard_firstlevel;
 
 void keyboard_startup(gboolean reconfig);
 void keyboard_shutdown(gboolean reconfig);
@@ -38,6 +38,8 @@ void tree_destroy(KeyBindingTree* tree) {
         actions_act_unref(sit->data);
       g_slist_free(tree->actions);
     }
+    if (tree->children)
+      g_hash_table_destroy(tree->children);
     g_slice_free(KeyBindingTree, tree);
     tree = c;
   }
@@ -66,88 +68,99 @@ KeyBindingTree* tree_build(GList* keylist) {
   return ret;
 }
 
-void tree_assimilate(KeyBindingTree* node) {
-  KeyBindingTree *a, *b, *tmp, *last;
+/* the key for a binding in its level's table. modifier masks and keycodes
+   both fit in 16 bits */
+#define LEVEL_KEY(state, key) GUINT_TO_POINTER(((state) << 16) | ((key)&0xffff))
+
+static GHashTable** level_of(KeyBindingTree* parent) {
+  return parent ? &parent->children : &keyboard_firstlevel;
+}
 
-  if (keyboard_firstnode == NULL) {
-    /* there are no nodes at this level yet */
-    keyboard_firstnode = node;
+static void level_add(KeyBindingTree* parent, KeyBindingTree* node) {
+  GHashTable** level;
+
+  /* key bindings that didn't get translated can't be pressed */
+  if (node->key == 0)
+    return;
+
+  level = level_of(parent);
+  if (*level == NULL)
+    *level = g_hash_table_new(g_direct_hash, g_direct_equal);
+  g_hash_table_insert(*level, LEVEL_KEY(node->state, node->key), node);
+}
+
+KeyBindingTree* tree_lookup(KeyBindingTree* parent, guint state, guint key) {
+  GHashTable* level = *level_of(parent);
+
+  if (level == NULL || key == 0)
+    return NULL;
+  return g_hash_table_lookup(level, LEVEL_KEY(state, key));
+}
+
+void tree_assimilate(KeyBindingTree* node) {
+  KeyBindingTree *parent = NULL, *a, *b, *tmp;
+
+  /* follow the chain down as far as it is already in the tree. check
+     b->key != 0 for key bindings that didn't get translated, and save them
+     as siblings */
+  b = node;
+  while (b && b->key != 0 && (a = tree_lookup(parent, b->state, b->key))) {
+    tmp = b;
+    b = b->first_child;
+    g_slice_free(KeyBindingTree, tmp);
+    parent = a;
+  }
+  if (b == NULL)
+    return; /* all of it was already there */
+
+  /* add the rest of the chain at this level */
+  b->parent = parent;
+  if (parent) {
+    b->next_sibling = parent->first_child;
+    parent->first_child = b;
   }
   else {
-    a = keyboard_firstnode;
-    last = a;
-    b = node;
-    while (a) {
-      last = a;
-      /* check b->key != 0 for key bindings that didn't get translated */
-      if (!(a->state == b->state && a->key == b->key && b->key != 0)) {
-        a = a->next_sibling;
-      }
-      else {
-        tmp = b;
-        b = b->first_child;
-        g_slice_free(KeyBindingTree, tmp);
-        a = a->first_child;
-      }
-    }
-    /* check b->key != 0, and save key bindings that didn't get translated
-       as siblings here */
-    if (!(last->state == b->state && last->key == b->key && b->key != 0)) {
-      last->next_sibling = b;
-      b->parent = last->parent;
-    }
-    else {
-      last->first_child = b->first_child;
-      last->first_child->parent = last;
-      g_slice_free(KeyBindingTree, b);
-    }
+    b->next_sibling = keyboard_firstnode;
+    keyboard_firstnode = b;
   }
+  for (; b; b = b->first_child)
+    level_add(b->parent, b);
 }
 
 KeyBindingTree* tree_find(KeyBindingTree* search, gboolean* conflict) {
-  KeyBindingTree *a, *b;
+  KeyBindingTree *a = NULL, *b;
 
   *conflict = FALSE;
 
-  a = keyboard_firstnode;
-  b = search;
-  while (a && b) {
-    /* check b->key != 0 for key bindings that didn't get translated, and
-       don't make them conflict with anything else so that they can all
-       live together in peace and harmony */
-    if (!(a->state == b->state && a->key == b->key && b->key != 0)) {
-      a = a->next_sibling;
-    }
-    else {
-      if ((a->first_child == NULL) == (b->first_child == NULL)) {
-        if (a->first_child == NULL) {
-          /* found it! (return the actual node, not the search's) */
-          return a;
-        }
-      }
-      else {
-        *conflict = TRUE;
-        return NULL; /* the chain status' don't match (conflict!) */
-      }
-      b = b->first_child;
-      a = a->first_child;
+  for (b = search; b; b = b->first_child) {
+    /* key bindings that didn't get translated aren't in the tables, so
+       they don't conflict with anything else and can all live together in
+       peace and harmony */
+    if (!(a = tree_lookup(a, b->state, b->key)))
+      return NULL; /* it just isn't in here */
+
+    if ((a->first_child == NULL) != (b->first_child == NULL)) {
+      *conflict = TRUE;
+      return NULL; /* the chain status' don't match (conflict!) */
     }
+    if (a->first_child == NULL)
+      return a; /* found it! (return the actual node, not the search's) */
   }
-  return NULL; /* it just isn't in here */
+  return NULL;
 }
 
-gboolean tree_chroot(KeyBindingTree* tree, GList* keylist) {
-  guint key, state;
-  translate_key(keylist->data, &state, &key);
-  while (tree != NULL && !(tree->state == state && tree->key == key))
-    tree = tree->next_sibling;
-  if (tree != NULL) {
-    if (keylist->next == NULL) {
-      tree->chroot = TRUE;
-      return TRUE;
-    }
-    else
-      return tree_chroot(tree->first_child, keylist->next);
+gboolean tree_chroot(GList* keylist) {
+  KeyBindingTree* tree = NULL;
+  GList* it;
+
+  for (it = keylist; it; it = g_list_next(it)) {
+    guint key, state;
+
+    translate_key(it->data, &state, &key);
+    if (!(tree = tree_lookup(tree, state, key)))
+      return FALSE;
   }
-  return FALSE;
+  if (tree)
+    tree->chroot = TRUE;
+  return tree != NULL;
 }
@@ -34,12 +34,18 @@ typedef struct KeyBindingTree {
   struct KeyBindingTree* next_sibling;
   /* the first child of this binding (next binding in a chained sequence).*/
   struct KeyBindingTree* first_child;
+  /* the children of this binding, by key and state. bindings that didn't
+     get translated are left out, as they can't be pressed */
+  GHashTable* children;
 } KeyBindingTree;
 
 void tree_destroy(KeyBindingTree* tree);
 KeyBindingTree* tree_build(GList* keylist);
 void tree_assimilate(KeyBindingTree* node);
 KeyBindingTree* tree_find(KeyBindingTree* search, gboolean* conflict);
-gboolean tree_chroot(KeyBindingTree* tree, GList* keylist);
+gboolean tree_chroot(GList* keylist);
+/*! Finds the binding for a key below @parent in the tree, or at the top level
+  if @parent is NULL */
+KeyBindingTree* tree_lookup(KeyBindingTree* parent, guint state, guint key);
 
 #endif
@@ -37,13 +37,31 @@
 #include "obt/xml.h"
 #include "obt/paths.h"
 
+#include <libxml/parser.h>
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+/* how much of a pipe-menu's output to read at a time */
+#define PIPE_READ_SIZE 4096
+
 typedef struct _ObMenuParseState ObMenuParseState;
+typedef struct _ObMenuPipe ObMenuPipe;
 
 struct _ObMenuParseState {
   ObMenu* parent;
   ObMenu* pipe_creator;
 };
 
+struct _ObMenuPipe {
+  GPid pid;
+  GIOChannel* channel;
+  guint watch_id;
+  guint timeout_id;
+  /* the output is parsed as it arrives */
+  xmlParserCtxtPtr ctxt;
+};
+
 static GHashTable* menu_hash = NULL;
 static ObtXmlInst* menu_parse_inst;
 static ObMenuParseState menu_parse_state;
@@ -61,6 +79,8 @@ static void dump_menu_hash(void) {
 }
 
 static void menu_destroy_hash_value(ObMenu* self);
+static void menu_free_entries(ObMenu* self);
+static void menu_pipe_cancel(ObMenu* self);
 static void parse_menu_item(xmlNodePtr node, gpointer data);
 static void parse_menu_separator(xmlNodePtr node, gpointer data);
 static void parse_menu(xmlNodePtr node, gpointer data);
@@ -81,6 +101,7 @@ void menu_startup(gboolean reconfig) {
   client_menu_startup();
 
   menu_parse_inst = obt_xml_instance_new();
+  obt_xml_instance_set_cache(menu_parse_inst, "openbox");
 
   menu_parse_state.parent = NULL;
   menu_parse_state.pipe_creator = NULL;
@@ -128,50 +149,175 @@ void menu_shutdown(gboolean reconfig) {
   menu_hash = NULL;
 }
 
-static gboolean menu_pipe_submenu(gpointer key, gpointer val, gpointer data) {
-  ObMenu* menu = val;
-  return menu->pipe_creator != NULL;
+/* returns TRUE if the pipe-menu's output can still be used */
+static gboolean menu_pipe_fresh(ObMenu* self) {
+  return self->pipe_cache_time && self->pipe_loaded &&
+         g_get_monotonic_time() - self->pipe_loaded < (gint64)self->pipe_cache_time * 1000;
+}
+
+/* returns TRUE if the menu was made by a pipe-menu whose output, or whose
+   creator's output, is no longer cached */
+static gboolean menu_pipe_expired(ObMenu* menu) {
+  for (; menu->pipe_creator; menu = menu->pipe_creator)
+    if (!menu_pipe_fresh(menu->pipe_creator))
+      return TRUE;
+  return FALSE;
+}
+
+static void find_expired(gpointer key, gpointer val, gpointer data) {
+  GSList** expired = data;
+  if (menu_pipe_expired(val))
+    *expired = g_slist_prepend(*expired, val);
 }
 
 static void clear_cache(gpointer key, gpointer val, gpointer data) {
   ObMenu* menu = val;
-  if (menu->execute)
+  if (menu->execute && !menu->pipe && !menu_pipe_fresh(menu))
     menu_clear_entries(menu);
 }
 
 void menu_clear_pipe_caches(void) {
-  /* delete any pipe menus' submenus */
-  g_hash_table_foreach_remove(menu_hash, menu_pipe_submenu, NULL);
+  GSList *expired = NULL, *it;
+
+  /* delete any pipe menus' submenus.  find them all first, since deciding
+     looks at their creators, which may be deleted too */
+  g_hash_table_foreach(menu_hash, find_expired, &expired);
+  for (it = expired; it; it = g_slist_next(it))
+    menu_free(it->data);
+  g_slist_free(expired);
   /* empty the top level pipe menus */
   g_hash_table_foreach(menu_hash, clear_cache, NULL);
 }
 
+static void menu_pipe_free(ObMenuPipe* p) {
+  if (p->watch_id)
+    g_source_remove(p->watch_id);
+  if (p->timeout_id)
+    g_source_remove(p->timeout_id);
+  g_io_channel_shutdown(p->channel, FALSE, NULL);
+  g_io_channel_unref(p->channel);
+  if (p->ctxt->myDoc)
+    xmlFreeDoc(p->ctxt->myDoc);
+  xmlFreeParserCtxt(p->ctxt);
+  g_slice_free(ObMenuPipe, p);
+}
+
+static void menu_pipe_cancel(ObMenu* self) {
+  if (self->pipe) {
+    kill(self->pipe->pid, SIGTERM);
+    menu_pipe_free(self->pipe);
+    self->pipe = NULL;
+  }
+}
+
+/* replaces the placeholder with the command's output, or with nothing if it
+   didn't give any */
+static void menu_pipe_finish(ObMenu* self, gboolean timed_out) {
+  ObMenuPipe* p = self->pipe;
+  xmlDocPtr doc = NULL;
+
+  if (timed_out) {
+    g_message(_("Pipe-menu \"%s\" did not finish within %u ms"), self->execute, self->pipe_timeout);
+    kill(p->pid, SIGTERM);
+  }
+  else {
+    xmlParseChunk(p->ctxt, NULL, 0, 1);
+    if (p->ctxt->wellFormed) {
+      doc = p->ctxt->myDoc;
+      p->ctxt->myDoc = NULL;
+    }
+  }
+  self->pipe = NULL;
+  menu_pipe_free(p);
+
+  menu_free_entries(self);
+
+  if (doc && obt_xml_load_doc(menu_parse_inst, doc, "openbox_pipe_menu")) {
+    menu_parse_state.pipe_creator = self;
+    menu_parse_state.parent = self;
+    obt_xml_tree_from_root(menu_parse_inst);
+    obt_xml_close(menu_parse_inst);
+    menu_parse_state.pipe_creator = NULL;
+    menu_parse_state.parent = NULL;
+
+    self->pipe_loaded = g_get_monotonic_time();
+  }
+  else if (!timed_out) {
+    g_message(_("Invalid output from pipe-menu \"%s\""), self->execute);
+  }
+
+  menu_frame_refresh(self);
+}
+
+static gboolean menu_pipe_read(GIOChannel* channel, GIOCondition cond, gpointer data) {
+  ObMenu* self = data;
+  gchar buf[PIPE_READ_SIZE];
+  gsize n = 0;
+  GIOStatus status;
+
+  /* read one chunk at a time, so a command that writes a lot can't keep
+     everything else waiting */
+  status = g_io_channel_read_chars(channel, buf, sizeof(buf), &n, NULL);
+  if (n > 0)
+    xmlParseChunk(self->pipe->ctxt, buf, n, 0);
+  if (status == G_IO_STATUS_NORMAL || status == G_IO_STATUS_AGAIN)
+    return TRUE;
+
+  /* the command closed its output, or it can't be read any more */
+  self->pipe->watch_id = 0;
+  menu_pipe_finish(self, FALSE);
+  return FALSE; /* remove the watch */
+}
+
+static gboolean menu_pipe_timeout(gpointer data) {
+  ObMenu* self = data;
+
+  self->pipe->timeout_id = 0;
+  menu_pipe_finish(self, TRUE);
+  return FALSE; /* don't repeat */
+}
+
 void menu_pipe_execute(ObMenu* self) {
-  gchar* output;
+  ObMenuPipe* p;
+  ObMenuEntry* e;
+  gchar** argv;
+  GPid pid;
+  gint out;
+  gboolean ok = FALSE;
   GError* err = NULL;
 
   if (!self->execute)
     return;
-  if (self->entries) /* the entries are already created and cached */
+  if (self->entries) /* the entries are already created and cached, or the
+                        command is still running */
     return;
 
-  if (!g_spawn_command_line_sync(self->execute, &output, NULL, NULL, &err)) {
+  if (g_shell_parse_argv(self->execute, NULL, &argv, &err)) {
+    ok = g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid,
+                                  NULL, &out, NULL, &err);
+    g_strfreev(argv);
+  }
+  if (!ok) {
     g_message(_("Failed to execute command for pipe-menu \"%s\": %s"), self->execute, err->message);
     g_error_free(err);
     return;
   }
 
-  if (obt_xml_load_mem(menu_parse_inst, output, strlen(output), "openbox_pipe_menu")) {
-    menu_parse_state.pipe_creator = self;
-    menu_parse_state.parent = self;
-    obt_xml_tree_from_root(menu_parse_inst);
-    obt_xml_close(menu_parse_inst);
-  }
-  else {
-    g_message(_("Invalid output from pipe-menu \"%s\""), self->execute);
-  }
+  p = g_slice_new0(ObMenuPipe);
+  p->pid = pid;
+  p->channel = g_io_channel_unix_new(out);
+  g_io_channel_set_close_on_unref(p->channel, TRUE);
+  g_io_channel_set_encoding(p->channel, NULL, NULL);
+  g_io_channel_set_flags(p->channel, G_IO_FLAG_NONBLOCK, NULL);
+  p->ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, self->execute);
+  p->watch_id = g_io_add_watch(p->channel, G_IO_IN | G_IO_HUP | G_IO_ERR, menu_pipe_read, self);
+  if (self->pipe_timeout)
+    p->timeout_id = g_timeout_add(self->pipe_timeout, menu_pipe_timeout, self);
+  self->pipe = p;
 
-  g_free(output);
+  /* show something until the output arrives */
+  e = menu_add_normal(self, -1, _("Loading..."), NULL, FALSE);
+  e->data.normal.enabled = FALSE;
 }
 
 static ObMenu* menu_from_name(gchar* name) {
@@ -336,7 +482,15 @@ static void parse_menu(xmlNodePtr node, gpointer data) {
     if ((menu = menu_new(name, title, TRUE, NULL))) {
       menu->pipe_creator = state->pipe_creator;
       if (obt_xml_attr_string(node, "execute", &script)) {
+        gint ms;
+
         menu->execute = obt_paths_expand_tilde(script);
+        menu->pipe_timeout = config_menu_pipe_timeout;
+        menu->pipe_cache_time = config_menu_pipe_cache_time;
+        if (obt_xml_attr_int(node, "timeout", &ms))
+          menu->pipe_timeout = MAX(ms, 0);
+        if (obt_xml_attr_int(node, "cacheTime", &ms))
+          menu->pipe_cache_time = MAX(ms, 0);
       }
       else {
         ObMenu* old;
@@ -419,6 +573,7 @@ static void menu_destroy_hash_value(ObMenu* self) {
   if (self->destroy_func)
     self->destroy_func(self, self->data);
 
+  menu_pipe_cancel(self);
   menu_clear_entries(self);
   g_free(self->name);
   g_free(self->title);
@@ -578,6 +733,12 @@ void menu_clear_entries(ObMenu* self) {
   }
 #endif
 
+  menu_free_entries(self);
+}
+
+/* like menu_clear_entries, but the menu may be visible.  its frames hold
+   their own references to the entries, and need to be refreshed after */
+static void menu_free_entries(ObMenu* self) {
   while (self->entries) {
     menu_entry_unref(self->entries->data);
     self->entries = g_list_delete_link(self->entries, self->entries);
@@ -72,6 +72,15 @@ struct _ObMenu {
 
   /* Command to execute to rebuild the menu */
   gchar* execute;
+  /* The command while it is running, NULL the rest of the time */
+  struct _ObMenuPipe* pipe;
+  /* How long to let the command run for, in milliseconds. 0 for no limit */
+  guint pipe_timeout;
+  /* How long to keep using the command's output for, in milliseconds. 0 to
+     run the command again each time the menu is shown */
+  guint pipe_cache_time;
+  /* When the command's output was last loaded, from g_get_monotonic_time() */
+  gint64 pipe_loaded;
 
   /* ObMenuEntry list */
   GList* entries;
@@ -165,9 +174,11 @@ void menu_entry_unref(ObMenuEntry* self);
 ObMenu* menu_new(const gchar* name, const gchar* title, gboolean allow_shortcut_selection, gpointer data);
 void menu_free(ObMenu* menu);
 
-/*! Repopulate a pipe-menu by running its command */
+/*! Repopulate a pipe-menu by running its command.  The command runs in the
+  background, and the menu shows a placeholder entry until its output has
+  been loaded. */
 void menu_pipe_execute(ObMenu* self);
-/*! Clear a pipe-menu's entries */
+/*! Clear the entries of pipe-menus whose output is no longer cached */
 void menu_clear_pipe_caches(void);
 
 void menu_show_all_shortcuts(ObMenu* self, gboolean show);
@@ -740,7 +740,6 @@ static void menu_frame_update(ObMenuFrame* self) {
   const Rect* a;
   gint h;
 
-  menu_pipe_execute(self->menu);
   menu_find_submenus(self->menu);
 
   self->selected = NULL;
@@ -863,6 +862,7 @@ static gboolean menu_frame_show(ObMenuFrame* self) {
     }
   }
 
+  menu_pipe_execute(self->menu);
   menu_frame_update(self);
 
   menu_frame_visible = g_list_prepend(menu_frame_visible, self);
@@ -1004,6 +1004,34 @@ static void menu_frame_hide(ObMenuFrame* self) {
     menu->cleanup_func(menu, menu->data);
 }
 
+void menu_frame_refresh(ObMenu* menu) {
+  GList *frames, *it;
+
+  frames = g_list_copy(menu_frame_visible);
+  for (it = frames; it; it = g_list_next(it)) {
+    ObMenuFrame* f = it->data;
+    gint dx, dy;
+
+    if (f->menu != menu || !g_list_find(menu_frame_visible, f))
+      continue;
+
+    if (f->child)
+      menu_frame_hide(f->child);
+
+    /* the entries may all be different now, so start over */
+    while (f->entries) {
+      menu_entry_frame_free(f->entries->data);
+      f->entries = g_list_delete_link(f->entries, f->entries);
+    }
+    menu_frame_update(f);
+
+    /* it probably changed size, so keep it on the screen */
+    menu_frame_move_on_screen(f, f->area.x, f->area.y, &dx, &dy);
+    menu_frame_move(f, f->area.x + dx, f->area.y + dy);
+  }
+  g_list_free(frames);
+}
+
 void menu_frame_hide_all(void) {
   GList* it;
 
@@ -126,6 +126,8 @@ void menu_frame_hide_all(void);
 void menu_frame_hide_all_client(struct _ObClient* client);
 
 void menu_frame_render(ObMenuFrame* self);
+/*! Rebuilds any visible frames for the menu after its entries have changed */
+void menu_frame_refresh(struct _ObMenu* menu);
 
 void menu_frame_select(ObMenuFrame* self, ObMenuEntryFrame* entry, gboolean immediate);
 void menu_frame_select_previous(ObMenuFrame* self);
@@ -22,8 +22,12 @@
 #include "session.h"
 #include "dock.h"
 #include "event.h"
+#include "eventrecord.h"
+#include "eventstats.h"
 #include "menu.h"
 #include "client.h"
+#include "edgeindex.h"
+#include "stacking.h"
 #include "screen.h"
 #include "actions.h"
 #include "startupnotify.h"
@@ -42,6 +46,7 @@
 #include "config.h"
 #include "ping.h"
 #include "prompt.h"
+#include "rootprops.h"
 #include "gettext.h"
 #include "obrender/render.h"
 #include "obrender/theme.h"
@@ -152,7 +157,9 @@ gint main(gint argc, gchar** argv) {
   if (remote_control) {
     /* Send client message telling the OB process to:
      * remote_control = 1 -> reconfigure
-     * remote_control = 2 -> restart */
+     * remote_control = 2 -> restart
+     * remote_control = 3 -> exit
+     * remote_control = 4 -> save the event stats */
     OBT_PROP_MSG(ob_screen, obt_root(ob_screen), OB_CONTROL, remote_control, 0, 0, 0, 0);
     obt_display_close();
     exit(EXIT_SUCCESS);
@@ -229,6 +236,8 @@ gint main(gint argc, gchar** argv) {
         /* startup the parsing so everything can register sections
            of the rc */
         i = obt_xml_instance_new();
+        /* reuse the parsed rc.xml while it hasn't changed */
+        obt_xml_instance_set_cache(i, "openbox");
 
         /* register all the available actions */
         actions_startup(reconfigure);
@@ -284,6 +293,9 @@ gint main(gint argc, gchar** argv) {
         obt_xml_instance_unref(i);
       }
 
+      RrSurfaceCacheSetSize(ob_rr_inst, (gsize)config_theme_surface_cache_size * 1024);
+      RrImageSetScaleFilter(config_theme_icon_scaling);
+
       /* load the theme specified in the rc file */
       {
         RrTheme* theme;
@@ -299,6 +311,9 @@ gint main(gint argc, gchar** argv) {
         OBT_PROP_SETS(obt_root(ob_screen), OB_THEME, ob_rr_theme->name);
       }
 
+      /* menu icons are drawn as tall as the menu's text */
+      RrImageSetIconTheme(config_theme_icon_theme, ob_rr_theme->menu_font_height);
+
       if (reconfigure) {
         GList* it;
 
@@ -308,11 +323,15 @@ gint main(gint argc, gchar** argv) {
           frame_adjust_theme(c->frame);
         }
       }
+      event_stats_startup(reconfigure);
+      event_record_startup(reconfigure);
       event_startup(reconfigure);
+      root_props_startup(reconfigure);
       /* focus_backup is used for stacking, so this needs to come before
          anything that calls stacking_add */
       sn_startup(reconfigure);
       window_startup(reconfigure);
+      stacking_startup(reconfigure);
       focus_startup(reconfigure);
       focus_cycle_startup(reconfigure);
       focus_cycle_indicator_startup(reconfigure);
@@ -322,6 +341,7 @@ gint main(gint argc, gchar** argv) {
       group_startup(reconfigure);
       ping_startup(reconfigure);
       client_startup(reconfigure);
+      edge_index_startup(reconfigure);
       dock_startup(reconfigure);
       moveresize_startup(reconfigure);
       keyboard_startup(reconfigure);
@@ -379,6 +399,9 @@ gint main(gint argc, gchar** argv) {
       }
 
       g_main_loop_run(ob_main_loop);
+      /* the last changes may still be waiting to be set on the root window,
+         where some of them are read back on startup */
+      root_props_flush();
       ob_set_state(reconfigure ? OB_STATE_RECONFIGURING : OB_STATE_EXITING);
 
       if (xmlprompt) {
@@ -386,8 +409,11 @@ gint main(gint argc, gchar** argv) {
         xmlprompt = NULL;
       }
 
-      if (!reconfigure)
+      if (!reconfigure) {
         window_unmanage_all();
+        /* let pagers know the windows are gone */
+        root_props_flush();
+      }
 
       prompt_shutdown(reconfigure);
       menu_shutdown(reconfigure);
@@ -396,6 +422,7 @@ gint main(gint argc, gchar** argv) {
       keyboard_shutdown(reconfigure);
       moveresize_shutdown(reconfigure);
       dock_shutdown(reconfigure);
+      edge_index_shutdown(reconfigure);
       client_shutdown(reconfigure);
       ping_shutdown(reconfigure);
       group_shutdown(reconfigure);
@@ -405,9 +432,13 @@ gint main(gint argc, gchar** argv) {
       focus_cycle_indicator_shutdown(reconfigure);
       focus_cycle_shutdown(reconfigure);
       focus_shutdown(reconfigure);
+      stacking_shutdown(reconfigure);
       window_shutdown(reconfigure);
       sn_shutdown(reconfigure);
+      root_props_shutdown(reconfigure);
       event_shutdown(reconfigure);
+      event_record_shutdown(reconfigure);
+      event_stats_shutdown(reconfigure);
       config_shutdown();
       actions_shutdown(reconfigure);
     } while (reconfigure);
@@ -417,6 +448,7 @@ gint main(gint argc, gchar** argv) {
 
   RrThemeFree(ob_rr_theme);
   RrImageCacheUnref(ob_rr_icons);
+  RrImageSetIconTheme(NULL, 0);
   RrInstanceFree(ob_rr_inst);
 
   session_shutdown(being_replaced);
@@ -555,6 +587,7 @@ static void print_help(void) {
   g_print(_("  --reconfigure       Reload Openbox's configuration\n"));
   g_print(_("  --restart           Restart Openbox\n"));
   g_print(_("  --exit              Exit Openbox\n"));
+  g_print(_("  --dump-stats        Save event stats to the cache directory\n"));
   g_print(_("\nDebugging options:\n"));
   g_print(_("  --sync              Run in synchronous mode\n"));
   g_print(_("  --startup CMD       Run CMD after starting\n"));
@@ -562,6 +595,8 @@ static void print_help(void) {
   g_print(_("  --debug-focus       Display debugging output for focus handling\n"));
   g_print(_("  --debug-session     Display debugging output for session management\n"));
   g_print(_("  --debug-xinerama    Split the display into fake xinerama screens\n"));
+  g_print(_("  --record-events FILE\n"
+            "                      Record the X events handled in FILE\n"));
   g_print(_("\nPlease report bugs at %s\n"), PACKAGE_BUGREPORT);
 }
 
@@ -658,6 +693,15 @@ static void parse_args(gint* argc, gchar** argv) {
     else if (!strcmp(argv[i], "--debug-xinerama")) {
       ob_debug_xinerama = TRUE;
     }
+    else if (!strcmp(argv[i], "--record-events")) {
+      if (i == *argc - 1) /* no args left */
+        g_printerr(_("%s requires an argument\n"), "--record-events");
+      else {
+        event_record_path = argv[i + 1];
+        ++i; /* skip the argument */
+        ob_debug("--record-events %s", event_record_path);
+      }
+    }
     else if (!strcmp(argv[i], "--reconfigure")) {
       remote_control = 1;
     }
@@ -667,6 +711,9 @@ static void parse_args(gint* argc, gchar** argv) {
     else if (!strcmp(argv[i], "--exit")) {
       remote_control = 3;
     }
+    else if (!strcmp(argv[i], "--dump-stats")) {
+      remote_control = 4;
+    }
     else if (!strcmp(argv[i], "--config-file")) {
       if (i == *argc - 1) /* no args left */
         g_printerr(_("%s requires an argument\n"), "--config-file");
@@ -31,20 +31,65 @@ static void make_grid(const Rect* client_rects,
                       int* y_edges,
                       int max_edges);
 
-static int best_direction(const Point* grid_point,
-                          const Rect* client_rects,
-                          int n_client_rects,
-                          const Rect* monitor,
-                          const Size* req_size,
-                          Point* best_top_left);
-
-static int total_overlap(const Rect* client_rects, int n_client_rects, const Rect* proposed_rect);
+/* The area of the client rects that lies above and to the left of each
+   grid point, counting areas covered by more than one rect more than once.
+   The coverage is constant inside each cell of the grid, so this gives the
+   total overlap of any rectangle within the grid from its four corners,
+   instead of having to look at every client rect for every rectangle. */
+typedef struct _OverlapTable {
+  const int* x_edges;
+  const int* y_edges;
+  int n_x_edges;
+  int n_y_edges;
+  gint64* sums;
+} OverlapTable;
+
+static void overlap_table_init(OverlapTable* t,
+                               const Rect* client_rects,
+                               int n_client_rects,
+                               const Rect* monitor,
+                               const int* x_edges,
+                               const int* y_edges,
+                               int max_edges);
+
+static void overlap_table_clear(OverlapTable* t);
+
+static gint64 total_overlap(const OverlapTable* t, const Rect* proposed_rect);
+
+/* The placements tried at a grid point have their edges on the grid lines
+   through it, or on the lines a window's width or height to either side of
+   those.  This is where the lines through a point fall in the grid, from
+   before it to after it. */
+typedef struct _GridLines {
+  struct {
+    int edge;  /* the grid line at or before it */
+    int delta; /* and how far past that it is */
+  } at[3];
+} GridLines;
+
+/* The overlap table along a vertical line through the grid, at each of the
+   horizontal grid lines, and how much it grows by going down through each
+   row. */
+typedef struct _OverlapColumn {
+  gint64* sums;
+  gint64* slopes;
+} OverlapColumn;
+
+static void grid_lines_init(GridLines* lines, const int* edges, int n_edges, int size);
+
+static void overlap_column_init(OverlapColumn* col, const OverlapTable* t, int x);
+
+static gint64 best_direction(const Point* grid_point,
+                             const OverlapColumn* columns,
+                             const GridLines* rows,
+                             const Rect* monitor,
+                             const Size* req_size,
+                             Point* best_top_left);
 
 static void center_in_field(Point* grid_point,
                             const Size* req_size,
                             const Rect* monitor,
-                            const Rect* client_rects,
-                            int n_client_rects,
+                            const OverlapTable* t,
                             const int* x_edges,
                             const int* y_edges,
                             int max_edges);
@@ -57,23 +102,41 @@ void place_overlap_find_least_placement(const Rect* client_rects,
                                         const Size* req_size,
                                         Point* result) {
   POINT_SET(*result, monitor->x, monitor->y);
-  int overlap = G_MAXINT;
+  gint64 overlap = G_MAXINT64;
   int max_edges = 2 * (n_client_rects + 1);
 
   int x_edges[max_edges];
   int y_edges[max_edges];
   make_grid(client_rects, n_client_rects, monitor, x_edges, y_edges, max_edges);
+  OverlapTable table;
+  overlap_table_init(&table, client_rects, n_client_rects, monitor, x_edges, y_edges, max_edges);
+
+  /* Work out where the placements at each grid point have their edges once
+     up front, and the overlap table along the three vertical lines for each
+     column of grid points, so that trying a placement only takes a few
+     lookups. */
+  GridLines rows[table.n_y_edges];
+  grid_lines_init(rows, y_edges, table.n_y_edges, req_size->height);
+  OverlapColumn columns[3];
+  int k;
+  for (k = 0; k < 3; ++k) {
+    columns[k].sums = g_new0(gint64, table.n_y_edges);
+    columns[k].slopes = g_new0(gint64, table.n_y_edges);
+  }
+
   int i;
   for (i = 0; i < max_edges; ++i) {
     if (x_edges[i] == G_MAXINT)
       break;
+    for (k = 0; k < 3; ++k)
+      overlap_column_init(&columns[k], &table, x_edges[i] + (k - 1) * req_size->width);
     int j;
     for (j = 0; j < max_edges; ++j) {
       if (y_edges[j] == G_MAXINT)
         break;
       Point grid_point = {.x = x_edges[i], .y = y_edges[j]};
       Point best_top_left;
-      int this_overlap = best_direction(&grid_point, client_rects, n_client_rects, monitor, req_size, &best_top_left);
+      gint64 this_overlap = best_direction(&grid_point, columns, &rows[j], monitor, req_size, &best_top_left);
       if (this_overlap < overlap) {
         overlap = this_overlap;
         *result = best_top_left;
@@ -85,8 +148,13 @@ void place_overlap_find_least_placement(const Rect* client_rects,
       break;
   }
   if (config_place_center && overlap == 0) {
-    center_in_field(result, req_size, monitor, client_rects, n_client_rects, x_edges, y_edges, max_edges);
+    center_in_field(result, req_size, monitor, &table, x_edges, y_edges, max_edges);
   }
+  for (k = 0; k < 3; ++k) {
+    g_free(columns[k].sums);
+    g_free(columns[k].slopes);
+  }
+  overlap_table_clear(&table);
 }
 
 static int compare_ints(const void* a, const void* b) {
@@ -138,17 +206,153 @@ static void make_grid(const Rect* client_rects,
   uniquify(y_edges, n_edges);
 }
 
-static int total_overlap(const Rect* client_rects, int n_client_rects, const Rect* proposed_rect) {
-  int overlap = 0;
-  int i;
+static int count_edges(const int* edges, int max_edges) {
+  int n = 0;
+  while (n < max_edges && edges[n] != G_MAXINT)
+    ++n;
+  return n;
+}
+
+/* Returns the grid line at or before the value */
+static int grid_position_at_or_before(int search_value, const int* edges, int n_edges) {
+  BSEARCH_SETUP();
+  BSEARCH(int, edges, 0, n_edges, search_value);
+  return BSEARCH_AT();
+}
+
+#define OVERLAP_SUM(t, i, j) ((t)->sums[(gsize)(j) * (t)->n_x_edges + (i)])
+
+static void overlap_table_init(OverlapTable* t,
+                               const Rect* client_rects,
+                               int n_client_rects,
+                               const Rect* monitor,
+                               const int* x_edges,
+                               const int* y_edges,
+                               int max_edges) {
+  t->x_edges = x_edges;
+  t->y_edges = y_edges;
+  t->n_x_edges = count_edges(x_edges, max_edges);
+  t->n_y_edges = count_edges(y_edges, max_edges);
+  t->sums = g_new0(gint64, (gsize)t->n_x_edges * t->n_y_edges);
+
+  const int nx = t->n_x_edges;
+  const int ny = t->n_y_edges;
+  int* cover = g_new0(int, (gsize)nx * ny);
+  int i, j;
+
+  /* Every rect that can overlap a placement on the monitor has its edges
+     on the grid, so mark the cells where each one starts and stops. */
   for (i = 0; i < n_client_rects; ++i) {
-    if (!RECT_INTERSECTS_RECT(*proposed_rect, client_rects[i]))
+    const Rect* r = &client_rects[i];
+    if (!RECT_INTERSECTS_RECT(*r, *monitor))
       continue;
-    Rect rtemp;
-    RECT_SET_INTERSECTION(rtemp, *proposed_rect, client_rects[i]);
-    overlap += RECT_AREA(rtemp);
+    int left = grid_position_at_or_before(r->x, x_edges, nx);
+    int top = grid_position_at_or_before(r->y, y_edges, ny);
+    int right = grid_position_at_or_before(r->x + r->width, x_edges, nx);
+    int bottom = grid_position_at_or_before(r->y + r->height, y_edges, ny);
+    cover[top * nx + left] += 1;
+    cover[top * nx + right] -= 1;
+    cover[bottom * nx + left] -= 1;
+    cover[bottom * nx + right] += 1;
   }
-  return overlap;
+
+  /* Adding those up gives the number of rects covering each cell, and
+     then the area covered above and to the left of each grid point. */
+  for (j = 0; j < ny; ++j)
+    for (i = 0; i < nx; ++i) {
+      if (i > 0)
+        cover[j * nx + i] += cover[j * nx + i - 1];
+      if (j > 0)
+        cover[j * nx + i] += cover[(j - 1) * nx + i];
+      if (i > 0 && j > 0)
+        cover[j * nx + i] -= cover[(j - 1) * nx + i - 1];
+    }
+  for (j = 1; j < ny; ++j)
+    for (i = 1; i < nx; ++i)
+      OVERLAP_SUM(t, i, j) = OVERLAP_SUM(t, i - 1, j) + OVERLAP_SUM(t, i, j - 1) - OVERLAP_SUM(t, i - 1, j - 1) +
+                             (gint64)cover[(j - 1) * nx + i - 1] * (x_edges[i] - x_edges[i - 1]) *
+                                 (y_edges[j] - y_edges[j - 1]);
+
+  g_free(cover);
+}
+
+static void overlap_table_clear(OverlapTable* t) {
+  g_free(t->sums);
+  t->sums = NULL;
+}
+
+/* The area of the client rects above and to the left of any point within
+   the grid.  Inside a cell it changes linearly along each axis, and the
+   divisions are exact because each cell's coverage is a whole number. */
+static gint64 overlap_before(const OverlapTable* t, int x, int y) {
+  int i = grid_position_at_or_before(x, t->x_edges, t->n_x_edges);
+  int j = grid_position_at_or_before(y, t->y_edges, t->n_y_edges);
+  int dx = x - t->x_edges[i];
+  int dy = y - t->y_edges[j];
+  gint64 s = OVERLAP_SUM(t, i, j);
+
+  if (dx) {
+    int w = t->x_edges[i + 1] - t->x_edges[i];
+    s += (OVERLAP_SUM(t, i + 1, j) - OVERLAP_SUM(t, i, j)) / w * dx;
+  }
+  if (dy) {
+    int h = t->y_edges[j + 1] - t->y_edges[j];
+    s += (OVERLAP_SUM(t, i, j + 1) - OVERLAP_SUM(t, i, j)) / h * dy;
+  }
+  if (dx && dy) {
+    int w = t->x_edges[i + 1] - t->x_edges[i];
+    int h = t->y_edges[j + 1] - t->y_edges[j];
+    gint64 cell = OVERLAP_SUM(t, i + 1, j + 1) - OVERLAP_SUM(t, i + 1, j) - OVERLAP_SUM(t, i, j + 1) +
+                  OVERLAP_SUM(t, i, j);
+    s += cell / ((gint64)w * h) * dx * dy;
+  }
+  return s;
+}
+
+static void grid_lines_init(GridLines* lines, const int* edges, int n_edges, int size) {
+  int i, k;
+
+  for (i = 0; i < n_edges; ++i)
+    for (k = 0; k < 3; ++k) {
+      int v = edges[i] + (k - 1) * size;
+      /* lines off the grid can't be the edge of a placement on the
+         monitor */
+      if (v < edges[0] || v > edges[n_edges - 1])
+        v = edges[i];
+      lines[i].at[k].edge = grid_position_at_or_before(v, edges, n_edges);
+      lines[i].at[k].delta = v - edges[lines[i].at[k].edge];
+    }
+}
+
+static void overlap_column_init(OverlapColumn* col, const OverlapTable* t, int x) {
+  const int ny = t->n_y_edges;
+  int j;
+
+  if (x < t->x_edges[0] || x > t->x_edges[t->n_x_edges - 1])
+    return;
+
+  int i = grid_position_at_or_before(x, t->x_edges, t->n_x_edges);
+  int dx = x - t->x_edges[i];
+  for (j = 0; j < ny; ++j) {
+    col->sums[j] = OVERLAP_SUM(t, i, j);
+    if (dx)
+      col->sums[j] += (OVERLAP_SUM(t, i + 1, j) - OVERLAP_SUM(t, i, j)) / (t->x_edges[i + 1] - t->x_edges[i]) * dx;
+  }
+  for (j = 0; j < ny - 1; ++j)
+    col->slopes[j] = (col->sums[j + 1] - col->sums[j]) / (t->y_edges[j + 1] - t->y_edges[j]);
+  col->slopes[ny - 1] = 0;
+}
+
+#define COLUMN_OVERLAP_BEFORE(col, lines, k) \
+  ((col)->sums[(lines)->at[k].edge] + (lines)->at[k].delta * (col)->slopes[(lines)->at[k].edge])
+
+/* The proposed rect must lie within the grid, which it does when it is on
+   the monitor */
+static gint64 total_overlap(const OverlapTable* t, const Rect* proposed_rect) {
+  int l = proposed_rect->x, r = proposed_rect->x + proposed_rect->width;
+  int u = proposed_rect->y, b = proposed_rect->y + proposed_rect->height;
+
+  return overlap_before(t, r, b) - overlap_before(t, l, b) - overlap_before(t, r, u) + overlap_before(t, l, u);
 }
 
 static int find_first_grid_position_greater_or_equal(int search_value, const int* edges, int max_edges) {
@@ -184,8 +388,7 @@ typedef struct _ExpandInfo {
   int orig_width;
   int orig_height;
   const Rect* monitor;
-  const Rect* client_rects;
-  int n_client_rects;
+  const OverlapTable* table;
   int max_edges;
 } ExpandInfo;
 
@@ -196,7 +399,7 @@ static int expand_field(int orig_edge_index, const int* edges, ExpandByMethod ex
   while (edge_index < i->max_edges - 1) {
     int next_edge_index = edge_index + 1;
     (*expand_by)(&field, edges[next_edge_index] - edges[edge_index]);
-    int overlap = total_overlap(i->client_rects, i->n_client_rects, &field);
+    gint64 overlap = total_overlap(i->table, &field);
     if (overlap != 0 || !RECT_CONTAINS_RECT(*(i->monitor), field))
       break;
     edge_index = next_edge_index;
@@ -217,8 +420,7 @@ static int expand_field(int orig_edge_index, const int* edges, ExpandByMethod ex
 static void center_in_field(Point* top_left,
                             const Size* req_size,
                             const Rect* monitor,
-                            const Rect* client_rects,
-                            int n_client_rects,
+                            const OverlapTable* t,
                             const int* x_edges,
                             const int* y_edges,
                             int max_edges) {
@@ -231,8 +433,7 @@ static void center_in_field(Point* top_left,
                   .orig_width = x_edges[orig_right_edge_index] - top_left->x,
                   .orig_height = y_edges[orig_bottom_edge_index] - top_left->y,
                   .monitor = monitor,
-                  .client_rects = client_rects,
-                  .n_client_rects = n_client_rects,
+                  .table = t,
                   .max_edges = max_edges};
   /* Try extending width. */
   int right_edge_index = expand_field(orig_right_edge_index, x_edges, expand_width, &i);
@@ -259,14 +460,14 @@ static void center_in_field(Point* top_left,
 
 #define NUM_DIRECTIONS 4
 
-static int best_direction(const Point* grid_point,
-                          const Rect* client_rects,
-                          int n_client_rects,
-                          const Rect* monitor,
-                          const Size* req_size,
-                          Point* best_top_left) {
+static gint64 best_direction(const Point* grid_point,
+                             const OverlapColumn* columns,
+                             const GridLines* rows,
+                             const Rect* monitor,
+                             const Size* req_size,
+                             Point* best_top_left) {
   static const Size directions[NUM_DIRECTIONS] = {{0, 0}, {0, -1}, {-1, 0}, {-1, -1}};
-  int overlap = G_MAXINT;
+  gint64 overlap = G_MAXINT64;
   int i;
   for (i = 0; i < NUM_DIRECTIONS; ++i) {
     Point pt = {.x = grid_point->x + (req_size->width * directions[i].width),
@@ -275,7 +476,14 @@ static int best_direction(const Point* grid_point,
     RECT_SET(r, pt.x, pt.y, req_size->width, req_size->height);
     if (!RECT_CONTAINS_RECT(*monitor, r))
       continue;
-    int this_overlap = total_overlap(client_rects, n_client_rects, &r);
+    /* the columns and rows go from a window's size before the grid point
+       to a window's size after it */
+    const OverlapColumn* left = &columns[1 + directions[i].width];
+    const OverlapColumn* right = left + 1;
+    int top = 1 + directions[i].height;
+    int bottom = top + 1;
+    gint64 this_overlap = COLUMN_OVERLAP_BEFORE(right, rows, bottom) - COLUMN_OVERLAP_BEFORE(left, rows, bottom) -
+                          COLUMN_OVERLAP_BEFORE(right, rows, top) + COLUMN_OVERLAP_BEFORE(left, rows, top);
     if (this_overlap < overlap) {
       overlap = this_overlap;
       *best_top_left = pt;
@@ -0,0 +1,174 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   placebench.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+/* Times place_overlap_find_least_placement against the search that it
+   replaced, which looked at every client rect for each spot it tried, on
+   random sets of windows.  Fails if they ever pick different places. */
+
+#include "geom.h"
+#include "place_overlap.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* place_overlap.c reads this, and centering isn't part of the search */
+gboolean config_place_center = FALSE;
+
+static int compare_ints(const void* a, const void* b) {
+  return *(const int*)a - *(const int*)b;
+}
+
+static int old_uniquify(int* edges, int n_edges) {
+  int i = 0, j = 0;
+
+  while (j < n_edges) {
+    int last = edges[j++];
+    edges[i++] = last;
+    while (j < n_edges && edges[j] == last)
+      ++j;
+  }
+  return i;
+}
+
+static int old_total_overlap(const Rect* rects, int n_rects, const Rect* proposed) {
+  int overlap = 0, i;
+
+  for (i = 0; i < n_rects; ++i) {
+    Rect rtemp;
+
+    if (!RECT_INTERSECTS_RECT(*proposed, rects[i]))
+      continue;
+    RECT_SET_INTERSECTION(rtemp, *proposed, rects[i]);
+    overlap += RECT_AREA(rtemp);
+  }
+  return overlap;
+}
+
+/* the old place_overlap_find_least_placement, without the centering */
+static void old_find_least_placement(const Rect* rects,
+                                     int n_rects,
+                                     const Rect* monitor,
+                                     const Size* req_size,
+                                     Point* result) {
+  static const Size directions[4] = {{0, 0}, {0, -1}, {-1, 0}, {-1, -1}};
+  int* x_edges = g_new(int, 2 * (n_rects + 1));
+  int* y_edges = g_new(int, 2 * (n_rects + 1));
+  int overlap = G_MAXINT;
+  int nx = 0, ny, i, j, d;
+
+  for (i = 0; i < n_rects; ++i) {
+    if (!RECT_INTERSECTS_RECT(rects[i], *monitor))
+      continue;
+    x_edges[nx] = rects[i].x;
+    y_edges[nx++] = rects[i].y;
+    x_edges[nx] = rects[i].x + rects[i].width;
+    y_edges[nx++] = rects[i].y + rects[i].height;
+  }
+  x_edges[nx] = monitor->x;
+  y_edges[nx++] = monitor->y;
+  x_edges[nx] = monitor->x + monitor->width;
+  y_edges[nx++] = monitor->y + monitor->height;
+  ny = nx;
+  qsort(x_edges, nx, sizeof(int), compare_ints);
+  nx = old_uniquify(x_edges, nx);
+  qsort(y_edges, ny, sizeof(int), compare_ints);
+  ny = old_uniquify(y_edges, ny);
+
+  POINT_SET(*result, monitor->x, monitor->y);
+  for (i = 0; i < nx && overlap; ++i)
+    for (j = 0; j < ny && overlap; ++j)
+      for (d = 0; d < 4 && overlap; ++d) {
+        Rect r;
+        int o;
+
+        RECT_SET(r, x_edges[i] + req_size->width * directions[d].width,
+                 y_edges[j] + req_size->height * directions[d].height, req_size->width, req_size->height);
+        if (!RECT_CONTAINS_RECT(*monitor, r))
+          continue;
+        o = old_total_overlap(rects, n_rects, &r);
+        if (o < overlap) {
+          overlap = o;
+          POINT_SET(*result, r.x, r.y);
+        }
+      }
+
+  g_free(x_edges);
+  g_free(y_edges);
+}
+
+/* windows of all sizes scattered over the monitor, with some hanging off
+   its edges */
+static void make_rects(GRand* rand, Rect* rects, int n, const Rect* monitor) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    int w = g_rand_int_range(rand, 50, monitor->width / 2);
+    int h = g_rand_int_range(rand, 50, monitor->height / 2);
+    RECT_SET(rects[i], g_rand_int_range(rand, monitor->x - w / 4, monitor->x + monitor->width - w * 3 / 4),
+             g_rand_int_range(rand, monitor->y - h / 4, monitor->y + monitor->height - h * 3 / 4), w, h);
+  }
+}
+
+gint main(gint argc, gchar** argv) {
+  static const int counts[] = {10, 25, 50, 100, 150, 200};
+  const gint rounds = argc > 1 ? atoi(argv[1]) : 20;
+  Rect monitor;
+  GRand* rand;
+  guint i;
+  gint failed = 0;
+
+  RECT_SET(monitor, 0, 0, 2560, 1440);
+  rand = g_rand_new_with_seed(argc > 2 ? atoi(argv[2]) : 1);
+
+  printf("%d rounds on a %dx%d monitor\n", rounds, monitor.width, monitor.height);
+  printf("%8s %10s %10s %10s\n", "windows", "old ms", "new ms", "differ");
+
+  for (i = 0; i < G_N_ELEMENTS(counts); ++i) {
+    const int n = counts[i];
+    Rect* rects = g_new(Rect, n);
+    gint64 old_time = 0, new_time = 0;
+    gint r, differ = 0;
+
+    for (r = 0; r < rounds; ++r) {
+      Size req;
+      Point a, b;
+      gint64 t0, t1, t2;
+
+      make_rects(rand, rects, n, &monitor);
+      SIZE_SET(req, g_rand_int_range(rand, 100, monitor.width / 2), g_rand_int_range(rand, 100, monitor.height / 2));
+
+      t0 = g_get_monotonic_time();
+      old_find_least_placement(rects, n, &monitor, &req, &a);
+      t1 = g_get_monotonic_time();
+      place_overlap_find_least_placement(rects, n, &monitor, &req, &b);
+      t2 = g_get_monotonic_time();
+
+      old_time += t1 - t0;
+      new_time += t2 - t1;
+      if (!POINT_EQUAL(a, b))
+        ++differ;
+    }
+
+    printf("%8d %10.2f %10.2f %10d\n", n, old_time / 1000.0, new_time / 1000.0, differ);
+    failed += differ;
+    g_free(rects);
+  }
+
+  g_rand_free(rand);
+  return failed ? 1 : 0;
+}
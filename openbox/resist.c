@@ -24,9 +24,41 @@
 #include "screen.h"
 #include "dock.h"
 #include "config.h"
+#include "edgeindex.h"
 
 #include <glib.h>
 
+static gint stacking_cmp(gconstpointer a, gconstpointer b) {
+  const guint pa = stacking_position(*(ObWindow**)a);
+  const guint pb = stacking_position(*(ObWindow**)b);
+  return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+/* finds the visible windows that line up with @c's frame in either
+   direction, since no others can stop it moving or resizing, and returns
+   them from the top of the stacking order down */
+static GPtrArray* resist_targets(ObClient* c) {
+  const Rect* a = &c->frame->area;
+  GPtrArray* found;
+  guint i, j;
+
+  found = g_ptr_array_new();
+  edge_index_find(screen_desktop, OB_ORIENTATION_HORZ, RECT_LEFT(*a), RECT_RIGHT(*a), found);
+  edge_index_find(screen_desktop, OB_ORIENTATION_VERT, RECT_TOP(*a), RECT_BOTTOM(*a), found);
+  if (screen_desktop != DESKTOP_ALL) {
+    edge_index_find(DESKTOP_ALL, OB_ORIENTATION_HORZ, RECT_LEFT(*a), RECT_RIGHT(*a), found);
+    edge_index_find(DESKTOP_ALL, OB_ORIENTATION_VERT, RECT_TOP(*a), RECT_BOTTOM(*a), found);
+  }
+
+  g_ptr_array_sort(found, stacking_cmp);
+  /* drop the windows found both ways */
+  for (i = j = 0; i < found->len; ++i)
+    if (!j || found->pdata[i] != found->pdata[j - 1])
+      found->pdata[j++] = found->pdata[i];
+  g_ptr_array_set_size(found, j);
+  return found;
+}
+
 static gboolean resist_move_window(Rect window, Rect target, gint resist, gint* x, gint* y) {
   gint l, t, r, b;     /* requested edges */
   gint cl, ct, cr, cb; /* current edges */
@@ -91,7 +123,8 @@ static gboolean resist_move_window(Rect window, Rect target, gint resist, gint*
 }
 
 void resist_move_windows(ObClient* c, gint resist, gint* x, gint* y) {
-  GList* it;
+  GPtrArray* targets;
+  guint i;
   Rect dock_area;
 
   if (!resist)
@@ -99,12 +132,9 @@ void resist_move_windows(ObClient* c, gint resist, gint* x, gint* y) {
 
   frame_client_gravity(c->frame, x, y);
 
-  for (it = stacking_list; it; it = g_list_next(it)) {
-    ObClient* target;
-
-    if (!WINDOW_IS_CLIENT(it->data))
-      continue;
-    target = it->data;
+  targets = resist_targets(c);
+  for (i = 0; i < targets->len; ++i) {
+    ObClient* target = targets->pdata[i];
 
     /* don't snap to self or non-visibles */
     if (!target->frame->visible || target == c)
@@ -116,6 +146,7 @@ void resist_move_windows(ObClient* c, gint resist, gint* x, gint* y) {
     if (resist_move_window(c->frame->area, target->frame->area, resist, x, y))
       break;
   }
+  g_ptr_array_free(targets, TRUE);
   dock_get_area(&dock_area);
   resist_move_window(c->frame->area, dock_area, resist, x, y);
 
@@ -271,17 +302,17 @@ static gboolean resist_size_window(Rect window, Rect target, gint resist, gint*
 }
 
 void resist_size_windows(ObClient* c, gint resist, gint* w, gint* h, ObDirection dir) {
-  GList* it;
+  GPtrArray* targets;
+  guint i;
   ObClient* target; /* target */
   Rect dock_area;
 
   if (!resist)
     return;
 
-  for (it = stacking_list; it; it = g_list_next(it)) {
-    if (!WINDOW_IS_CLIENT(it->data))
-      continue;
-    target = it->data;
+  targets = resist_targets(c);
+  for (i = 0; i < targets->len; ++i) {
+    target = targets->pdata[i];
 
     /* don't snap to invisibles or ourself */
     if (!target->frame->visible || target == c)
@@ -293,6 +324,7 @@ void resist_size_windows(ObClient* c, gint resist, gint* w, gint* h, ObDirection
     if (resist_size_window(c->frame->area, target->frame->area, resist, w, h, dir))
       break;
   }
+  g_ptr_array_free(targets, TRUE);
   dock_get_area(&dock_area);
   resist_size_window(c->frame->area, dock_area, resist, w, h, dir);
 }
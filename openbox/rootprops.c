@@ -0,0 +1,160 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   rootprops.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "rootprops.h"
+#include "openbox.h"
+#include "obt/display.h"
+
+#include <string.h>
+
+typedef struct _ObRootProp ObRootProp;
+
+struct _ObRootProp {
+  Atom prop;
+
+  /* the value waiting to be written */
+  Atom type;
+  gulong* val;
+  guint num;
+  gboolean dirty;
+
+  /* what was last written */
+  Atom written_type;
+  gulong* written;
+  guint written_num;
+  gboolean was_written;
+};
+
+/*! ObRootProps by their atom */
+static GHashTable* props = NULL;
+/*! The ObRootProps with values waiting to be written, in the order they were
+  first changed in, since pagers can care what order some of them change in
+  (like the number of desktops and the current desktop) */
+static GSList* dirty = NULL;
+/*! The ObRootPropsBuildFuncs to call before writing them */
+static GSList* builders = NULL;
+static guint flush_id = 0;
+
+static void prop_free(gpointer p) {
+  ObRootProp* r = p;
+
+  g_free(r->val);
+  g_free(r->written);
+  g_slice_free(ObRootProp, r);
+}
+
+void root_props_startup(gboolean reconfig) {
+  if (reconfig)
+    return;
+
+  props = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, prop_free);
+}
+
+void root_props_shutdown(gboolean reconfig) {
+  if (reconfig)
+    return;
+
+  if (flush_id)
+    g_source_remove(flush_id);
+  flush_id = 0;
+
+  /* anything still waiting is dropped, openbox is going away */
+  g_slist_free(builders);
+  builders = NULL;
+  g_slist_free(dirty);
+  dirty = NULL;
+  g_hash_table_destroy(props);
+  props = NULL;
+}
+
+static gboolean flush_func(gpointer data) {
+  flush_id = 0;
+  root_props_flush();
+  return FALSE; /* don't repeat */
+}
+
+static void schedule_flush(void) {
+  if (!flush_id)
+    flush_id = g_idle_add_full(G_PRIORITY_DEFAULT, flush_func, NULL, NULL);
+}
+
+void root_props_set_array32(Atom prop, Atom type, const gulong* val, guint num) {
+  ObRootProp* r;
+
+  if (!(r = g_hash_table_lookup(props, GUINT_TO_POINTER(prop)))) {
+    r = g_slice_new0(ObRootProp);
+    r->prop = prop;
+    g_hash_table_insert(props, GUINT_TO_POINTER(prop), r);
+  }
+
+  r->type = type;
+  r->num = num;
+  g_free(r->val);
+  r->val = num ? g_memdup2(val, num * sizeof(gulong)) : NULL;
+
+  if (!r->dirty) {
+    r->dirty = TRUE;
+    dirty = g_slist_append(dirty, r);
+  }
+  schedule_flush();
+}
+
+void root_props_set32(Atom prop, Atom type, gulong val) {
+  root_props_set_array32(prop, type, &val, 1);
+}
+
+void root_props_build(ObRootPropsBuildFunc func) {
+  if (!g_slist_find(builders, (gpointer)func))
+    builders = g_slist_append(builders, (gpointer)func);
+  schedule_flush();
+}
+
+void root_props_flush(void) {
+  if (flush_id) {
+    g_source_remove(flush_id);
+    flush_id = 0;
+  }
+
+  while (builders) {
+    ObRootPropsBuildFunc func = (ObRootPropsBuildFunc)builders->data;
+
+    builders = g_slist_delete_link(builders, builders);
+    func();
+  }
+
+  while (dirty) {
+    ObRootProp* r = dirty->data;
+
+    dirty = g_slist_delete_link(dirty, dirty);
+    r->dirty = FALSE;
+
+    /* skip it if pagers already have this value */
+    if (r->was_written && r->written_type == r->type && r->written_num == r->num &&
+        (r->num == 0 || !memcmp(r->written, r->val, r->num * sizeof(gulong))))
+      continue;
+
+    obt_prop_set_array32(obt_root(ob_screen), r->prop, r->type, r->val, r->num);
+
+    g_free(r->written);
+    r->written = r->val;
+    r->written_num = r->num;
+    r->written_type = r->type;
+    r->was_written = TRUE;
+    r->val = NULL;
+    r->num = 0;
+  }
+}
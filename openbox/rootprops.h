@@ -0,0 +1,54 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   rootprops.h for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef ob__rootprops_h
+#define ob__rootprops_h
+
+#include "obt/prop.h"
+
+#include <X11/Xlib.h>
+#include <glib.h>
+
+/*! Publishes the properties that we keep up to date on the root window.
+  Changes are written once the main loop is done with what it is handling,
+  so a pager sees one change for a whole batch of them, and a property is
+  only written when its value is different from what was last written. */
+
+typedef void (*ObRootPropsBuildFunc)(void);
+
+void root_props_startup(gboolean reconfig);
+void root_props_shutdown(gboolean reconfig);
+
+/*! Sets a property on the root window to a list of 32-bit values */
+void root_props_set_array32(Atom prop, Atom type, const gulong* val, guint num);
+/*! Sets a property on the root window to a 32-bit value */
+void root_props_set32(Atom prop, Atom type, gulong val);
+
+/*! Calls @func before the properties are written, so that properties which
+  take a while to make are only made once for all of the changes to them.
+  @func should set them with root_props_set_array32 or root_props_set32. */
+void root_props_build(ObRootPropsBuildFunc func);
+
+/*! Writes the properties that have changed now, instead of waiting for the
+  main loop */
+void root_props_flush(void);
+
+#define ROOT_PROPS_SET32(prop, type, val) (root_props_set32(OBT_PROP_ATOM(prop), OBT_PROP_ATOM(type), val))
+#define ROOT_PROPS_SETA32(prop, type, val, num) \
+  (root_props_set_array32(OBT_PROP_ATOM(prop), OBT_PROP_ATOM(type), val, num))
+
+#endif
@@ -32,6 +32,7 @@
 #include "focus.h"
 #include "focus_cycle.h"
 #include "popup.h"
+#include "rootprops.h"
 #include "version.h"
 #include "obrender/render.h"
 #include "gettext.h"
@@ -421,7 +422,7 @@ void screen_startup(gboolean reconfig) {
 
   /* don't start in showing-desktop mode */
   screen_show_desktop_mode = SCREEN_SHOW_DESKTOP_NO;
-  OBT_PROP_SET32(obt_root(ob_screen), NET_SHOWING_DESKTOP, CARDINAL, screen_showing_desktop());
+  ROOT_PROPS_SET32(NET_SHOWING_DESKTOP, CARDINAL, screen_showing_desktop());
 
   if (session_desktop_layout_present && screen_validate_layout(&session_desktop_layout)) {
     screen_desktop_layout = session_desktop_layout;
@@ -462,7 +463,7 @@ void screen_resize(void) {
   /* Set the _NET_DESKTOP_GEOMETRY hint */
   screen_physical_size.width = geometry[0] = w;
   screen_physical_size.height = geometry[1] = h;
-  OBT_PROP_SETA32(obt_root(ob_screen), NET_DESKTOP_GEOMETRY, CARDINAL, geometry, 2);
+  ROOT_PROPS_SETA32(NET_DESKTOP_GEOMETRY, CARDINAL, geometry, 2);
 
   if (ob_state() != OB_STATE_RUNNING)
     return;
@@ -486,11 +487,11 @@ void screen_set_num_desktops(guint num) {
     return;
 
   screen_num_desktops = num;
-  OBT_PROP_SET32(obt_root(ob_screen), NET_NUMBER_OF_DESKTOPS, CARDINAL, num);
+  ROOT_PROPS_SET32(NET_NUMBER_OF_DESKTOPS, CARDINAL, num);
 
   /* set the viewport hint */
   viewport = g_new0(gulong, num * 2);
-  OBT_PROP_SETA32(obt_root(ob_screen), NET_DESKTOP_VIEWPORT, CARDINAL, viewport, num * 2);
+  ROOT_PROPS_SETA32(NET_DESKTOP_VIEWPORT, CARDINAL, viewport, num * 2);
   g_free(viewport);
 
   /* the number of rows/columns will differ */
@@ -580,7 +581,7 @@ void screen_set_desktop(guint num, gboolean dofocus) {
   if (previous == num)
     return;
 
-  OBT_PROP_SET32(obt_root(ob_screen), NET_CURRENT_DESKTOP, CARDINAL, num);
+  ROOT_PROPS_SET32(NET_CURRENT_DESKTOP, CARDINAL, num);
 
   /* This whole thing decides when/how to save the screen_last_desktop so
      that it can be restored later if you want */
@@ -1202,7 +1203,7 @@ void screen_show_desktop(ObScreenShowDestopMode show_mode, ObClient* show_only)
     }
   }
 
-  OBT_PROP_SET32(obt_root(ob_screen), NET_SHOWING_DESKTOP, CARDINAL, !!showing_after);
+  ROOT_PROPS_SET32(NET_SHOWING_DESKTOP, CARDINAL, !!showing_after);
 }
 
 gboolean screen_showing_desktop() {
@@ -1390,7 +1391,7 @@ void screen_update_areas(void) {
   }
 
   /* set the legacy workarea hint to the union of all the monitors */
-  OBT_PROP_SETA32(obt_root(ob_screen), NET_WORKAREA, CARDINAL, dims, 4 * screen_num_desktops);
+  ROOT_PROPS_SETA32(NET_WORKAREA, CARDINAL, dims, 4 * screen_num_desktops);
 
   /* the area has changed, adjust all the windows if they need it */
   for (it = onscreen; it; it = g_list_next(it))
@@ -28,41 +28,193 @@
 #include "debug.h"
 #include "dock.h"
 #include "config.h"
+#include "rootprops.h"
 #include "obt/prop.h"
 
+typedef struct _ObStackingEntry ObStackingEntry;
+
+/* where a window is in the stacking_list */
+struct _ObStackingEntry {
+  GList* link;
+  /* the layer it was put in, which stays the same while it is in the list
+     even if window_layer() changes */
+  ObStackingLayer layer;
+  /* increases going down the list, with gaps so that windows can be put
+     between others without renumbering them */
+  guint order;
+};
+
 GList* stacking_list = NULL;
 GList* stacking_list_tail = NULL;
 /*! When true, stacking changes will not be reflected on the screen.  This is
   to freeze the on-screen stacking order while a window is being temporarily
   raised during focus cycling */
 static gboolean pause_changes = FALSE;
+/*! ObStackingEntrys by ObWindow */
+static GHashTable* entries = NULL;
+/*! The highest window in each layer, or NULL when a layer is empty */
+static GList* layer_first[OB_NUM_STACKING_LAYERS];
 
-void stacking_set_list(void) {
-  Window* windows = NULL;
+static void entry_free(gpointer p) {
+  g_slice_free(ObStackingEntry, p);
+}
+
+void stacking_startup(gboolean reconfig) {
+  if (reconfig)
+    return;
+
+  entries = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, entry_free);
+}
+
+void stacking_shutdown(gboolean reconfig) {
+  gint i;
+
+  if (reconfig)
+    return;
+
+  g_hash_table_destroy(entries);
+  entries = NULL;
+  g_list_free(stacking_list);
+  stacking_list = stacking_list_tail = NULL;
+  for (i = 0; i < OB_NUM_STACKING_LAYERS; ++i)
+    layer_first[i] = NULL;
+}
+
+/* number the windows again, evenly spaced, when there is no room left
+   between two of them */
+static void renumber(void) {
+  const guint step = G_MAXUINT / (g_hash_table_size(entries) + 1);
   GList* it;
-  guint i = 0;
+  guint order = 0;
 
-  /* on shutdown, don't update the properties, so that we can read it back
-     in on startup and re-stack the windows as they were before we shut down
-  */
-  if (ob_state() == OB_STATE_EXITING)
+  for (it = stacking_list; it; it = g_list_next(it)) {
+    ObStackingEntry* e = g_hash_table_lookup(entries, it->data);
+    order += step;
+    e->order = order;
+  }
+}
+
+/* puts the window in the stacking_list above @before, or at the bottom if
+   @before is NULL */
+static void list_insert(ObWindow* win, GList* before) {
+  ObStackingEntry *e, *prev, *next;
+  guint lo, hi;
+
+  g_assert(!g_hash_table_lookup(entries, win));
+
+  e = g_slice_new(ObStackingEntry);
+  if (before) {
+    stacking_list = g_list_insert_before(stacking_list, before, win);
+    e->link = before->prev;
+  }
+  else {
+    /* g_list_append() would walk the whole list to find its end */
+    e->link = g_list_alloc();
+    e->link->data = win;
+    e->link->prev = stacking_list_tail;
+    if (stacking_list_tail)
+      stacking_list_tail->next = e->link;
+    else
+      stacking_list = e->link;
+    stacking_list_tail = e->link;
+  }
+  e->layer = window_layer(win);
+  g_hash_table_insert(entries, win, e);
+
+  if (!layer_first[e->layer] || layer_first[e->layer] == before)
+    layer_first[e->layer] = e->link;
+
+  prev = e->link->prev ? g_hash_table_lookup(entries, e->link->prev->data) : NULL;
+  next = e->link->next ? g_hash_table_lookup(entries, e->link->next->data) : NULL;
+  lo = prev ? prev->order : 0;
+  hi = next ? next->order : G_MAXUINT;
+  if (hi - lo >= 2)
+    e->order = lo + (hi - lo) / 2;
+  else
+    renumber();
+}
+
+/* takes the window out of the stacking_list */
+static void list_remove(ObWindow* win) {
+  ObStackingEntry* e;
+  GList* link;
+
+  if (!entries || !(e = g_hash_table_lookup(entries, win)))
     return;
 
+  link = e->link;
+  if (layer_first[e->layer] == link) {
+    ObStackingEntry* next = link->next ? g_hash_table_lookup(entries, link->next->data) : NULL;
+    layer_first[e->layer] = next && next->layer == e->layer ? link->next : NULL;
+  }
+  if (stacking_list_tail == link)
+    stacking_list_tail = link->prev;
+  stacking_list = g_list_delete_link(stacking_list, link);
+  g_hash_table_remove(entries, win);
+}
+
+static GList* list_find(ObWindow* win) {
+  ObStackingEntry* e = entries ? g_hash_table_lookup(entries, win) : NULL;
+  return e ? e->link : NULL;
+}
+
+/* returns the highest window in the layer or any layer below it */
+static GList* layer_top(gint layer) {
+  for (; layer >= 0; --layer)
+    if (layer_first[layer])
+      return layer_first[layer];
+  return NULL;
+}
+
+/* returns the lowest window in the layer, or NULL if it is empty */
+static GList* layer_bottom(ObStackingLayer layer) {
+  GList* below;
+
+  if (!layer_first[layer])
+    return NULL;
+  below = layer_top(layer - 1);
+  return below ? g_list_previous(below) : stacking_list_tail;
+}
+
+void stacking_remove(ObWindow* win) {
+  list_remove(win);
+}
+
+static void set_list(void) {
+  Window* windows;
+  GList* it;
+  guint i = 0;
+
   /* create an array of the window ids (from bottom to top,
      reverse order!) */
-  if (stacking_list) {
-    windows = g_new(Window, g_list_length(stacking_list));
-    for (it = g_list_last(stacking_list); it; it = g_list_previous(it)) {
-      if (WINDOW_IS_CLIENT(it->data))
-        windows[i++] = WINDOW_AS_CLIENT(it->data)->window;
-    }
+  windows = g_new(Window, g_hash_table_size(entries));
+  for (it = stacking_list_tail; it; it = g_list_previous(it)) {
+    if (WINDOW_IS_CLIENT(it->data))
+      windows[i++] = WINDOW_AS_CLIENT(it->data)->window;
   }
 
-  OBT_PROP_SETA32(obt_root(ob_screen), NET_CLIENT_LIST_STACKING, WINDOW, (gulong*)windows, i);
+  ROOT_PROPS_SETA32(NET_CLIENT_LIST_STACKING, WINDOW, (gulong*)windows, i);
 
   g_free(windows);
 }
 
+void stacking_set_list(void) {
+  /* on shutdown, don't update the properties, so that we can read it back
+     in on startup and re-stack the windows as they were before we shut down
+  */
+  if (ob_state() == OB_STATE_EXITING)
+    return;
+
+  /* the list is usually changed many times while handling one event, so
+     only make it once they are done */
+  root_props_build(set_list);
+}
+
+guint stacking_position(ObWindow* win) {
+  ObStackingEntry* e = entries ? g_hash_table_lookup(entries, win) : NULL;
+  return e ? e->order : 0;
+}
+
 static void do_restack(GList* wins, GList* before) {
   GList* it;
   Window* win;
@@ -88,7 +240,7 @@ static void do_restack(GList* wins, GList* before) {
   if (before == stacking_list)
     win[0] = screen_support_win;
   else if (!before)
-    win[0] = window_top(g_list_last(stacking_list)->data);
+    win[0] = window_top(stacking_list_tail->data);
   else
     win[0] = window_top(g_list_previous(before)->data);
 
@@ -96,7 +248,7 @@ static void do_restack(GList* wins, GList* before) {
     win[i] = window_top(it->data);
     g_assert(win[i] != None); /* better not call stacking shit before
                                  setting your top level window value */
-    stacking_list = g_list_insert_before(stacking_list, before, it->data);
+    list_insert(it->data, before);
   }
 
 #ifdef DEBUG
@@ -125,14 +277,9 @@ void stacking_temp_raise(ObWindow* window) {
   g_assert(window_layer(window) < OB_STACKING_LAYER_INTERNAL);
 
   /* find the window to drop it underneath */
-  win[0] = screen_support_win;
-  for (it = stacking_list; it; it = g_list_next(it)) {
-    ObWindow* w = it->data;
-    if (window_layer(w) >= OB_STACKING_LAYER_INTERNAL)
-      win[0] = window_top(w);
-    else
-      break;
-  }
+  it = layer_top(OB_STACKING_LAYER_INTERNAL - 1);
+  it = it ? g_list_previous(it) : stacking_list_tail;
+  win[0] = it ? window_top(it->data) : screen_support_win;
 
   win[1] = window_top(window);
   start = event_start_ignore_all_enters();
@@ -148,7 +295,7 @@ void stacking_restore(void) {
   gint i;
   gulong start;
 
-  win = g_new(Window, g_list_length(stacking_list) + 1);
+  win = g_new(Window, g_hash_table_size(entries) + 1);
   win[0] = screen_support_win;
   for (i = 1, it = stacking_list; it; ++i, it = g_list_next(it))
     win[i] = window_top(it->data);
@@ -172,15 +319,10 @@ static void do_raise(GList* wins) {
     layer[l] = g_list_append(layer[l], it->data);
   }
 
-  it = stacking_list;
   for (i = OB_NUM_STACKING_LAYERS - 1; i >= 0; --i) {
     if (layer[i]) {
-      for (; it; it = g_list_next(it)) {
-        /* look for the top of the layer */
-        if (window_layer(it->data) <= (ObStackingLayer)i)
-          break;
-      }
-      do_restack(layer[i], it);
+      /* put them at the top of the layer */
+      do_restack(layer[i], layer_top(i));
       g_list_free(layer[i]);
     }
   }
@@ -198,22 +340,23 @@ static void do_lower(GList* wins) {
     layer[l] = g_list_append(layer[l], it->data);
   }
 
-  it = stacking_list;
   for (i = OB_NUM_STACKING_LAYERS - 1; i >= 0; --i) {
     if (layer[i]) {
-      for (; it; it = g_list_next(it)) {
-        /* look for the top of the next layer down */
-        if (window_layer(it->data) < (ObStackingLayer)i)
-          break;
-      }
-      do_restack(layer[i], it);
+      /* put them above the top of the next layer down */
+      do_restack(layer[i], layer_top(i - 1));
       g_list_free(layer[i]);
     }
   }
 }
 
+static gint position_cmp(gconstpointer a, gconstpointer b) {
+  const guint pa = stacking_position((ObWindow*)a);
+  const guint pb = stacking_position((ObWindow*)b);
+  return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
 static void restack_windows(ObClient* selected, gboolean raise) {
-  GList *it, *last, *below, *above, *next;
+  GList *it, *below, *above, *next;
   GList* wins = NULL;
 
   GList* group_helpers = NULL;
@@ -232,14 +375,13 @@ static void restack_windows(ObClient* selected, gboolean raise) {
   }
 
   /* remove first so we can't run into ourself */
-  it = g_list_find(stacking_list, selected);
-  g_assert(it);
-  stacking_list = g_list_delete_link(stacking_list, it);
+  g_assert(list_find(CLIENT_AS_WINDOW(selected)));
+  list_remove(CLIENT_AS_WINDOW(selected));
 
-  /* go from the bottom of the stacking list up. don't move any other windows
+  /* go from the bottom of the layer up. don't move any other windows
      when lowering, we call this for each window independently */
   if (raise) {
-    for (it = g_list_last(stacking_list); it; it = next) {
+    for (it = layer_bottom(selected->layer); it && window_layer(it->data) == selected->layer; it = next) {
       next = g_list_previous(it);
 
       if (WINDOW_IS_CLIENT(it->data)) {
@@ -269,7 +411,7 @@ static void restack_windows(ObClient* selected, gboolean raise) {
             else
               group_trans = g_list_prepend(group_trans, ch);
           }
-          stacking_list = g_list_delete_link(stacking_list, it);
+          list_remove(it->data);
         }
       }
     }
@@ -295,32 +437,14 @@ static void restack_windows(ObClient* selected, gboolean raise) {
     group_trans = NULL;
   }
 
-  /* find where to put the selected window, start from bottom of list,
-     this is the window below everything we are re-adding to the list */
-  last = NULL;
-  for (it = g_list_last(stacking_list); it; it = g_list_previous(it)) {
-    if (window_layer(it->data) < selected->layer) {
-      last = it;
-      continue;
-    }
-    /* if lowering, stop at the beginning of the layer */
-    if (!raise)
-      break;
-    /* if raising, stop at the end of the layer */
-    if (window_layer(it->data) > selected->layer)
-      break;
-
-    last = it;
-  }
-
-  /* save this position in the stacking list */
-  below = last;
+  /* find where to put the selected window, this is the window below
+     everything we are re-adding to the list. if lowering, it's at the
+     bottom of the layer, and if raising, at the top */
+  below = layer_top(raise ? selected->layer : selected->layer - 1);
 
-  /* find where to put the group transients, start from the top of list */
-  for (it = stacking_list; it; it = g_list_next(it)) {
-    /* skip past higher layers */
-    if (window_layer(it->data) > selected->layer)
-      continue;
+  /* find where to put the group transients, start from the top of the
+     layer */
+  for (it = layer_top(selected->layer); it; it = g_list_next(it)) {
     /* if we reach the end of the layer (how?) then don't go further */
     if (window_layer(it->data) < selected->layer)
       break;
@@ -343,7 +467,7 @@ static void restack_windows(ObClient* selected, gboolean raise) {
      we actually want to save 1 position _above_ that, for for loops to work
      nicely, so move back one position in the list while saving it
   */
-  above = it ? g_list_previous(it) : g_list_last(stacking_list);
+  above = it ? g_list_previous(it) : stacking_list_tail;
 
   /* put the windows inside the gap to the other windows we're stacking
      into the restacking list, go from the bottom up so that we can use
@@ -351,11 +475,11 @@ static void restack_windows(ObClient* selected, gboolean raise) {
   if (below)
     it = g_list_previous(below);
   else
-    it = g_list_last(stacking_list);
+    it = stacking_list_tail;
   for (; it != above; it = next) {
     next = g_list_previous(it);
     wins = g_list_prepend(wins, it->data);
-    stacking_list = g_list_delete_link(stacking_list, it);
+    list_remove(it->data);
   }
 
   /* group transients go above the rest of the stuff acquired to now */
@@ -368,22 +492,15 @@ static void restack_windows(ObClient* selected, gboolean raise) {
 
   /* lower our parents after us, so they go below us */
   if (!raise && selected->parents) {
-    GSList *parents_copy, *sit;
-    GSList* reorder = NULL;
-
-    parents_copy = g_slist_copy(selected->parents);
+    GSList *reorder, *sit;
 
-    /* go thru stacking list backwards so we can use g_slist_prepend */
-    for (it = g_list_last(stacking_list); it && parents_copy; it = g_list_previous(it))
-      if ((sit = g_slist_find(parents_copy, it->data))) {
-        reorder = g_slist_prepend(reorder, sit->data);
-        parents_copy = g_slist_delete_link(parents_copy, sit);
-      }
-    g_assert(parents_copy == NULL);
+    /* put them in stacking order, from the top down */
+    reorder = g_slist_sort(g_slist_copy(selected->parents), position_cmp);
 
     /* call restack for each of these to lower them */
     for (sit = reorder; sit; sit = g_slist_next(sit))
       restack_windows(sit->data, raise);
+    g_slist_free(reorder);
   }
 }
 
@@ -396,11 +513,10 @@ void stacking_raise(ObWindow* window) {
   else {
     GList* wins;
     wins = g_list_append(NULL, window);
-    stacking_list = g_list_remove(stacking_list, window);
+    list_remove(window);
     do_raise(wins);
     g_list_free(wins);
   }
-  stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_lower(ObWindow* window) {
@@ -412,11 +528,10 @@ void stacking_lower(ObWindow* window) {
   else {
     GList* wins;
     wins = g_list_append(NULL, window);
-    stacking_list = g_list_remove(stacking_list, window);
+    list_remove(window);
     do_lower(wins);
     g_list_free(wins);
   }
-  stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_below(ObWindow* window, ObWindow* below) {
@@ -426,11 +541,10 @@ void stacking_below(ObWindow* window, ObWindow* below) {
     return;
 
   wins = g_list_append(NULL, window);
-  stacking_list = g_list_remove(stacking_list, window);
-  before = g_list_next(g_list_find(stacking_list, below));
+  list_remove(window);
+  before = g_list_next(list_find(below));
   do_restack(wins, before);
   g_list_free(wins);
-  stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_add(ObWindow* win) {
@@ -440,47 +554,41 @@ void stacking_add(ObWindow* win) {
   if (WINDOW_IS_CLIENT(win))
     g_assert(WINDOW_AS_CLIENT(win)->managed);
 
-  stacking_list = g_list_append(stacking_list, win);
+  list_insert(win, NULL);
 
   stacking_raise(win);
-  /* stacking_list_tail set by stacking_raise() */
+}
+
+/* finds the highest of @c and its transients that @client could go above */
+static void find_highest_transient(ObClient* client, ObClient* c, ObStackingEntry** best) {
+  ObStackingEntry* e;
+  GSList* it;
+
+  /* only look at windows in the same layer and that are visible */
+  if (c->layer == client->layer && !c->iconic &&
+      (c->desktop == client->desktop || c->desktop == DESKTOP_ALL || client->desktop == DESKTOP_ALL) &&
+      (e = g_hash_table_lookup(entries, c)) && (!*best || e->order < (*best)->order))
+    *best = e;
+
+  for (it = c->transients; it; it = g_slist_next(it))
+    find_highest_transient(client, it->data, best);
 }
 
 static GList* find_highest_relative(ObClient* client) {
-  GList* ret = NULL;
+  ObStackingEntry* best = NULL;
 
   if (client->parents) {
-    GList* it;
-    GSList* top;
+    GSList *top, *sit;
 
     /* get all top level relatives of this client */
     top = client_search_all_top_parents_layer(client);
 
-    /* go from the top of the stacking order down */
-    for (it = stacking_list; !ret && it; it = g_list_next(it)) {
-      if (WINDOW_IS_CLIENT(it->data)) {
-        ObClient* c = it->data;
-        /* only look at windows in the same layer and that are
-           visible */
-        if (c->layer == client->layer && !c->iconic &&
-            (c->desktop == client->desktop || c->desktop == DESKTOP_ALL || client->desktop == DESKTOP_ALL)) {
-          GSList* sit;
-
-          /* go through each top level parent and see it this window
-             is related to them */
-          for (sit = top; !ret && sit; sit = g_slist_next(sit)) {
-            ObClient* topc = sit->data;
-
-            /* are they related ? */
-            if (topc == c || client_search_transient(topc, c))
-              ret = it;
-          }
-        }
-      }
-    }
+    /* go through each top level parent and the windows related to them */
+    for (sit = top; sit; sit = g_slist_next(sit))
+      find_highest_transient(client, sit->data, &best);
     g_slist_free(top);
   }
-  return ret;
+  return best ? best->link : NULL;
 }
 
 void stacking_add_nonintrusive(ObWindow* win) {
@@ -506,7 +614,7 @@ void stacking_add_nonintrusive(ObWindow* win) {
     /* nothing to put it directly above, so try find the focused client
        to put it underneath it */
     if (focus_client && client != focus_client && focus_client->layer == client->layer) {
-      it_below = g_list_find(stacking_list, focus_client);
+      it_below = list_find(CLIENT_AS_WINDOW(focus_client));
       /* this can give NULL, but it means the focused window is on the
          bottom of the stacking order, so go to the bottom in that case,
          below it */
@@ -531,24 +639,23 @@ void stacking_add_nonintrusive(ObWindow* win) {
   }
 
   /* make sure it's not in the wrong layer though ! */
-  for (; it_below; it_below = g_list_next(it_below)) {
-    /* stop when the window is not in a higher layer than the window
-       it is going above (it_below) */
-    if (client->layer >= window_layer(it_below->data))
-      break;
+  if (it_below && client->layer < window_layer(it_below->data)) {
+    /* it can't go above windows in a higher layer, so put it at the top of
+       its own layer instead */
+    it_below = layer_top(client->layer);
   }
-  for (; it_below != stacking_list; it_below = it_above) {
-    /* stop when the window is not in a lower layer than the
-       window it is going under (it_above) */
-    it_above = it_below ? g_list_previous(it_below) : g_list_last(stacking_list);
-    if (client->layer <= window_layer(it_above->data))
-      break;
+  else {
+    it_above = it_below ? g_list_previous(it_below) : stacking_list_tail;
+    if (it_above && client->layer > window_layer(it_above->data)) {
+      /* it can't go under windows in a lower layer, so put it at the
+         bottom of its own layer instead */
+      it_below = layer_top(client->layer - 1);
+    }
   }
 
   wins = g_list_append(NULL, win);
   do_restack(wins, it_below);
   g_list_free(wins);
-  stacking_list_tail = g_list_last(stacking_list);
 }
 
 /*! Returns TRUE if client is occluded by the sibling. If sibling is NULL it
@@ -566,7 +673,7 @@ static gboolean stacking_occluded(ObClient* client, ObWindow* sibling_win) {
   if (sibling && client->layer != sibling->layer)
     return FALSE;
 
-  for (it = g_list_previous(g_list_find(stacking_list, client)); it; it = g_list_previous(it))
+  for (it = g_list_previous(list_find(CLIENT_AS_WINDOW(client))); it; it = g_list_previous(it))
     if (WINDOW_IS_CLIENT(it->data)) {
       ObClient* c = it->data;
       if (!c->iconic &&
@@ -621,7 +728,7 @@ static gboolean stacking_occludes(ObClient* client, ObWindow* sibling_win) {
   if (sibling && client->layer != sibling->layer)
     return FALSE;
 
-  for (it = g_list_next(g_list_find(stacking_list, client)); it; it = g_list_next(it))
+  for (it = g_list_next(list_find(CLIENT_AS_WINDOW(client))); it; it = g_list_next(it))
     if (WINDOW_IS_CLIENT(it->data)) {
       ObClient* c = it->data;
       if (!c->iconic &&
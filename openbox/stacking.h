@@ -43,13 +43,21 @@ extern GList* stacking_list;
 /* list of ObWindow*s in stacking order from lowest to highest */
 extern GList* stacking_list_tail;
 
+void stacking_startup(gboolean reconfig);
+void stacking_shutdown(gboolean reconfig);
+
 /*! Sets the window stacking list on the root window from the
-  stacking_list */
+  stacking_list, once the current event has been handled */
 void stacking_set_list(void);
 
+/*! Returns where the window is in the stacking_list, as a number that is
+  smaller for windows nearer the top.  Only meaningful for comparing windows
+  that are both in the list. */
+guint stacking_position(struct _ObWindow* win);
+
 void stacking_add(struct _ObWindow* win);
 void stacking_add_nonintrusive(struct _ObWindow* win);
-#define stacking_remove(win) stacking_list = g_list_remove(stacking_list, win);
+void stacking_remove(struct _ObWindow* win);
 
 /*! Raises a window above all others in its stacking layer */
 void stacking_raise(struct _ObWindow* window);
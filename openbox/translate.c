@@ -150,7 +150,7 @@ gboolean translate_key(const gchar* str, guint* state, guint* keycode) {
       g_message(_("Invalid key name \"%s\" in key binding"), l);
       goto translation_fail;
     }
-    *keycode = XKeysymToKeycode(obt_display, sym);
+    *keycode = obt_keyboard_keysym_to_first_keycode(sym);
   }
   if (!*keycode) {
     g_message(_("Requested key \"%s\" does not exist on the display"), l);
@@ -108,16 +108,21 @@ void window_manage_all(void) {
   XWMHints* wmhints;
   XWindowAttributes attrib;
 
+  /* hold the server for all of them, so that their properties can be read
+     all at once up front */
+  grab_server(TRUE);
+
   if (!XQueryTree(obt_display, RootWindow(obt_display, ob_screen), &w, &w, &children, &nchild)) {
     ob_debug("XQueryTree failed in window_manage_all");
     nchild = 0;
   }
+  client_prefetch(children, nchild);
 
   /* remove all icon windows from the list */
   for (i = 0; i < nchild; i++) {
     if (children[i] == None)
       continue;
-    wmhints = XGetWMHints(obt_display, children[i]);
+    wmhints = obt_prop_get_wm_hints(children[i]);
     if (wmhints) {
       if ((wmhints->flags & IconWindowHint) && (wmhints->icon_window != children[i]))
         for (j = 0; j < nchild; j++)
@@ -145,6 +150,9 @@ void window_manage_all(void) {
 
   if (children)
     XFree(children);
+
+  obt_prop_prefetch_forget(None);
+  grab_server(FALSE);
 }
 
 static gboolean check_unmap(XEvent* e, gpointer data) {
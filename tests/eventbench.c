@@ -0,0 +1,467 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   eventbench.c for the Openbox window manager
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+/* Plays the part of some clients, which send a storm of requests to the
+   running window manager, and prints how long it took the window manager to
+   get through them.  The same requests are made every time, so runs can be
+   compared.  eventbench.py runs it against openbox and reports on it.
+
+   With --stats, openbox is asked to save its event stats before and after
+   the storm, and they are moved to stats-before.json and stats-after.json
+   in its cache directory. */
+
+#include "eventrecord.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+/* how many windows to switch between or resize */
+#define NUM_WINDOWS 10
+
+static Display* display;
+static Window root;
+static Window sync_win;
+static Atom net_request_frame_extents, net_frame_extents, net_active_window, net_supporting_wm_check, ob_control;
+
+static Window make_window(gint i, gint x, gint y, gint w, gint h) {
+  Window win;
+  gchar* title = g_strdup_printf("eventbench %d", i);
+
+  win = XCreateWindow(display, root, x, y, w, h, 0, CopyFromParent, InputOutput, CopyFromParent, 0, NULL);
+  XStoreName(display, win, title);
+  g_free(title);
+  return win;
+}
+
+static void send_message(Window win, Atom type, glong l0, glong l1, glong l2, glong l3, glong l4) {
+  XEvent msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.xclient.type = ClientMessage;
+  msg.xclient.display = display;
+  msg.xclient.window = win;
+  msg.xclient.message_type = type;
+  msg.xclient.format = 32;
+  msg.xclient.data.l[0] = l0;
+  msg.xclient.data.l[1] = l1;
+  msg.xclient.data.l[2] = l2;
+  msg.xclient.data.l[3] = l3;
+  msg.xclient.data.l[4] = l4;
+  XSendEvent(display, root, False, SubstructureNotifyMask | SubstructureRedirectMask, &msg);
+}
+
+static Bool is_frame_extents(Display* d, XEvent* e, XPointer arg) {
+  return e->type == PropertyNotify && e->xproperty.window == sync_win && e->xproperty.atom == net_frame_extents &&
+         e->xproperty.state == PropertyNewValue;
+}
+
+/* returns once the window manager has handled everything sent to it so
+   far, since it answers this request after them */
+static void sync_wm(void) {
+  XEvent e;
+
+  XDeleteProperty(display, sync_win, net_frame_extents);
+  send_message(sync_win, net_request_frame_extents, 0, 0, 0, 0, 0);
+  XIfEvent(display, &e, is_frame_extents, NULL);
+}
+
+static gboolean wait_for_wm(void) {
+  gint tries;
+
+  for (tries = 0; tries < 200; ++tries) {
+    Atom type;
+    gint format;
+    gulong n, after;
+    guchar* data = NULL;
+
+    if (XGetWindowProperty(display, root, net_supporting_wm_check, 0, 1, False, XA_WINDOW, &type, &format, &n,
+                           &after, &data) == Success &&
+        data) {
+      XFree(data);
+      if (n)
+        return TRUE;
+    }
+    g_usleep(50000);
+  }
+  return FALSE;
+}
+
+/* has openbox save its stats, and moves them to stats-NAME.json */
+static void save_stats(const gchar* name) {
+  gchar* path = g_build_filename(g_get_user_cache_dir(), "openbox", "stats.json", NULL);
+  gchar* base = g_strdup_printf("stats-%s.json", name);
+  gchar* to = g_build_filename(g_get_user_cache_dir(), "openbox", base, NULL);
+
+  send_message(root, ob_control, 4, 0, 0, 0, 0);
+  sync_wm();
+  if (g_rename(path, to) < 0)
+    fprintf(stderr, "openbox didn't save its stats in %s\n", path);
+
+  g_free(to);
+  g_free(base);
+  g_free(path);
+}
+
+static void map_windows(Window* wins, gint n) {
+  gint i;
+
+  for (i = 0; i < n; ++i) {
+    wins[i] = make_window(i, (i * 37) % 800, (i * 53) % 500, 200 + i % 100, 150 + i % 80);
+    XMapWindow(display, wins[i]);
+  }
+}
+
+static void activate_windows(Window* wins, gint n) {
+  gint i;
+
+  /* as a pager would, so focus stealing prevention doesn't get in the way */
+  for (i = 0; i < n; ++i)
+    send_message(wins[i % NUM_WINDOWS], net_active_window, 2, CurrentTime, 0, 0, 0);
+}
+
+static void resize_windows(Window* wins, gint n) {
+  gint i;
+
+  for (i = 0; i < n; ++i) {
+    const Window win = wins[i % NUM_WINDOWS];
+
+    if (i % 5 == 0)
+      XMoveResizeWindow(display, win, (i * 13) % 600, (i * 17) % 400, 200 + (i * 7) % 300, 150 + (i * 11) % 200);
+    else
+      XResizeWindow(display, win, 200 + (i * 7) % 300, 150 + (i * 11) % 200);
+  }
+}
+
+/* reading recordings from openbox --record-events */
+
+typedef struct {
+  const guchar* p;
+  const guchar* end;
+  /* set when a number is too long to be one that was written */
+  gboolean bad;
+} Reader;
+
+static guint64 get_uint(Reader* r) {
+  guint64 v = 0;
+  guint shift = 0;
+
+  while (r->p < r->end) {
+    const guchar b = *r->p++;
+
+    if (shift >= 64) {
+      r->bad = TRUE;
+      r->p = r->end;
+      return 0;
+    }
+    v |= (guint64)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      break;
+    shift += 7;
+  }
+  return v;
+}
+
+static gint64 get_int(Reader* r) {
+  const guint64 v = get_uint(r);
+  return (gint64)(v >> 1) ^ -(gint64)(v & 1);
+}
+
+/* what clients can ask for in messages, that make sense to play back */
+static const gchar* const replayed_messages[] = {
+    "_NET_ACTIVE_WINDOW",  "_NET_CLOSE_WINDOW", "_NET_CURRENT_DESKTOP", "_NET_MOVERESIZE_WINDOW",
+    "_NET_RESTACK_WINDOW", "_NET_WM_DESKTOP",   "_NET_WM_STATE",        "WM_CHANGE_STATE",
+    NULL,
+};
+
+/* properties that clients change, and can be played back without their
+   real values */
+static const gchar* const replayed_titles[] = {
+    "WM_NAME",
+    "_NET_WM_NAME",
+    "WM_ICON_NAME",
+    "_NET_WM_ICON_NAME",
+    NULL,
+};
+
+static gboolean in_list(const gchar* const* list, const gchar* s) {
+  for (; s && *list; ++list)
+    if (!strcmp(*list, s))
+      return TRUE;
+  return FALSE;
+}
+
+/* the atom on this server with the name of one that was recorded */
+static Atom replay_atom(GHashTable* atoms, guint64 recorded) {
+  const gchar* name = g_hash_table_lookup(atoms, GSIZE_TO_POINTER(recorded));
+
+  return name && *name ? XInternAtom(display, name, False) : None;
+}
+
+static Window replay_window(GHashTable* windows, guint64 recorded) {
+  if (recorded == 0)
+    return root;
+  return GPOINTER_TO_SIZE(g_hash_table_lookup(windows, GSIZE_TO_POINTER(recorded)));
+}
+
+static gboolean replay(const gchar* path, gulong* replayed, gulong* skipped) {
+  GHashTable* atoms = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  GHashTable* windows = g_hash_table_new(g_direct_hash, g_direct_equal);
+  gchar* contents;
+  gsize len;
+  Reader r;
+  gulong user_time = 1;
+  guint64 version;
+
+  if (!g_file_get_contents(path, &contents, &len, NULL) || len < sizeof(OB_EVENT_RECORD_MAGIC) ||
+      memcmp(contents, OB_EVENT_RECORD_MAGIC, sizeof(OB_EVENT_RECORD_MAGIC))) {
+    fprintf(stderr, "%s is not an event recording\n", path);
+    return FALSE;
+  }
+  r.p = (const guchar*)contents + sizeof(OB_EVENT_RECORD_MAGIC);
+  r.end = (const guchar*)contents + len;
+  r.bad = FALSE;
+  if ((version = get_uint(&r)) != OB_EVENT_RECORD_VERSION) {
+    fprintf(stderr, "%s is version %u, not %d\n", path, (guint)version, OB_EVENT_RECORD_VERSION);
+    return FALSE;
+  }
+
+  *replayed = *skipped = 0;
+  while (r.p < r.end) {
+    const guint64 kind = get_uint(&r);
+    guint64 type, recorded;
+    Window win;
+
+    if (kind == OB_EVENT_RECORD_ATOM) {
+      const guint64 atom = get_uint(&r);
+      const guint64 n = MIN(get_uint(&r), (guint64)(r.end - r.p));
+
+      g_hash_table_insert(atoms, GSIZE_TO_POINTER(atom), g_strndup((const gchar*)r.p, n));
+      r.p += n;
+      continue;
+    }
+
+    type = get_uint(&r);
+    get_uint(&r); /* the time, they are played back as fast as possible */
+    recorded = get_uint(&r);
+    win = replay_window(windows, recorded);
+
+    switch (type) {
+      case MapRequest: {
+        const gint x = get_int(&r);
+        const gint y = get_int(&r);
+        const gint w = get_uint(&r);
+        const gint h = get_uint(&r);
+
+        if (!win) {
+          const gint i = g_hash_table_size(windows);
+
+          /* the window was gone before it could be looked at */
+          win = w ? make_window(i, x, y, w, MAX(1, h)) : make_window(i, 0, 0, 300, 200);
+          g_hash_table_insert(windows, GSIZE_TO_POINTER(recorded), GSIZE_TO_POINTER(win));
+        }
+        XMapWindow(display, win);
+        ++*replayed;
+        break;
+      }
+      case DestroyNotify:
+        if (win && win != root) {
+          XDestroyWindow(display, win);
+          g_hash_table_remove(windows, GSIZE_TO_POINTER(recorded));
+          ++*replayed;
+        }
+        break;
+      case ConfigureRequest: {
+        XWindowChanges xwc;
+        const guint mask = get_uint(&r) & ~CWSibling;
+
+        xwc.x = get_int(&r);
+        xwc.y = get_int(&r);
+        xwc.width = MAX(1, (gint)get_uint(&r));
+        xwc.height = MAX(1, (gint)get_uint(&r));
+        xwc.border_width = get_uint(&r);
+        xwc.stack_mode = get_uint(&r);
+        if (win && win != root) {
+          XConfigureWindow(display, win, mask, &xwc);
+          ++*replayed;
+        }
+        else
+          ++*skipped;
+        break;
+      }
+      case PropertyNotify: {
+        const gchar* name = g_hash_table_lookup(atoms, GSIZE_TO_POINTER(get_uint(&r)));
+        const gboolean deleted = get_uint(&r) == PropertyDelete;
+
+        /* the window manager changes properties on clients too, so only
+           the ones that the clients change themselves are played back */
+        if (!win || win == root || deleted)
+          break;
+        if (in_list(replayed_titles, name)) {
+          gchar* title = g_strdup_printf("eventbench %lu", *replayed);
+
+          XChangeProperty(display, win, XInternAtom(display, name, False),
+                          XInternAtom(display, name[0] == '_' ? "UTF8_STRING" : "STRING", False), 8,
+                          PropModeReplace, (guchar*)title, strlen(title));
+          g_free(title);
+          ++*replayed;
+        }
+        else if (name && !strcmp(name, "_NET_WM_USER_TIME")) {
+          ++user_time;
+          XChangeProperty(display, win, XInternAtom(display, name, False), XA_CARDINAL, 32, PropModeReplace,
+                          (guchar*)&user_time, 1);
+          ++*replayed;
+        }
+        else
+          ++*skipped;
+        break;
+      }
+      case ClientMessage: {
+        const gchar* name = g_hash_table_lookup(atoms, GSIZE_TO_POINTER(get_uint(&r)));
+        glong l[5] = {0, 0, 0, 0, 0};
+        gint i;
+
+        if (get_uint(&r) == 32)
+          for (i = 0; i < 5; ++i)
+            l[i] = get_int(&r);
+        if (win && in_list(replayed_messages, name)) {
+          /* windows given in the data are not known here */
+          if (!strcmp(name, "_NET_ACTIVE_WINDOW"))
+            l[2] = 0;
+          else if (!strcmp(name, "_NET_RESTACK_WINDOW"))
+            l[1] = 0;
+          else if (!strcmp(name, "_NET_WM_STATE")) {
+            /* the states are atoms, which differ between servers */
+            l[1] = replay_atom(atoms, l[1]);
+            l[2] = replay_atom(atoms, l[2]);
+          }
+          send_message(win, XInternAtom(display, name, False), l[0], l[1], l[2], l[3], l[4]);
+          ++*replayed;
+        }
+        else
+          ++*skipped;
+        break;
+      }
+      default:
+        /* the rest come from the server, not from clients */
+        break;
+    }
+  }
+
+  g_hash_table_destroy(windows);
+  g_hash_table_destroy(atoms);
+  g_free(contents);
+  if (r.bad) {
+    fprintf(stderr, "%s is not a valid event recording\n", path);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: eventbench [--stats] SCENARIO\n"
+          "  map N         map N windows\n"
+          "  activate N    switch between windows N times, like alt-tab\n"
+          "  resize N      resize windows N times\n"
+          "  replay FILE   play back what clients did in a file from openbox --record-events\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Window wins[NUM_WINDOWS];
+  Window* many = NULL;
+  gboolean stats = FALSE;
+  gint64 start, end;
+  gint n = 0;
+  gulong replayed = 0, skipped = 0;
+  const gchar* scenario;
+
+  if (argc > 1 && !strcmp(argv[1], "--stats")) {
+    stats = TRUE;
+    --argc;
+    ++argv;
+  }
+  if (argc != 3)
+    usage();
+  scenario = argv[1];
+  if (strcmp(scenario, "replay") && (n = atoi(argv[2])) <= 0)
+    usage();
+
+  display = XOpenDisplay(NULL);
+  if (display == NULL) {
+    fprintf(stderr, "couldn't connect to X server\n");
+    return 1;
+  }
+  root = DefaultRootWindow(display);
+  net_request_frame_extents = XInternAtom(display, "_NET_REQUEST_FRAME_EXTENTS", False);
+  net_frame_extents = XInternAtom(display, "_NET_FRAME_EXTENTS", False);
+  net_active_window = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+  net_supporting_wm_check = XInternAtom(display, "_NET_SUPPORTING_WM_CHECK", False);
+  ob_control = XInternAtom(display, "_OB_CONTROL", False);
+
+  if (!wait_for_wm()) {
+    fprintf(stderr, "no window manager is running\n");
+    return 1;
+  }
+
+  sync_win = XCreateWindow(display, root, 0, 0, 1, 1, 0, CopyFromParent, InputOutput, CopyFromParent, 0, NULL);
+  XSelectInput(display, sync_win, PropertyChangeMask);
+
+  /* the windows to switch between and resize are there before the storm */
+  if (!strcmp(scenario, "activate") || !strcmp(scenario, "resize")) {
+    map_windows(wins, NUM_WINDOWS);
+    sync_wm();
+  }
+
+  if (stats)
+    save_stats("before");
+
+  start = g_get_monotonic_time();
+  if (!strcmp(scenario, "map")) {
+    many = g_new(Window, n);
+    map_windows(many, n);
+  }
+  else if (!strcmp(scenario, "activate"))
+    activate_windows(wins, n);
+  else if (!strcmp(scenario, "resize"))
+    resize_windows(wins, n);
+  else if (!strcmp(scenario, "replay")) {
+    if (!replay(argv[2], &replayed, &skipped))
+      return 1;
+  }
+  else
+    usage();
+  sync_wm();
+  end = g_get_monotonic_time();
+
+  if (stats)
+    save_stats("after");
+
+  printf("elapsed_us %" G_GINT64_FORMAT "\n", end - start);
+  if (!strcmp(scenario, "replay"))
+    printf("replayed %lu\nskipped %lu\n", replayed, skipped);
+
+  /* the windows go away with the connection */
+  g_free(many);
+  XCloseDisplay(display);
+  return 0;
+}
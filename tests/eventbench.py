@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""
+eventbench.py - Times how openbox copes with storms of requests from clients
+
+Runs openbox on the current display, has eventbench play the clients, and
+reports how quickly openbox handled the events they caused, from the stats
+that openbox saves with --dump-stats.
+
+usage: eventbench.py OPENBOX EVENTBENCH SCENARIO ARG
+  SCENARIO is one of eventbench's, or record-replay, which records what
+  openbox sees during the resize scenario, and then times playing the
+  recording back to a new openbox.
+"""
+
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+SUB_BITS = 3
+
+
+def bucket_high(low):
+    """The largest time in the histogram bucket starting at low"""
+    if low < (1 << SUB_BITS):
+        return low
+    return low + (1 << (low.bit_length() - 1 - SUB_BITS)) - 1
+
+
+def setup_dirs(tmp):
+    """Gives openbox its own cache, and a theme and config from the source
+    tree, in case it isn't installed"""
+    top = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    config = os.path.join(tmp, 'config', 'openbox')
+    os.makedirs(os.path.join(tmp, 'data'))
+    os.makedirs(config)
+    os.symlink(os.path.join(top, 'themes'), os.path.join(tmp, 'data', 'themes'))
+    shutil.copy(os.path.join(top, 'data', 'rc.xml'), config)
+
+    env = dict(os.environ)
+    env['XDG_CACHE_HOME'] = os.path.join(tmp, 'cache')
+    env['XDG_CONFIG_HOME'] = os.path.join(tmp, 'config')
+    env['XDG_DATA_DIRS'] = os.path.join(tmp, 'data') + ':' + env.get('XDG_DATA_DIRS', '/usr/local/share:/usr/share')
+    return env
+
+
+def run(openbox, eventbench, args, record=None):
+    """Runs a scenario against a new openbox, and returns what eventbench
+    printed and the stats from before and after it"""
+    tmp = tempfile.mkdtemp(prefix='eventbench')
+    try:
+        env = setup_dirs(tmp)
+        cmd = [openbox, '--sm-disable']
+        if record:
+            cmd += ['--record-events', record]
+        wm = subprocess.Popen(cmd, env=env)
+        try:
+            out = subprocess.run([eventbench, '--stats'] + args, env=env, check=True, timeout=600,
+                                 stdout=subprocess.PIPE, universal_newlines=True).stdout
+        finally:
+            wm.terminate()
+            wm.wait()
+
+        printed = dict(line.split(None, 1) for line in out.splitlines() if line.strip())
+        stats = []
+        for name in ('before', 'after'):
+            with open(os.path.join(tmp, 'cache', 'openbox', 'stats-%s.json' % name)) as f:
+                stats.append(json.load(f))
+        return printed, stats[0], stats[1]
+    finally:
+        shutil.rmtree(tmp)
+
+
+def difference(before, after, key, name):
+    """The counts for one type or handler that came between two stats"""
+    old = {e[key]: e for e in before[name]}
+    diff = {}
+    for e in after[name]:
+        o = old.get(e[key], {'count': 0, 'requests': 0, 'total_us': 0, 'histogram': []})
+        hist = dict((low, n) for low, n in e['histogram'])
+        for low, n in o['histogram']:
+            hist[low] -= n
+        diff[e[key]] = {
+            'count': e['count'] - o['count'],
+            'requests': e['requests'] - o['requests'],
+            'total_us': e['total_us'] - o['total_us'],
+            'histogram': hist,
+        }
+    return diff
+
+
+def percentile(hist, count, fraction):
+    want = max(1, int(count * fraction + 0.5))
+    seen = 0
+    for low in sorted(hist):
+        seen += hist[low]
+        if seen >= want:
+            return bucket_high(low)
+    return 0
+
+
+def report(name, printed, before, after):
+    handlers = difference(before, after, 'handler', 'handlers')
+    types = difference(before, after, 'type', 'types')
+    elapsed = int(printed['elapsed_us'])
+
+    count = sum(h['count'] for h in handlers.values())
+    total = sum(h['total_us'] for h in handlers.values())
+    requests = sum(h['requests'] for h in handlers.values())
+    hist = {}
+    for h in handlers.values():
+        for low, n in h['histogram'].items():
+            hist[low] = hist.get(low, 0) + n
+
+    print('%s: %d events in %.3f s' % (name, count, elapsed / 1e6))
+    print('  events/sec    %.0f' % (count / (elapsed / 1e6) if elapsed else 0))
+    print('  mean latency  %.1f us' % (total / count if count else 0))
+    print('  p99 latency   %d us' % percentile(hist, count, 0.99))
+    print('  requests      %d (%.2f per event)' % (requests, requests / count if count else 0))
+    for key in ('replayed', 'skipped'):
+        if key in printed:
+            print('  %-13s %s' % (key, printed[key].strip()))
+
+    print('  %-18s %8s %10s %10s %9s' % ('handled by', 'events', 'mean us', 'p99 us', 'requests'))
+    for what, counts in sorted(list(handlers.items()) + list(types.items()), key=lambda i: -i[1]['count']):
+        if counts['count']:
+            print('  %-18s %8d %10.1f %10d %9d' %
+                  (what, counts['count'], counts['total_us'] / counts['count'],
+                   percentile(counts['histogram'], counts['count'], 0.99), counts['requests']))
+
+
+def main():
+    if len(sys.argv) != 5:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    openbox, eventbench, scenario, arg = sys.argv[1:]
+
+    if scenario == 'record-replay':
+        fd, recording = tempfile.mkstemp(prefix='eventbench', suffix='.rec')
+        os.close(fd)
+        try:
+            n = int(arg)
+            run(openbox, eventbench, ['resize', str(n)], record=recording)
+            printed, before, after = run(openbox, eventbench, ['replay', recording])
+        finally:
+            os.unlink(recording)
+        report('replay of resize %d' % n, printed, before, after)
+    else:
+        printed, before, after = run(openbox, eventbench, [scenario, arg])
+        report('%s %s' % (scenario, arg), printed, before, after)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())